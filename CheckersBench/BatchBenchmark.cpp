@@ -0,0 +1,438 @@
+#include "StdAfx.h"
+#include "BatchBenchmark.h"
+
+#include "PerfTimer.h"
+#include "Random.h"
+
+#include <algorithm>
+#include <set>
+
+namespace
+{
+	const unsigned int kLanes = CCheckersBoardBatch::Lanes;
+	// Random games are cut off here, as the Monte Carlo playouts are.
+	const unsigned int kMaxPlies = 150;
+
+	//--------------------------------------------------------------------------------------
+	// Plays random games eight at a time, a lane taking the next game whenever its own ends.  A
+	// lane that is jumping stops with the same chance as MakeRandomMove gives.  Returns the plies
+	// played and adds the hash of every final position to checksum.
+	unsigned __int64 PlayBatchGames( unsigned int games, unsigned int seed, bool useVector, unsigned __int64& checksum )
+	{
+		CRandom random( seed );
+		CCheckersBoardBatch batch;
+		CCheckersBoardBatch::SMoves moves;
+		const CCheckersBoard opening;
+		unsigned int plies[kLanes];
+		unsigned int choices[kLanes];
+		bool active[kLanes];
+		unsigned int started = 0;
+		unsigned int running = 0;
+		for( unsigned int lane = 0; lane < kLanes; ++lane )
+		{
+			plies[lane] = 0;
+			active[lane] = ( started < games );
+			if( active[lane] )
+			{
+				batch.Load( lane, opening, Player_Red );
+				++started;
+				++running;
+			}
+		}
+
+		unsigned __int64 totalPlies = 0;
+		while( running )
+		{
+			if( useVector )
+				batch.GenerateMoves( moves );
+			else
+				batch.GenerateMovesScalar( moves );
+
+			EPlayer players[kLanes];
+			for( unsigned int lane = 0; lane < kLanes; ++lane )
+			{
+				players[lane] = batch.GetPlayer( lane );
+				choices[lane] = ~0u;
+				if( !active[lane] )
+					continue;
+
+				const bool jumping = batch.IsJumping( lane );
+				if( !jumping && ( !moves.m_counts[lane] || plies[lane] >= kMaxPlies ) )
+				{
+					CCheckersBoard board;
+					batch.Store( lane, board );
+					checksum += board.GetHashKey();
+					totalPlies += plies[lane];
+					plies[lane] = 0;
+					if( started < games )
+					{
+						batch.Load( lane, opening, Player_Red );
+						++started;
+					}
+					else
+					{
+						active[lane] = false;
+						--running;
+					}
+					continue;
+				}
+				choices[lane] = random.NextBelow( moves.m_counts[lane] + ( jumping ? 1 : 0 ) );
+			}
+
+			if( useVector )
+				batch.Apply( moves, choices );
+			else
+				batch.ApplyScalar( moves, choices );
+
+			for( unsigned int lane = 0; lane < kLanes; ++lane )
+				if( batch.GetPlayer( lane ) != players[lane] )
+					++plies[lane];
+		}
+		return totalPlies;
+	}
+
+	//--------------------------------------------------------------------------------------
+	// Plays random games one at a time with MakeRandomMove.
+	unsigned __int64 PlayBoardGames( unsigned int games, unsigned int seed, unsigned __int64& checksum )
+	{
+		CRandom random( seed );
+		unsigned __int64 totalPlies = 0;
+		for( unsigned int game = 0; game < games; ++game )
+		{
+			CCheckersBoard board;
+			EPlayer player = Player_Red;
+			unsigned int ply = 0;
+			bool reversible = false;
+			while( ply < kMaxPlies && board.MakeRandomMove( player, random, reversible ) )
+			{
+				player = CCheckersBoard::GetOpponent( player );
+				++ply;
+			}
+			checksum += board.GetHashKey();
+			totalPlies += ply;
+		}
+		return totalPlies;
+	}
+
+	//--------------------------------------------------------------------------------------
+	// Finds the square a piece of the player left and the square it reached between two
+	// positions.  Returns false unless exactly one of the player's pieces moved.
+	bool FindStep( const CCheckersBoard& before, const CCheckersBoard& after, EPlayer player, SPosition& from, SPosition& to )
+	{
+		unsigned int left = 0;
+		unsigned int reached = 0;
+		for( unsigned int x = 0; x < kBoardSize; ++x )
+		{
+			for( unsigned int y = 0; y < kBoardSize; ++y )
+			{
+				const SPosition position( x, y );
+				const bool was = ( CCheckersBoard::GetPlayerOwner( before.GetSquareState( position ) ) == player );
+				const bool is = ( CCheckersBoard::GetPlayerOwner( after.GetSquareState( position ) ) == player );
+				if( was && !is )
+				{
+					from = position;
+					++left;
+				}
+				else if( is && !was )
+				{
+					to = position;
+					++reached;
+				}
+			}
+		}
+		return left == 1 && reached == 1;
+	}
+
+	//--------------------------------------------------------------------------------------
+	void ReportGenerator( std::ostream& os, const char* name, unsigned __int64 positions, unsigned __int64 moves, unsigned __int64 us, unsigned __int64 baseUs )
+	{
+		os << "batch generator=" << name
+		   << " positions=" << positions
+		   << " moves=" << moves
+		   << " us=" << us
+		   << " nsPerPosition=" << ( positions ? us * 1000.0 / positions : 0.0 )
+		   << " speedup=" << ( us ? (double)baseUs / us : 0.0 ) << std::endl;
+	}
+
+	//--------------------------------------------------------------------------------------
+	// The games differ between the board and the batch, so speed is compared per ply.  Returns
+	// the nanoseconds per ply.
+	double ReportPlayouts( std::ostream& os, const char* name, unsigned int games, unsigned __int64 plies, unsigned __int64 us, double baseNsPerPly )
+	{
+		const double nsPerPly = plies ? us * 1000.0 / plies : 0.0;
+		os << "batch playouts=" << name
+		   << " games=" << games
+		   << " plies=" << plies
+		   << " us=" << us
+		   << " nsPerPly=" << nsPerPly
+		   << " speedup=" << ( nsPerPly > 0.0 ? ( baseNsPerPly > 0.0 ? baseNsPerPly : nsPerPly ) / nsPerPly : 0.0 ) << std::endl;
+		return nsPerPly;
+	}
+}
+
+//--------------------------------------------------------------------------------------
+CBatchBenchmark::CBatchBenchmark( unsigned int positions, unsigned int games, unsigned int repeat, unsigned int seed )
+	: m_positions( positions )
+	, m_games( games )
+	, m_repeat( repeat ? repeat : 1 )
+	, m_seed( seed )
+{
+}
+
+//--------------------------------------------------------------------------------------
+unsigned int CBatchBenchmark::Run( std::ostream& os ) const
+{
+	os << "batch simd=" << CCheckersBoardBatch::GetSimdWidth() << " lanes=" << kLanes << " positions=" << m_positions
+	   << " games=" << m_games << " repeat=" << m_repeat << std::endl;
+
+	std::vector<SSample> positions;
+	CollectPositions( positions );
+	unsigned int mismatches = Check( positions, os );
+	mismatches += CheckApply( positions, os );
+	TimeGenerators( positions, os );
+	mismatches += TimePlayouts( os );
+	return mismatches;
+}
+
+//--------------------------------------------------------------------------------------
+void CBatchBenchmark::CollectPositions( std::vector<SSample>& positions ) const
+{
+	// Every position of random games from the opening, so openings, middlegames, endgames and
+	// captures all turn up.
+	CRandom random( m_seed );
+	positions.reserve( m_positions );
+	while( positions.size() < m_positions )
+	{
+		SSample sample;
+		sample.m_toMove = Player_Red;
+		bool reversible = false;
+		for( unsigned int ply = 0; ply < kMaxPlies && positions.size() < m_positions; ++ply )
+		{
+			positions.push_back( sample );
+			if( !sample.m_board.MakeRandomMove( sample.m_toMove, random, reversible ) )
+				break;
+			sample.m_toMove = CCheckersBoard::GetOpponent( sample.m_toMove );
+		}
+	}
+}
+
+//--------------------------------------------------------------------------------------
+unsigned int CBatchBenchmark::Check( const std::vector<SSample>& positions, std::ostream& os ) const
+{
+	// A lane counts a move per piece and direction; GetMoves lists every chain a jump can make,
+	// so its moves are compared by their start and first landing square.
+	unsigned int mismatches = 0;
+	unsigned int jumpPositions = 0;
+	std::vector<CMove> moves;
+	CCheckersBoardBatch batch;
+	CCheckersBoardBatch::SMoves vectorMoves;
+	CCheckersBoardBatch::SMoves scalarMoves;
+	for( size_t first = 0; first < positions.size(); first += kLanes )
+	{
+		const unsigned int lanes = (unsigned int)( std::min )( positions.size() - first, (size_t)kLanes );
+		for( unsigned int lane = 0; lane < lanes; ++lane )
+			batch.Load( lane, positions[first + lane].m_board, positions[first + lane].m_toMove );
+		batch.GenerateMoves( vectorMoves );
+		batch.GenerateMovesScalar( scalarMoves );
+
+		for( unsigned int lane = 0; lane < lanes; ++lane )
+		{
+			const SSample& sample = positions[first + lane];
+			moves.clear();
+			sample.m_board.GetMoves( sample.m_toMove, moves );
+			std::set< std::pair<int, int> > firstSteps;
+			for( size_t i = 0; i < moves.size(); ++i )
+				firstSteps.insert( std::make_pair( moves[i].m_start.ToIndex(), moves[i].m_sequence.empty() ? -1 : moves[i].m_sequence[0].ToIndex() ) );
+
+			bool same = ( vectorMoves.m_counts[lane] == firstSteps.size() )
+				&& ( vectorMoves.m_counts[lane] == scalarMoves.m_counts[lane] )
+				&& ( vectorMoves.m_targets[lane] == scalarMoves.m_targets[lane] )
+				&& ( vectorMoves.m_jumps[lane] == scalarMoves.m_jumps[lane] );
+			for( int direction = 0; direction < CCheckersBoardBatch::DirectionCount; ++direction )
+				same = same && ( vectorMoves.m_movers[direction][lane] == scalarMoves.m_movers[direction][lane] );
+			if( !same )
+				++mismatches;
+			if( vectorMoves.m_jumps[lane] )
+				++jumpPositions;
+		}
+	}
+	os << "batch check positions=" << positions.size() << " jumpPositions=" << jumpPositions << " mismatches=" << mismatches << std::endl;
+	return mismatches;
+}
+
+//--------------------------------------------------------------------------------------
+unsigned int CBatchBenchmark::CheckApply( const std::vector<SSample>& positions, std::ostream& os ) const
+{
+	// Plays one whole move in every lane with random choices, a chain stopping early with the
+	// same chance as in the playouts.  The move played so far is read back from the lane after
+	// each step and must be one GetMoves lists.  While the lane is jumping it must hold the
+	// board that move gives, less the crowning, with the same side to move; once the move is
+	// over it must hold exactly that board, with the opponent to move.
+	CRandom random( m_seed );
+	unsigned int mismatches = 0;
+	unsigned int jumps = 0;
+	unsigned int earlyEnds = 0;
+	unsigned int crownings = 0;
+	std::vector<CMove> legal;
+	CCheckersBoardBatch batch;
+	CCheckersBoardBatch::SMoves moves;
+	for( size_t first = 0; first < positions.size(); first += kLanes )
+	{
+		const unsigned int lanes = (unsigned int)( std::min )( positions.size() - first, (size_t)kLanes );
+		CMove played[kLanes];
+		bool playing[kLanes];
+		for( unsigned int lane = 0; lane < kLanes; ++lane )
+		{
+			playing[lane] = ( lane < lanes );
+			if( playing[lane] )
+				batch.Load( lane, positions[first + lane].m_board, positions[first + lane].m_toMove );
+		}
+
+		for( bool any = ( lanes != 0 ); any; )
+		{
+			batch.GenerateMoves( moves );
+			CCheckersBoard before[kLanes];
+			unsigned int choices[kLanes];
+			for( unsigned int lane = 0; lane < kLanes; ++lane )
+			{
+				choices[lane] = ~0u;
+				if( !playing[lane] )
+					continue;
+				const bool jumping = batch.IsJumping( lane );
+				if( !jumping && !moves.m_counts[lane] )
+				{
+					playing[lane] = false;
+					continue;
+				}
+				choices[lane] = random.NextBelow( moves.m_counts[lane] + ( jumping ? 1 : 0 ) );
+				batch.Store( lane, before[lane] );
+			}
+
+			batch.Apply( moves, choices );
+
+			any = false;
+			for( unsigned int lane = 0; lane < kLanes; ++lane )
+			{
+				if( !playing[lane] )
+					continue;
+				const SSample& sample = positions[first + lane];
+				CMove& move = played[lane];
+				CCheckersBoard after;
+				const EPlayer toMove = batch.Store( lane, after );
+
+				bool same = true;
+				if( choices[lane] < moves.m_counts[lane] )
+				{
+					SPosition from;
+					SPosition to;
+					same = FindStep( before[lane], after, sample.m_toMove, from, to )
+						&& ( move.m_sequence.empty() || from == move.m_sequence.back() );
+					if( move.m_sequence.empty() )
+						move.m_start = from;
+					move.m_sequence.push_back( to );
+					if( moves.m_jumps[lane] )
+						++jumps;
+				}
+				else if( moves.m_counts[lane] )
+				{
+					++earlyEnds;
+				}
+
+				legal.clear();
+				sample.m_board.GetMoves( sample.m_toMove, legal );
+				same = same && ( std::find( legal.begin(), legal.end(), move ) != legal.end() );
+
+				const bool over = !batch.IsJumping( lane );
+				if( same )
+				{
+					CCheckersBoard expected( sample.m_board, sample.m_toMove, move );
+					const ESquareState piece = sample.m_board.GetSquareState( move.m_start );
+					if( over )
+					{
+						if( expected.GetSquareState( move.m_sequence.back() ) != piece )
+							++crownings;
+					}
+					else
+					{
+						expected.SetSquareState( move.m_sequence.back(), piece );
+					}
+					same = ( after.GetHashKey() == expected.GetHashKey() )
+						&& ( toMove == ( over ? CCheckersBoard::GetOpponent( sample.m_toMove ) : sample.m_toMove ) );
+				}
+
+				if( !same )
+					++mismatches;
+				playing[lane] = same && !over;
+				any = any || playing[lane];
+			}
+		}
+	}
+	os << "batch apply positions=" << positions.size() << " jumps=" << jumps << " earlyEnds=" << earlyEnds
+	   << " crownings=" << crownings << " mismatches=" << mismatches << std::endl;
+	return mismatches;
+}
+
+//--------------------------------------------------------------------------------------
+void CBatchBenchmark::TimeGenerators( const std::vector<SSample>& positions, std::ostream& os ) const
+{
+	std::vector<CCheckersBoardBatch> batches( ( positions.size() + kLanes - 1 ) / kLanes );
+	for( size_t i = 0; i < positions.size(); ++i )
+		batches[i / kLanes].Load( (unsigned int)( i % kLanes ), positions[i].m_board, positions[i].m_toMove );
+	const unsigned __int64 total = (unsigned __int64)batches.size() * kLanes * m_repeat;
+
+	// GetMoves builds every move list, which is what scalar callers pay for the counts.
+	std::vector<CMove> moves;
+	unsigned __int64 moveCount = 0;
+	CStopwatch stopwatch;
+	for( unsigned int pass = 0; pass < m_repeat; ++pass )
+	{
+		for( size_t i = 0; i < positions.size(); ++i )
+		{
+			moves.clear();
+			positions[i].m_board.GetMoves( positions[i].m_toMove, moves );
+			moveCount += moves.size();
+		}
+	}
+	const unsigned __int64 getMovesUs = stopwatch.GetElapsedUs();
+	ReportGenerator( os, "getmoves", (unsigned __int64)positions.size() * m_repeat, moveCount, getMovesUs, getMovesUs );
+
+	CCheckersBoardBatch::SMoves batchMoves;
+	for( int useVector = 0; useVector < 2; ++useVector )
+	{
+		moveCount = 0;
+		stopwatch.Restart();
+		for( unsigned int pass = 0; pass < m_repeat; ++pass )
+		{
+			for( size_t i = 0; i < batches.size(); ++i )
+			{
+				if( useVector )
+					batches[i].GenerateMoves( batchMoves );
+				else
+					batches[i].GenerateMovesScalar( batchMoves );
+				for( unsigned int lane = 0; lane < kLanes; ++lane )
+					moveCount += batchMoves.m_counts[lane];
+			}
+		}
+		ReportGenerator( os, useVector ? "batch" : "batchscalar", total, moveCount, stopwatch.GetElapsedUs(), getMovesUs );
+	}
+}
+
+//--------------------------------------------------------------------------------------
+unsigned int CBatchBenchmark::TimePlayouts( std::ostream& os ) const
+{
+	unsigned __int64 boardChecksum = 0;
+	CStopwatch stopwatch;
+	const unsigned __int64 boardPlies = PlayBoardGames( m_games, m_seed, boardChecksum );
+	const double boardNsPerPly = ReportPlayouts( os, "board", m_games, boardPlies, stopwatch.GetElapsedUs(), 0.0 );
+
+	// Both batch runs draw the same choices, so they must end every game the same way.
+	unsigned __int64 checksums[2] = { 0, 0 };
+	unsigned __int64 plies[2] = { 0, 0 };
+	for( int useVector = 0; useVector < 2; ++useVector )
+	{
+		stopwatch.Restart();
+		plies[useVector] = PlayBatchGames( m_games, m_seed, useVector != 0, checksums[useVector] );
+		ReportPlayouts( os, useVector ? "batch" : "batchscalar", m_games, plies[useVector], stopwatch.GetElapsedUs(), boardNsPerPly );
+	}
+	return ( plies[0] == plies[1] && checksums[0] == checksums[1] ) ? 0 : 1;
+}
@@ -0,0 +1,45 @@
+#pragma once
+
+#include "CheckersBoard.h"
+#include "CheckersBoardBatch.h"
+
+#include <iostream>
+#include <vector>
+
+//--------------------------------------------------------------------------------------
+// Move generation eight boards at a time.  Collects positions from random games, checks the
+// vector move masks against the plain 64 bit ones and the move counts against GetMoves, and
+// plays a move in every position with Apply against CCheckersBoard.  Then times GetMoves one
+// position at a time against the batch with and without the vector code.  Finally plays
+// random games in lockstep batches, a lane starting a new game whenever its game ends, against
+// the one board playout kernel.
+class CBatchBenchmark
+{
+public:
+	CBatchBenchmark( unsigned int positions, unsigned int games, unsigned int repeat, unsigned int seed );
+
+	// Returns the number of positions whose moves differ between the generators or the boards.
+	unsigned int Run( std::ostream& os ) const;
+
+private:
+	struct SSample
+	{
+		CCheckersBoard m_board;
+		EPlayer m_toMove;
+	};
+
+	// Positions collected, random games played and timing passes over the positions.
+	unsigned int m_positions;
+	unsigned int m_games;
+	unsigned int m_repeat;
+	unsigned int m_seed;
+
+	void CollectPositions( std::vector<SSample>& positions ) const;
+	unsigned int Check( const std::vector<SSample>& positions, std::ostream& os ) const;
+	// Returns the positions whose move, played a jump at a time by Apply, ends on a different
+	// board or side to move than CCheckersBoard gives.
+	unsigned int CheckApply( const std::vector<SSample>& positions, std::ostream& os ) const;
+	void TimeGenerators( const std::vector<SSample>& positions, std::ostream& os ) const;
+	// Returns the mismatches between the vector and plain Apply over the games.
+	unsigned int TimePlayouts( std::ostream& os ) const;
+};
@@ -0,0 +1,154 @@
+#include "StdAfx.h"
+#include "CacheBenchmark.h"
+
+#include "ConcurrentLearningCache.h"
+#include "Threading.h"
+
+#include <vector>
+
+namespace
+{
+	//--------------------------------------------------------------------------------------
+	// Stand-in for a transposition entry so copies cost about the same.
+	struct SBenchValue
+	{
+		unsigned int m_draft;
+		int m_score;
+		unsigned int m_scoreType;
+
+		SBenchValue() : m_draft(0), m_score(0), m_scoreType(0) {}
+		SBenchValue( unsigned int seed ) : m_draft(seed & 0xF), m_score(seed), m_scoreType(seed >> 30) {}
+	};
+
+	//--------------------------------------------------------------------------------------
+	// The baseline: one LRU cache shared behind a single lock.
+	class CLockedLearningCache
+	{
+	public:
+		CLockedLearningCache( unsigned int cacheSize ) : m_cache( cacheSize ) {}
+
+		bool Get( unsigned int key, SBenchValue& value )
+		{
+			CScopedLock<CCriticalSection> lock( m_lock );
+			SBenchValue* pValue = m_cache.Get( key );
+			if( !pValue )
+				return false;
+			value = *pValue;
+			return true;
+		}
+		void UpdateCache( unsigned int key, const SBenchValue& value )
+		{
+			CScopedLock<CCriticalSection> lock( m_lock );
+			m_cache.UpdateCache( key, value );
+		}
+
+	private:
+		CCriticalSection m_lock;
+		CLearningCache<unsigned int, SBenchValue> m_cache;
+	};
+
+	//--------------------------------------------------------------------------------------
+	inline unsigned int NextRandom( unsigned int& state )
+	{
+		// xorshift32, good enough to pick keys and operations.
+		state ^= state << 13;
+		state ^= state >> 17;
+		state ^= state << 5;
+		return state;
+	}
+}
+
+//--------------------------------------------------------------------------------------
+CCacheBenchmark::CCacheBenchmark( unsigned int cacheSize, unsigned int keyRange, unsigned int opsPerThread, unsigned int readPercent )
+	: m_cacheSize( cacheSize )
+	, m_keyRange( keyRange ? keyRange : 1 )
+	, m_opsPerThread( opsPerThread )
+	, m_readPercent( readPercent )
+{
+}
+
+//--------------------------------------------------------------------------------------
+void CCacheBenchmark::Run( std::ostream& os, unsigned int maxThreads ) const
+{
+	for( unsigned int threadCount = 1; ; threadCount <<= 1 )
+	{
+		if( threadCount > maxThreads )
+			threadCount = maxThreads;
+
+		{
+			CLockedLearningCache cache( m_cacheSize );
+			Report( os, "locked", threadCount, Measure( cache, threadCount ) );
+		}
+		{
+			CConcurrentLearningCache<unsigned int, SBenchValue> cache( m_cacheSize );
+			Report( os, "sharded", threadCount, Measure( cache, threadCount ) );
+		}
+
+		if( threadCount == maxThreads )
+			break;
+	}
+}
+
+//--------------------------------------------------------------------------------------
+template <typename TCache>
+double CCacheBenchmark::Measure( TCache& cache, unsigned int threadCount ) const
+{
+	// Warm the cache so the timed part sees a steady hit rate.
+	for( unsigned int key = 0; key < m_cacheSize && key < m_keyRange; ++key )
+		cache.UpdateCache( key, SBenchValue( key ) );
+
+	volatile LONG ready = 0;
+	volatile LONG go = 0;
+
+	std::vector<CThread*> threads( threadCount );
+	for( unsigned int i = 0; i < threadCount; ++i )
+	{
+		threads[i] = new CThread;
+		threads[i]->Start( [&, i]() {
+			unsigned int state = 0x9E3779B9 * ( i + 1 );
+			InterlockedIncrement( &ready );
+			while( !go )
+				YieldProcessor();
+
+			SBenchValue value;
+			for( unsigned int op = 0; op < m_opsPerThread; ++op )
+			{
+				unsigned int random = NextRandom( state );
+				unsigned int key = random % m_keyRange;
+				if( ( random >> 24 ) % 100 < m_readPercent )
+					cache.Get( key, value );
+				else
+					cache.UpdateCache( key, SBenchValue( random ) );
+			}
+		} );
+	}
+
+	// Start every thread at once so thread creation is not measured.
+	while( ready != (LONG)threadCount )
+		YieldProcessor();
+
+	LARGE_INTEGER start, end, frequency;
+	QueryPerformanceFrequency( &frequency );
+	QueryPerformanceCounter( &start );
+	InterlockedExchange( &go, 1 );
+	for( unsigned int i = 0; i < threadCount; ++i )
+	{
+		threads[i]->Join();
+		delete threads[i];
+	}
+	QueryPerformanceCounter( &end );
+
+	return (double)( end.QuadPart - start.QuadPart ) / (double)frequency.QuadPart;
+}
+
+//--------------------------------------------------------------------------------------
+void CCacheBenchmark::Report( std::ostream& os, const char* name, unsigned int threadCount, double seconds ) const
+{
+	double totalOps = (double)m_opsPerThread * threadCount;
+	os << "cache=" << name
+	   << " threads=" << threadCount
+	   << " ops=" << totalOps
+	   << " seconds=" << seconds
+	   << " mops=" << ( seconds > 0.0 ? totalOps / seconds / 1000000.0 : 0.0 )
+	   << std::endl;
+}
@@ -0,0 +1,27 @@
+#pragma once
+
+#include <iostream>
+
+//--------------------------------------------------------------------------------------
+// Measures cache throughput under mixed Get/UpdateCache load from many threads.
+// Compares a single CLearningCache behind one lock against CConcurrentLearningCache.
+class CCacheBenchmark
+{
+public:
+	CCacheBenchmark( unsigned int cacheSize, unsigned int keyRange, unsigned int opsPerThread, unsigned int readPercent );
+
+	// Runs every cache type with 1, 2, 4 ... maxThreads threads and prints one line per run.
+	void Run( std::ostream& os, unsigned int maxThreads ) const;
+
+private:
+	unsigned int m_cacheSize;
+	unsigned int m_keyRange;
+	unsigned int m_opsPerThread;
+	unsigned int m_readPercent;
+
+	// Returns the elapsed time in seconds for all threads to finish their operations.
+	template <typename TCache>
+	double Measure( TCache& cache, unsigned int threadCount ) const;
+
+	void Report( std::ostream& os, const char* name, unsigned int threadCount, double seconds ) const;
+};
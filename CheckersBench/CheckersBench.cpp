@@ -0,0 +1,328 @@
+// CheckersBench.cpp : Defines the entry point for the benchmark console application.
+//
+
+#include "stdafx.h"
+
+#include "BatchBenchmark.h"
+#include "CacheBenchmark.h"
+#include "CommandLine.h"
+#include "DraughtsBenchmark.h"
+#include "GeneratorBenchmark.h"
+#include "MonteCarloBenchmark.h"
+#include "NetworkBenchmark.h"
+#include "ProofBenchmark.h"
+#include "ScanBenchmark.h"
+#include "ServiceBenchmark.h"
+#include "SuiteBenchmark.h"
+#include "TableBenchmark.h"
+#include "Threading.h"
+#include "TraceRecorder.h"
+
+#include <iostream>
+using namespace std;
+
+static void PrintUsage();
+static void StartTrace( const CCommandLine& commandLine );
+static bool WriteTrace( const CCommandLine& commandLine );
+static bool LoadNetwork( const CCommandLine& commandLine, CNeuralNetwork& network );
+static bool ReadPageConfig( const CCommandLine& commandLine, SPageConfig& pages );
+
+int _tmain(int argc, _TCHAR* argv[])
+{
+	CCommandLine commandLine( argc, argv );
+	string mode = commandLine.GetPositional( 0 );
+
+	if( mode == "cache" )
+	{
+		unsigned int threads = commandLine.GetInt( "threads", CThread::GetHardwareThreadCount() );
+		CCacheBenchmark benchmark(
+			commandLine.GetInt( "size", 1 << 16 ),
+			commandLine.GetInt( "keys", 1 << 18 ),
+			commandLine.GetInt( "ops", 2000000 ),
+			commandLine.GetInt( "reads", 80 ) );
+		benchmark.Run( cout, threads ? threads : 1 );
+		return 0;
+	}
+
+	if( mode == "service" )
+	{
+		TCheckersService::SConfig config;
+		config.m_threads = commandLine.GetInt( "threads", 0 );
+		config.m_maxQueued = commandLine.GetInt( "queue", config.m_maxQueued );
+		config.m_sharedCacheSize = commandLine.GetInt( "cache", config.m_sharedCacheSize );
+		config.m_player.m_depth = commandLine.GetInt( "depth", 4 );
+		config.m_player.m_prefetch = commandLine.GetInt( "prefetch", config.m_player.m_prefetch ? 1 : 0 ) != 0;
+		if( !ReadPageConfig( commandLine, config.m_player.m_tablePages ) )
+			return 1;
+		CServiceBenchmark benchmark( config,
+			commandLine.GetInt( "games", 64 ),
+			commandLine.GetInt( "moves", 2000 ),
+			commandLine.GetInt( "budget", 0 ),
+			commandLine.GetInt( "maxPlies", 200 ) );
+		StartTrace( commandLine );
+		benchmark.Run( cout );
+		return WriteTrace( commandLine ) ? 0 : 1;
+	}
+
+	if( mode == "scan" )
+	{
+		CScanBenchmark benchmark( commandLine.GetString( "db" ), commandLine.GetInt( "depth", 0 ), commandLine.GetInt( "random", 1000000 ) );
+		if( !benchmark.Run( cout, commandLine.GetInt( "threads", 0 ) ) )
+		{
+			cout << "Unable to open " << commandLine.GetString( "db" ) << endl;
+			return 1;
+		}
+		return 0;
+	}
+
+	if( mode == "suite" )
+	{
+		CSuiteBenchmark::TPlayerConfig config;
+		config.m_lmrMoves = commandLine.GetInt( "lmrMoves", config.m_lmrMoves );
+		config.m_lmrDepth = commandLine.GetInt( "lmrDepth", config.m_lmrDepth );
+		config.m_futilityDepth = commandLine.GetInt( "futilityDepth", config.m_futilityDepth );
+		config.m_futilityMargin = commandLine.GetInt( "futilityMargin", config.m_futilityMargin );
+		config.m_razorDepth = commandLine.GetInt( "razorDepth", config.m_razorDepth );
+		config.m_razorMargin = commandLine.GetInt( "razorMargin", config.m_razorMargin );
+		config.m_hardwareCounters = commandLine.GetInt( "counters", 0 ) != 0;
+		config.m_cacheSize = commandLine.GetInt( "cache", config.m_cacheSize );
+		config.m_prefetch = commandLine.GetInt( "prefetch", config.m_prefetch ? 1 : 0 ) != 0;
+		if( !ReadPageConfig( commandLine, config.m_tablePages ) )
+			return 1;
+		CNeuralNetwork network;
+		if( commandLine.HasOption( "network" ) )
+		{
+			if( !LoadNetwork( commandLine, network ) )
+				return 1;
+			config.m_pNetwork = &network;
+		}
+		CSuiteBenchmark benchmark( config, commandLine.GetInt( "depth", 10 ), commandLine.GetInt( "seed", 1 ), commandLine.GetInt( "repeat", 3 ) );
+		StartTrace( commandLine );
+		benchmark.Run( cout );
+		return WriteTrace( commandLine ) ? 0 : 1;
+	}
+
+	if( mode == "draughts" )
+	{
+		CDraughtsBenchmark::TPlayerConfig config;
+		CDraughtsBenchmark benchmark( config, commandLine.GetInt( "perft", 6 ), commandLine.GetInt( "depth", 8 ), commandLine.GetInt( "seed", 1 ) );
+		StartTrace( commandLine );
+		benchmark.Run( cout );
+		return WriteTrace( commandLine ) ? 0 : 1;
+	}
+
+	if( mode == "network" )
+	{
+		// Without a file a random network of the same size costs the same to evaluate.
+		CNeuralNetwork network;
+		if( commandLine.HasOption( "network" ) )
+		{
+			if( !LoadNetwork( commandLine, network ) )
+				return 1;
+		}
+		else
+			network.Randomize( CCheckersBoard::NetworkInputCount, commandLine.GetInt( "seed", 1 ) );
+
+		if( commandLine.HasOption( "save" ) && !network.Save( commandLine.GetString( "save" ) ) )
+		{
+			cout << "Unable to write " << commandLine.GetString( "save" ) << endl;
+			return 1;
+		}
+		CNetworkBenchmark benchmark( network, commandLine.GetInt( "games", 200 ), commandLine.GetInt( "depth", 8 ), commandLine.GetInt( "seed", 1 ) );
+		benchmark.Run( cout );
+		return 0;
+	}
+
+	if( mode == "proof" )
+	{
+		CProofBenchmark::TSolver::SConfig config;
+		config.m_threads = commandLine.GetInt( "threads", 0 );
+		config.m_tableSize = commandLine.GetInt( "table", config.m_tableSize );
+		config.m_noProgressMoves = commandLine.GetInt( "noProgress", config.m_noProgressMoves );
+		config.m_maxNodes = commandLine.GetInt( "nodes", 20000000 );
+		config.m_timeLimitMs = commandLine.GetInt( "time", 0 );
+		config.m_reportIntervalMs = commandLine.GetInt( "report", config.m_reportIntervalMs );
+		CProofBenchmark benchmark( config );
+		return benchmark.Run( cout, commandLine.HasOption( "progress" ) ) ? 1 : 0;
+	}
+
+	if( mode == "montecarlo" )
+	{
+		CMonteCarloBenchmark::TPlayer::SConfig config;
+		config.m_timeLimitMs = commandLine.GetInt( "time", 10 );
+		config.m_playouts = commandLine.GetInt( "playouts", config.m_playouts );
+		config.m_threads = commandLine.GetInt( "threads", 0 );
+		config.m_maxNodes = commandLine.GetInt( "nodes", config.m_maxNodes );
+		config.m_virtualLoss = commandLine.GetInt( "virtualLoss", config.m_virtualLoss );
+		config.m_seed = commandLine.GetInt( "seed", 1 );
+		CMonteCarloBenchmark benchmark( config, commandLine.GetInt( "games", 20000 ), commandLine.GetInt( "match", 4 ) );
+		benchmark.Run( cout );
+		return 0;
+	}
+
+	if( mode == "batch" )
+	{
+		CBatchBenchmark benchmark( commandLine.GetInt( "positions", 100000 ), commandLine.GetInt( "games", 20000 ), commandLine.GetInt( "repeat", 10 ), commandLine.GetInt( "seed", 1 ) );
+		return benchmark.Run( cout ) ? 1 : 0;
+	}
+
+	if( mode == "generator" )
+	{
+		CGeneratorBenchmark benchmark( commandLine.GetInt( "positions", 100000 ), commandLine.GetInt( "seed", 1 ) );
+		return benchmark.Run( cout ) ? 1 : 0;
+	}
+
+	if( mode == "table" )
+	{
+		CTableBenchmark benchmark( commandLine.GetInt( "entries", 1 << 21 ), commandLine.GetInt( "probes", 4000000 ), commandLine.GetInt( "distance", 4 ), commandLine.GetInt( "seed", 1 ) );
+		benchmark.Run( cout );
+		return 0;
+	}
+
+	if( mode == "compare" )
+	{
+		string basePath = commandLine.GetPositional( 1 );
+		string newPath = commandLine.GetPositional( 2 );
+		int regressions = CSuiteBenchmark::Compare( basePath, newPath, commandLine.GetDouble( "threshold", 10.0 ), cout );
+		if( regressions < 0 )
+		{
+			cout << "Unable to read " << basePath << " or " << newPath << endl;
+			return 2;
+		}
+		return regressions ? 1 : 0;
+	}
+
+	PrintUsage();
+	return 1;
+}
+
+//--------------------------------------------------------------------------------------
+// With -trace=file the searches of a benchmark are recorded as a Chrome trace.
+static void StartTrace( const CCommandLine& commandLine )
+{
+	if( commandLine.HasOption( "trace" ) )
+		CTraceRecorder::Start( commandLine.GetInt( "traceEvents", CTraceRecorder::DefaultEventsPerThread ), commandLine.GetInt( "traceDepth", CTraceRecorder::DefaultDetailDepth ) );
+}
+
+//--------------------------------------------------------------------------------------
+static bool WriteTrace( const CCommandLine& commandLine )
+{
+	if( !commandLine.HasOption( "trace" ) )
+		return true;
+
+	CTraceRecorder::Stop();
+	string path = commandLine.GetString( "trace" );
+	if( CTraceRecorder::Write( path ) )
+		return true;
+	cout << "Unable to write " << path << endl;
+	return false;
+}
+
+//--------------------------------------------------------------------------------------
+static bool LoadNetwork( const CCommandLine& commandLine, CNeuralNetwork& network )
+{
+	string path = commandLine.GetString( "network" );
+	if( network.Load( path, CCheckersBoard::NetworkInputCount ) )
+		return true;
+	cout << "Unable to read network " << path << endl;
+	return false;
+}
+
+//--------------------------------------------------------------------------------------
+// -hugePages=1 puts large tables on huge pages; -numa=interleave or local places them.
+static bool ReadPageConfig( const CCommandLine& commandLine, SPageConfig& pages )
+{
+	pages.m_hugePages = commandLine.GetInt( "hugePages", pages.m_hugePages ? 1 : 0 ) != 0;
+	if( !commandLine.HasOption( "numa" ) )
+		return true;
+
+	string name = commandLine.GetString( "numa" );
+	pages.m_numa = SPageConfig::ParseNumaPolicy( name.c_str() );
+	if( pages.m_numa != NumaPolicyCount )
+		return true;
+	cout << "Unknown NUMA policy " << name << ", use default, interleave or local" << endl;
+	return false;
+}
+
+//--------------------------------------------------------------------------------------
+static void PrintUsage()
+{
+	cout << "usage: CheckersBench <mode> [-option=value ...]" << endl;
+	cout << endl;
+	cout << "  cache    Shared cache contention benchmark." << endl;
+	cout << "           -threads=N  maximum thread count (default: all cores)" << endl;
+	cout << "           -size=N     cache entries" << endl;
+	cout << "           -keys=N     size of the key space" << endl;
+	cout << "           -ops=N      operations per thread" << endl;
+	cout << "           -reads=P    percentage of Get calls, the rest are UpdateCache" << endl;
+	cout << "  service  Engine service load generator playing many games at once." << endl;
+	cout << "           -games=N    concurrent games" << endl;
+	cout << "           -threads=N  worker threads (default: all cores)" << endl;
+	cout << "           -moves=N    total moves to make" << endl;
+	cout << "           -depth=N    search depth" << endl;
+	cout << "           -budget=MS  time per move, 0 for fixed depth" << endl;
+	cout << "           -queue=N    waiting requests before new ones are refused" << endl;
+	cout << "           -cache=N    entries in each shared table" << endl;
+	cout << "           -maxPlies=N plies before a game is restarted" << endl;
+	cout << "           -hugePages=1 -numa=P -prefetch=1 table memory, as for suite" << endl;
+	cout << "  scan     Position database scan and random access." << endl;
+	cout << "           -db=FILE    database written by CheckersLite -replay -positions" << endl;
+	cout << "           -threads=N  scan threads (default: all cores)" << endl;
+	cout << "           -depth=N    search depth per position, 0 for the static evaluation" << endl;
+	cout << "           -random=N   random reads after the scan" << endl;
+	cout << "  suite    Fixed positions searched at every depth with seeded move order." << endl;
+	cout << "           -depth=N    deepest search" << endl;
+	cout << "           -seed=N     seed for choosing between equally scored moves" << endl;
+	cout << "           -repeat=N   searches per depth, the fastest is reported" << endl;
+	cout << "           -lmrMoves=N -lmrDepth=N -futilityDepth=N -futilityMargin=N -razorDepth=N -razorMargin=N" << endl;
+	cout << "                       search reductions and pruning, as in tournament.ini" << endl;
+	cout << "           -counters=1 hardware counters per node: the thread's cycles" << endl;
+	cout << "           -network=FILE evaluate with a neural network instead of the weights" << endl;
+	cout << "           -cache=N    entries in the transposition table" << endl;
+	cout << "           -hugePages=1 puts a large table on huge pages where the OS gives them" << endl;
+	cout << "           -numa=P     places a large table: default, interleave over the nodes or local to the searching thread" << endl;
+	cout << "           -prefetch=1 prefetches the table entries of the moves searched next" << endl;
+	cout << "  draughts 10x10 international draughts move generation and search." << endl;
+	cout << "           -perft=N    depth to count the opening move tree to, checked against the published counts" << endl;
+	cout << "           -depth=N    deepest search of the fixed positions" << endl;
+	cout << "           -seed=N     seed for choosing between equally scored moves" << endl;
+	cout << "  network  Neural evaluation cost against the weighted evaluation, per position and in a search." << endl;
+	cout << "           -network=FILE network to measure (default: random weights)" << endl;
+	cout << "           -save=FILE  writes the network measured" << endl;
+	cout << "           -games=N    random games whose positions are evaluated" << endl;
+	cout << "           -depth=N    depth of the opening search" << endl;
+	cout << "  proof    Proof-number solver over endgames with known results; exits with 1 if any is wrong." << endl;
+	cout << "           -threads=N  solver threads (default: all cores)" << endl;
+	cout << "           -table=N    entries in the solver's table" << endl;
+	cout << "           -noProgress=N moves per player without progress before a draw" << endl;
+	cout << "           -nodes=N    nodes per position before giving up, 0 for no limit" << endl;
+	cout << "           -time=MS    time per position before giving up, 0 for no limit" << endl;
+	cout << "           -progress=1 prints a progress line every -report=MS" << endl;
+	cout << "  montecarlo Monte Carlo player: playout kernels, search speed by threads and a match against alpha-beta." << endl;
+	cout << "           -time=MS    time per move, 0 to search -playouts=N playouts instead" << endl;
+	cout << "           -threads=N  most threads to search with (default: all cores)" << endl;
+	cout << "           -nodes=N    tree nodes in the pool" << endl;
+	cout << "           -virtualLoss=N losses added along the path of each running playout" << endl;
+	cout << "           -games=N    random games timed with each playout kernel" << endl;
+	cout << "           -match=N    games against the alpha-beta player" << endl;
+	cout << "           -seed=N     seed for the playouts and the match openings" << endl;
+	cout << "  batch    Move generation eight boards at a time against GetMoves; exits with 1 if the vector and plain code or the boards differ." << endl;
+	cout << "           -positions=N positions from random games to check and time" << endl;
+	cout << "           -repeat=N   timing passes over the positions" << endl;
+	cout << "           -games=N    random games played in lockstep batches and one board at a time" << endl;
+	cout << "           -seed=N     seed for the random games" << endl;
+	cout << "  generator GetMoves and IsValidMove against a copy of the original move generator; exits with 1 if they differ." << endl;
+	cout << "           -positions=N positions from random games and random placements to check" << endl;
+	cout << "           -seed=N     seed for the games and placements" << endl;
+	cout << "  table    Random transposition table probes with normal and huge pages, NUMA placements and prefetching." << endl;
+	cout << "           -entries=N  table entries, filled with positions from random games" << endl;
+	cout << "           -probes=N   random lookups timed for each setup" << endl;
+	cout << "           -distance=N lookups between prefetching an entry and reading it" << endl;
+	cout << "           -seed=N     seed for the games and the probe order" << endl;
+	cout << "  compare  Compares two suite outputs: CheckersBench compare base.txt new.txt" << endl;
+	cout << "           -threshold=P percent slower that counts as a regression; exits with 1 if any" << endl;
+	cout << endl;
+	cout << "  service, suite and draughts also take -trace=FILE to write a Chrome trace of the searches," << endl;
+	cout << "  -traceDepth=N plies of each search to show and -traceEvents=N events kept per thread." << endl;
+	cout << "  Plies are traced only in builds with COMPUTER_PLAYER_PERF_LEVEL at PERF_LEVEL_TIME, the Debug default." << endl;
+}
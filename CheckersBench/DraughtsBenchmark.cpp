@@ -0,0 +1,189 @@
+#include "StdAfx.h"
+#include "DraughtsBenchmark.h"
+
+#include "ComputerPlayer.inl"
+
+#include <sstream>
+#include <stdlib.h>
+
+namespace
+{
+	//--------------------------------------------------------------------------------------
+	struct SDraughtsPosition
+	{
+		const char* m_name;
+		const char* m_fen;
+	};
+
+	// Append new positions at the end so results of older builds still line up.
+	const SDraughtsPosition s_positions[] =
+	{
+		{ "opening",      "W:W31-50:B1-20" },
+		{ "middlegame",   "W:W27,28,31,32,33,34,36,37,38,39,40,41,43,45,47:B3,4,6,7,8,9,11,12,13,14,16,17,19,22,24" },
+		{ "endgame",      "W:WK47,28,33:B8,K19,24" },
+		// A flying king with men spread to be taken, most of the moves are long captures.
+		{ "multicapture", "W:WK46:B8,13,18,22,29,33,37,39" },
+	};
+	const size_t kPositionCount = sizeof( s_positions ) / sizeof( s_positions[0] );
+
+	// Leaves of the move tree from the opening, from the published international draughts perft.
+	const unsigned __int64 s_openingPerft[] = { 1, 9, 81, 658, 4265, 27117, 167140, 1049442, 6483961, 41022423, 258895763 };
+	const unsigned int kKnownPerftDepth = sizeof( s_openingPerft ) / sizeof( s_openingPerft[0] ) - 1;
+}
+
+//--------------------------------------------------------------------------------------
+CDraughtsBenchmark::CDraughtsBenchmark( const TPlayerConfig& config, unsigned int perftDepth, unsigned int depth, unsigned int seed )
+	: m_config( config )
+	, m_perftDepth( perftDepth )
+	, m_depth( depth )
+	, m_seed( seed )
+{
+}
+
+//--------------------------------------------------------------------------------------
+void CDraughtsBenchmark::Run( std::ostream& os ) const
+{
+	os << "draughts positions=" << kPositionCount << " perftDepth=" << m_perftDepth << " depth=" << m_depth << " seed=" << m_seed << std::endl;
+	CPerfTimer::ResetAll();
+
+	const CDraughtsBoard opening;
+	for( unsigned int depth = 1; depth <= m_perftDepth; ++depth )
+	{
+		CStopwatch stopwatch;
+		const unsigned __int64 leaves = Perft( opening, Player_Red, depth );
+		const unsigned __int64 us = stopwatch.GetElapsedUs();
+		os << "draughts perft=" << depth
+		   << " leaves=" << leaves
+		   << " us=" << us
+		   << " lps=" << ( us ? leaves * 1000000 / us : 0 );
+		if( depth <= kKnownPerftDepth )
+			os << " expected=" << s_openingPerft[depth] << ( leaves == s_openingPerft[depth] ? " ok" : " MISMATCH" );
+		os << std::endl;
+	}
+
+	unsigned __int64 totalNodes = 0;
+	unsigned __int64 totalUs = 0;
+	for( size_t p = 0; p < kPositionCount; ++p )
+	{
+		CDraughtsBoard board;
+		EPlayer toMove;
+		if( !ParseFen( s_positions[p].m_fen, board, toMove ) )
+		{
+			os << "draughts position=" << s_positions[p].m_name << " error=badFen" << std::endl;
+			continue;
+		}
+
+		for( unsigned int depth = 1; depth <= m_depth; ++depth )
+		{
+			TPlayerConfig config( m_config );
+			config.m_depth = depth;
+			config.m_seed = m_seed + (unsigned int)p;
+			CComputerPlayer<CDraughtsBoard> player( toMove, config );
+			CMove move;
+			const bool found = player.FindBestMove( board, move );
+			const SSearchStats& stats = player.GetLastSearchStats();
+
+			totalNodes += stats.m_nodes;
+			totalUs += stats.m_elapsedUs;
+			os << "draughts position=" << s_positions[p].m_name
+			   << " depth=" << depth
+			   << " nodes=" << stats.m_nodes
+			   << " us=" << stats.m_elapsedUs
+			   << " nps=" << ( stats.m_elapsedUs ? stats.m_nodes * 1000000 / stats.m_elapsedUs : 0 )
+			   << " move=" << ( found ? ToString( board, move ) : std::string( "none" ) )
+			   << std::endl;
+		}
+	}
+
+	os << "total nodes=" << totalNodes
+	   << " us=" << totalUs
+	   << " nps=" << ( totalUs ? totalNodes * 1000000 / totalUs : 0 )
+	   << std::endl;
+
+	// Nothing is printed unless instrumentation was compiled in.
+	CPerfTimer::ReportAll( os );
+}
+
+//--------------------------------------------------------------------------------------
+unsigned __int64 CDraughtsBenchmark::Perft( const CDraughtsBoard& board, EPlayer player, unsigned int depth )
+{
+	std::vector<CMove> moves;
+	board.GetMoves( player, moves );
+	// The last ply only needs counting.
+	if( depth <= 1 )
+		return moves.size();
+
+	unsigned __int64 leaves = 0;
+	const EPlayer opponent = CDraughtsBoard::GetOpponent( player );
+	for( size_t i = 0; i < moves.size(); ++i )
+		leaves += Perft( CDraughtsBoard( board, player, moves[i] ), opponent, depth - 1 );
+	return leaves;
+}
+
+//--------------------------------------------------------------------------------------
+bool CDraughtsBenchmark::ParseFen( const std::string& fen, CDraughtsBoard& board, EPlayer& toMove )
+{
+	std::istringstream fields( fen );
+	std::string field;
+	if( !std::getline( fields, field, ':' ) || ( field != "W" && field != "B" ) )
+		return false;
+	toMove = ( field == "W" ) ? Player_Red : Player_Black;
+
+	board.Clear();
+	while( std::getline( fields, field, ':' ) )
+	{
+		if( field.empty() || ( field[0] != 'W' && field[0] != 'B' ) )
+			return false;
+		const bool white = field[0] == 'W';
+
+		std::istringstream squares( field.substr( 1 ) );
+		std::string square;
+		while( std::getline( squares, square, ',' ) )
+		{
+			const bool king = !square.empty() && square[0] == 'K';
+			if( king )
+				square = square.substr( 1 );
+
+			// A single square or a range such as 31-50.
+			const size_t dash = square.find( '-' );
+			const int first = atoi( square.c_str() );
+			const int last = ( dash == std::string::npos ) ? first : atoi( square.c_str() + dash + 1 );
+			if( first < 1 || last > 50 || first > last )
+				return false;
+
+			for( int number = first; number <= last; ++number )
+			{
+				const ESquareState state = white ? ( king ? SquareState_RedKing : SquareState_Red ) : ( king ? SquareState_BlackKing : SquareState_Black );
+				board.SetSquareState( NumberToPosition( number ), state );
+			}
+		}
+	}
+	return true;
+}
+
+//--------------------------------------------------------------------------------------
+std::string CDraughtsBenchmark::ToString( const CDraughtsBoard& board, const CMove& move )
+{
+	const char separator = board.IsCapture( move ) ? 'x' : '-';
+	std::ostringstream text;
+	text << PositionToNumber( move.m_start );
+	for( size_t i = 0; i < move.m_sequence.size(); ++i )
+		text << separator << PositionToNumber( move.m_sequence[i] );
+	return text.str();
+}
+
+//--------------------------------------------------------------------------------------
+SPosition CDraughtsBenchmark::NumberToPosition( int number )
+{
+	const int row = ( number - 1 ) / 5;
+	const int column = ( ( number - 1 ) % 5 ) * 2 + ( ( row + 1 ) & 1 );
+	return SPosition( CDraughtsBoard::Size - 1 - column, CDraughtsBoard::Size - 1 - row );
+}
+
+//--------------------------------------------------------------------------------------
+int CDraughtsBenchmark::PositionToNumber( const SPosition& pos )
+{
+	const int row = CDraughtsBoard::Size - 1 - pos.m_y;
+	const int column = CDraughtsBoard::Size - 1 - pos.m_x;
+	return row * 5 + column / 2 + 1;
+}
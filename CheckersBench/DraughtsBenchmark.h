@@ -0,0 +1,41 @@
+#pragma once
+
+#include "ComputerPlayer.h"
+#include "DraughtsBoard.h"
+
+#include <iostream>
+#include <string>
+
+//--------------------------------------------------------------------------------------
+// Move generation and search throughput on the 10x10 international draughts board.  Counts
+// the leaves of the move tree from the opening (perft) to check the move generator against
+// the published counts, then searches fixed positions at every depth up to a limit like the
+// suite benchmark does.  Prints one "draughts" key=value line per measurement.
+class CDraughtsBenchmark
+{
+public:
+	typedef CComputerPlayer<CDraughtsBoard>::SConfig TPlayerConfig;
+
+	CDraughtsBenchmark( const TPlayerConfig& config, unsigned int perftDepth, unsigned int depth, unsigned int seed );
+
+	void Run( std::ostream& os ) const;
+
+	// Sets up a position from draughts FEN, e.g. "W:W31-50:B1-20", with white as red.  Squares
+	// are numbered 1 to 50 from black's side as in draughts notation.  Returns false if the
+	// string cannot be read.
+	static bool ParseFen( const std::string& fen, CDraughtsBoard& board, EPlayer& toMove );
+	// Writes a move in draughts notation, "32-28" or "28x17x8" for captures.
+	static std::string ToString( const CDraughtsBoard& board, const CMove& move );
+
+private:
+	TPlayerConfig m_config;
+	unsigned int m_perftDepth;
+	unsigned int m_depth;
+	unsigned int m_seed;
+
+	static unsigned __int64 Perft( const CDraughtsBoard& board, EPlayer player, unsigned int depth );
+	// Converts between square numbers and positions.  Numbers run along each row from the top,
+	// so they are mirrored in x to put the first square of the bottom row on a dark square.
+	static SPosition NumberToPosition( int number );
+	static int PositionToNumber( const SPosition& pos );
+};
@@ -0,0 +1,352 @@
+#include "StdAfx.h"
+#include "GeneratorBenchmark.h"
+
+#include "Pdn.h"
+#include "PerfTimer.h"
+#include "PositionDb.h"
+#include "Random.h"
+
+#include <algorithm>
+#include <iterator>
+
+namespace
+{
+	// Random games are cut off here, as in the other benchmarks.
+	const unsigned int kMaxPlies = 150;
+	// Positions whose differences are printed in full.
+	const unsigned int kReportedMismatches = 5;
+
+	//--------------------------------------------------------------------------------------
+	// The square one step from start in a direction: 0 and 1 up the rows, 2 and 3 down them.
+	// Returns false off the board.
+	bool GetNextSpace( const SPosition& start, int direction, SPosition& next )
+	{
+		const int x = start.m_x + ( ( direction & 1 ) ? -1 : 1 );
+		const int y = start.m_y + ( ( direction & 2 ) ? -1 : 1 );
+		if( x < 0 || y < 0 || x >= kBoardSize || y >= kBoardSize )
+			return false;
+		next = SPosition( x, y );
+		return true;
+	}
+
+	//--------------------------------------------------------------------------------------
+	// Determines if the sequence has a loop at the end, the original guard against kings going
+	// round in circles.
+	bool EndsInLoop( const std::vector<SPosition>& sequence )
+	{
+		size_t maxLoopSize = sequence.size() >> 1;
+		for( size_t testSize = 2; testSize <= maxLoopSize; ++testSize )
+		{
+			bool found = true;
+			for( int i1 = (int)sequence.size() - 1, i2 = (int)( sequence.size() - 1 - testSize ); i1 >= 0 && i2 >= 0; i1--, i2-- )
+			{
+				if( sequence[i1] != sequence[i2] )
+				{
+					found = false;
+					break;
+				}
+			}
+			if( found )
+				return true;
+		}
+		return false;
+	}
+
+	//--------------------------------------------------------------------------------------
+	// The square jumped going from one square to the other.
+	SPosition GetMiddle( const SPosition& from, const SPosition& to )
+	{
+		return SPosition( ( from.m_x + to.m_x ) / 2, ( from.m_y + to.m_y ) / 2 );
+	}
+
+	//--------------------------------------------------------------------------------------
+	// Returns true if the last jump of a chain takes a piece an earlier jump already took.
+	bool JumpsTwice( const CMove& move )
+	{
+		const size_t last = move.m_sequence.size() - 1;
+		const SPosition lastMiddle = GetMiddle( last ? move.m_sequence[last - 1] : move.m_start, move.m_sequence[last] );
+		SPosition from = move.m_start;
+		for( size_t i = 0; i < last; ++i )
+		{
+			if( GetMiddle( from, move.m_sequence[i] ) == lastMiddle )
+				return true;
+			from = move.m_sequence[i];
+		}
+		return false;
+	}
+
+	//--------------------------------------------------------------------------------------
+	// The original AddNextJumpMoves: extends a copy of the chain by every jump from its last
+	// square, checks the whole chain as the original IsValidMove did, and recurses.
+	void AddReferenceJumps( const CCheckersBoard& board, EPlayer player, bool isKing, const CMove& chain, std::vector<CMove>& moves, unsigned int& recaptures )
+	{
+		const EPlayer opponent = CCheckersBoard::GetOpponent( player );
+		const SPosition from = chain.m_sequence.empty() ? chain.m_start : chain.m_sequence.back();
+		const SPosition prev = ( chain.m_sequence.size() > 1 ) ? chain.m_sequence[ chain.m_sequence.size() - 2 ] : chain.m_start;
+
+		CMove test( chain );
+		test.m_sequence.push_back( SPosition() );
+
+		// Kings go all four ways, red men only up the rows and black men only down them.
+		const int colorOffset = ( isKing || player == Player_Red ) ? 0 : 2;
+		const int moveCount = isKing ? 4 : 2;
+		for( int direction = colorOffset; direction < colorOffset + moveCount; ++direction )
+		{
+			SPosition middle;
+			SPosition& landing = test.m_sequence.back();
+			if( !GetNextSpace( from, direction, middle ) || CCheckersBoard::GetPlayerOwner( board.GetSquareState( middle ) ) != opponent )
+				continue;
+			if( !GetNextSpace( middle, direction, landing ) || board.GetSquareState( landing ) != SquareState_Blank )
+				continue;
+
+			// The original rules: no jumping straight back, and for kings no repeated loop.
+			if( !chain.m_sequence.empty() && landing == prev )
+				continue;
+			if( isKing && EndsInLoop( test.m_sequence ) )
+				continue;
+
+			// What the original let through by taking the same piece twice.
+			if( JumpsTwice( test ) )
+			{
+				++recaptures;
+				continue;
+			}
+
+			moves.push_back( test );
+			AddReferenceJumps( board, player, isKing, test, moves, recaptures );
+		}
+	}
+
+	//--------------------------------------------------------------------------------------
+	// The original GetMoves, walking the board a column at a time.  Jumps are forced, so simple
+	// moves only count when no piece can jump.
+	void GetReferenceMoves( const CCheckersBoard& board, EPlayer player, std::vector<CMove>& moves, unsigned int& recaptures )
+	{
+		std::vector<CMove> simpleMoves;
+		moves.clear();
+		for( int x = 0; x < kBoardSize; ++x )
+		{
+			for( int y = 0; y < kBoardSize; ++y )
+			{
+				const SPosition start( x, y );
+				const ESquareState state = board.GetSquareState( start );
+				if( CCheckersBoard::GetPlayerOwner( state ) != player )
+					continue;
+
+				const bool isKing = CCheckersBoard::IsKing( state );
+				CMove chain;
+				chain.m_start = start;
+				AddReferenceJumps( board, player, isKing, chain, moves, recaptures );
+
+				CMove test;
+				test.m_start = start;
+				test.m_sequence.resize( 1 );
+				const int colorOffset = ( isKing || player == Player_Red ) ? 0 : 2;
+				const int moveCount = isKing ? 4 : 2;
+				for( int direction = colorOffset; direction < colorOffset + moveCount; ++direction )
+				{
+					if( GetNextSpace( start, direction, test.m_sequence[0] ) && board.GetSquareState( test.m_sequence[0] ) == SquareState_Blank )
+						simpleMoves.push_back( test );
+				}
+			}
+		}
+		if( moves.empty() )
+			moves.swap( simpleMoves );
+	}
+
+	//--------------------------------------------------------------------------------------
+	// Writes the moves of one list missing from the other, both sorted.
+	void ReportMissing( std::ostream& os, const char* name, const std::vector<CMove>& moves, const std::vector<CMove>& others )
+	{
+		std::vector<CMove> missing;
+		std::set_difference( moves.begin(), moves.end(), others.begin(), others.end(), std::back_inserter( missing ) );
+		for( size_t i = 0; i < missing.size(); ++i )
+			os << " " << name << "=" << CPdn::ToString( CPdn::FromMove( missing[i] ) );
+	}
+}
+
+//--------------------------------------------------------------------------------------
+CGeneratorBenchmark::CGeneratorBenchmark( unsigned int positions, unsigned int seed )
+	: m_positions( positions )
+	, m_seed( seed )
+{
+}
+
+//--------------------------------------------------------------------------------------
+unsigned int CGeneratorBenchmark::Run( std::ostream& os ) const
+{
+	os << "generator positions=" << m_positions << " seed=" << m_seed << std::endl;
+
+	std::vector<SSample> positions;
+	CollectPositions( positions );
+	unsigned int mismatches = CheckMoves( positions, os );
+	mismatches += CheckValidation( positions, os );
+	TimeGenerators( positions, os );
+	return mismatches;
+}
+
+//--------------------------------------------------------------------------------------
+void CGeneratorBenchmark::CollectPositions( std::vector<SSample>& positions ) const
+{
+	CRandom random( m_seed );
+	positions.reserve( m_positions );
+
+	// Every position of random games from the opening.
+	const unsigned int fromGames = m_positions / 2;
+	while( positions.size() < fromGames )
+	{
+		SSample sample;
+		sample.m_toMove = Player_Red;
+		bool reversible = false;
+		for( unsigned int ply = 0; ply < kMaxPlies && positions.size() < fromGames; ++ply )
+		{
+			positions.push_back( sample );
+			if( !sample.m_board.MakeRandomMove( sample.m_toMove, random, reversible ) )
+				break;
+			sample.m_toMove = CCheckersBoard::GetOpponent( sample.m_toMove );
+		}
+	}
+
+	// Pieces scattered over a third of the dark squares, half of them kings, which games
+	// rarely reach.  A man on the row where it would crown is made a king.
+	while( positions.size() < m_positions )
+	{
+		SSample sample;
+		sample.m_board.Clear();
+		sample.m_toMove = random.NextBelow( 2 ) ? Player_Red : Player_Black;
+		for( int x = 0; x < kBoardSize; ++x )
+		{
+			for( int y = ( x + 1 ) % 2; y < kBoardSize; y += 2 )
+			{
+				if( random.NextBelow( 3 ) )
+					continue;
+				const bool red = random.NextBelow( 2 ) != 0;
+				const bool king = random.NextBelow( 2 ) || y == ( red ? kBoardSize - 1 : 0 );
+				const ESquareState state = red ? ( king ? SquareState_RedKing : SquareState_Red ) : ( king ? SquareState_BlackKing : SquareState_Black );
+				sample.m_board.SetSquareState( SPosition( x, y ), state );
+			}
+		}
+		positions.push_back( sample );
+	}
+}
+
+//--------------------------------------------------------------------------------------
+unsigned int CGeneratorBenchmark::CheckMoves( const std::vector<SSample>& positions, std::ostream& os ) const
+{
+	// The generators list moves in different orders, so the lists are compared sorted.
+	unsigned int mismatches = 0;
+	unsigned int recaptures = 0;
+	unsigned __int64 moveCount = 0;
+	unsigned __int64 chainCount = 0;
+	unsigned int longestChain = 0;
+	std::vector<CMove> moves;
+	std::vector<CMove> reference;
+	for( size_t i = 0; i < positions.size(); ++i )
+	{
+		const SSample& sample = positions[i];
+		moves.clear();
+		sample.m_board.GetMoves( sample.m_toMove, moves );
+		GetReferenceMoves( sample.m_board, sample.m_toMove, reference, recaptures );
+		std::sort( moves.begin(), moves.end() );
+		std::sort( reference.begin(), reference.end() );
+
+		moveCount += moves.size();
+		for( size_t m = 0; m < moves.size(); ++m )
+		{
+			if( moves[m].m_sequence.size() > 1 )
+				chainCount++;
+			longestChain = ( std::max )( longestChain, (unsigned int)moves[m].m_sequence.size() );
+		}
+
+		if( moves == reference )
+			continue;
+
+		if( ++mismatches <= kReportedMismatches )
+		{
+			SPositionRecord record;
+			record.FromBoard( sample.m_board, sample.m_toMove );
+			os << "generator mismatch toMove=" << ( sample.m_toMove == Player_Red ? "red" : "black" ) << std::hex
+			   << " red=0x" << record.m_red << " black=0x" << record.m_black << " kings=0x" << record.m_kings << std::dec;
+			ReportMissing( os, "onlyNew", moves, reference );
+			ReportMissing( os, "onlyReference", reference, moves );
+			os << std::endl;
+		}
+	}
+	os << "generator check positions=" << positions.size() << " moves=" << moveCount << " multiJumps=" << chainCount
+	   << " longestChain=" << longestChain << " recaptures=" << recaptures << " mismatches=" << mismatches << std::endl;
+	return mismatches;
+}
+
+//--------------------------------------------------------------------------------------
+unsigned int CGeneratorBenchmark::CheckValidation( const std::vector<SSample>& positions, std::ostream& os ) const
+{
+	// Each move of the reference list must be valid, and remove the pieces it jumps and end on
+	// its last square, all worked out here from the coordinates.
+	unsigned int mismatches = 0;
+	unsigned int recaptures = 0;
+	unsigned __int64 moveCount = 0;
+	std::vector<CMove> moves;
+	std::vector<SPosition> removed;
+	std::vector<SPosition> expected;
+	for( size_t i = 0; i < positions.size(); ++i )
+	{
+		const SSample& sample = positions[i];
+		GetReferenceMoves( sample.m_board, sample.m_toMove, moves, recaptures );
+		for( size_t m = 0; m < moves.size(); ++m )
+		{
+			const CMove& move = moves[m];
+			expected.clear();
+			SPosition from = move.m_start;
+			for( size_t step = 0; step < move.m_sequence.size(); ++step )
+			{
+				if( abs( (int)move.m_sequence[step].m_x - (int)from.m_x ) == 2 )
+					expected.push_back( GetMiddle( from, move.m_sequence[step] ) );
+				from = move.m_sequence[step];
+			}
+
+			removed.clear();
+			SPosition final;
+			moveCount++;
+			if( !sample.m_board.IsValidMove( sample.m_toMove, move, &removed, &final ) || removed != expected || final != move.m_sequence.back() )
+			{
+				if( ++mismatches <= kReportedMismatches )
+					os << "generator invalid move=" << CPdn::ToString( CPdn::FromMove( move ) ) << std::endl;
+			}
+		}
+	}
+	os << "generator validate moves=" << moveCount << " mismatches=" << mismatches << std::endl;
+	return mismatches;
+}
+
+//--------------------------------------------------------------------------------------
+void CGeneratorBenchmark::TimeGenerators( const std::vector<SSample>& positions, std::ostream& os ) const
+{
+	std::vector<CMove> moves;
+	unsigned int recaptures = 0;
+	unsigned __int64 referenceMoves = 0;
+	CStopwatch stopwatch;
+	for( size_t i = 0; i < positions.size(); ++i )
+	{
+		GetReferenceMoves( positions[i].m_board, positions[i].m_toMove, moves, recaptures );
+		referenceMoves += moves.size();
+	}
+	const unsigned __int64 referenceUs = stopwatch.GetElapsedUs();
+
+	unsigned __int64 newMoves = 0;
+	stopwatch.Restart();
+	for( size_t i = 0; i < positions.size(); ++i )
+	{
+		moves.clear();
+		positions[i].m_board.GetMoves( positions[i].m_toMove, moves );
+		newMoves += moves.size();
+	}
+	const unsigned __int64 newUs = stopwatch.GetElapsedUs();
+
+	const double count = positions.empty() ? 1.0 : (double)positions.size();
+	os << "generator time referenceUs=" << referenceUs << " getMovesUs=" << newUs
+	   << " referenceNsPerPosition=" << referenceUs * 1000.0 / count << " getMovesNsPerPosition=" << newUs * 1000.0 / count
+	   << " speedup=" << ( newUs ? (double)referenceUs / newUs : 0.0 ) << " moves=" << newMoves;
+	if( newMoves != referenceMoves )
+		os << " referenceMoves=" << referenceMoves;
+	os << std::endl;
+}
@@ -0,0 +1,41 @@
+#pragma once
+
+#include "CheckersBoard.h"
+
+#include <iostream>
+#include <vector>
+
+//--------------------------------------------------------------------------------------
+// Checks GetMoves against a copy of the original move generator, which extends every chain by
+// copying the move so far and stepping with coordinate arithmetic.  Positions come from random
+// games and from random placements crowded with kings, where the long capture chains are.  The
+// copy keeps the original rules except that a piece cannot be jumped twice; the chains the
+// original listed by doing so are counted apart.  Both list every prefix of a chain, since a
+// chain may stop after any jump.  Every move is also checked with IsValidMove, whose removed
+// pieces and final square come from the square tables, against the same found by coordinate
+// arithmetic, and both generators are timed.
+class CGeneratorBenchmark
+{
+public:
+	CGeneratorBenchmark( unsigned int positions, unsigned int seed );
+
+	// Returns the number of positions whose moves differ between the generators, plus the moves
+	// IsValidMove gets wrong.
+	unsigned int Run( std::ostream& os ) const;
+
+private:
+	struct SSample
+	{
+		CCheckersBoard m_board;
+		EPlayer m_toMove;
+	};
+
+	unsigned int m_positions;
+	unsigned int m_seed;
+
+	// Half the positions from random games and half placed at random.
+	void CollectPositions( std::vector<SSample>& positions ) const;
+	unsigned int CheckMoves( const std::vector<SSample>& positions, std::ostream& os ) const;
+	unsigned int CheckValidation( const std::vector<SSample>& positions, std::ostream& os ) const;
+	void TimeGenerators( const std::vector<SSample>& positions, std::ostream& os ) const;
+};
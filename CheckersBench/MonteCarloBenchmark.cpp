@@ -0,0 +1,201 @@
+#include "StdAfx.h"
+#include "MonteCarloBenchmark.h"
+
+#include "ComputerPlayer.inl"
+#include "GameHistory.h"
+#include "MonteCarloPlayer.inl"
+#include "PerfTimer.h"
+#include "Random.h"
+
+#include <vector>
+
+namespace
+{
+	// Random games are cut off here, as the player's playouts are.
+	const unsigned int kMaxPlies = 150;
+	// Match games: plies before a draw is called, repetitions that draw, and random opening plies.
+	const unsigned int kMatchPlies = 200;
+	const unsigned int kRepetitions = 3;
+	const unsigned int kOpeningPlies = 4;
+
+	//--------------------------------------------------------------------------------------
+	// Plays a random game with the bit mask kernel.  Returns the plies played.
+	unsigned int PlayKernelGame( CRandom& random )
+	{
+		CCheckersBoard board;
+		EPlayer player = Player_Red;
+		unsigned int ply = 0;
+		bool reversible = false;
+		while( ply < kMaxPlies && board.MakeRandomMove( player, random, reversible ) )
+		{
+			player = CCheckersBoard::GetOpponent( player );
+			++ply;
+		}
+		return ply;
+	}
+
+	//--------------------------------------------------------------------------------------
+	// Plays a random game through GetMoves and MakeMoveIfValid.  Returns the plies played.
+	unsigned int PlayMoveListGame( CRandom& random, std::vector<CMove>& moves )
+	{
+		CCheckersBoard board;
+		EPlayer player = Player_Red;
+		unsigned int ply = 0;
+		for( ; ply < kMaxPlies; ++ply )
+		{
+			moves.clear();
+			if( !board.GetMoves( player, moves ) || moves.empty() )
+				break;
+			board.MakeMoveIfValid( player, moves[ random.NextBelow( (unsigned int)moves.size() ) ] );
+			player = CCheckersBoard::GetOpponent( player );
+		}
+		return ply;
+	}
+
+	//--------------------------------------------------------------------------------------
+	void ReportKernel( std::ostream& os, const char* name, unsigned int games, unsigned __int64 plies, unsigned __int64 us )
+	{
+		os << "montecarlo kernel=" << name
+		   << " games=" << games
+		   << " plies=" << plies
+		   << " us=" << us
+		   << " nsPerPly=" << ( plies ? us * 1000.0 / plies : 0.0 )
+		   << " gamesPerSec=" << ( us ? games * 1000000.0 / us : 0.0 ) << std::endl;
+	}
+}
+
+//--------------------------------------------------------------------------------------
+CMonteCarloBenchmark::CMonteCarloBenchmark( const TPlayer::SConfig& config, unsigned int playouts, unsigned int games )
+	: m_config( config )
+	, m_playouts( playouts )
+	, m_games( games )
+{
+}
+
+//--------------------------------------------------------------------------------------
+void CMonteCarloBenchmark::Run( std::ostream& os ) const
+{
+	const unsigned int maxThreads = m_config.m_threads ? m_config.m_threads : CThread::GetHardwareThreadCount();
+	os << "montecarlo timeLimitMs=" << m_config.m_timeLimitMs << " maxThreads=" << maxThreads
+	   << " maxNodes=" << m_config.m_maxNodes << " virtualLoss=" << m_config.m_virtualLoss << std::endl;
+
+	// Both kernels play the same number of games from the same seed.
+	CRandom random( m_config.m_seed );
+	unsigned __int64 plies = 0;
+	CStopwatch stopwatch;
+	for( unsigned int game = 0; game < m_playouts; ++game )
+		plies += PlayKernelGame( random );
+	ReportKernel( os, "bitboard", m_playouts, plies, stopwatch.GetElapsedUs() );
+
+	random.Seed( m_config.m_seed );
+	std::vector<CMove> moves;
+	plies = 0;
+	stopwatch.Restart();
+	for( unsigned int game = 0; game < m_playouts; ++game )
+		plies += PlayMoveListGame( random, moves );
+	ReportKernel( os, "movelist", m_playouts, plies, stopwatch.GetElapsedUs() );
+
+	// The opening searched for the same time on more and more threads.
+	for( unsigned int threads = 1; ; threads <<= 1 )
+	{
+		if( threads > maxThreads )
+			threads = maxThreads;
+
+		TPlayer::SConfig config( m_config );
+		config.m_threads = threads;
+		TPlayer player( Player_Red, config );
+		CMove move;
+		player.FindBestMove( CCheckersBoard(), move );
+		const SMonteCarloStats& stats = player.GetLastSearchStats();
+		os << "montecarlo search threads=" << threads
+		   << " playouts=" << stats.m_playouts
+		   << " us=" << stats.m_elapsedUs
+		   << " playoutsPerSec=" << stats.GetPlayoutsPerSecond()
+		   << " pliesPerPlayout=" << ( stats.m_playouts ? (double)stats.m_playoutPlies / stats.m_playouts : 0.0 )
+		   << " nodes=" << stats.m_nodes
+		   << " depth=" << stats.m_depth
+		   << " bestVisits=" << stats.m_bestVisits
+		   << " bestScore=" << stats.m_bestScore << std::endl;
+		if( threads == maxThreads )
+			break;
+	}
+
+	if( !m_games )
+		return;
+
+	int results[3] = { 0 };
+	unsigned __int64 monteCarloUs = 0;
+	unsigned __int64 alphaBetaUs = 0;
+	unsigned int monteCarloMoves = 0;
+	unsigned int alphaBetaMoves = 0;
+	for( unsigned int game = 0; game < m_games; ++game )
+		results[ PlayGame( game, monteCarloUs, monteCarloMoves, alphaBetaUs, alphaBetaMoves ) + 1 ]++;
+	os << "montecarlo match games=" << m_games
+	   << " wins=" << results[2]
+	   << " draws=" << results[1]
+	   << " losses=" << results[0]
+	   << " monteCarloMsPerMove=" << ( monteCarloMoves ? monteCarloUs / 1000.0 / monteCarloMoves : 0.0 )
+	   << " alphaBetaMsPerMove=" << ( alphaBetaMoves ? alphaBetaUs / 1000.0 / alphaBetaMoves : 0.0 ) << std::endl;
+}
+
+//--------------------------------------------------------------------------------------
+int CMonteCarloBenchmark::PlayGame( unsigned int gameIndex, unsigned __int64& monteCarloUs, unsigned int& monteCarloMoves, unsigned __int64& alphaBetaUs, unsigned int& alphaBetaMoves ) const
+{
+	// Each pair of games starts from the same random opening with the colours swapped.
+	CCheckersBoard board;
+	CRandom random( m_config.m_seed + gameIndex / 2 );
+	std::vector<CMove> openingMoves;
+	EPlayer toMove = Player_Red;
+	for( unsigned int ply = 0; ply < kOpeningPlies; ++ply )
+	{
+		openingMoves.clear();
+		if( !board.GetMoves( toMove, openingMoves ) || openingMoves.empty() )
+			break;
+		board.MakeMoveIfValid( toMove, openingMoves[ random.NextBelow( (unsigned int)openingMoves.size() ) ] );
+		toMove = CCheckersBoard::GetOpponent( toMove );
+	}
+
+	const EPlayer monteCarloColour = ( gameIndex % 2 ) ? CCheckersBoard::GetOpponent( toMove ) : toMove;
+	TPlayer::SConfig monteCarloConfig( m_config );
+	monteCarloConfig.m_threads = 1;
+	monteCarloConfig.m_seed = m_config.m_seed + gameIndex;
+	TPlayer monteCarlo( monteCarloColour, monteCarloConfig );
+
+	// Alpha-beta deepens iteratively within the same time per move, or searches a fixed depth
+	// when the Monte Carlo player counts playouts instead.
+	CComputerPlayer<CCheckersBoard>::SConfig alphaBetaConfig( m_config.m_timeLimitMs ? 64 : 6 );
+	alphaBetaConfig.m_timeLimitMs = m_config.m_timeLimitMs;
+	alphaBetaConfig.m_seed = m_config.m_seed + gameIndex;
+	CComputerPlayer<CCheckersBoard> alphaBeta( CCheckersBoard::GetOpponent( monteCarloColour ), alphaBetaConfig );
+
+	CGameHistory history( m_config.m_noProgressMoves );
+	history.Push( board.GetHashKey(), false );
+	for( unsigned int ply = 0; ply < kMatchPlies; ++ply )
+	{
+		const bool monteCarloToMove = ( toMove == monteCarloColour );
+		CMove move;
+		bool found = false;
+		if( monteCarloToMove )
+		{
+			found = monteCarlo.FindBestMove( board, move, &history );
+			monteCarloUs += monteCarlo.GetLastSearchStats().m_elapsedUs;
+			monteCarloMoves++;
+		}
+		else
+		{
+			found = alphaBeta.FindBestMove( board, move, &history );
+			alphaBetaUs += alphaBeta.GetLastSearchStats().m_elapsedUs;
+			alphaBetaMoves++;
+		}
+
+		const bool reversible = found && board.IsReversibleMove( toMove, move );
+		if( !found || !board.MakeMoveIfValid( toMove, move ) )
+			return monteCarloToMove ? -1 : 1;
+
+		history.Push( board.GetHashKey(), reversible );
+		if( history.IsDraw( kRepetitions ) )
+			return 0;
+		toMove = CCheckersBoard::GetOpponent( toMove );
+	}
+	return 0;
+}
@@ -0,0 +1,33 @@
+#pragma once
+
+#include "CheckersBoard.h"
+#include "MonteCarloPlayer.h"
+
+#include <iostream>
+
+//--------------------------------------------------------------------------------------
+// Speed and strength of the Monte Carlo player.  Times random playouts from the opening made
+// with the bit mask kernel against the same playouts made through GetMoves, then searches the
+// opening for a fixed time with one thread up to the thread limit, reporting playouts per
+// second.  Finally plays a short match against the alpha-beta player with the same time per move.
+class CMonteCarloBenchmark
+{
+public:
+	typedef CMonteCarloPlayer<CCheckersBoard> TPlayer;
+
+	// config gives the time per move and the most threads to search with.
+	CMonteCarloBenchmark( const TPlayer::SConfig& config, unsigned int playouts, unsigned int games );
+
+	void Run( std::ostream& os ) const;
+
+private:
+	TPlayer::SConfig m_config;
+	// Random games timed with each kernel, and games of the match.
+	unsigned int m_playouts;
+	unsigned int m_games;
+
+	// Plays a game between the players from a random opening, the Monte Carlo player moving first
+	// from it in even games.  Returns +1
+	// for a Monte Carlo win, -1 for a loss and 0 for a draw.  Adds up each player's search time and moves.
+	int PlayGame( unsigned int gameIndex, unsigned __int64& monteCarloUs, unsigned int& monteCarloMoves, unsigned __int64& alphaBetaUs, unsigned int& alphaBetaMoves ) const;
+};
@@ -0,0 +1,136 @@
+#include "StdAfx.h"
+#include "NetworkBenchmark.h"
+
+#include "CheckersBoard.h"
+#include "ComputerPlayer.inl"
+#include "PerfTimer.h"
+#include "Random.h"
+
+#include <vector>
+
+namespace
+{
+	const unsigned int kMaxPlies = 120;
+	// Each timing goes over every position this many times.
+	const unsigned int kRepeat = 20;
+
+	//--------------------------------------------------------------------------------------
+	// A position and the one before it.
+	struct SPositionPair
+	{
+		CCheckersBoard m_previous;
+		CCheckersBoard m_board;
+	};
+
+	//--------------------------------------------------------------------------------------
+	double NsPerCall( unsigned __int64 us, size_t calls )
+	{
+		return calls ? (double)us * 1000.0 / (double)calls : 0.0;
+	}
+}
+
+//--------------------------------------------------------------------------------------
+CNetworkBenchmark::CNetworkBenchmark( const CNeuralNetwork& network, unsigned int games, unsigned int depth, unsigned int seed )
+	: m_network( network )
+	, m_games( games )
+	, m_depth( depth )
+	, m_seed( seed )
+{
+}
+
+//--------------------------------------------------------------------------------------
+void CNetworkBenchmark::Run( std::ostream& os ) const
+{
+	// Random games visit the same kinds of positions, and moves, as a search.
+	std::vector<SPositionPair> pairs;
+	CRandom random( m_seed );
+	for( unsigned int game = 0; game < m_games; ++game )
+	{
+		CCheckersBoard board;
+		EPlayer player = Player_Red;
+		for( unsigned int ply = 0; ply < kMaxPlies; ++ply )
+		{
+			std::vector<CMove> moves;
+			if( !board.GetMoves( player, moves ) || moves.empty() )
+				break;
+			SPositionPair pair;
+			pair.m_previous = board;
+			board.MakeMoveIfValid( player, moves[ random.NextBelow( (unsigned int)moves.size() ) ] );
+			pair.m_board = board;
+			pairs.push_back( pair );
+			player = CCheckersBoard::GetOpponent( player );
+		}
+	}
+
+	os << "network simd=" << CNeuralNetwork::GetSimdName() << " positions=" << pairs.size() << " repeat=" << kRepeat << std::endl;
+	const size_t calls = pairs.size() * kRepeat;
+
+	// The sums keep the compiler from dropping the work.
+	CStopwatch stopwatch;
+	__int64 weightedSum = 0;
+	const SEvalWeights weights;
+	for( unsigned int r = 0; r < kRepeat; ++r )
+	{
+		for( size_t i = 0; i < pairs.size(); ++i )
+			weightedSum += pairs[i].m_board.CalculatePlayerScore( Player_Red, weights );
+	}
+	const unsigned __int64 weightedUs = stopwatch.GetElapsedUs();
+
+	std::vector<int> fullScores( pairs.size() );
+	unsigned short inputs[CCheckersBoard::NetworkInputCount];
+	SNeuralAccumulator accumulator;
+	stopwatch.Restart();
+	for( unsigned int r = 0; r < kRepeat; ++r )
+	{
+		for( size_t i = 0; i < pairs.size(); ++i )
+		{
+			m_network.Refresh( accumulator, inputs, pairs[i].m_board.GetNetworkInputs( inputs ) );
+			fullScores[i] = m_network.Evaluate( accumulator );
+		}
+	}
+	const unsigned __int64 fullUs = stopwatch.GetElapsedUs();
+
+	// The accumulators of the previous positions are made beforehand, as a search has them.
+	std::vector<SNeuralAccumulator> previous( pairs.size() );
+	for( size_t i = 0; i < pairs.size(); ++i )
+		m_network.Refresh( previous[i], inputs, pairs[i].m_previous.GetNetworkInputs( inputs ) );
+
+	unsigned short removed[CCheckersBoard::NetworkInputCount];
+	unsigned int mismatches = 0;
+	stopwatch.Restart();
+	for( unsigned int r = 0; r < kRepeat; ++r )
+	{
+		for( size_t i = 0; i < pairs.size(); ++i )
+		{
+			unsigned int addedCount = 0;
+			unsigned int removedCount = 0;
+			pairs[i].m_board.GetNetworkChanges( pairs[i].m_previous, inputs, addedCount, removed, removedCount );
+			m_network.Update( accumulator, previous[i], inputs, addedCount, removed, removedCount );
+			if( m_network.Evaluate( accumulator ) != fullScores[i] )
+				mismatches++;
+		}
+	}
+	const unsigned __int64 incrementalUs = stopwatch.GetElapsedUs();
+
+	os << "network eval=weighted nsPerEval=" << NsPerCall( weightedUs, calls ) << " sum=" << weightedSum << std::endl;
+	os << "network eval=full nsPerEval=" << NsPerCall( fullUs, calls ) << std::endl;
+	os << "network eval=incremental nsPerEval=" << NsPerCall( incrementalUs, calls ) << " mismatches=" << mismatches << std::endl;
+
+	// The same search with each evaluation.
+	for( int useNetwork = 0; useNetwork < 2; ++useNetwork )
+	{
+		CComputerPlayer<CCheckersBoard>::SConfig config( m_depth );
+		config.m_seed = m_seed;
+		config.m_pNetwork = useNetwork ? &m_network : NULL;
+		CComputerPlayer<CCheckersBoard> player( Player_Red, config );
+		CMove move;
+		player.FindBestMove( CCheckersBoard(), move );
+		const SSearchStats& stats = player.GetLastSearchStats();
+		os << "network search=" << ( useNetwork ? "network" : "weighted" )
+		   << " depth=" << m_depth
+		   << " nodes=" << stats.m_nodes
+		   << " us=" << stats.m_elapsedUs
+		   << " nps=" << ( stats.m_elapsedUs ? stats.m_nodes * 1000000 / stats.m_elapsedUs : 0 )
+		   << std::endl;
+	}
+}
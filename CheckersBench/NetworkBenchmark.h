@@ -0,0 +1,24 @@
+#pragma once
+
+#include "NeuralNetwork.h"
+
+#include <iostream>
+
+//--------------------------------------------------------------------------------------
+// Cost of the network evaluation against the weighted one.  Times each over the positions
+// of random games: the weighted sum, the network computed from scratch and the network
+// updated from the position before, checking the last two agree.  Then searches the
+// opening with each to compare nodes per second.
+class CNetworkBenchmark
+{
+public:
+	CNetworkBenchmark( const CNeuralNetwork& network, unsigned int games, unsigned int depth, unsigned int seed );
+
+	void Run( std::ostream& os ) const;
+
+private:
+	const CNeuralNetwork& m_network;
+	unsigned int m_games;
+	unsigned int m_depth;
+	unsigned int m_seed;
+};
@@ -0,0 +1,99 @@
+#include "StdAfx.h"
+#include "ProofBenchmark.h"
+
+#include "Pdn.h"
+#include "ProofNumberSolver.inl"
+
+namespace
+{
+	//--------------------------------------------------------------------------------------
+	struct SProofPosition
+	{
+		const char* m_name;
+		const char* m_fen;
+		// For the player to move.
+		CProofBenchmark::TSolver::EResult m_expected;
+	};
+
+	typedef CProofBenchmark::TSolver TSolver;
+
+	// Append new positions at the end so results of older builds still line up.
+	const SProofPosition s_positions[] =
+	{
+		{ "nomoves",   "B:W1,5,6:B",          TSolver::Result_Loss },
+		// Two kings beat one, but only after driving it out of the double corner.
+		{ "2k1k",      "B:WK32:BK1,K2",       TSolver::Result_Win },
+		{ "1k2k",      "W:WK32:BK1,K2",       TSolver::Result_Loss },
+		{ "1k1k",      "B:WK32:BK1",          TSolver::Result_Draw },
+		{ "3k1k",      "B:WK32:BK1,K2,K3",    TSolver::Result_Win },
+		{ "1k3k",      "W:WK32:BK1,K2,K3",    TSolver::Result_Loss },
+		{ "2k1m",      "B:W29:BK1,K2",        TSolver::Result_Win },
+		{ "2k2m",      "B:W21,22:BK1,K2",     TSolver::Result_Win },
+		// The man crowns under the king's protection.
+		{ "km1k",      "B:WK32:BK1,10",       TSolver::Result_Win },
+		// The king catches the man before it crowns.
+		{ "1k1m",      "W:WK32:B10",          TSolver::Result_Win },
+		// Both men crown, leaving a king each.
+		{ "1m1m",      "B:W25:B8",            TSolver::Result_Draw },
+	};
+	const size_t kPositionCount = sizeof( s_positions ) / sizeof( s_positions[0] );
+}
+
+//--------------------------------------------------------------------------------------
+CProofBenchmark::CProofBenchmark( const TSolver::SConfig& config )
+	: m_config( config )
+{
+}
+
+//--------------------------------------------------------------------------------------
+unsigned int CProofBenchmark::Run( std::ostream& os, bool showProgress ) const
+{
+	TSolver solver( m_config );
+	os << "proof positions=" << kPositionCount << " threads=" << ( m_config.m_threads ? m_config.m_threads : CThread::GetHardwareThreadCount() )
+	   << " tableSize=" << m_config.m_tableSize << " noProgressMoves=" << m_config.m_noProgressMoves
+	   << " maxNodes=" << m_config.m_maxNodes << " timeLimitMs=" << m_config.m_timeLimitMs << std::endl;
+
+	unsigned int counts[TSolver::ResultCount] = { 0 };
+	unsigned int wrong = 0;
+	unsigned __int64 totalNodes = 0;
+	unsigned __int64 totalUs = 0;
+	for( size_t p = 0; p < kPositionCount; ++p )
+	{
+		CCheckersBoard board;
+		EPlayer toMove;
+		if( !CPdn::ParseFen( s_positions[p].m_fen, board, toMove ) )
+		{
+			os << "proof position=" << s_positions[p].m_name << " error=badFen" << std::endl;
+			continue;
+		}
+
+		const TSolver::EResult result = solver.Solve( board, toMove, showProgress ? &os : NULL );
+		const TSolver::SStats& stats = solver.GetLastStats();
+		const bool correct = ( result == s_positions[p].m_expected );
+		counts[result]++;
+		if( result != TSolver::Result_Unknown && !correct )
+			wrong++;
+		totalNodes += stats.m_nodes;
+		totalUs += stats.m_elapsedUs;
+
+		os << "proof position=" << s_positions[p].m_name
+		   << " result=" << TSolver::GetResultName( result )
+		   << " expected=" << TSolver::GetResultName( s_positions[p].m_expected )
+		   << ( correct ? " ok" : ( result == TSolver::Result_Unknown ? " UNSOLVED" : " MISMATCH" ) )
+		   << " passes=" << stats.m_passes
+		   << " nodes=" << stats.m_nodes
+		   << " us=" << stats.m_elapsedUs
+		   << " nps=" << ( stats.m_elapsedUs ? stats.m_nodes * 1000000 / stats.m_elapsedUs : 0 )
+		   << " maxPly=" << stats.m_maxPly
+		   << " stores=" << stats.m_tableStores
+		   << " replacements=" << stats.m_tableReplacements << std::endl;
+	}
+
+	os << "total solved=" << ( kPositionCount - counts[TSolver::Result_Unknown] )
+	   << " unknown=" << counts[TSolver::Result_Unknown]
+	   << " wrong=" << wrong
+	   << " nodes=" << totalNodes
+	   << " us=" << totalUs
+	   << " nps=" << ( totalUs ? totalNodes * 1000000 / totalUs : 0 ) << std::endl;
+	return wrong;
+}
@@ -0,0 +1,24 @@
+#pragma once
+
+#include "CheckersBoard.h"
+#include "ProofNumberSolver.h"
+
+#include <iostream>
+
+//--------------------------------------------------------------------------------------
+// Solves a fixed set of positions with known results with the proof-number solver and checks
+// each result.  Prints one "proof" key=value line per position with nodes, time and table
+// use, and a total.  Positions the solver cannot settle within its limits count as unknown.
+class CProofBenchmark
+{
+public:
+	typedef CProofNumberSolver<CCheckersBoard> TSolver;
+
+	CProofBenchmark( const TSolver::SConfig& config );
+
+	// Returns the number of positions solved with a result other than the known one.
+	unsigned int Run( std::ostream& os, bool showProgress ) const;
+
+private:
+	TSolver::SConfig m_config;
+};
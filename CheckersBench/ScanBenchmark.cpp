@@ -0,0 +1,103 @@
+#include "StdAfx.h"
+#include "ScanBenchmark.h"
+
+#include "ComputerPlayer.inl"
+#include "PerfTimer.h"
+#include "PositionDb.h"
+#include "Threading.h"
+
+#include <memory>
+
+//--------------------------------------------------------------------------------------
+CScanBenchmark::CScanBenchmark( const std::string& path, unsigned int depth, unsigned int randomReads )
+	: m_path( path )
+	, m_depth( depth )
+	, m_randomReads( randomReads )
+{
+}
+
+//--------------------------------------------------------------------------------------
+bool CScanBenchmark::Run( std::ostream& os, unsigned int threads ) const
+{
+	CPositionDb db;
+	if( !db.Open( m_path ) )
+		return false;
+
+	volatile LONGLONG checksum = 0;
+	volatile LONGLONG redWins = 0;
+	volatile LONGLONG blackWins = 0;
+	const unsigned int depth = m_depth;
+
+	CStopwatch stopwatch;
+	db.ParallelScan( [&]( const SPositionRecord* pRecords, size_t count, unsigned __int64 ) {
+		LONGLONG blockSum = 0;
+		LONGLONG blockRed = 0;
+		LONGLONG blockBlack = 0;
+
+		// One player per colour for the whole block so their tables are reused.
+		std::unique_ptr< CComputerPlayer<CCheckersBoard> > players[PlayerCount];
+		if( depth )
+		{
+			players[Player_Red].reset( new CComputerPlayer<CCheckersBoard>( Player_Red, depth ) );
+			players[Player_Black].reset( new CComputerPlayer<CCheckersBoard>( Player_Black, depth ) );
+		}
+
+		for( size_t i = 0; i < count; ++i )
+		{
+			const SPositionRecord& record = pRecords[i];
+			blockRed += ( record.m_result == SPositionRecord::Result_RedWin );
+			blockBlack += ( record.m_result == SPositionRecord::Result_BlackWin );
+
+			CCheckersBoard board;
+			record.ToBoard( board );
+			EPlayer toMove = record.GetPlayerToMove();
+			if( !depth )
+			{
+				blockSum += board.CalculatePlayerScore( toMove );
+				continue;
+			}
+
+			// The move found is folded into the checksum since its score is not exposed.
+			CMove move;
+			if( players[toMove]->FindBestMove( board, move ) )
+				blockSum += CCheckersBoard( board, toMove, move ).CalculatePlayerScore( toMove );
+		}
+		InterlockedExchangeAdd64( &checksum, blockSum );
+		InterlockedExchangeAdd64( &redWins, blockRed );
+		InterlockedExchangeAdd64( &blackWins, blockBlack );
+	}, threads );
+	double seconds = stopwatch.GetElapsedUs() / 1000000.0;
+
+	os << "scan records=" << db.GetCount()
+	   << " threads=" << ( threads ? threads : CThread::GetHardwareThreadCount() )
+	   << " depth=" << m_depth
+	   << " seconds=" << seconds
+	   << " recordsPerSec=" << ( seconds > 0.0 ? db.GetCount() / seconds : 0.0 )
+	   << " redWins=" << redWins
+	   << " blackWins=" << blackWins
+	   << " checksum=" << checksum << std::endl;
+
+	if( m_randomReads && db.GetCount() )
+	{
+		// Scattered reads through one cursor, remapping its window as needed.
+		CPositionDbCursor cursor( db );
+		unsigned int state = 0x9E3779B9;
+		unsigned __int64 pieces = 0;
+		stopwatch.Restart();
+		for( unsigned int i = 0; i < m_randomReads; ++i )
+		{
+			state ^= state << 13;
+			state ^= state >> 17;
+			state ^= state << 5;
+			const SPositionRecord* pRecord = cursor.Get( state % db.GetCount() );
+			if( pRecord )
+				pieces += ( pRecord->m_red != 0 ) + ( pRecord->m_black != 0 );
+		}
+		seconds = stopwatch.GetElapsedUs() / 1000000.0;
+		os << "random reads=" << m_randomReads
+		   << " seconds=" << seconds
+		   << " readsPerSec=" << ( seconds > 0.0 ? m_randomReads / seconds : 0.0 )
+		   << " occupied=" << pieces << std::endl;
+	}
+	return true;
+}
@@ -0,0 +1,22 @@
+#pragma once
+
+#include <iostream>
+#include <string>
+
+//--------------------------------------------------------------------------------------
+// Reads a position database through the memory mapped scan and through random access.
+// Each position is either evaluated statically or searched to a fixed depth, and a checksum
+// of the scores is printed; static checksums must match across thread counts.
+class CScanBenchmark
+{
+public:
+	CScanBenchmark( const std::string& path, unsigned int depth, unsigned int randomReads );
+
+	// Returns false if the database cannot be opened.
+	bool Run( std::ostream& os, unsigned int threads ) const;
+
+private:
+	std::string m_path;
+	unsigned int m_depth;
+	unsigned int m_randomReads;
+};
@@ -0,0 +1,146 @@
+#include "StdAfx.h"
+#include "ServiceBenchmark.h"
+
+#include "EngineService.inl"
+#include "PerfTimer.h"
+
+//--------------------------------------------------------------------------------------
+void CServiceBenchmark::SLoadGame::Reset()
+{
+	m_board = CCheckersBoard();
+	m_history.Clear();
+	m_history.Push( m_board.GetHashKey(), false );
+	m_side = Player_Red;
+	m_plies = 0;
+}
+
+//--------------------------------------------------------------------------------------
+CServiceBenchmark::CServiceBenchmark( const TCheckersService::SConfig& config, unsigned int games, unsigned int moves, unsigned int budgetMs, unsigned int maxPlies )
+	: m_config( config )
+	, m_moves( moves )
+	, m_budgetMs( budgetMs )
+	, m_maxPlies( maxPlies )
+	, m_games( games ? games : 1 )
+	, m_pService( NULL )
+	, m_issued( 0 )
+	, m_rejected( 0 )
+	, m_finishedGames( 0 )
+{
+}
+
+//--------------------------------------------------------------------------------------
+void CServiceBenchmark::Run( std::ostream& os )
+{
+	TCheckersService service( m_config );
+	m_pService = &service;
+	m_issued = 0;
+	m_rejected = 0;
+	m_finishedGames = 0;
+
+	CStopwatch wallTime;
+	for( size_t i = 0; i < m_games.size(); ++i )
+	{
+		m_games[i].m_session = service.OpenSession();
+		m_games[i].Reset();
+		Next( m_games[i] );
+	}
+
+	// Clients turned away retry after a short pause until every game has run out of moves.
+	for( ;; )
+	{
+		Sleep( 1 );
+		CScopedLock<CCriticalSection> lock( m_lock );
+		if( m_finishedGames == m_games.size() )
+			break;
+		for( size_t i = 0; i < m_games.size(); ++i )
+		{
+			if( m_games[i].m_stalled )
+			{
+				m_games[i].m_stalled = false;
+				m_lock.Unlock();
+				Next( m_games[i] );
+				m_lock.Lock();
+			}
+		}
+	}
+	service.WaitIdle();
+	unsigned __int64 wallUs = wallTime.GetElapsedUs();
+	for( size_t i = 0; i < m_games.size(); ++i )
+		service.CloseSession( m_games[i].m_session );
+	m_pService = NULL;
+
+	CLatencyStats latency;
+	CLatencyStats queueLatency;
+	unsigned __int64 nodes = 0;
+	for( size_t i = 0; i < m_games.size(); ++i )
+	{
+		latency.Merge( m_games[i].m_latency );
+		queueLatency.Merge( m_games[i].m_queueLatency );
+		nodes += m_games[i].m_nodes;
+	}
+
+	double seconds = wallUs / 1000000.0;
+	os << "service games=" << m_games.size()
+	   << " threads=" << service.GetThreadCount()
+	   << " moves=" << latency.GetCount()
+	   << " rejected=" << m_rejected
+	   << " seconds=" << seconds
+	   << " movesPerSec=" << ( seconds > 0.0 ? latency.GetCount() / seconds : 0.0 )
+	   << " nps=" << ( seconds > 0.0 ? nodes / seconds : 0.0 ) << std::endl;
+	os << "moveUs mean=" << latency.GetMean()
+	   << " p50=" << latency.GetPercentile( 50.0 )
+	   << " p90=" << latency.GetPercentile( 90.0 )
+	   << " p99=" << latency.GetPercentile( 99.0 )
+	   << " max=" << latency.GetMax() << std::endl;
+	os << "queueUs mean=" << queueLatency.GetMean()
+	   << " p50=" << queueLatency.GetPercentile( 50.0 )
+	   << " p99=" << queueLatency.GetPercentile( 99.0 )
+	   << " max=" << queueLatency.GetMax() << std::endl;
+}
+
+//--------------------------------------------------------------------------------------
+void CServiceBenchmark::Next( SLoadGame& game )
+{
+	if( InterlockedIncrement( &m_issued ) > (LONG)m_moves )
+	{
+		CScopedLock<CCriticalSection> lock( m_lock );
+		m_finishedGames++;
+		return;
+	}
+
+	SLoadGame* pGame = &game;
+	TCheckersService::ESubmitResult submitted = m_pService->Submit( game.m_session, game.m_board, game.m_side, game.m_history, m_budgetMs,
+		[this, pGame]( const SServiceResult& result ) { OnResult( *pGame, result ); } );
+	if( submitted != TCheckersService::SubmitResult_Accepted )
+	{
+		// The move was not made, so give it back.
+		InterlockedDecrement( &m_issued );
+		InterlockedIncrement( &m_rejected );
+		CScopedLock<CCriticalSection> lock( m_lock );
+		game.m_stalled = true;
+	}
+}
+
+//--------------------------------------------------------------------------------------
+void CServiceBenchmark::OnResult( SLoadGame& game, const SServiceResult& result )
+{
+	game.m_latency.Add( result.m_totalUs );
+	game.m_queueLatency.Add( result.m_queueUs );
+	game.m_nodes += result.m_stats.m_nodes;
+
+	// Start a new game once this one is over.
+	bool reversible = result.m_found && game.m_board.IsReversibleMove( game.m_side, result.m_bestMove );
+	if( !result.m_found || !game.m_board.MakeMoveIfValid( game.m_side, result.m_bestMove ) )
+	{
+		game.Reset();
+	}
+	else
+	{
+		game.m_history.Push( game.m_board.GetHashKey(), reversible );
+		game.m_side = CCheckersBoard::GetOpponent( game.m_side );
+		if( ++game.m_plies >= m_maxPlies || game.m_history.IsDraw( 3 ) )
+			game.Reset();
+	}
+
+	Next( game );
+}
@@ -0,0 +1,60 @@
+#pragma once
+
+#include "CheckersBoard.h"
+#include "EngineService.h"
+#include "LatencyStats.h"
+
+#include <iostream>
+#include <vector>
+
+typedef CEngineService<CCheckersBoard> TCheckersService;
+
+//--------------------------------------------------------------------------------------
+// Load generator for CEngineService. Plays many self-play games at once through the
+// service, each game submitting its next move as soon as the last one is answered, and
+// reports throughput and move latency including the time spent queued.
+class CServiceBenchmark
+{
+public:
+	CServiceBenchmark( const TCheckersService::SConfig& config, unsigned int games, unsigned int moves, unsigned int budgetMs, unsigned int maxPlies );
+
+	// Plays until the given number of moves has been made and prints a key=value report.
+	void Run( std::ostream& os );
+
+private:
+	// A game is only touched by the callback of its outstanding request, or by Run
+	// while it has none.
+	struct SLoadGame
+	{
+		unsigned int m_session;
+		CCheckersBoard m_board;
+		CGameHistory m_history;
+		EPlayer m_side;
+		unsigned int m_plies;
+		// Turned away by admission control, Run submits again later.
+		bool m_stalled;
+		CLatencyStats m_latency;
+		CLatencyStats m_queueLatency;
+		unsigned __int64 m_nodes;
+
+		SLoadGame() : m_session(0), m_side(Player_Red), m_plies(0), m_stalled(false), m_nodes(0) {}
+		void Reset();
+	};
+
+	const TCheckersService::SConfig m_config;
+	const unsigned int m_moves;
+	const unsigned int m_budgetMs;
+	const unsigned int m_maxPlies;
+
+	std::vector<SLoadGame> m_games;
+	TCheckersService* m_pService;
+	volatile LONG m_issued;
+	volatile LONG m_rejected;
+
+	CCriticalSection m_lock;
+	unsigned int m_finishedGames;
+
+	// Submits the game's next move unless the move budget is spent.
+	void Next( SLoadGame& game );
+	void OnResult( SLoadGame& game, const SServiceResult& result );
+};
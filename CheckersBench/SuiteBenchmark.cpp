@@ -0,0 +1,234 @@
+#include "StdAfx.h"
+#include "SuiteBenchmark.h"
+
+#include "ComputerPlayer.inl"
+#include "Pdn.h"
+
+#include <fstream>
+#include <sstream>
+#include <stdlib.h>
+
+namespace
+{
+	//--------------------------------------------------------------------------------------
+	struct SSuitePosition
+	{
+		const char* m_name;
+		const char* m_fen;
+	};
+
+	// Append new positions at the end so results of older builds still line up.
+	const SSuitePosition s_positions[] =
+	{
+		{ "opening",     "B:W21-32:B1-12" },
+		{ "middlegame1", "B:W19,21,22,23,24,25,26,27,28,32:B1,7,8,9,10,12,14,15,16,20" },
+		{ "middlegame2", "B:W13,17,18,19,21,23,24,25,26,29:B4,5,6,7,8,9,10,11,12,14" },
+		{ "middlegame3", "B:W14,21,22,24,25,26,28,31,32:B2,3,4,5,7,10,13,15,19,20,23" },
+		{ "endgame1",    "B:WK5,24,27:B13,20,22,25,K30" },
+		{ "endgame2",    "B:WK2,K7,K10,14,K16,29:B5,K30,K31,K32" },
+		// A king with a ring of men to jump, most of the moves are long captures.
+		{ "multijump",   "B:W6,7,14,15,22,23,30:B1,K3" },
+	};
+	const size_t kPositionCount = sizeof( s_positions ) / sizeof( s_positions[0] );
+
+	//--------------------------------------------------------------------------------------
+	std::string MakeKey( const std::string& position, unsigned int depth )
+	{
+		std::ostringstream key;
+		key << position << " " << depth;
+		return key.str();
+	}
+}
+
+//--------------------------------------------------------------------------------------
+CSuiteBenchmark::CSuiteBenchmark( const TPlayerConfig& config, unsigned int depth, unsigned int seed, unsigned int repeat )
+	: m_config( config )
+	, m_depth( depth )
+	, m_seed( seed )
+	, m_repeat( repeat ? repeat : 1 )
+{
+}
+
+//--------------------------------------------------------------------------------------
+void CSuiteBenchmark::Run( std::ostream& os ) const
+{
+	os << "suite positions=" << kPositionCount << " depth=" << m_depth << " seed=" << m_seed << " repeat=" << m_repeat
+	   << " lmrMoves=" << m_config.m_lmrMoves << " futilityDepth=" << m_config.m_futilityDepth << " razorDepth=" << m_config.m_razorDepth
+	   << " cache=" << m_config.m_cacheSize << " hugePages=" << ( m_config.m_tablePages.m_hugePages ? 1 : 0 )
+	   << " numa=" << SPageConfig::GetNumaPolicyName( m_config.m_tablePages.m_numa ) << " prefetch=" << ( m_config.m_prefetch ? 1 : 0 );
+	if( m_config.m_hardwareCounters )
+		os << " counters=" << ( CHardwareCounters().IsAvailable() ? "available" : "unavailable" );
+	os << std::endl;
+	CPerfTimer::ResetAll();
+
+	unsigned __int64 totalNodes = 0;
+	unsigned __int64 totalUs = 0;
+	SHardwareCounts totalCounts;
+	for( size_t p = 0; p < kPositionCount; ++p )
+	{
+		CCheckersBoard board;
+		EPlayer toMove;
+		if( !CPdn::ParseFen( s_positions[p].m_fen, board, toMove ) )
+		{
+			os << "suite position=" << s_positions[p].m_name << " error=badFen" << std::endl;
+			continue;
+		}
+
+		for( unsigned int depth = 1; depth <= m_depth; ++depth )
+		{
+			// Every repeat makes the same search, so keep the fastest to cut timer noise.
+			SSearchStats best;
+			CMove move;
+			bool found = false;
+			for( unsigned int r = 0; r < m_repeat; ++r )
+			{
+				TPlayerConfig config( m_config );
+				config.m_depth = depth;
+				config.m_seed = m_seed + (unsigned int)p;
+				CComputerPlayer<CCheckersBoard> player( toMove, config );
+				found = player.FindBestMove( board, move );
+				const SSearchStats& stats = player.GetLastSearchStats();
+				if( r == 0 || stats.m_elapsedUs < best.m_elapsedUs )
+					best = stats;
+			}
+
+			totalNodes += best.m_nodes;
+			totalUs += best.m_elapsedUs;
+			totalCounts += best.m_hardware;
+			os << "suite position=" << s_positions[p].m_name
+			   << " depth=" << depth
+			   << " nodes=" << best.m_nodes
+			   << " us=" << best.m_elapsedUs
+			   << " nps=" << ( best.m_elapsedUs ? best.m_nodes * 1000000 / best.m_elapsedUs : 0 )
+			   << " reduced=" << best.m_reduced
+			   << " researched=" << best.m_researched
+			   << " pruned=" << best.m_pruned
+			   << " move=" << ( found ? CPdn::ToString( CPdn::FromMove( move ) ) : std::string( "none" ) );
+			best.m_hardware.PrintPerNode( os, best.m_nodes );
+			os << std::endl;
+		}
+	}
+
+	os << "total nodes=" << totalNodes
+	   << " us=" << totalUs
+	   << " nps=" << ( totalUs ? totalNodes * 1000000 / totalUs : 0 );
+	totalCounts.PrintPerNode( os, totalNodes );
+	os << std::endl;
+
+	// Nothing is printed unless instrumentation was compiled in.
+	CPerfTimer::ReportAll( os );
+}
+
+//--------------------------------------------------------------------------------------
+bool CSuiteBenchmark::Load( const std::string& path, TResults& results )
+{
+	std::ifstream file( path.c_str() );
+	if( !file )
+		return false;
+
+	std::string line;
+	while( std::getline( file, line ) )
+	{
+		std::istringstream fields( line );
+		std::string field;
+		if( !( fields >> field ) || field != "suite" )
+			continue;
+
+		std::string position;
+		unsigned int depth = 0;
+		SResult result;
+		while( fields >> field )
+		{
+			size_t equals = field.find( '=' );
+			if( equals == std::string::npos )
+				continue;
+			std::string key = field.substr( 0, equals );
+			std::string value = field.substr( equals + 1 );
+			if( key == "position" )
+				position = value;
+			else if( key == "depth" )
+				depth = atoi( value.c_str() );
+			else if( key == "nodes" )
+				result.m_nodes = _strtoui64( value.c_str(), NULL, 10 );
+			else if( key == "us" )
+				result.m_us = _strtoui64( value.c_str(), NULL, 10 );
+			else if( key == "move" )
+				result.m_move = value;
+		}
+
+		// The header line has no position.
+		if( !position.empty() && depth )
+			results[MakeKey( position, depth )] = result;
+	}
+	return true;
+}
+
+//--------------------------------------------------------------------------------------
+int CSuiteBenchmark::Compare( const std::string& basePath, const std::string& newPath, double thresholdPercent, std::ostream& os )
+{
+	TResults base;
+	TResults current;
+	if( !Load( basePath, base ) || !Load( newPath, current ) )
+		return -1;
+
+	// Searches this short are mostly timer noise.
+	const unsigned __int64 minimumUs = 1000;
+
+	int regressions = 0;
+	int missing = 0;
+	int moveChanges = 0;
+	int nodeChanges = 0;
+	unsigned int compared = 0;
+	unsigned __int64 baseUs = 0;
+	unsigned __int64 newUs = 0;
+	for( TResults::const_iterator it = base.begin(); it != base.end(); ++it )
+	{
+		std::istringstream key( it->first );
+		std::string position;
+		unsigned int depth = 0;
+		key >> position >> depth;
+
+		// A search the new run never reached, from a truncated or failed run.
+		TResults::const_iterator match = current.find( it->first );
+		if( match == current.end() )
+		{
+			missing++;
+			os << "compare position=" << position << " depth=" << depth << " baseUs=" << it->second.m_us << " missing" << std::endl;
+			continue;
+		}
+
+		const SResult& before = it->second;
+		const SResult& after = match->second;
+		compared++;
+		baseUs += before.m_us;
+		newUs += after.m_us;
+
+		double change = before.m_us ? 100.0 * ( (double)after.m_us - (double)before.m_us ) / (double)before.m_us : 0.0;
+		bool slower = before.m_us >= minimumUs && change > thresholdPercent;
+		bool moveChanged = before.m_move != after.m_move;
+		bool nodesChanged = before.m_nodes != after.m_nodes;
+		regressions += slower;
+		moveChanges += moveChanged;
+		nodeChanges += nodesChanged;
+		if( !slower && !moveChanged && !nodesChanged )
+			continue;
+
+		os << "compare position=" << position << " depth=" << depth
+		   << " baseUs=" << before.m_us << " newUs=" << after.m_us << " change=" << change << "%";
+		if( slower )
+			os << " regression";
+		if( nodesChanged )
+			os << " nodes=" << before.m_nodes << "->" << after.m_nodes;
+		if( moveChanged )
+			os << " move=" << before.m_move << "->" << after.m_move;
+		os << std::endl;
+	}
+
+	os << "compare entries=" << compared
+	   << " missing=" << missing
+	   << " regressions=" << regressions
+	   << " nodeChanges=" << nodeChanges
+	   << " moveChanges=" << moveChanges
+	   << " totalChange=" << ( baseUs ? 100.0 * ( (double)newUs - (double)baseUs ) / (double)baseUs : 0.0 ) << "%" << std::endl;
+	return regressions + missing;
+}
@@ -0,0 +1,49 @@
+#pragma once
+
+#include "CheckersBoard.h"
+#include "ComputerPlayer.h"
+
+#include <iostream>
+#include <map>
+#include <string>
+
+//--------------------------------------------------------------------------------------
+// Reproducible search workload: a fixed set of positions, each searched from a fresh player
+// at every depth up to a limit with its tie-breaks seeded, so nodes and best moves are
+// the same on every run of a build.  Prints one "suite" key=value line per search.
+class CSuiteBenchmark
+{
+public:
+	typedef CComputerPlayer<CCheckersBoard>::SConfig TPlayerConfig;
+
+	// Searches use the given config with its depth and seed replaced.
+	CSuiteBenchmark( const TPlayerConfig& config, unsigned int depth, unsigned int seed, unsigned int repeat );
+
+	void Run( std::ostream& os ) const;
+
+	// Compares two outputs of Run.  Searches that got slower by more than thresholdPercent are
+	// flagged as regressions; changed node counts and best moves are listed too since they mean
+	// the search itself changed.  Searches of the base missing from the new output count as
+	// failures too.  Returns the number of regressions and missing searches, or -1 if a file
+	// cannot be read.
+	static int Compare( const std::string& basePath, const std::string& newPath, double thresholdPercent, std::ostream& os );
+
+private:
+	struct SResult
+	{
+		unsigned __int64 m_nodes;
+		unsigned __int64 m_us;
+		std::string m_move;
+
+		SResult() : m_nodes(0), m_us(0) {}
+	};
+	// Keyed by "position depth".
+	typedef std::map<std::string, SResult> TResults;
+
+	TPlayerConfig m_config;
+	unsigned int m_depth;
+	unsigned int m_seed;
+	unsigned int m_repeat;
+
+	static bool Load( const std::string& path, TResults& results );
+};
@@ -0,0 +1,128 @@
+#include "StdAfx.h"
+#include "TableBenchmark.h"
+
+#include "PerfTimer.h"
+#include "Random.h"
+
+#include <set>
+
+namespace
+{
+	// Random games are cut off here, as in the other benchmarks.
+	const unsigned int kMaxPlies = 150;
+
+	//--------------------------------------------------------------------------------------
+	double NsPer( unsigned __int64 us, unsigned __int64 count )
+	{
+		return count ? us * 1000.0 / count : 0.0;
+	}
+}
+
+//--------------------------------------------------------------------------------------
+CTableBenchmark::CTableBenchmark( unsigned int entries, unsigned int probes, unsigned int distance, unsigned int seed )
+	: m_entries( entries ? entries : 1 )
+	, m_probes( probes )
+	, m_distance( distance ? distance : 1 )
+	, m_seed( seed )
+{
+}
+
+//--------------------------------------------------------------------------------------
+void CTableBenchmark::Run( std::ostream& os ) const
+{
+	std::vector<CCheckersBoard> positions;
+	CollectPositions( positions );
+
+	// The same random probe order for every setup.
+	CRandom random( m_seed );
+	std::vector<unsigned int> order( m_probes );
+	for( unsigned int i = 0; i < m_probes; ++i )
+		order[i] = random.NextBelow( (unsigned int)positions.size() );
+
+	os << "table entries=" << m_entries << " positions=" << positions.size() << " bytes=" << TTable::GetMemorySize( m_entries )
+	   << " probes=" << m_probes << " distance=" << m_distance << " numaNodes=" << CPageMemory::GetNumaNodeCount() << std::endl;
+
+	SPageConfig pages;
+	pages.m_hugePages = false;
+	RunSetup( os, pages, positions, order );
+	pages.m_hugePages = true;
+	RunSetup( os, pages, positions, order );
+	pages.m_numa = NumaPolicy_Interleave;
+	RunSetup( os, pages, positions, order );
+	pages.m_numa = NumaPolicy_Local;
+	RunSetup( os, pages, positions, order );
+}
+
+//--------------------------------------------------------------------------------------
+void CTableBenchmark::CollectPositions( std::vector<CCheckersBoard>& positions ) const
+{
+	// Distinct positions of random games, enough to fill the table.
+	CRandom random( m_seed );
+	std::set<unsigned __int64> seen;
+	positions.reserve( m_entries );
+	while( positions.size() < m_entries )
+	{
+		CCheckersBoard board;
+		EPlayer player = Player_Red;
+		bool reversible = false;
+		for( unsigned int ply = 0; ply < kMaxPlies && positions.size() < m_entries; ++ply )
+		{
+			if( !board.MakeRandomMove( player, random, reversible ) )
+				break;
+			player = CCheckersBoard::GetOpponent( player );
+			if( seen.insert( board.GetHashKey() ).second )
+				positions.push_back( board );
+		}
+	}
+}
+
+//--------------------------------------------------------------------------------------
+void CTableBenchmark::RunSetup( std::ostream& os, const SPageConfig& pages, const std::vector<CCheckersBoard>& positions, const std::vector<unsigned int>& order ) const
+{
+	CStopwatch stopwatch;
+	TTable table( m_entries, pages );
+	const unsigned __int64 allocateUs = stopwatch.GetElapsedUs();
+
+	// Filling faults every page in.
+	stopwatch.Restart();
+	for( size_t i = 0; i < positions.size(); ++i )
+		table.UpdateCache( positions[i], TEntry( (unsigned int)i & 15, (unsigned int)i, CComputerPlayer<CCheckersBoard>::ScoreType_Exact ) );
+	const unsigned __int64 fillUs = stopwatch.GetElapsedUs();
+
+	// Lookups one after another, each waiting on its own misses.
+	unsigned int found = 0;
+	stopwatch.Restart();
+	for( size_t i = 0; i < order.size(); ++i )
+		found += table.Get( positions[ order[i] ] ) ? 1 : 0;
+	const unsigned __int64 probeUs = stopwatch.GetElapsedUs();
+
+	// The same lookups with each slot loaded 2 * distance probes ahead and its entry distance
+	// probes ahead, as the search does for the moves it is about to make.
+	const size_t distance = m_distance;
+	unsigned int prefetchedFound = 0;
+	stopwatch.Restart();
+	for( size_t i = 0; i < order.size(); ++i )
+	{
+		if( i + 2 * distance < order.size() )
+			table.PrefetchSlot( table.GetKeyHash( positions[ order[i + 2 * distance] ] ) );
+		if( i + distance < order.size() )
+			table.PrefetchEntry( table.GetKeyHash( positions[ order[i + distance] ] ) );
+		prefetchedFound += table.Get( positions[ order[i] ] ) ? 1 : 0;
+	}
+	const unsigned __int64 prefetchUs = stopwatch.GetElapsedUs();
+
+	const CPageMemory& memory = table.GetMemory();
+	os << "table hugePages=" << ( pages.m_hugePages ? 1 : 0 )
+	   << " numa=" << SPageConfig::GetNumaPolicyName( pages.m_numa )
+	   << " pages=" << CPageMemory::GetPageKindName( memory.GetPageKind() )
+	   << " placed=" << SPageConfig::GetNumaPolicyName( memory.GetNumaPolicy() )
+	   << " allocateUs=" << allocateUs
+	   << " fillNsPerEntry=" << NsPer( fillUs, positions.size() )
+	   << " probeNs=" << NsPer( probeUs, order.size() )
+	   << " prefetchProbeNs=" << NsPer( prefetchUs, order.size() )
+	   << " prefetchSpeedup=" << ( prefetchUs ? (double)probeUs / prefetchUs : 0.0 )
+	   << " hits=" << found;
+	if( prefetchedFound != found )
+		os << " prefetchHits=" << prefetchedFound;
+	os << std::endl;
+}
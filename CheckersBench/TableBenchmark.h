@@ -0,0 +1,35 @@
+#pragma once
+
+#include "CheckersBoard.h"
+#include "ComputerPlayer.h"
+#include "PageMemory.h"
+
+#include <iostream>
+#include <vector>
+
+//--------------------------------------------------------------------------------------
+// Memory cost of a large transposition table.  Fills a table of the search's own type with
+// positions from random games, then times random probes of it with normal pages, with huge
+// pages, and with huge pages interleaved over the NUMA nodes and on the local node, each with
+// and without prefetching the probes a few ahead.  Every line gives the pages and placement
+// the OS actually granted, since each falls back when it cannot be had.
+class CTableBenchmark
+{
+public:
+	typedef CComputerPlayer<CCheckersBoard>::STranspositionEntry TEntry;
+	typedef CLearningCache<CCheckersBoard, TEntry> TTable;
+
+	CTableBenchmark( unsigned int entries, unsigned int probes, unsigned int distance, unsigned int seed );
+
+	void Run( std::ostream& os ) const;
+
+private:
+	unsigned int m_entries;
+	unsigned int m_probes;
+	// Probes between prefetching a slot and making the lookup.
+	unsigned int m_distance;
+	unsigned int m_seed;
+
+	void CollectPositions( std::vector<CCheckersBoard>& positions ) const;
+	void RunSetup( std::ostream& os, const SPageConfig& pages, const std::vector<CCheckersBoard>& positions, const std::vector<unsigned int>& order ) const;
+};
@@ -0,0 +1,115 @@
+#pragma once
+
+#include "stdafx.h"
+
+#include "ComputerPlayer.h"
+#include "GameHistory.h"
+#include "Threading.h"
+
+#include <functional>
+
+//--------------------------------------------------------------------------------------
+// Outcome of a search run by CAsyncSearch.
+struct SSearchResult
+{
+	// False if the side to move had no move.
+	bool m_found;
+	CMove m_bestMove;
+	SSearchStats m_stats;
+	// The search was abandoned by Cancel; the move must not be played.
+	bool m_cancelled;
+	// The result came from pondering on the move the opponent actually made.
+	bool m_ponderHit;
+
+	SSearchResult() : m_found(false), m_cancelled(false), m_ponderHit(false) {}
+};
+
+//--------------------------------------------------------------------------------------
+// Runs a computer player on its own thread so the caller is never blocked by a search.
+// A search is started on a position and its result is collected with Wait or a callback.
+// It can be stopped early, which keeps the best move found so far, or cancelled.
+//
+// Pondering: after making its move the engine guesses the opponent's reply and searches the
+// position after it while the opponent thinks.  When the opponent plays the guessed move the
+// search carries on as the real one with the time limit counting from then, or its result is
+// used straight away if it already finished.  Any other reply cancels it and starts afresh.
+template <typename TGameBoard>
+class CAsyncSearch
+{
+public:
+	typedef CComputerPlayer<TGameBoard> TPlayer;
+	// Called on the search thread when a search finishes, or on the thread calling
+	// OpponentMoved if pondering had already found the result.  Not called for cancelled searches.
+	typedef std::function<void ( const SSearchResult& )> TCallback;
+
+	CAsyncSearch( EPlayer player, const typename TPlayer::SConfig& config );
+	// Cancels any search and waits for the thread to finish.
+	~CAsyncSearch();
+
+	EPlayer GetPlayer() const { return m_player.GetPlayer(); }
+
+	// Searches the position with this player to move.  A search in progress is cancelled first.
+	void Start( const TGameBoard& board, const CGameHistory& history, const TCallback& callback = TCallback() );
+	// Ends the search early; the best move of the last finished iteration is reported.
+	void Stop();
+	// Abandons the search or pondering; the result is flagged as cancelled.
+	void Cancel();
+
+	// Returns true while a search is running, including pondering.
+	bool IsSearching() const;
+	// Blocks until the current search finishes and returns its result.
+	// Must not be called while pondering before the opponent has moved.
+	SSearchResult Wait();
+
+	// Starts pondering on the board after this player's move, with the opponent to move.
+	// Returns false if the opponent has no move to guess.
+	bool Ponder( const TGameBoard& board, const CGameHistory& history );
+	// Tells the engine the opponent's reply.  board and history are the position after it.
+	// Reuses the ponder search on a hit and starts a new search otherwise; either way the
+	// result is delivered as for Start.
+	void OpponentMoved( const TGameBoard& board, const CMove& reply, const CGameHistory& history, const TCallback& callback = TCallback() );
+
+private:
+	struct SJob
+	{
+		TGameBoard m_board;
+		CGameHistory m_history;
+		TCallback m_callback;
+		bool m_ponder;
+
+		SJob() : m_ponder(false) {}
+	};
+
+	// Only the worker thread touches the player while a search runs, except for the
+	// Stop and PonderHit signals.
+	TPlayer m_player;
+	CThread m_thread;
+
+	mutable CCriticalSection m_lock;
+	CConditionVariable m_wake;
+	CConditionVariable m_done;
+
+	SJob m_job;
+	bool m_hasJob;
+	bool m_busy;
+	bool m_quit;
+	bool m_stopRequested;
+	bool m_cancelled;
+	SSearchResult m_result;
+
+	// Pondering state.  m_ponderActive is set from Ponder until OpponentMoved or Cancel.
+	bool m_ponderActive;
+	bool m_ponderFinished;
+	bool m_ponderHitReceived;
+	CMove m_ponderMove;
+	TCallback m_ponderHitCallback;
+
+	void WorkerLoop();
+	// Queues a job for the worker, which must be idle.  Called with m_lock held.
+	void Post( const TGameBoard& board, const CGameHistory& history, const TCallback& callback, bool ponder );
+	// Stops the current search without reporting it and waits for the worker to go idle.
+	void CancelAndWait();
+
+	CAsyncSearch( const CAsyncSearch& );
+	CAsyncSearch& operator=( const CAsyncSearch& );
+};
@@ -0,0 +1,234 @@
+#pragma once
+
+#include "StdAfx.h"
+#include "AsyncSearch.h"
+#include "ComputerPlayer.inl"
+
+//--------------------------------------------------------------------------------------
+template <typename TGameBoard>
+CAsyncSearch<TGameBoard>::CAsyncSearch( EPlayer player, const typename TPlayer::SConfig& config )
+	: m_player( player, config )
+	, m_hasJob( false )
+	, m_busy( false )
+	, m_quit( false )
+	, m_stopRequested( false )
+	, m_cancelled( false )
+	, m_ponderActive( false )
+	, m_ponderFinished( false )
+	, m_ponderHitReceived( false )
+{
+	m_thread.Start( [this]() { WorkerLoop(); } );
+}
+
+//--------------------------------------------------------------------------------------
+template <typename TGameBoard>
+CAsyncSearch<TGameBoard>::~CAsyncSearch()
+{
+	{
+		CScopedLock<CCriticalSection> lock( m_lock );
+		m_quit = true;
+		m_cancelled = true;
+		m_player.Stop();
+		m_wake.NotifyAll();
+	}
+	m_thread.Join();
+}
+
+//--------------------------------------------------------------------------------------
+template <typename TGameBoard>
+void CAsyncSearch<TGameBoard>::Start( const TGameBoard& board, const CGameHistory& history, const TCallback& callback )
+{
+	CancelAndWait();
+
+	CScopedLock<CCriticalSection> lock( m_lock );
+	Post( board, history, callback, false );
+}
+
+//--------------------------------------------------------------------------------------
+template <typename TGameBoard>
+void CAsyncSearch<TGameBoard>::Stop()
+{
+	CScopedLock<CCriticalSection> lock( m_lock );
+	if( m_busy )
+	{
+		m_stopRequested = true;
+		m_player.Stop();
+	}
+}
+
+//--------------------------------------------------------------------------------------
+template <typename TGameBoard>
+void CAsyncSearch<TGameBoard>::Cancel()
+{
+	CScopedLock<CCriticalSection> lock( m_lock );
+	m_ponderActive = false;
+	if( m_busy )
+	{
+		m_cancelled = true;
+		m_stopRequested = true;
+		m_player.Stop();
+	}
+}
+
+//--------------------------------------------------------------------------------------
+template <typename TGameBoard>
+bool CAsyncSearch<TGameBoard>::IsSearching() const
+{
+	CScopedLock<CCriticalSection> lock( m_lock );
+	return m_busy;
+}
+
+//--------------------------------------------------------------------------------------
+template <typename TGameBoard>
+SSearchResult CAsyncSearch<TGameBoard>::Wait()
+{
+	CScopedLock<CCriticalSection> lock( m_lock );
+	while( m_busy )
+		m_done.Wait( m_lock );
+	return m_result;
+}
+
+//--------------------------------------------------------------------------------------
+template <typename TGameBoard>
+bool CAsyncSearch<TGameBoard>::Ponder( const TGameBoard& board, const CGameHistory& history )
+{
+	CancelAndWait();
+
+	// The worker is idle so the player's table can be read here.
+	CMove reply;
+	if( !m_player.GuessReply( board, reply ) )
+		return false;
+
+	EPlayer opponent = TGameBoard::GetOpponent( m_player.GetPlayer() );
+	TGameBoard expected( board, opponent, reply );
+	CGameHistory expectedHistory( history );
+	expectedHistory.Push( expected.GetHashKey(), board.IsReversibleMove( opponent, reply ) );
+
+	CScopedLock<CCriticalSection> lock( m_lock );
+	Post( expected, expectedHistory, TCallback(), true );
+	m_ponderActive = true;
+	m_ponderFinished = false;
+	m_ponderHitReceived = false;
+	m_ponderMove = reply;
+	m_ponderHitCallback = TCallback();
+	return true;
+}
+
+//--------------------------------------------------------------------------------------
+template <typename TGameBoard>
+void CAsyncSearch<TGameBoard>::OpponentMoved( const TGameBoard& board, const CMove& reply, const CGameHistory& history, const TCallback& callback )
+{
+	SSearchResult result;
+	{
+		CScopedLock<CCriticalSection> lock( m_lock );
+		if( m_ponderActive && reply == m_ponderMove )
+		{
+			m_ponderActive = false;
+			if( !m_ponderFinished )
+			{
+				// The worker reports the result when the search ends.
+				m_ponderHitReceived = true;
+				m_ponderHitCallback = callback;
+				m_player.PonderHit();
+				return;
+			}
+
+			result = m_result;
+			result.m_ponderHit = true;
+			m_result = result;
+		}
+	}
+
+	if( result.m_ponderHit )
+	{
+		if( callback )
+			callback( result );
+		return;
+	}
+
+	// A miss, or no pondering at all.
+	Start( board, history, callback );
+}
+
+//--------------------------------------------------------------------------------------
+template <typename TGameBoard>
+void CAsyncSearch<TGameBoard>::Post( const TGameBoard& board, const CGameHistory& history, const TCallback& callback, bool ponder )
+{
+	m_job.m_board = board;
+	m_job.m_history = history;
+	m_job.m_callback = callback;
+	m_job.m_ponder = ponder;
+	m_hasJob = true;
+	m_busy = true;
+	m_stopRequested = false;
+	m_cancelled = false;
+	m_ponderActive = false;
+	m_result = SSearchResult();
+	m_wake.NotifyAll();
+}
+
+//--------------------------------------------------------------------------------------
+template <typename TGameBoard>
+void CAsyncSearch<TGameBoard>::CancelAndWait()
+{
+	Cancel();
+
+	CScopedLock<CCriticalSection> lock( m_lock );
+	while( m_busy )
+		m_done.Wait( m_lock );
+}
+
+//--------------------------------------------------------------------------------------
+template <typename TGameBoard>
+void CAsyncSearch<TGameBoard>::WorkerLoop()
+{
+	for( ;; )
+	{
+		SJob job;
+		{
+			CScopedLock<CCriticalSection> lock( m_lock );
+			while( !m_hasJob && !m_quit )
+				m_wake.Wait( m_lock );
+			if( m_quit )
+				return;
+
+			job = m_job;
+			m_hasJob = false;
+
+			// Signals are cleared here rather than in Post so a Stop issued before the search
+			// got going is not lost.
+			m_player.ResetSignals();
+			m_player.SetPondering( job.m_ponder );
+			if( m_stopRequested )
+				m_player.Stop();
+		}
+
+		SSearchResult result;
+		result.m_found = m_player.FindBestMove( job.m_board, result.m_bestMove, &job.m_history );
+		result.m_stats = m_player.GetLastSearchStats();
+
+		TCallback callback;
+		{
+			CScopedLock<CCriticalSection> lock( m_lock );
+			result.m_cancelled = m_cancelled;
+			if( job.m_ponder )
+			{
+				result.m_ponderHit = m_ponderHitReceived;
+				callback = m_ponderHitCallback;
+				// Finished before the opponent moved: keep the result for OpponentMoved.
+				m_ponderFinished = !m_ponderHitReceived;
+			}
+			else
+			{
+				callback = job.m_callback;
+			}
+
+			m_result = result;
+			m_busy = false;
+			m_done.NotifyAll();
+		}
+
+		if( callback && !result.m_cancelled )
+			callback( result );
+	}
+}
@@ -1,6 +1,10 @@
 #include "StdAfx.h"
 #include "CheckersBoard.h"
 
+#include "ConfigFile.h"
+
+#include <fstream>
+
 CPerfTimer CCheckersBoard::s_GetMoves( "CCheckersBoard::GetMoves" );
 CPerfTimer CCheckersBoard::s_AddSimpleMoves( "CCheckersBoard::AddSimpleMoves" );
 CPerfTimer CCheckersBoard::s_AddJumpMoves( "CCheckersBoard::AddJumpMoves" );
@@ -22,6 +26,124 @@ static int BitCount( unsigned __int64 l )
 	return BitCount( (unsigned int)l ) + BitCount( (unsigned int)(l >> 32) );
 }
 
+//--------------------------------------------------------------------------------------
+// The 32 dark squares are numbered in the order of their bits, x * 8 + y, so square s is bit
+// s * 2 or s * 2 + 1 and bit i is square i / 2.  Directions are those of the old diagonal
+// walk: bit 0 set steps towards lower x and bit 1 set towards lower y.
+namespace
+{
+	const int kSquareCount = kBoardSize * kBoardSize / 2;
+	const int kDirectionCount = 4;
+
+	// Coordinates of a square, worked out by the compiler for the tables below.
+	template <int square> struct SSquare
+	{
+		enum
+		{
+			x = square / 4,
+			y = ( square % 4 ) * 2 + ( ( x + 1 ) & 1 )
+		};
+	};
+
+	// The square distance steps away along a diagonal, or -1 when that is off the board.
+	template <int square, int direction, int distance> struct SDiagonal
+	{
+		enum
+		{
+			x = SSquare<square>::x + ( ( direction & 1 ) ? -distance : distance ),
+			y = SSquare<square>::y + ( ( direction & 2 ) ? -distance : distance ),
+			value = ( x >= 0 && x < kBoardSize && y >= 0 && y < kBoardSize ) ? x * 4 + y / 2 : -1
+		};
+	};
+
+#define SQUARE_DIAGONALS( square, distance ) \
+	{ SDiagonal<square, 0, distance>::value, SDiagonal<square, 1, distance>::value, SDiagonal<square, 2, distance>::value, SDiagonal<square, 3, distance>::value }
+#define SQUARE_COLUMN( column, distance ) \
+	SQUARE_DIAGONALS( column * 4, distance ), SQUARE_DIAGONALS( column * 4 + 1, distance ), SQUARE_DIAGONALS( column * 4 + 2, distance ), SQUARE_DIAGONALS( column * 4 + 3, distance )
+#define SQUARE_TABLE( distance ) \
+	{ SQUARE_COLUMN( 0, distance ), SQUARE_COLUMN( 1, distance ), SQUARE_COLUMN( 2, distance ), SQUARE_COLUMN( 3, distance ), \
+	  SQUARE_COLUMN( 4, distance ), SQUARE_COLUMN( 5, distance ), SQUARE_COLUMN( 6, distance ), SQUARE_COLUMN( 7, distance ) }
+
+	// The neighbouring square in each direction, which is also the square a jump takes.
+	const signed char kStepSquares[kSquareCount][kDirectionCount] = SQUARE_TABLE( 1 );
+	// Where a jump in each direction lands.
+	const signed char kJumpSquares[kSquareCount][kDirectionCount] = SQUARE_TABLE( 2 );
+
+#undef SQUARE_TABLE
+#undef SQUARE_COLUMN
+#undef SQUARE_DIAGONALS
+
+	inline int SquareToIndex( int square ) { return square * 2 + ( ( ( square >> 2 ) + 1 ) & 1 ); }
+	inline unsigned __int64 SquareToBit( int square ) { return (unsigned __int64)1 << SquareToIndex( square ); }
+	inline SPosition SquareToPosition( int square ) { const int index = SquareToIndex( square ); return SPosition( index / kBoardSize, index % kBoardSize ); }
+	inline int PositionToSquare( const SPosition& pos ) { return pos.ToIndex() / 2; }
+
+	// Writes first + square for every square set in bits.  Returns how many were written.
+	unsigned int GetSquareInputs( unsigned __int64 bits, unsigned short first, unsigned short* pInputs )
+	{
+		unsigned int count = 0;
+		for( int square = 0; bits && square < kSquareCount; ++square )
+		{
+			const unsigned __int64 bit = SquareToBit( square );
+			if( bits & bit )
+			{
+				pInputs[count++] = (unsigned short)( first + square );
+				bits &= ~bit;
+			}
+		}
+		return count;
+	}
+
+	// Directions of a step or jump between two squares, as in the tables.
+	inline int GetDirection( const SPosition& from, const SPosition& to ) { return ( to.m_x < from.m_x ? 1 : 0 ) | ( to.m_y < from.m_y ? 2 : 0 ); }
+}
+
+//--------------------------------------------------------------------------------------
+SEvalWeights::SEvalWeights()
+{
+	memset( m_values, 0, sizeof( m_values ) );
+	m_values[Feature_Man] = 100;
+	m_values[Feature_King] = 200;
+}
+
+//--------------------------------------------------------------------------------------
+const char* SEvalWeights::GetFeatureName( EFeature feature )
+{
+	static const char* s_names[FeatureCount] = { "man", "king", "backRowMan", "centerMan", "centerKing", "manAdvance", "edgeKing" };
+	return ( feature >= 0 && feature < FeatureCount ) ? s_names[feature] : "";
+}
+
+//--------------------------------------------------------------------------------------
+void SEvalWeights::Load( const CConfigFile& file, const std::string& section )
+{
+	for( int i = 0; i < FeatureCount; ++i )
+		m_values[i] = file.GetInt( section, GetFeatureName( (EFeature)i ), m_values[i] );
+}
+
+//--------------------------------------------------------------------------------------
+bool SEvalWeights::Load( const std::string& path )
+{
+	CConfigFile file;
+	if( !file.Load( path ) )
+		return false;
+
+	Load( file, "weights" );
+	return true;
+}
+
+//--------------------------------------------------------------------------------------
+bool SEvalWeights::Save( const std::string& path ) const
+{
+	std::ofstream os( path.c_str() );
+	if( !os )
+		return false;
+
+	os << "[weights]" << std::endl;
+	for( int i = 0; i < FeatureCount; ++i )
+		os << GetFeatureName( (EFeature)i ) << " = " << m_values[i] << std::endl;
+	return os.good();
+}
+
 //--------------------------------------------------------------------------------------
 CCheckersBoard::CCheckersBoard(const CCheckersBoard& cpy, EPlayer movingPlayer, const CMove& move)
 {
@@ -32,10 +154,7 @@ CCheckersBoard::CCheckersBoard(const CCheckersBoard& cpy, EPlayer movingPlayer,
 //--------------------------------------------------------------------------------------
 void CCheckersBoard::Initialize()
 {
-	m_blackPieces = 0ll;
-	m_redPieces = 0ll;
-	m_blackKings = 0ll;
-	m_redKings = 0ll;
+	Clear();
 	for( int i = 0; i < 4; ++i )
 	{
 		SetSquareState( SPosition(1 + i * 2, 0), SquareState_Red );
@@ -51,19 +170,33 @@ void CCheckersBoard::Initialize()
 //--------------------------------------------------------------------------------------
 bool CCheckersBoard::IsValidMove( EPlayer player, const CMove& move, std::vector<SPosition>* pRemovedPieces, SPosition* pFinalPosition, ESquareState* pNewState ) const
 {
-	CPerfTimerCall __call( s_IsValidMove );
+	switch( player )
+	{
+	case Player_Red:
+		return IsValidPlayerMove<Player_Red>( move, pRemovedPieces, pFinalPosition, pNewState );
+	case Player_Black:
+		return IsValidPlayerMove<Player_Black>( move, pRemovedPieces, pFinalPosition, pNewState );
+	default:
+		return false;
+	}
+}
+
+//--------------------------------------------------------------------------------------
+template <EPlayer player>
+bool CCheckersBoard::IsValidPlayerMove( const CMove& move, std::vector<SPosition>* pRemovedPieces, SPosition* pFinalPosition, ESquareState* pNewState ) const
+{
+	TPerfCall __call( s_IsValidMove );
 
 	assert( !pRemovedPieces || pRemovedPieces->empty() );
 	assert( move.m_start.IsValid() );
 	assert( GetPlayerOwner( GetSquareState( move.m_start ) ) == player );
 	assert( move.m_sequence.size() );
 
-	EPlayer opponentPlayer = GetOpponent( player );
+	const EPlayer opponentPlayer = ( player == Player_Red ) ? Player_Black : Player_Red;
 	bool isKing = IsKing( GetSquareState( move.m_start ) );
-	
-	// Only test for loops with kings since only they can jump backwards.
-	if( isKing && EndsInLoop( move.m_sequence ) )
-		return false;
+
+	// Squares of the pieces jumped so far.
+	unsigned int captured = 0;
 
 	SPosition curr = move.m_start;
 	SPosition prev( 0, 0 );
@@ -90,31 +223,26 @@ bool CCheckersBoard::IsValidMove( EPlayer player, const CMove& move, std::vector
 		assert( disX <= 2 );
 		assert( i == 0 || disY == 2 );
 
-		// Only kings can reverse direction.
-		if( !isKing )
-		{
-			switch( player )
-			{
-			case Player_Red:
-				if( curr.m_y > next.m_y )
-					return false;
-				break;
-			case Player_Black:
-				if( curr.m_y < next.m_y )
-					return false;
-				break;
-			}
-		}
+		// Only kings can reverse direction.  Red men move up the rows and black men down them.
+		if( !isKing && ( ( player == Player_Red ) ? ( curr.m_y > next.m_y ) : ( curr.m_y < next.m_y ) ) )
+			return false;
 
 		// Jump test.
 		if( disX == 2 )
 		{
-			SPosition middle;
-			if( !GetMiddlePosition( curr, next, middle ) )
+			const int from = PositionToSquare( curr );
+			const int direction = GetDirection( curr, next );
+			if( kJumpSquares[from][direction] != PositionToSquare( next ) )
 				return false;
-			assert( GetPlayerOwner( GetSquareState( middle ) ) == opponentPlayer );
+			const int middle = kStepSquares[from][direction];
+			assert( GetPlayerOwner( GetSquareState( SquareToPosition( middle ) ) ) == opponentPlayer );
+			// A piece can only be jumped once.
+			const unsigned int middleBit = 1u << middle;
+			if( captured & middleBit )
+				return false;
+			captured |= middleBit;
 			if( pRemovedPieces )
-				pRemovedPieces->push_back( middle );
+				pRemovedPieces->push_back( SquareToPosition( middle ) );
 			hasJumped = true;
 		}
 
@@ -126,18 +254,10 @@ bool CCheckersBoard::IsValidMove( EPlayer player, const CMove& move, std::vector
 	if( pNewState )
 	{
 		// If the piece reaches the back row then it becomes a king if it isn't already.
-		switch( player )
-		{
-		case Player_Red:
+		if( player == Player_Red )
 			*pNewState = (curr.m_y == 7 || isKing) ? SquareState_RedKing : SquareState_Red;
-			break;
-		case Player_Black:
+		else
 			*pNewState = (curr.m_y == 0 || isKing) ? SquareState_BlackKing : SquareState_Black;
-			break;
-		default:
-			// error state.
-			return false;
-		}
 	}
 
 	return true;
@@ -146,7 +266,7 @@ bool CCheckersBoard::IsValidMove( EPlayer player, const CMove& move, std::vector
 //--------------------------------------------------------------------------------------
 bool CCheckersBoard::MakeMoveIfValid( EPlayer player, const CMove& move )
 {
-	CPerfTimerCall __call( s_MakeMoveIfValid );
+	TPerfCall __call( s_MakeMoveIfValid );
 
 	std::vector<SPosition> removed;
 	SPosition final;
@@ -164,101 +284,239 @@ bool CCheckersBoard::MakeMoveIfValid( EPlayer player, const CMove& move )
 }
 
 //--------------------------------------------------------------------------------------
-int CCheckersBoard::CalculatePlayerScore( EPlayer player ) const
+// Square sets for the evaluation features.  Bit x * 8 + y is the square ( x, y ).
+static const unsigned __int64 kRowMask = 0x0101010101010101ull;
+static const unsigned __int64 kRedBackRow = kRowMask;
+static const unsigned __int64 kBlackBackRow = kRowMask << ( kBoardSize - 1 );
+static const unsigned __int64 kCenter = 0x00003C3C3C3C0000ull;
+static const unsigned __int64 kSideColumns = 0xFF000000000000FFull;
+
+//--------------------------------------------------------------------------------------
+int CCheckersBoard::CalculatePlayerScore( EPlayer player, const SEvalWeights& weights ) const
 {
-	// Score kings as 2 points.
+	int features[SEvalWeights::FeatureCount];
+	GetEvalFeatures( features );
 
-	int redScore   = BitCount( m_redPieces   ) + 2 * BitCount( m_redKings );
-	int blackScore = BitCount( m_blackPieces ) + 2 * BitCount( m_blackKings );
+	int redScore = 0;
+	for( int i = 0; i < SEvalWeights::FeatureCount; ++i )
+		redScore += weights.m_values[i] * features[i];
 
 	// Test for win state.
-	if( !redScore )
-		blackScore = CCheckersBoard::MaxScore;
-	if( !blackScore )
+	if( !( m_redPieces | m_redKings ) )
+		redScore = CCheckersBoard::MinScore;
+	else if( !( m_blackPieces | m_blackKings ) )
 		redScore = CCheckersBoard::MaxScore;
 
-	return ( player == Player_Red ) ? ( redScore - blackScore ) : ( blackScore - redScore );
+	return ( player == Player_Red ) ? redScore : -redScore;
 }
 
 //--------------------------------------------------------------------------------------
-bool CCheckersBoard::AddSimpleMoves( EPlayer player, const SPosition& start, std::vector<CMove>& moves ) const
+void CCheckersBoard::GetEvalFeatures( int features[SEvalWeights::FeatureCount] ) const
 {
-	CPerfTimerCall __call( s_AddSimpleMoves );
+	features[SEvalWeights::Feature_Man] = BitCount( m_redPieces ) - BitCount( m_blackPieces );
+	features[SEvalWeights::Feature_King] = BitCount( m_redKings ) - BitCount( m_blackKings );
+	features[SEvalWeights::Feature_BackRowMan] = BitCount( m_redPieces & kRedBackRow ) - BitCount( m_blackPieces & kBlackBackRow );
+	features[SEvalWeights::Feature_CenterMan] = BitCount( m_redPieces & kCenter ) - BitCount( m_blackPieces & kCenter );
+	features[SEvalWeights::Feature_CenterKing] = BitCount( m_redKings & kCenter ) - BitCount( m_blackKings & kCenter );
+	features[SEvalWeights::Feature_EdgeKing] = BitCount( m_redKings & kSideColumns ) - BitCount( m_blackKings & kSideColumns );
+
+	// Red advances up the rows and black down them.
+	int advance = 0;
+	for( int rows = 1; rows < kBoardSize; ++rows )
+	{
+		advance += rows * BitCount( m_redPieces & ( kRowMask << rows ) );
+		advance -= rows * BitCount( m_blackPieces & ( kRowMask << ( kBoardSize - 1 - rows ) ) );
+	}
+	features[SEvalWeights::Feature_ManAdvance] = advance;
+}
 
-	bool added = false;
+//--------------------------------------------------------------------------------------
+unsigned int CCheckersBoard::GetNetworkInputs( unsigned short* pInputs ) const
+{
+	const unsigned __int64 sets[4] = { m_redPieces, m_redKings, m_blackPieces, m_blackKings };
+	unsigned int count = 0;
+	for( int i = 0; i < 4; ++i )
+		count += GetSquareInputs( sets[i], (unsigned short)( i * kSquareCount ), pInputs + count );
+	return count;
+}
 
-	CMove test;
-	test.m_start = start;
-	test.m_sequence.resize( 1 );
+//--------------------------------------------------------------------------------------
+void CCheckersBoard::GetNetworkChanges( const CCheckersBoard& from, unsigned short* pAdded, unsigned int& addedCount, unsigned short* pRemoved, unsigned int& removedCount ) const
+{
+	const unsigned __int64 sets[4] = { m_redPieces, m_redKings, m_blackPieces, m_blackKings };
+	const unsigned __int64 fromSets[4] = { from.m_redPieces, from.m_redKings, from.m_blackPieces, from.m_blackKings };
+	addedCount = 0;
+	removedCount = 0;
+	for( int i = 0; i < 4; ++i )
+	{
+		// A move changes a few squares of one or two sets, the others are skipped whole.
+		const unsigned __int64 changed = sets[i] ^ fromSets[i];
+		if( !changed )
+			continue;
+		addedCount += GetSquareInputs( changed & sets[i], (unsigned short)( i * kSquareCount ), pAdded + addedCount );
+		removedCount += GetSquareInputs( changed & fromSets[i], (unsigned short)( i * kSquareCount ), pRemoved + removedCount );
+	}
+}
+
+//--------------------------------------------------------------------------------------
+// Diagonal steps on the square masks, for the random moves of playouts.  In the directions of
+// the tables a step shifts the bits by 9, -7, 7 or -9; steps off the sides shift out of the
+// mask and those off the first or last row are kept out by the source masks.
+namespace
+{
+	const int kStepShifts[kDirectionCount] = { 9, -7, 7, -9 };
+	// Squares a piece can step, or jump, from in each direction.
+	const unsigned __int64 kStepSources[kDirectionCount] = { ~kBlackBackRow, ~kBlackBackRow, ~kRedBackRow, ~kRedBackRow };
+	const unsigned __int64 kJumpSources[kDirectionCount] = { ~( kBlackBackRow | kBlackBackRow >> 1 ), ~( kBlackBackRow | kBlackBackRow >> 1 ),
+		~( kRedBackRow | kRedBackRow << 1 ), ~( kRedBackRow | kRedBackRow << 1 ) };
+
+	inline unsigned __int64 ShiftSquares( unsigned __int64 bits, int shift ) { return ( shift > 0 ) ? bits << shift : bits >> -shift; }
 
-	unsigned int colorOffset = 0;
-	unsigned int moveCount = 4;
-	bool isKing = IsKing( GetSquareState( start ) );
-	if( !isKing )
+	// Picks the index'th of the squares set in bits.
+	inline unsigned __int64 PickSquare( unsigned __int64 bits, unsigned int index )
 	{
-		colorOffset = ( player == Player_Red ) ? 0 : 2;
-		moveCount = 2;
+		while( index-- )
+			bits &= bits - 1;
+		return bits & ( ~bits + 1 );
 	}
+}
 
-	for( unsigned int move = colorOffset; move < colorOffset + moveCount; ++move )
+//--------------------------------------------------------------------------------------
+bool CCheckersBoard::MakeRandomMove( EPlayer player, CRandom& random, bool& reversible )
+{
+	switch( player )
 	{
-		if( !GetNextSpace( test.m_start, move, test.m_sequence[ 0 ] ) )
-			continue;
+	case Player_Red:
+		return MakeRandomPlayerMove<Player_Red>( random, reversible );
+	case Player_Black:
+		return MakeRandomPlayerMove<Player_Black>( random, reversible );
+	default:
+		return false;
+	}
+}
 
-		if( GetSquareState( test.m_sequence[ 0 ] ) != SquareState_Blank )
-			continue;
+//--------------------------------------------------------------------------------------
+template <EPlayer player>
+bool CCheckersBoard::MakeRandomPlayerMove( CRandom& random, bool& reversible )
+{
+	unsigned __int64& men = ( player == Player_Red ) ? m_redPieces : m_blackPieces;
+	unsigned __int64& kings = ( player == Player_Red ) ? m_redKings : m_blackKings;
+	unsigned __int64& opponentMen = ( player == Player_Red ) ? m_blackPieces : m_redPieces;
+	unsigned __int64& opponentKings = ( player == Player_Red ) ? m_blackKings : m_redKings;
+	const unsigned __int64 crowningRow = ( player == Player_Red ) ? kBlackBackRow : kRedBackRow;
+	const unsigned __int64 opponents = opponentMen | opponentKings;
+	// The moving piece and the pieces it jumps stay on the board until the chain ends, as in GetMoves.
+	const unsigned __int64 empty = ~( men | kings | opponents );
+
+	// The pieces that can jump, or failing that step, in each direction.  Red men go up the rows
+	// (directions 0 and 1) and black men down them (2 and 3); kings go all four ways.
+	const int manDirections = ( player == Player_Red ) ? 0 : 1;
+	unsigned __int64 movers[kDirectionCount];
+	unsigned int count = 0;
+	for( int direction = 0; direction < kDirectionCount; ++direction )
+	{
+		const int shift = kStepShifts[direction];
+		const unsigned __int64 pieces = ( ( direction >> 1 ) == manDirections ) ? ( men | kings ) : kings;
+		movers[direction] = pieces & kJumpSources[direction] & ShiftSquares( opponents, -shift ) & ShiftSquares( empty, -2 * shift );
+		count += BitCount( movers[direction] );
+	}
 
-		assert( IsValidMove( player, test ) );
+	const bool jumping = count != 0;
+	if( !jumping )
+	{
+		for( int direction = 0; direction < kDirectionCount; ++direction )
+		{
+			const unsigned __int64 pieces = ( ( direction >> 1 ) == manDirections ) ? ( men | kings ) : kings;
+			movers[direction] = pieces & kStepSources[direction] & ShiftSquares( empty, -kStepShifts[direction] );
+			count += BitCount( movers[direction] );
+		}
+		if( !count )
+			return false;
+	}
 
-		moves.push_back( test );
-		added = true;
+	unsigned int index = random.NextBelow( count );
+	int direction = 0;
+	for( ; ; ++direction )
+	{
+		const unsigned int directionCount = BitCount( movers[direction] );
+		if( index < directionCount )
+			break;
+		index -= directionCount;
 	}
+	const unsigned __int64 from = PickSquare( movers[direction], index );
+	const bool isKing = ( kings & from ) != 0;
 
-	return added;
+	unsigned __int64 to = ShiftSquares( from, kStepShifts[direction] );
+	unsigned __int64 captured = 0;
+	if( jumping )
+	{
+		// Jumps on until the piece cannot, or chooses to stop.
+		const int firstDirection = isKing ? 0 : manDirections * 2;
+		const int lastDirection = isKing ? kDirectionCount : firstDirection + 2;
+		for( ;; )
+		{
+			captured |= to;
+			to = ShiftSquares( to, kStepShifts[direction] );
+
+			unsigned int next = 0;
+			int nextDirections[kDirectionCount];
+			for( int d = firstDirection; d < lastDirection; ++d )
+			{
+				const int shift = kStepShifts[d];
+				if( to & kJumpSources[d] & ShiftSquares( opponents & ~captured, -shift ) & ShiftSquares( empty, -2 * shift ) )
+					nextDirections[next++] = d;
+			}
+			const unsigned int choice = next ? random.NextBelow( next + 1 ) : 0;
+			if( choice == next )
+				break;
+			direction = nextDirections[choice];
+			to = ShiftSquares( to, kStepShifts[direction] );
+		}
+		opponentMen &= ~captured;
+		opponentKings &= ~captured;
+	}
+
+	reversible = isKing && !jumping;
+	if( isKing )
+		kings ^= from | to;
+	else
+	{
+		men &= ~from;
+		if( to & crowningRow )
+			kings |= to;
+		else
+			men |= to;
+	}
+	return true;
 }
 
 //--------------------------------------------------------------------------------------
-bool CCheckersBoard::AddJumpMoves( EPlayer player, const SPosition& start, bool hasJumps, std::vector<CMove>& moves ) const
+template <EPlayer player>
+bool CCheckersBoard::AddSimpleMoves( int square, bool isKing, std::vector<CMove>& moves ) const
 {
-	CPerfTimerCall __call( s_AddJumpMoves );
+	TPerfCall __call( s_AddSimpleMoves );
 
 	bool added = false;
 
 	CMove test;
-	test.m_start = start;
+	test.m_start = SquareToPosition( square );
 	test.m_sequence.resize( 1 );
 
-	unsigned int colorOffset = 0;
-	unsigned int moveCount = 4;
-	bool isKing = IsKing( GetSquareState( start ) );
-	if( !isKing )
-	{
-		colorOffset = ( player == Player_Red ) ? 0 : 2;
-		moveCount = 2;
-	}
+	// Kings go all four ways, red men only up the rows and black men only down them.
+	const unsigned int colorOffset = ( isKing || player == Player_Red ) ? 0 : 2;
+	const unsigned int moveCount = isKing ? 4 : 2;
 
-	EPlayer opponentPlayer = GetOpponent( player );
+	const unsigned __int64 occupied = m_blackPieces | m_redPieces | m_blackKings | m_redKings;
 	for( unsigned int move = colorOffset; move < colorOffset + moveCount; ++move )
 	{
-		if( !GetNextSpace( test.m_start, move, test.m_sequence[ 0 ] ) )
-			continue;
-
-		if( GetPlayerOwner( GetSquareState( test.m_sequence[ 0 ] ) ) != opponentPlayer )
-			continue;
-
-		if( !GetNextSpace( test.m_sequence[ 0 ], move, test.m_sequence[ 0 ] ) )
-			continue;
-
-		if( GetSquareState( test.m_sequence[ 0 ] ) != SquareState_Blank )
+		const int next = kStepSquares[square][move];
+		if( next < 0 || ( occupied & SquareToBit( next ) ) )
 			continue;
 
+		test.m_sequence[ 0 ] = SquareToPosition( next );
 		assert( IsValidMove( player, test ) );
 
-		if( !added && !hasJumps )
-			moves.clear();
-
 		moves.push_back( test );
-		AddNextJumpMoves( player, test, moves );
 		added = true;
 	}
 
@@ -266,52 +524,67 @@ bool CCheckersBoard::AddJumpMoves( EPlayer player, const SPosition& start, bool
 }
 
 //--------------------------------------------------------------------------------------
-bool CCheckersBoard::AddNextJumpMoves( EPlayer player, const CMove& start, std::vector<CMove>& moves ) const
+template <EPlayer player>
+bool CCheckersBoard::AddJumpMoves( int square, bool isKing, bool hasJumps, std::vector<CMove>& moves ) const
 {
-	CPerfTimerCall __call( s_AddNextJumpMoves );
+	TPerfCall __call( s_AddJumpMoves );
 
-	bool added = false;
-
-	CMove test( start );
-
-	test.m_sequence.resize( start.m_sequence.size() + 1 );
+	// The landing squares of the chain being walked, shared by every step of the walk.
+	SPosition path[ MaxJumpChain ];
+	return AddNextJumpMoves<player>( isKing, SquareToPosition( square ), square, path, 0, 0, hasJumps, moves );
+}
 
-	if( test.m_sequence.size() < 2 )
-		return added;
+//--------------------------------------------------------------------------------------
+template <EPlayer player>
+bool CCheckersBoard::AddNextJumpMoves( bool isKing, const SPosition& start, int from, SPosition* pPath, unsigned int length, unsigned int captured, bool& hasJumps, std::vector<CMove>& moves ) const
+{
+	TPerfCall __call( s_AddNextJumpMoves );
 
-	unsigned int colorOffset = 0;
-	unsigned int moveCount = 4;
-	bool isKing = IsKing( GetSquareState( start.m_start ) );
-	if( !isKing )
-	{
-		colorOffset = ( player == Player_Red ) ? 0 : 2;
-		moveCount = 2;
-	}
+	bool added = false;
 
-	EPlayer opponentPlayer = GetOpponent( player );
+	// Kings go all four ways, red men only up the rows and black men only down them.
+	const unsigned int colorOffset = ( isKing || player == Player_Red ) ? 0 : 2;
+	const unsigned int moveCount = isKing ? 4 : 2;
 
-	const SPosition& prev = test.m_sequence[ test.m_sequence.size() - 2 ];
-	SPosition& curr = test.m_sequence[ test.m_sequence.size() - 1 ];
+	const unsigned __int64 occupied = m_blackPieces | m_redPieces | m_blackKings | m_redKings;
+	const unsigned __int64 opponents = ( player == Player_Red ) ? ( m_blackPieces | m_blackKings ) : ( m_redPieces | m_redKings );
 
+	assert( length < MaxJumpChain );
 	for( unsigned int move = colorOffset; move < colorOffset + moveCount; ++move )
 	{
-		if( !GetNextSpace( prev, move, curr ) )
+		const int landing = kJumpSquares[from][move];
+		if( landing < 0 )
 			continue;
 
-		if( GetPlayerOwner( GetSquareState( curr ) ) != opponentPlayer )
+		const int middle = kStepSquares[from][move];
+		if( !( opponents & SquareToBit( middle ) ) )
 			continue;
 
-		if( !GetNextSpace( curr, move, curr ) )
+		// A piece can only be jumped once, which also keeps kings from going round in circles.
+		const unsigned int middleBit = 1u << middle;
+		if( captured & middleBit )
 			continue;
 
-		if( GetSquareState( curr ) != SquareState_Blank )
+		// The moving piece is still on its start square, so chains never land there.
+		if( occupied & SquareToBit( landing ) )
 			continue;
 
-		if( !IsValidMove( player, test ) )
-			continue;
+		// Jumps are forced, so the first one found drops the simple moves found so far.
+		if( !hasJumps )
+		{
+			moves.clear();
+			hasJumps = true;
+		}
 
-		moves.push_back( test );
-		AddNextJumpMoves( player, test, moves );
+		// Every chain is a move of its own, the shorter ones included.
+		pPath[ length ] = SquareToPosition( landing );
+		moves.push_back( CMove() );
+		CMove& chain = moves.back();
+		chain.m_start = start;
+		chain.m_sequence.assign( pPath, pPath + length + 1 );
+		assert( IsValidMove( player, chain ) );
+
+		AddNextJumpMoves<player>( isKing, start, landing, pPath, length + 1, captured | middleBit, hasJumps, moves );
 		added = true;
 	}
 
@@ -321,44 +594,38 @@ bool CCheckersBoard::AddNextJumpMoves( EPlayer player, const CMove& start, std::
 //--------------------------------------------------------------------------------------
 bool CCheckersBoard::GetMoves( EPlayer player, std::vector<CMove>& moves ) const
 {
-	CPerfTimerCall __call( s_GetMoves );
-
-	bool hasJumps = false;
-
-	for( unsigned int x = 0; x < kBoardSize; ++x )
+	switch( player )
 	{
-		for( unsigned int y = 0; y < kBoardSize; ++y )
-		{
-			SPosition start( x, y );
-			if( GetPlayerOwner( GetSquareState( start ) ) == player )
-			{
-				if( !hasJumps )
-					AddSimpleMoves( player, start, moves );
-				hasJumps |= AddJumpMoves( player, start, hasJumps, moves );
-			}
-		}
+	case Player_Red:
+		return GetPlayerMoves<Player_Red>( moves );
+	case Player_Black:
+		return GetPlayerMoves<Player_Black>( moves );
+	default:
+		return false;
 	}
-
-	return !moves.empty();
 }
 
 //--------------------------------------------------------------------------------------
-bool CCheckersBoard::EndsInLoop( const std::vector<SPosition>& sequence )
+template <EPlayer player>
+bool CCheckersBoard::GetPlayerMoves( std::vector<CMove>& moves ) const
 {
-	size_t maxLoopSize = sequence.size() >> 1;
-	for( size_t testSize = 2; testSize <= maxLoopSize; ++testSize )
+	TPerfCall __call( s_GetMoves );
+
+	bool hasJumps = false;
+
+	const unsigned __int64 pieces = ( player == Player_Red ) ? ( m_redPieces | m_redKings ) : ( m_blackPieces | m_blackKings );
+	const unsigned __int64 kings = m_redKings | m_blackKings;
+	for( int square = 0; square < kSquareCount; ++square )
 	{
-		bool found = true;
-		for( int i1 = sequence.size() - 1, i2 = sequence.size() - 1 - testSize; i1 >= 0 && i2 >= 0; i1--, i2-- )
-		{
-			if( sequence[i1] != sequence[i2] )
-			{
-				found = false;
-				break;
-			}
-		}
-		if( found )
-			return true;
+		const unsigned __int64 bit = SquareToBit( square );
+		if( !( pieces & bit ) )
+			continue;
+
+		const bool isKing = ( kings & bit ) != 0;
+		if( !hasJumps )
+			AddSimpleMoves<player>( square, isKing, moves );
+		hasJumps |= AddJumpMoves<player>( square, isKing, hasJumps, moves );
 	}
-	return false;
+
+	return !moves.empty();
 }
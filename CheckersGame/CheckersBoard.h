@@ -3,11 +3,21 @@
 #include "stdafx.h"
 
 #include "GameBoardBasics.h"
+#include "Random.h"
 
 #include <memory.h>
+#include <stdlib.h>
+#include <string>
 #include <vector>
 #include <xhash>
 
+class CConfigFile;
+
+// Instrumentation level of move generation and validation, see PerfTimer.h.
+#ifndef CHECKERS_BOARD_PERF_LEVEL
+#define CHECKERS_BOARD_PERF_LEVEL PERF_LEVEL
+#endif
+
 static const int kMoveIndexLimit = 4;
 
 //--------------------------------------------------------------------------------------
@@ -23,12 +33,51 @@ enum ESquareState
 	SquareStateCount
 };
 
+//--------------------------------------------------------------------------------------
+// Weights of the evaluation features used when scoring a board.  A man is worth 100.
+// NOTE: any position must score well inside CCheckersBoard::MaxScore so wins still dominate.
+struct SEvalWeights
+{
+	enum EFeature
+	{
+		Feature_Man,
+		Feature_King,
+		// Men still on their own back row, where they keep the opponent from crowning.
+		Feature_BackRowMan,
+		// Pieces on the eight central squares.
+		Feature_CenterMan,
+		Feature_CenterKing,
+		// Rows advanced, summed over every man.
+		Feature_ManAdvance,
+		// Kings on the side columns, which reach fewer squares.
+		Feature_EdgeKing,
+
+		FeatureCount
+	};
+
+	int m_values[FeatureCount];
+
+	// Material only: a man is 100 and a king 200.
+	SEvalWeights();
+
+	// The name of a feature in weight files and tournament configs, e.g. "man".
+	static const char* GetFeatureName( EFeature feature );
+
+	// Reads the weights named in a section.  Missing keys keep their values.
+	void Load( const CConfigFile& file, const std::string& section );
+	// Weight files hold a [weights] section.
+	bool Load( const std::string& path );
+	bool Save( const std::string& path ) const;
+};
+
 //--------------------------------------------------------------------------------------
 // Represents the board and performs most game operations.
 class CCheckersBoard
 {
 public:
-	enum { MaxScore = kBoardSize * kBoardSize, MinScore = - kBoardSize * kBoardSize };
+	enum { MaxScore = 10000, MinScore = -10000 };
+
+	typedef SEvalWeights TEvalWeights;
 
 	CCheckersBoard(const CCheckersBoard& cpy, EPlayer movingPlayer, const CMove& move);
 	CCheckersBoard(void) { Initialize(); }
@@ -39,6 +88,10 @@ public:
 
 	// Returns the piece on a particulare square.
 	ESquareState GetSquareState( const SPosition& pos ) const;
+	// Sets the game state of a space, for setting up positions.
+	ESquareState SetSquareState( const SPosition& pos, ESquareState state );
+	// Removes every piece from the board.
+	void Clear() { m_blackPieces = m_redPieces = m_blackKings = m_redKings = 0; }
 
 	// Calculates the list of valid moves for a provided player.
 	bool GetMoves( EPlayer player, std::vector<CMove>& moves ) const;
@@ -49,8 +102,18 @@ public:
 	// Tests if a move is valid and finalizes it.
 	bool MakeMoveIfValid( EPlayer player, const CMove& move );
 
+	// Plays a random legal move straight on the square masks, for Monte Carlo playouts, without
+	// building a move list.  Jumps are forced; since shorter chains are legal too, a chain stops
+	// after each jump with one chance in one more than the jumps that could follow it.  Returns
+	// false if the player cannot move.  reversible is set as by IsReversibleMove.
+	bool MakeRandomMove( EPlayer player, CRandom& random, bool& reversible );
+
 	// Evaluate score.
-	int CalculatePlayerScore( EPlayer player ) const;
+	int CalculatePlayerScore( EPlayer player ) const { return CalculatePlayerScore( player, SEvalWeights() ); }
+	int CalculatePlayerScore( EPlayer player, const SEvalWeights& weights ) const;
+	// Counts every evaluation feature for red less the same count for black.  The score of a
+	// position that is not won is the sum of these counts times their weights.
+	void GetEvalFeatures( int features[SEvalWeights::FeatureCount] ) const;
 
 	// Returns the opponent player to the given player.
 	static EPlayer GetOpponent( EPlayer player ) { return( player == Player_Red ? Player_Black : Player_Red ); }
@@ -60,6 +123,23 @@ public:
 	// Returns true if the space is a king.
 	static bool IsKing( ESquareState square );
 
+	// Returns a 64 bit key identifying the position, used for repetition detection.
+	unsigned __int64 GetHashKey() const;
+	// Returns true if the move could be undone later: a king moving without a capture.
+	bool IsReversibleMove( EPlayer player, const CMove& move ) const;
+	// Returns true if the move jumps a piece.
+	static bool IsCapture( const CMove& move );
+	// Returns true if the move neither captures nor crowns a man.
+	bool IsQuietMove( EPlayer player, const CMove& move ) const;
+
+	// Inputs of a neural evaluation (see NeuralNetwork.h), one for each kind of piece on each
+	// dark square: red men, red kings, black men and black kings, 32 squares each.
+	enum { NetworkInputCount = 4 * 32 };
+	// Lists the inputs of the pieces on the board.  Returns how many there are.
+	unsigned int GetNetworkInputs( unsigned short* pInputs ) const;
+	// Lists the inputs set and cleared going from the board from to this one.
+	void GetNetworkChanges( const CCheckersBoard& from, unsigned short* pAdded, unsigned int& addedCount, unsigned short* pRemoved, unsigned int& removedCount ) const;
+
 	// Returns 0 if equal else +1 if this > rhs else -1 (implying this < rhs)
 	int Compare( const CCheckersBoard& rhs ) const;
 
@@ -77,6 +157,7 @@ public:
 		return stdext::_Hash_value( begin, end );
 	}
 
+	// Active at CHECKERS_BOARD_PERF_LEVEL.
 	static CPerfTimer s_GetMoves;
 	static CPerfTimer s_AddSimpleMoves;
 	static CPerfTimer s_AddJumpMoves;
@@ -85,6 +166,14 @@ public:
 	static CPerfTimer s_MakeMoveIfValid;
 
 private:
+	// Reads and writes the piece masks directly.
+	friend class CCheckersBoardBatch;
+
+	typedef CPerfTimerScope<CHECKERS_BOARD_PERF_LEVEL> TPerfCall;
+
+	// Every jump takes a different piece, so a chain is never longer than the number of dark squares.
+	enum { MaxJumpChain = kBoardSize * kBoardSize / 2 };
+
 	// The memory holding the game state.
 	// NOTE: assumes a kBoardSize of 8
 	unsigned __int64 m_blackPieces;
@@ -92,24 +181,25 @@ private:
 	unsigned __int64 m_blackKings;
 	unsigned __int64 m_redKings;
 
-	// Sets the game state of a space.
-	ESquareState SetSquareState( const SPosition& pos, ESquareState state );
-
-	// Determines the next position from the start position given a number from 0 to 3 which represents one of the 4 diagonals.
-	// Returns false of the next position requested isn't on the board.
-	static bool GetNextSpace( const SPosition& start, int moveIndex, SPosition& next );
-	// Determines the position that is inbetween the given two positions.
-	// Returns false if there is no position between the given two positions.
-	static bool GetMiddlePosition( const SPosition& start, const SPosition& next, SPosition& middle );
-	// Determins if the sequence has a loop at the end.
-	static bool EndsInLoop( const std::vector<SPosition>& sequence );
-
-	// Adds non-jump moves from the start position for the given player.
-	bool AddSimpleMoves( EPlayer player, const SPosition& start, std::vector<CMove>& moves ) const;
-	// Adds all jump moves from the start position for the given player.
-	bool AddJumpMoves( EPlayer player, const SPosition& start, bool hasJumps, std::vector<CMove>& moves ) const;
-	// Adds multi-jump moves from the start move for the given player.
-	bool AddNextJumpMoves( EPlayer player, const CMove& start, std::vector<CMove>& moves ) const;
+	// Scrambles the bits of a value for GetHashKey.
+	static unsigned __int64 MixHash( unsigned __int64 value );
+
+	// Move generation works on the 32 dark squares, numbered by their bit index / 2, with
+	// precomputed neighbour and jump tables in place of coordinate arithmetic.  It and move
+	// validation are compiled once per player, so which way men move is known at compile time.
+	template <EPlayer player> bool GetPlayerMoves( std::vector<CMove>& moves ) const;
+	template <EPlayer player> bool IsValidPlayerMove( const CMove& move, std::vector<SPosition>* pRemovedPieces, SPosition* pFinalPosition, ESquareState* pNewState ) const;
+	template <EPlayer player> bool MakeRandomPlayerMove( CRandom& random, bool& reversible );
+	// Adds non-jump moves from the square for the given player.
+	template <EPlayer player> bool AddSimpleMoves( int square, bool isKing, std::vector<CMove>& moves ) const;
+	// Adds all jump moves from the square for the given player.
+	template <EPlayer player> bool AddJumpMoves( int square, bool isKing, bool hasJumps, std::vector<CMove>& moves ) const;
+	// Walks capture chains depth first from the square from, adding a move for every chain and
+	// each of its shorter prefixes, since a chain may stop after any jump and IsValidMove accepts
+	// them.  pPath holds the length landing squares so far and captured the squares of the pieces
+	// they jumped, which cannot be jumped again.  Clears moves and sets hasJumps at the first
+	// jump if there were none before.
+	template <EPlayer player> bool AddNextJumpMoves( bool isKing, const SPosition& start, int from, SPosition* pPath, unsigned int length, unsigned int captured, bool& hasJumps, std::vector<CMove>& moves ) const;
 
 	// Helpers for the compare function.
 	int CompareBlack( const CCheckersBoard& rhs ) const { return ( m_blackPieces == rhs.m_blackPieces ) ? 0 : ( m_blackPieces > rhs.m_blackPieces ) ? 1 : -1; }
@@ -197,29 +287,52 @@ inline int CCheckersBoard::Compare( const CCheckersBoard& rhs ) const
 }
 
 //--------------------------------------------------------------------------------------
-inline bool CCheckersBoard::GetNextSpace( const SPosition& start, int moveIndex, SPosition& next )
+inline unsigned __int64 CCheckersBoard::MixHash( unsigned __int64 value )
 {
-	switch( moveIndex )
-	{
-	case 0:
-		next.m_x = start.m_x + 1;
-		next.m_y = start.m_y + 1;
-		return next.IsValid();
-	case 1:
-		next.m_x = start.m_x - 1;
-		next.m_y = start.m_y + 1;
-		return next.IsValid();
-	case 2:
-		next.m_x = start.m_x + 1;
-		next.m_y = start.m_y - 1;
-		return next.IsValid();
-	case 3:
-		next.m_x = start.m_x - 1;
-		next.m_y = start.m_y - 1;
-		return next.IsValid();
-	}
+	// splitmix64 finalizer.
+	value ^= value >> 30;
+	value *= 0xBF58476D1CE4E5B9ull;
+	value ^= value >> 27;
+	value *= 0x94D049BB133111EBull;
+	value ^= value >> 31;
+	return value;
+}
+
+//--------------------------------------------------------------------------------------
+inline unsigned __int64 CCheckersBoard::GetHashKey() const
+{
+	// Chain the sets through the mixer so the same pattern in two sets does not cancel out.
+	unsigned __int64 key = MixHash( m_blackPieces );
+	key = MixHash( key ^ m_redPieces );
+	key = MixHash( key ^ m_blackKings );
+	return MixHash( key ^ m_redKings );
+}
+
+//--------------------------------------------------------------------------------------
+inline bool CCheckersBoard::IsReversibleMove( EPlayer player, const CMove& move ) const
+{
+	if( !IsKing( GetSquareState( move.m_start ) ) || move.m_sequence.size() != 1 )
+		return false;
 
-	return false;
+	// A single step of one square is not a jump.
+	return abs( (int)move.m_start.m_x - (int)move.m_sequence[0].m_x ) == 1;
+}
+
+//--------------------------------------------------------------------------------------
+inline bool CCheckersBoard::IsCapture( const CMove& move )
+{
+	return !move.m_sequence.empty() && abs( (int)move.m_start.m_x - (int)move.m_sequence[0].m_x ) == 2;
+}
+
+//--------------------------------------------------------------------------------------
+inline bool CCheckersBoard::IsQuietMove( EPlayer player, const CMove& move ) const
+{
+	if( IsCapture( move ) )
+		return false;
+
+	// Men only move forwards, so a man stepping onto either end row is crowned.
+	const unsigned int row = move.m_sequence.back().m_y;
+	return IsKing( GetSquareState( move.m_start ) ) || ( row != 0 && row != kBoardSize - 1 );
 }
 
 //--------------------------------------------------------------------------------------
@@ -252,12 +365,3 @@ inline bool CCheckersBoard::IsKing( ESquareState square )
 		return false;
 	};
 }
-
-//--------------------------------------------------------------------------------------
-inline bool CCheckersBoard::GetMiddlePosition( const SPosition& start, const SPosition& next, SPosition& middle )
-{
-	middle.m_x = ( start.m_x + next.m_x ) / 2;
-	middle.m_y = ( start.m_y + next.m_y ) / 2;
-	
-	return( middle.IsValid() && middle != start && middle != next );
-}
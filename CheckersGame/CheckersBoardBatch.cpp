@@ -0,0 +1,380 @@
+#include "StdAfx.h"
+#include "CheckersBoardBatch.h"
+
+#if CHECKERS_BOARD_BATCH_SIMD
+#include <emmintrin.h>
+#endif
+
+//--------------------------------------------------------------------------------------
+// Bit x * 8 + y is the square ( x, y ), as in CCheckersBoard.  A step in the directions of the
+// board's tables shifts the bits by 9, -7, 7 or -9; steps off the sides shift out of the mask
+// and those off the first or last row are kept out by the source masks.
+namespace
+{
+	const int kDirectionCount = CCheckersBoardBatch::DirectionCount;
+	const unsigned int kLanes = CCheckersBoardBatch::Lanes;
+
+	const unsigned __int64 kRowMask = 0x0101010101010101ull;
+	const unsigned __int64 kRedBackRow = kRowMask;
+	const unsigned __int64 kBlackBackRow = kRowMask << 7;
+
+	const int kStepShifts[kDirectionCount] = { 9, -7, 7, -9 };
+	// Squares a piece can step, or jump, from in each direction.
+	const unsigned __int64 kStepSources[kDirectionCount] = { ~kBlackBackRow, ~kBlackBackRow, ~kRedBackRow, ~kRedBackRow };
+	const unsigned __int64 kJumpSources[kDirectionCount] = { ~( kBlackBackRow | kBlackBackRow >> 1 ), ~( kBlackBackRow | kBlackBackRow >> 1 ),
+		~( kRedBackRow | kRedBackRow << 1 ), ~( kRedBackRow | kRedBackRow << 1 ) };
+
+	//--------------------------------------------------------------------------------------
+	inline unsigned int BitCount( unsigned __int64 bits )
+	{
+		unsigned int count = 0;
+		for( ; bits; bits &= bits - 1 )
+			++count;
+		return count;
+	}
+
+	//--------------------------------------------------------------------------------------
+	// Picks the index'th of the squares set in bits.
+	inline unsigned __int64 PickSquare( unsigned __int64 bits, unsigned int index )
+	{
+		while( index-- )
+			bits &= bits - 1;
+		return bits & ( ~bits + 1 );
+	}
+
+	//--------------------------------------------------------------------------------------
+	// The operations the move generator needs on a mask of every lane, one set per instruction
+	// set.  Shift shifts every lane the same way, left for a positive count; ShiftEach shifts
+	// each lane by its own counts, and a count of 64 shifts everything out.  Masks of lanes are
+	// all ones or all zeros.
+	struct SScalarLanes
+	{
+		struct V { unsigned __int64 m[kLanes]; };
+
+		static V Load( const unsigned __int64* p ) { V r; for( unsigned int i = 0; i < kLanes; ++i ) r.m[i] = p[i]; return r; }
+		static void Store( unsigned __int64* p, const V& a ) { for( unsigned int i = 0; i < kLanes; ++i ) p[i] = a.m[i]; }
+		static V Set( unsigned __int64 x ) { V r; for( unsigned int i = 0; i < kLanes; ++i ) r.m[i] = x; return r; }
+		static V And( const V& a, const V& b ) { V r; for( unsigned int i = 0; i < kLanes; ++i ) r.m[i] = a.m[i] & b.m[i]; return r; }
+		static V Or( const V& a, const V& b ) { V r; for( unsigned int i = 0; i < kLanes; ++i ) r.m[i] = a.m[i] | b.m[i]; return r; }
+		static V Xor( const V& a, const V& b ) { V r; for( unsigned int i = 0; i < kLanes; ++i ) r.m[i] = a.m[i] ^ b.m[i]; return r; }
+		// a and not b.
+		static V AndNot( const V& a, const V& b ) { V r; for( unsigned int i = 0; i < kLanes; ++i ) r.m[i] = a.m[i] & ~b.m[i]; return r; }
+		static V Add( const V& a, const V& b ) { V r; for( unsigned int i = 0; i < kLanes; ++i ) r.m[i] = a.m[i] + b.m[i]; return r; }
+		static V Shift( const V& a, int shift )
+		{
+			V r;
+			for( unsigned int i = 0; i < kLanes; ++i )
+				r.m[i] = ( shift > 0 ) ? a.m[i] << shift : a.m[i] >> -shift;
+			return r;
+		}
+		static V ShiftEach( const V& a, const V& left, const V& right )
+		{
+			V r;
+			for( unsigned int i = 0; i < kLanes; ++i )
+				r.m[i] = ( left.m[i] < 64 ? a.m[i] << left.m[i] : 0 ) | ( right.m[i] < 64 ? a.m[i] >> right.m[i] : 0 );
+			return r;
+		}
+		static V NonZero( const V& a ) { V r; for( unsigned int i = 0; i < kLanes; ++i ) r.m[i] = a.m[i] ? ~0ull : 0; return r; }
+		static V PopCount( const V& a ) { V r; for( unsigned int i = 0; i < kLanes; ++i ) r.m[i] = BitCount( a.m[i] ); return r; }
+	};
+
+#if CHECKERS_BOARD_BATCH_SIMD
+	//--------------------------------------------------------------------------------------
+	// SSE2 has no shifts by a count per lane, no 64 bit compares and no byte shuffles, so those
+	// are built from shifts of a whole register, 32 bit compares and arithmetic on bit fields.
+	struct SSse2Lanes
+	{
+		enum { Registers = kLanes / 2 };
+
+		struct V { __m128i m[Registers]; };
+
+		static V Load( const unsigned __int64* p ) { V r; for( int i = 0; i < Registers; ++i ) r.m[i] = _mm_loadu_si128( (const __m128i*)( p + i * 2 ) ); return r; }
+		static void Store( unsigned __int64* p, const V& a ) { for( int i = 0; i < Registers; ++i ) _mm_storeu_si128( (__m128i*)( p + i * 2 ), a.m[i] ); }
+		// _mm_set1_epi64x is missing from 32 bit builds of older compilers.
+		static V Set( unsigned __int64 x ) { const __m128i v = _mm_set_epi32( (int)( x >> 32 ), (int)x, (int)( x >> 32 ), (int)x ); V r; for( int i = 0; i < Registers; ++i ) r.m[i] = v; return r; }
+		static V And( const V& a, const V& b ) { V r; for( int i = 0; i < Registers; ++i ) r.m[i] = _mm_and_si128( a.m[i], b.m[i] ); return r; }
+		static V Or( const V& a, const V& b ) { V r; for( int i = 0; i < Registers; ++i ) r.m[i] = _mm_or_si128( a.m[i], b.m[i] ); return r; }
+		static V Xor( const V& a, const V& b ) { V r; for( int i = 0; i < Registers; ++i ) r.m[i] = _mm_xor_si128( a.m[i], b.m[i] ); return r; }
+		static V AndNot( const V& a, const V& b ) { V r; for( int i = 0; i < Registers; ++i ) r.m[i] = _mm_andnot_si128( b.m[i], a.m[i] ); return r; }
+		static V Add( const V& a, const V& b ) { V r; for( int i = 0; i < Registers; ++i ) r.m[i] = _mm_add_epi64( a.m[i], b.m[i] ); return r; }
+		static V Shift( const V& a, int shift )
+		{
+			const __m128i count = _mm_cvtsi32_si128( shift > 0 ? shift : -shift );
+			V r;
+			for( int i = 0; i < Registers; ++i )
+				r.m[i] = ( shift > 0 ) ? _mm_sll_epi64( a.m[i], count ) : _mm_srl_epi64( a.m[i], count );
+			return r;
+		}
+		// Shifts the whole register by the count of each lane and keeps that lane of each.
+		static V ShiftEach( const V& a, const V& left, const V& right )
+		{
+			V r;
+			for( int i = 0; i < Registers; ++i )
+			{
+				const __m128i highLeft = _mm_unpackhi_epi64( left.m[i], left.m[i] );
+				const __m128i highRight = _mm_unpackhi_epi64( right.m[i], right.m[i] );
+				const __m128i low = _mm_or_si128( _mm_sll_epi64( a.m[i], left.m[i] ), _mm_srl_epi64( a.m[i], right.m[i] ) );
+				const __m128i high = _mm_or_si128( _mm_sll_epi64( a.m[i], highLeft ), _mm_srl_epi64( a.m[i], highRight ) );
+				r.m[i] = _mm_unpacklo_epi64( low, _mm_unpackhi_epi64( high, high ) );
+			}
+			return r;
+		}
+		static V NonZero( const V& a )
+		{
+			const __m128i zero = _mm_setzero_si128();
+			const __m128i ones = _mm_cmpeq_epi32( zero, zero );
+			V r;
+			for( int i = 0; i < Registers; ++i )
+			{
+				// A lane is zero when both its halves are.
+				const __m128i halves = _mm_cmpeq_epi32( a.m[i], zero );
+				r.m[i] = _mm_xor_si128( _mm_and_si128( halves, _mm_shuffle_epi32( halves, 0xB1 ) ), ones );
+			}
+			return r;
+		}
+		// Counts the bits of pairs, nibbles and bytes in turn, then adds up the bytes of each lane.
+		static V PopCount( const V& a )
+		{
+			const __m128i pairs = _mm_set1_epi8( 0x55 );
+			const __m128i nibbles = _mm_set1_epi8( 0x33 );
+			const __m128i bytes = _mm_set1_epi8( 0x0F );
+			V r;
+			for( int i = 0; i < Registers; ++i )
+			{
+				__m128i x = _mm_sub_epi8( a.m[i], _mm_and_si128( _mm_srli_epi64( a.m[i], 1 ), pairs ) );
+				x = _mm_add_epi8( _mm_and_si128( x, nibbles ), _mm_and_si128( _mm_srli_epi64( x, 2 ), nibbles ) );
+				x = _mm_and_si128( _mm_add_epi8( x, _mm_srli_epi64( x, 4 ) ), bytes );
+				r.m[i] = _mm_sad_epu8( x, _mm_setzero_si128() );
+			}
+			return r;
+		}
+	};
+	typedef SSse2Lanes TSimdLanes;
+#else
+	typedef SScalarLanes TSimdLanes;
+#endif
+
+	//--------------------------------------------------------------------------------------
+	// Takes a where mask is set and b elsewhere.
+	template <typename TLanes>
+	inline typename TLanes::V Select( const typename TLanes::V& mask, const typename TLanes::V& a, const typename TLanes::V& b )
+	{
+		return TLanes::Or( TLanes::And( mask, a ), TLanes::AndNot( b, mask ) );
+	}
+}
+
+//--------------------------------------------------------------------------------------
+CCheckersBoardBatch::CCheckersBoardBatch()
+{
+	const CCheckersBoard empty;
+	for( unsigned int lane = 0; lane < Lanes; ++lane )
+		Load( lane, empty, Player_Red );
+}
+
+//--------------------------------------------------------------------------------------
+void CCheckersBoardBatch::Load( unsigned int lane, const CCheckersBoard& board, EPlayer toMove )
+{
+	const bool red = ( toMove == Player_Red );
+	m_men[lane] = red ? board.m_redPieces : board.m_blackPieces;
+	m_kings[lane] = red ? board.m_redKings : board.m_blackKings;
+	m_opponentMen[lane] = red ? board.m_blackPieces : board.m_redPieces;
+	m_opponentKings[lane] = red ? board.m_blackKings : board.m_redKings;
+	m_red[lane] = red ? ~0ull : 0;
+	m_chain[lane] = 0;
+	m_blocked[lane] = 0;
+}
+
+//--------------------------------------------------------------------------------------
+EPlayer CCheckersBoardBatch::Store( unsigned int lane, CCheckersBoard& board ) const
+{
+	const bool red = m_red[lane] != 0;
+	board.m_redPieces = red ? m_men[lane] : m_opponentMen[lane];
+	board.m_redKings = red ? m_kings[lane] : m_opponentKings[lane];
+	board.m_blackPieces = red ? m_opponentMen[lane] : m_men[lane];
+	board.m_blackKings = red ? m_opponentKings[lane] : m_kings[lane];
+	return red ? Player_Red : Player_Black;
+}
+
+//--------------------------------------------------------------------------------------
+void CCheckersBoardBatch::GenerateMoves( SMoves& moves ) const
+{
+#if CHECKERS_BOARD_BATCH_SIMD
+	if( !CCpuFeatures::HasSse2() )
+	{
+		GenerateMovesWith<SScalarLanes>( moves );
+		return;
+	}
+#endif
+	GenerateMovesWith<TSimdLanes>( moves );
+}
+
+//--------------------------------------------------------------------------------------
+void CCheckersBoardBatch::GenerateMovesScalar( SMoves& moves ) const
+{
+	GenerateMovesWith<SScalarLanes>( moves );
+}
+
+//--------------------------------------------------------------------------------------
+void CCheckersBoardBatch::Apply( const SMoves& moves, const unsigned int* pChoices )
+{
+#if CHECKERS_BOARD_BATCH_SIMD
+	if( !CCpuFeatures::HasSse2() )
+	{
+		ApplyWith<SScalarLanes>( moves, pChoices );
+		return;
+	}
+#endif
+	ApplyWith<TSimdLanes>( moves, pChoices );
+}
+
+//--------------------------------------------------------------------------------------
+void CCheckersBoardBatch::ApplyScalar( const SMoves& moves, const unsigned int* pChoices )
+{
+	ApplyWith<SScalarLanes>( moves, pChoices );
+}
+
+//--------------------------------------------------------------------------------------
+int CCheckersBoardBatch::GetSimdWidth()
+{
+#if CHECKERS_BOARD_BATCH_SIMD
+	return CCpuFeatures::HasSse2() ? 128 : 0;
+#else
+	return 0;
+#endif
+}
+
+//--------------------------------------------------------------------------------------
+template <typename TLanes>
+void CCheckersBoardBatch::GenerateMovesWith( SMoves& moves ) const
+{
+	typedef typename TLanes::V V;
+
+	const V men = TLanes::Load( m_men );
+	const V kings = TLanes::Load( m_kings );
+	const V opponents = TLanes::Or( TLanes::Load( m_opponentMen ), TLanes::Load( m_opponentKings ) );
+	const V red = TLanes::Load( m_red );
+	const V chain = TLanes::Load( m_chain );
+	const V empty = TLanes::Xor( TLanes::Or( TLanes::Or( men, kings ), TLanes::Or( opponents, TLanes::Load( m_blocked ) ) ), TLanes::Set( ~0ull ) );
+
+	// Outside a chain every piece may move; within one only the piece jumping.
+	const V chaining = TLanes::NonZero( chain );
+	const V pieces = Select<TLanes>( chaining, chain, TLanes::Or( men, kings ) );
+
+	V jumpers[kDirectionCount];
+	V steppers[kDirectionCount];
+	V anyJumps = TLanes::Set( 0 );
+	for( int direction = 0; direction < kDirectionCount; ++direction )
+	{
+		const int shift = kStepShifts[direction];
+		// Red men go up the rows (directions 0 and 1) and black men down them (2 and 3).
+		const V forwardMen = ( direction < 2 ) ? TLanes::And( men, red ) : TLanes::AndNot( men, red );
+		const V movers = TLanes::And( pieces, TLanes::Or( kings, forwardMen ) );
+		jumpers[direction] = TLanes::And( TLanes::And( movers, TLanes::Set( kJumpSources[direction] ) ),
+			TLanes::And( TLanes::Shift( opponents, -shift ), TLanes::Shift( empty, -2 * shift ) ) );
+		steppers[direction] = TLanes::And( TLanes::And( movers, TLanes::Set( kStepSources[direction] ) ), TLanes::Shift( empty, -shift ) );
+		anyJumps = TLanes::Or( anyJumps, jumpers[direction] );
+	}
+
+	// Jumps are forced, and a chain goes on only with jumps.
+	const V jumping = TLanes::Or( TLanes::NonZero( anyJumps ), chaining );
+	V targets = TLanes::Set( 0 );
+	V counts = TLanes::Set( 0 );
+	for( int direction = 0; direction < kDirectionCount; ++direction )
+	{
+		const int shift = kStepShifts[direction];
+		const V movers = Select<TLanes>( jumping, jumpers[direction], steppers[direction] );
+		TLanes::Store( moves.m_movers[direction], movers );
+		targets = TLanes::Or( targets, Select<TLanes>( jumping, TLanes::Shift( jumpers[direction], 2 * shift ), TLanes::Shift( steppers[direction], shift ) ) );
+		counts = TLanes::Add( counts, TLanes::PopCount( movers ) );
+	}
+	TLanes::Store( moves.m_targets, targets );
+	TLanes::Store( moves.m_jumps, jumping );
+
+	unsigned __int64 laneCounts[Lanes];
+	TLanes::Store( laneCounts, counts );
+	for( unsigned int lane = 0; lane < Lanes; ++lane )
+		moves.m_counts[lane] = (unsigned int)laneCounts[lane];
+}
+
+//--------------------------------------------------------------------------------------
+template <typename TLanes>
+void CCheckersBoardBatch::ApplyWith( const SMoves& moves, const unsigned int* pChoices )
+{
+	typedef typename TLanes::V V;
+
+	// The piece and direction of each lane's move are found lane by lane; the boards are then
+	// updated in every lane at once.  Lanes that do not move get a start square of zero.
+	unsigned __int64 from[Lanes];
+	unsigned __int64 left[Lanes];
+	unsigned __int64 right[Lanes];
+	unsigned __int64 ending[Lanes];
+	for( unsigned int lane = 0; lane < Lanes; ++lane )
+	{
+		from[lane] = 0;
+		left[lane] = right[lane] = 64;
+		ending[lane] = 0;
+
+		unsigned int choice = pChoices[lane];
+		if( choice >= moves.m_counts[lane] )
+		{
+			ending[lane] = m_chain[lane] ? ~0ull : 0;
+			continue;
+		}
+		for( int direction = 0; direction < kDirectionCount; ++direction )
+		{
+			const unsigned int count = BitCount( moves.m_movers[direction][lane] );
+			if( choice < count )
+			{
+				const int shift = kStepShifts[direction];
+				from[lane] = PickSquare( moves.m_movers[direction][lane], choice );
+				left[lane] = ( shift > 0 ) ? shift : 64;
+				right[lane] = ( shift < 0 ) ? -shift : 64;
+				break;
+			}
+			choice -= count;
+		}
+	}
+
+	const V start = TLanes::Load( from );
+	const V leftShifts = TLanes::Load( left );
+	const V rightShifts = TLanes::Load( right );
+	const V jumps = TLanes::Load( moves.m_jumps );
+	const V moved = TLanes::NonZero( start );
+	const V step = TLanes::ShiftEach( start, leftShifts, rightShifts );
+	const V to = Select<TLanes>( jumps, TLanes::ShiftEach( step, leftShifts, rightShifts ), step );
+	const V jumped = TLanes::And( step, jumps );
+
+	V men = TLanes::Load( m_men );
+	V kings = TLanes::Load( m_kings );
+	V opponentMen = TLanes::AndNot( TLanes::Load( m_opponentMen ), jumped );
+	V opponentKings = TLanes::AndNot( TLanes::Load( m_opponentKings ), jumped );
+	V red = TLanes::Load( m_red );
+	V chain = TLanes::Load( m_chain );
+	V blocked = TLanes::Load( m_blocked );
+
+	const V isKing = TLanes::NonZero( TLanes::And( kings, start ) );
+	kings = TLanes::Or( TLanes::AndNot( kings, start ), TLanes::And( to, isKing ) );
+	men = TLanes::Or( TLanes::AndNot( men, start ), TLanes::AndNot( to, isKing ) );
+
+	// A chain keeps its start square and the pieces it jumped in the way until it ends.
+	const V starting = TLanes::AndNot( TLanes::And( start, jumps ), TLanes::NonZero( chain ) );
+	blocked = TLanes::Or( blocked, TLanes::Or( jumped, starting ) );
+	chain = Select<TLanes>( TLanes::And( moved, jumps ), to, chain );
+
+	// Finished moves crown their man and hand the move over.
+	const V finished = TLanes::Or( TLanes::AndNot( moved, jumps ), TLanes::Load( ending ) );
+	const V crowningRow = Select<TLanes>( red, TLanes::Set( kBlackBackRow ), TLanes::Set( kRedBackRow ) );
+	const V crowned = TLanes::And( TLanes::And( men, crowningRow ), finished );
+	men = TLanes::Xor( men, crowned );
+	kings = TLanes::Or( kings, crowned );
+	chain = TLanes::AndNot( chain, finished );
+	blocked = TLanes::AndNot( blocked, finished );
+
+	TLanes::Store( m_men, Select<TLanes>( finished, opponentMen, men ) );
+	TLanes::Store( m_kings, Select<TLanes>( finished, opponentKings, kings ) );
+	TLanes::Store( m_opponentMen, Select<TLanes>( finished, men, opponentMen ) );
+	TLanes::Store( m_opponentKings, Select<TLanes>( finished, kings, opponentKings ) );
+	TLanes::Store( m_red, TLanes::Xor( red, finished ) );
+	TLanes::Store( m_chain, chain );
+	TLanes::Store( m_blocked, blocked );
+}
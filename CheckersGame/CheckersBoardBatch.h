@@ -0,0 +1,85 @@
+#pragma once
+
+#include "stdafx.h"
+
+#include "CheckersBoard.h"
+#include "CpuFeatures.h"
+
+// x86 builds carry SSE2 code for the batch, taken when the processor has it; plain 64 bit code
+// is left for the rest.  Both give exactly the same moves.
+#if CPU_FEATURES_SSE2
+#define CHECKERS_BOARD_BATCH_SIMD 128
+#else
+#define CHECKERS_BOARD_BATCH_SIMD 0
+#endif
+
+//--------------------------------------------------------------------------------------
+// Eight independent checkers positions advanced together, for bulk work such as perft and
+// data generation.  The square masks of each kind of piece are kept lane by lane so the moves
+// of every position are found with the same few vector instructions: four SSE2 registers hold
+// a mask of all eight boards.
+//
+// Moves are described by masks rather than lists: for each direction, the pieces that can
+// move that way.  Each lane has its own side to move.  A jump moves one step of its chain at a
+// time; while a lane is jumping its next moves are the jumps the same piece can go on with.
+class CCheckersBoardBatch
+{
+public:
+	enum { Lanes = 8, DirectionCount = 4 };
+
+	// The moves of every lane, as found by GenerateMoves.
+	struct SMoves
+	{
+		// For each direction, the pieces of the side to move that can jump that way or, when
+		// none of them can jump, step that way.  Directions are those of CCheckersBoard.
+		unsigned __int64 m_movers[DirectionCount][Lanes];
+		// The squares those moves land on, every direction together.
+		unsigned __int64 m_targets[Lanes];
+		// All ones in lanes whose moves are jumps.
+		unsigned __int64 m_jumps[Lanes];
+		// Moves of each lane: one per piece and direction it can move in.
+		unsigned int m_counts[Lanes];
+	};
+
+	CCheckersBoardBatch();
+
+	// Puts a position in a lane, ending any chain the lane was in.
+	void Load( unsigned int lane, const CCheckersBoard& board, EPlayer toMove );
+	// Reads the position of a lane.  In the middle of a chain the pieces jumped so far are
+	// already gone.  Returns the side to move.
+	EPlayer Store( unsigned int lane, CCheckersBoard& board ) const;
+	EPlayer GetPlayer( unsigned int lane ) const { return m_red[lane] ? Player_Red : Player_Black; }
+	// Returns true while the lane is in the middle of a chain of jumps.
+	bool IsJumping( unsigned int lane ) const { return m_chain[lane] != 0; }
+
+	void GenerateMoves( SMoves& moves ) const;
+	// The same in plain 64 bit code whatever the build targets, to check the vector code against.
+	void GenerateMovesScalar( SMoves& moves ) const;
+
+	// Plays one move in every lane: the pChoices[lane]'th of the lane's moves, counting
+	// direction by direction and square by square.  A choice past the last move leaves the lane
+	// as it is, except that it ends the move of a lane that is jumping, since shorter chains are
+	// legal.  The side to move changes once a move is over; men crown then.
+	void Apply( const SMoves& moves, const unsigned int* pChoices );
+	void ApplyScalar( const SMoves& moves, const unsigned int* pChoices );
+
+	// Bits of the vectors GenerateMoves and Apply use on this processor, zero for 64 bit code.
+	static int GetSimdWidth();
+
+private:
+	// Pieces of the side to move and of its opponent.
+	unsigned __int64 m_men[Lanes];
+	unsigned __int64 m_kings[Lanes];
+	unsigned __int64 m_opponentMen[Lanes];
+	unsigned __int64 m_opponentKings[Lanes];
+	// All ones in lanes where red is to move.
+	unsigned __int64 m_red[Lanes];
+	// In a lane that is jumping: the square the piece has reached, and the squares it started
+	// from and jumped, which stay occupied until the move is over as in CCheckersBoard::GetMoves.
+	unsigned __int64 m_chain[Lanes];
+	unsigned __int64 m_blocked[Lanes];
+
+	// Written once over the operations of each instruction set.
+	template <typename TLanes> void GenerateMovesWith( SMoves& moves ) const;
+	template <typename TLanes> void ApplyWith( const SMoves& moves, const unsigned int* pChoices );
+};
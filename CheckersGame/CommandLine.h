@@ -0,0 +1,79 @@
+#pragma once
+
+#include <stdlib.h>
+#include <string>
+#include <vector>
+
+//--------------------------------------------------------------------------------------
+// Minimal command line parser shared by the console tools.
+// Arguments of the form -name=value or -flag are options, anything else is positional.
+class CCommandLine
+{
+public:
+	// Accepts both narrow and wide argv so it works with _tmain. Arguments are expected to be ASCII.
+	template <typename TChar>
+	CCommandLine( int argc, TChar* argv[] )
+	{
+		for( int i = 1; i < argc; ++i )
+		{
+			std::string arg;
+			for( const TChar* p = argv[i]; *p; ++p )
+				arg += static_cast<char>( *p );
+			Add( arg );
+		}
+	}
+
+	size_t GetPositionalCount() const { return m_positional.size(); }
+	std::string GetPositional( size_t index, const std::string& defaultValue = std::string() ) const
+	{
+		return ( index < m_positional.size() ) ? m_positional[index] : defaultValue;
+	}
+
+	bool HasOption( const std::string& name ) const { return Find( name ) != NULL; }
+	std::string GetString( const std::string& name, const std::string& defaultValue = std::string() ) const
+	{
+		const std::string* pValue = Find( name );
+		return pValue ? *pValue : defaultValue;
+	}
+	int GetInt( const std::string& name, int defaultValue ) const
+	{
+		const std::string* pValue = Find( name );
+		return ( pValue && !pValue->empty() ) ? atoi( pValue->c_str() ) : defaultValue;
+	}
+	double GetDouble( const std::string& name, double defaultValue ) const
+	{
+		const std::string* pValue = Find( name );
+		return ( pValue && !pValue->empty() ) ? atof( pValue->c_str() ) : defaultValue;
+	}
+
+private:
+	typedef std::pair<std::string, std::string> TOption;
+	std::vector<TOption> m_options;
+	std::vector<std::string> m_positional;
+
+	void Add( const std::string& arg )
+	{
+		if( arg.size() < 2 || arg[0] != '-' )
+		{
+			m_positional.push_back( arg );
+			return;
+		}
+
+		size_t equals = arg.find( '=' );
+		if( equals == std::string::npos )
+			m_options.push_back( TOption( arg.substr( 1 ), std::string() ) );
+		else
+			m_options.push_back( TOption( arg.substr( 1, equals - 1 ), arg.substr( equals + 1 ) ) );
+	}
+
+	const std::string* Find( const std::string& name ) const
+	{
+		// Later options override earlier ones.
+		for( size_t i = m_options.size(); i > 0; --i )
+		{
+			if( m_options[i - 1].first == name )
+				return &m_options[i - 1].second;
+		}
+		return NULL;
+	}
+};
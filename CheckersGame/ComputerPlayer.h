@@ -2,30 +2,90 @@
 
 #include "stdafx.h"
 
+#include "ConcurrentLearningCache.h"
 #include "GameBoardBasics.h"
+#include "GameHistory.h"
+#include "HardwareCounters.h"
 #include "LearningCache.h"
+#include "NeuralNetwork.h"
+#include "Random.h"
+#include "TraceRecorder.h"
+
+// Instrumentation level of the search, see PerfTimer.h.
+#ifndef COMPUTER_PLAYER_PERF_LEVEL
+#define COMPUTER_PLAYER_PERF_LEVEL PERF_LEVEL
+#endif
+
+//--------------------------------------------------------------------------------------
+// Counters from the last search made by a computer player.
+struct SSearchStats
+{
+	unsigned __int64 m_nodes;
+	unsigned __int64 m_elapsedUs;
+	// Deepest iteration that finished, and the score of its best move for the searching player.
+	unsigned int m_depth;
+	int m_score;
+	// Moves searched shallower by late move reductions or razoring, how many of those were
+	// searched again at full depth, and positions cut by futility pruning.
+	unsigned __int64 m_reduced;
+	unsigned __int64 m_researched;
+	unsigned __int64 m_pruned;
+	// CPU events of the whole search, when the player was configured to count them.
+	SHardwareCounts m_hardware;
+
+	SSearchStats() : m_nodes(0), m_elapsedUs(0), m_depth(0), m_score(0), m_reduced(0), m_researched(0), m_pruned(0) {}
+};
 
 //--------------------------------------------------------------------------------------
 template <typename TGameBoard>
 class CComputerPlayer
 {
-	enum { CacheSize = 10240 };
 public:
-	CComputerPlayer( EPlayer player, unsigned int depth );
-	~CComputerPlayer(void) {}
+	enum { DefaultCacheSize = 10240 };
 
-	// Returns the player this computer represents.
-	EPlayer GetPlayer() const { return m_player; }
+	struct SConfig
+	{
+		// Maximum number of plies to search.
+		unsigned int m_depth;
+		// Milliseconds allowed per move. When set the search deepens one ply at a time and
+		// keeps the result of the last iteration that finished in time.
+		unsigned int m_timeLimitMs;
+		// Number of entries in the transposition table.
+		unsigned int m_cacheSize;
+		// Memory of the transposition table, which matters once it is large.
+		SPageConfig m_tablePages;
+		// Prefetches the table entries of the positions searched next, so their probes do not
+		// wait on memory.
+		bool m_prefetch;
+		typename TGameBoard::TEvalWeights m_weights;
+		// Evaluates positions with this network instead of the weights when set.  Its inputs
+		// must be those of the board, and it must outlive the players using it.
+		const CNeuralNetwork* m_pNetwork;
+		// Seeds the choice between equally scored moves. The two colours draw different
+		// sequences from the same seed.
+		unsigned int m_seed;
 
-	// Asks that the computer make a random valid move.
-	bool Move( TGameBoard& board );
+		// Late move reductions: quiet moves ordered after the first m_lmrMoves, with at least
+		// m_lmrDepth plies left, are searched a ply shallower first. 0 moves disables them.
+		unsigned int m_lmrMoves;
+		unsigned int m_lmrDepth;
+		// Futility pruning: with at most m_futilityDepth plies left and no capture pending, a
+		// position m_futilityMargin per ply short of the bound is not searched. 0 disables it.
+		unsigned int m_futilityDepth;
+		int m_futilityMargin;
+		// Razoring: with at most m_razorDepth plies left, a quiet position m_razorMargin short
+		// of the bound is searched a ply shallower. 0 disables it.
+		unsigned int m_razorDepth;
+		int m_razorMargin;
 
-	static CPerfTimer s_Move;
-	static CPerfTimer s_AlphaBeta;
+		// Counts CPU events over each search with CHardwareCounters, for profiling.
+		bool m_hardwareCounters;
 
-private:
-	const EPlayer m_player;
-	const unsigned int m_depth;
+		SConfig( unsigned int depth = 6 )
+			: m_depth(depth), m_timeLimitMs(0), m_cacheSize(DefaultCacheSize), m_prefetch(false), m_pNetwork(NULL), m_seed(0)
+			, m_lmrMoves(0), m_lmrDepth(3), m_futilityDepth(0), m_futilityMargin(150), m_razorDepth(0), m_razorMargin(300)
+			, m_hardwareCounters(false) {}
+	};
 
 	enum EScoreType
 	{
@@ -38,21 +98,115 @@ private:
 
 	struct STranspositionEntry
 	{
+		// Number of plies searched below the position.
 		unsigned int m_draft;
 		unsigned int m_score;
 		EScoreType m_scoreType;
 
+		STranspositionEntry() : m_draft(0), m_score(0), m_scoreType(ScoreType_Exact) { }
 		STranspositionEntry( unsigned int draft, unsigned int score, EScoreType scoreType ) : m_draft(draft), m_score(score), m_scoreType(scoreType) { }
 	};
 
+	// A table several players can search with at once.  Scores are from one player's point of
+	// view with one set of weights, so only players of the same colour and config may share it.
+	typedef CConcurrentLearningCache<TGameBoard, STranspositionEntry> TSharedTable;
 
-	// Memory of expected AlphaBeta results.
+	CComputerPlayer( EPlayer player, unsigned int depth );
+	// The player uses pSharedTable instead of a table of its own when one is given.
+	CComputerPlayer( EPlayer player, const SConfig& config, TSharedTable* pSharedTable = NULL );
+	~CComputerPlayer(void) {}
+
+	// Returns the player this computer represents.
+	EPlayer GetPlayer() const { return m_player; }
+	const SConfig& GetConfig() const { return m_config; }
+
+	// Asks that the computer make the best move, chosen at random among equally scored ones.
+	// The game history, if given, lets the search score repetitions and no-progress positions as draws.
+	bool Move( TGameBoard& board, const CGameHistory* pHistory = NULL );
+	// Searches for the best move without changing the board. Returns false if there is no move.
+	bool FindBestMove( const TGameBoard& board, CMove& bestMove, const CGameHistory* pHistory = NULL );
+
+	// Counters from the last call to Move or FindBestMove.
+	const SSearchStats& GetLastSearchStats() const { return m_stats; }
+
+	// Guesses the opponent's reply from the transposition table. The opponent is to move on the board.
+	bool GuessReply( const TGameBoard& board, CMove& reply );
+
+	// The following may be called from another thread while FindBestMove runs.
+	// Ends the search early; the best move of the last finished iteration is used.
+	void Stop() { InterlockedExchange( &m_stopRequested, 1 ); }
+	// Ends pondering: the time limit starts counting from now.
+	void PonderHit() { InterlockedExchange( &m_ponderHit, 1 ); }
+
+	// Called before FindBestMove by the thread that runs it.
+	// While pondering the time limit is ignored until PonderHit.
+	void SetPondering( bool pondering ) { m_pondering = pondering; }
+	void ResetSignals() { InterlockedExchange( &m_stopRequested, 0 ); InterlockedExchange( &m_ponderHit, 0 ); }
+
+	// Active at COMPUTER_PLAYER_PERF_LEVEL, as is the tracing of AlphaBeta.
+	static CPerfTimer s_Move;
+	static CPerfTimer s_AlphaBeta;
+
+private:
+	typedef CPerfTimerScope<COMPUTER_PLAYER_PERF_LEVEL> TPerfCall;
+	typedef CTraceDepthScope<COMPUTER_PLAYER_PERF_LEVEL> TTraceCall;
+
+	const EPlayer m_player;
+	const SConfig m_config;
+
+	// Memory of expected AlphaBeta results, unless a shared table was given.
 	typedef CLearningCache<TGameBoard, STranspositionEntry> TTranspositionTable;
 	TTranspositionTable m_table;
+	TSharedTable* m_pSharedTable;
+
+	// State of the search in progress.
+	CGameHistory m_history;
+	unsigned int m_searchDepth;
+	bool m_canAbort;
+	bool m_aborted;
+	bool m_pondering;
+	volatile LONG m_stopRequested;
+	volatile LONG m_ponderHit;
+	CStopwatch m_stopwatch;
+	SSearchStats m_stats;
+	CRandom m_random;
+	// The boards along the search path, for the network evaluation.
+	CNeuralEvaluator<TGameBoard> m_evaluator;
 
-	// Determine the best score for the given move using alpha-beta prunning.
+	// What a node works on at one ply, kept from node to node so the search stops allocating
+	// once the vectors have grown.
+	struct SPlyBuffers
+	{
+		std::vector<CMove> m_moves;
+		// The position after each move and its table hash, in move order.
+		std::vector<TGameBoard> m_children;
+		std::vector<size_t> m_hashes;
+		std::vector< std::pair<size_t, int> > m_guesses;
+		// The moves sorted, and the hashes of their positions in the same order.
+		std::vector<TScoredMove> m_scoredMoves;
+		std::vector<size_t> m_childHashes;
+	};
+	// One per draft of the search in progress; deeper plies never touch those above them.
+	std::vector<SPlyBuffers> m_plies;
+
+	// Determine the best score for the given move using alpha-beta prunning.  maximizing is true
+	// when this player replies to the move; each ply calls the other instantiation, so the side
+	// being searched for is known at compile time.
+	template <bool maximizing>
 	int AlphaBeta( const TGameBoard& board, const CMove& move, EPlayer movingPlayer, unsigned int draft, int alpha, int beta );
-	// Sort by expected score.
-	void SortByGuess( std::vector<TScoredMove>& scoredMoves, const std::vector<CMove>& moves, const TGameBoard& current, EPlayer nextPlayer );
+	// Sorts the moves of the ply into its scored moves by expected score, best first for this
+	// player when maximizing and worst first otherwise.
+	template <bool maximizing>
+	void SortByGuess( SPlyBuffers& ply, const TGameBoard& current, EPlayer nextPlayer );
+	// Scores the board, which must be the last one pushed on m_evaluator, for this player.
+	int Evaluate( const TGameBoard& board );
+	// Table access, going to the shared table when there is one.
+	bool ProbeTable( const TGameBoard& board, STranspositionEntry& entry ) { return ProbeTable( board, GetTableKeyHash( board ), entry ); }
+	bool ProbeTable( const TGameBoard& board, size_t keyHash, STranspositionEntry& entry );
+	void StoreTable( const TGameBoard& board, const STranspositionEntry& entry );
+	size_t GetTableKeyHash( const TGameBoard& board ) const { return m_pSharedTable ? m_pSharedTable->GetKeyHash( board ) : m_table.GetKeyHash( board ); }
+	void PrefetchTableSlot( size_t keyHash ) const;
+	void PrefetchTableEntry( size_t keyHash ) const;
+	// Returns true once the search has been stopped or the time limit of an iterative search has run out.
+	bool ShouldStop();
 };
-
@@ -4,6 +4,7 @@
 #include "ComputerPlayer.h"
 
 #include <algorithm>
+#include <memory>
 
 template <typename TGameBoard>
 CPerfTimer CComputerPlayer<TGameBoard>::s_Move( "CComputerPlayer::Move" );
@@ -13,18 +14,73 @@ CPerfTimer CComputerPlayer<TGameBoard>::s_AlphaBeta( "CComputerPlayer::AlphaBeta
 
 //--------------------------------------------------------------------------------------
 template <typename TGameBoard>
-CComputerPlayer<TGameBoard>::CComputerPlayer( EPlayer player, unsigned int depth ) 
+CComputerPlayer<TGameBoard>::CComputerPlayer( EPlayer player, unsigned int depth )
 	: m_player( player )
-	, m_depth( depth )
-	, m_table( CacheSize )
-{ 
+	, m_config( depth )
+	, m_table( DefaultCacheSize )
+	, m_pSharedTable( NULL )
+	, m_searchDepth( depth )
+	, m_canAbort( false )
+	, m_aborted( false )
+	, m_pondering( false )
+	, m_stopRequested( 0 )
+	, m_ponderHit( 0 )
+	, m_random( (unsigned __int64)m_config.m_seed * 2 + player )
+{
+	m_evaluator.SetNetwork( m_config.m_pNetwork );
+}
+
+//--------------------------------------------------------------------------------------
+template <typename TGameBoard>
+CComputerPlayer<TGameBoard>::CComputerPlayer( EPlayer player, const SConfig& config, TSharedTable* pSharedTable )
+	: m_player( player )
+	, m_config( config )
+	, m_table( pSharedTable ? 1 : config.m_cacheSize, config.m_tablePages )
+	, m_pSharedTable( pSharedTable )
+	, m_searchDepth( config.m_depth )
+	, m_canAbort( false )
+	, m_aborted( false )
+	, m_pondering( false )
+	, m_stopRequested( 0 )
+	, m_ponderHit( 0 )
+	, m_random( (unsigned __int64)m_config.m_seed * 2 + player )
+{
+	m_evaluator.SetNetwork( m_config.m_pNetwork );
+}
+
+//--------------------------------------------------------------------------------------
+template <typename TGameBoard>
+bool CComputerPlayer<TGameBoard>::Move( TGameBoard& board, const CGameHistory* pHistory )
+{
+	CMove bestMove;
+	if( !FindBestMove( board, bestMove, pHistory ) )
+		return false;
+
+	return board.MakeMoveIfValid( m_player, bestMove );
 }
 
 //--------------------------------------------------------------------------------------
 template <typename TGameBoard>
-bool CComputerPlayer<TGameBoard>::Move( TGameBoard& board )
+bool CComputerPlayer<TGameBoard>::FindBestMove( const TGameBoard& board, CMove& bestMove, const CGameHistory* pHistory )
 {
-	CPerfTimerCall __call( s_Move );
+	TPerfCall __call( s_Move );
+	CTraceScope trace( "Move", "depth", m_config.m_depth );
+
+	m_stats = SSearchStats();
+	m_stopwatch.Restart();
+
+	// Opened per search since the counters follow the thread that opens them.
+	std::unique_ptr<CHardwareCounters> pCounters;
+	if( m_config.m_hardwareCounters )
+	{
+		pCounters.reset( new CHardwareCounters() );
+		pCounters->Start();
+	}
+
+	// The search extends the game so far; without one the root is the only known position.
+	m_history = pHistory ? *pHistory : CGameHistory();
+	if( m_history.IsEmpty() )
+		m_history.Push( board.GetHashKey(), false );
 
 	std::vector<CMove> moves;
 	if( !board.GetMoves( m_player, moves ) )
@@ -33,116 +89,339 @@ bool CComputerPlayer<TGameBoard>::Move( TGameBoard& board )
 	if( moves.empty() )
 		return false;
 
-	// add some randomness.
-	std::random_shuffle( moves.begin(), moves.end() );
+	m_evaluator.Reset( board );
 
-	// Score all moves.
-	std::vector<TScoredMove> scoredMoves( moves.size() );
-	for( size_t i = 0; i < moves.size(); ++i )
+	// With a time limit search one ply deeper each iteration until the time runs out.
+	// The first iteration always finishes so there is always a move to make.
+	unsigned int firstDepth = m_config.m_timeLimitMs ? 1 : m_config.m_depth;
+	std::vector<TScoredMove> bestScoredMoves;
+	m_aborted = false;
+	for( m_searchDepth = firstDepth; m_searchDepth <= m_config.m_depth; ++m_searchDepth )
+	{
+		m_canAbort = ( m_searchDepth > firstDepth );
+		// Nodes below the last draft are leaves and need no buffers.
+		if( m_plies.size() < m_searchDepth )
+			m_plies.resize( m_searchDepth );
+		CTraceScope iteration( "Iteration", "depth", m_searchDepth );
+
+		// Score all moves.
+		std::vector<TScoredMove> scoredMoves( moves.size() );
+		for( size_t i = 0; i < moves.size() && !m_aborted; ++i )
+		{
+			scoredMoves[i] = TScoredMove( moves[i], AlphaBeta<false>( board, moves[i], m_player, 0, TGameBoard::MinScore, TGameBoard::MaxScore ) );
+		}
+		if( m_aborted )
+			break;
+
+		// Re-sort moves to find the best move (highest to lowest).
+		std::sort( scoredMoves.begin(), scoredMoves.end(), []( const TScoredMove& lhs, const TScoredMove& rhs)->bool{return lhs.second > rhs.second;} );
+
+		// The next iteration tries the moves in this order.
+		for( size_t i = 0; i < scoredMoves.size(); ++i )
+			moves[i] = scoredMoves[i].first;
+
+		bestScoredMoves.swap( scoredMoves );
+		m_stats.m_depth = m_searchDepth;
+		m_stats.m_score = bestScoredMoves[0].second;
+	}
+	m_canAbort = false;
+	m_stats.m_elapsedUs = m_stopwatch.GetElapsedUs();
+	if( pCounters.get() )
+		pCounters->Stop( m_stats.m_hardware );
+	trace.SetEndArg( "nodes", m_stats.m_nodes );
+
+	// If stopped before any iteration finished, fall back on the first move tried.
+	if( bestScoredMoves.empty() )
 	{
-		scoredMoves[i] = TScoredMove( moves[i], AlphaBeta( board, moves[i], m_player, 0, TGameBoard::MinScore, TGameBoard::MaxScore ) );
+		bestMove = moves[0];
+		return true;
 	}
 
-	// Re-sort moves to find the best move (highest to lowest).
-	std::sort( scoredMoves.begin(), scoredMoves.end(), []( const TScoredMove& lhs, const TScoredMove& rhs)->bool{return lhs.second > rhs.second;} );
+	// Pick one of the best moves at random, to vary play between equally good lines.
+	unsigned int bestCount = 1;
+	while( bestCount < bestScoredMoves.size() && bestScoredMoves[ bestCount ].second == bestScoredMoves[0].second )
+		bestCount++;
+	bestMove = bestScoredMoves[ m_random.NextBelow( bestCount ) ].first;
+	return true;
+}
+
+//--------------------------------------------------------------------------------------
+template <typename TGameBoard>
+bool CComputerPlayer<TGameBoard>::GuessReply( const TGameBoard& board, CMove& reply )
+{
+	EPlayer opponent = TGameBoard::GetOpponent( m_player );
+	SPlyBuffers ply;
+	if( !board.GetMoves( opponent, ply.m_moves ) || ply.m_moves.empty() )
+		return false;
 
-	// Pick the first one which will be the best move.
-	return board.MakeMoveIfValid( m_player, scoredMoves[0].first );
+	// The opponent is expected to pick the reply that is worst for this player.
+	SortByGuess<false>( ply, board, opponent );
+	reply = ply.m_scoredMoves[0].first;
+	return true;
 }
 
+//--------------------------------------------------------------------------------------
+// Orders scored moves from the best to the worst for the player to move.
+template <bool maximizing>
+struct SGuessOrder
+{
+	template <typename TScored>
+	bool operator()( const TScored& lhs, const TScored& rhs ) const { return maximizing ? ( lhs.second > rhs.second ) : ( lhs.second < rhs.second ); }
+};
+
 //--------------------------------------------------------------------------------------
 template <typename TGameBoard>
-void CComputerPlayer<TGameBoard>::SortByGuess( std::vector<TScoredMove>& scoredMoves, const std::vector<CMove>& moves, const TGameBoard& current, EPlayer nextPlayer )
+template <bool maximizing>
+void CComputerPlayer<TGameBoard>::SortByGuess( SPlyBuffers& ply, const TGameBoard& current, EPlayer nextPlayer )
 {
 	int scoreOffset = TGameBoard::MaxScore;
+	const std::vector<CMove>& moves = ply.m_moves;
 
-	// Build the set of expected scores.
+	// Each child is hashed once, for its probe and its prefetches.  The table key is the hash
+	// of the child board, so a child is made before its slot is prefetched rather than the
+	// prefetch going ahead of the move.  The slots of all of them still start loading before
+	// the first is probed.
+	ply.m_children.clear();
+	ply.m_hashes.clear();
 	for( size_t i = 0; i < moves.size(); ++i )
 	{
-		STranspositionEntry* pEntry = m_table.Get( TGameBoard( current, nextPlayer, moves[i] ) );
-		if( pEntry && pEntry->m_scoreType == ScoreType_Exact )
+		ply.m_children.push_back( TGameBoard( current, nextPlayer, moves[i] ) );
+		ply.m_hashes.push_back( GetTableKeyHash( ply.m_children.back() ) );
+		if( m_config.m_prefetch )
+			PrefetchTableSlot( ply.m_hashes.back() );
+	}
+
+	// Build the set of expected scores, each with the index of its move.
+	std::vector< std::pair<size_t, int> >& guesses = ply.m_guesses;
+	guesses.clear();
+	STranspositionEntry entry;
+	for( size_t i = 0; i < moves.size(); ++i )
+	{
+		bool found = ProbeTable( ply.m_children[i], ply.m_hashes[i], entry );
+		if( found && entry.m_scoreType == ScoreType_Exact )
 		{
-			scoredMoves.push_back( TScoredMove( moves[i], pEntry ? (pEntry->m_score + m_depth * scoreOffset) : 0 ) );
+			guesses.push_back( std::make_pair( i, (int)( entry.m_score + m_searchDepth * scoreOffset ) ) );
 		}
 		else
 		{
-			scoredMoves.push_back( TScoredMove( moves[i], pEntry ? (pEntry->m_score + pEntry->m_draft * scoreOffset) : 0 ) );
+			guesses.push_back( std::make_pair( i, found ? (int)(entry.m_score + entry.m_draft * scoreOffset) : 0 ) );
 		}
 	}
 
 	// Sort by expected score, but the order is based on who the next player is.
-	auto compareMoves = [this, nextPlayer]( const TScoredMove& lhs, const TScoredMove& rhs )->bool{
-		return ( m_player == nextPlayer ) ? ( lhs.second > rhs.second ) : ( lhs.second < rhs.second ); 
-	};
+	assert( maximizing == ( m_player == nextPlayer ) );
+	std::sort( guesses.begin(), guesses.end(), SGuessOrder<maximizing>() );
+	ply.m_scoredMoves.clear();
+	ply.m_childHashes.clear();
+	for( size_t i = 0; i < guesses.size(); ++i )
+	{
+		ply.m_scoredMoves.push_back( TScoredMove( moves[ guesses[i].first ], guesses[i].second ) );
+		ply.m_childHashes.push_back( ply.m_hashes[ guesses[i].first ] );
+	}
+}
 
-	// Perform the sort.
-	std::sort( scoredMoves.begin(), scoredMoves.end(), compareMoves );	
+//--------------------------------------------------------------------------------------
+template <typename TGameBoard>
+int CComputerPlayer<TGameBoard>::Evaluate( const TGameBoard& board )
+{
+	// The network keeps its accumulators for the path; the weighted sum needs only the board.
+	if( m_config.m_pNetwork )
+		return m_evaluator.Evaluate( m_player );
+	return board.CalculatePlayerScore( m_player, m_config.m_weights );
 }
 
 //--------------------------------------------------------------------------------------
 template <typename TGameBoard>
+bool CComputerPlayer<TGameBoard>::ProbeTable( const TGameBoard& board, size_t keyHash, STranspositionEntry& entry )
+{
+	if( m_pSharedTable )
+		return m_pSharedTable->Get( board, keyHash, entry );
+
+	STranspositionEntry* pEntry = m_table.Get( board, keyHash );
+	if( !pEntry )
+		return false;
+	entry = *pEntry;
+	return true;
+}
+
+//--------------------------------------------------------------------------------------
+template <typename TGameBoard>
+void CComputerPlayer<TGameBoard>::StoreTable( const TGameBoard& board, const STranspositionEntry& entry )
+{
+	if( m_pSharedTable )
+		m_pSharedTable->UpdateCache( board, entry );
+	else
+		m_table.UpdateCache( board, entry );
+}
+
+//--------------------------------------------------------------------------------------
+template <typename TGameBoard>
+void CComputerPlayer<TGameBoard>::PrefetchTableSlot( size_t keyHash ) const
+{
+	if( m_pSharedTable )
+		m_pSharedTable->PrefetchSlot( keyHash );
+	else
+		m_table.PrefetchSlot( keyHash );
+}
+
+//--------------------------------------------------------------------------------------
+template <typename TGameBoard>
+void CComputerPlayer<TGameBoard>::PrefetchTableEntry( size_t keyHash ) const
+{
+	if( m_pSharedTable )
+		m_pSharedTable->PrefetchEntry( keyHash );
+	else
+		m_table.PrefetchEntry( keyHash );
+}
+
+//--------------------------------------------------------------------------------------
+template <typename TGameBoard>
+bool CComputerPlayer<TGameBoard>::ShouldStop()
+{
+	if( m_stopRequested )
+		m_aborted = true;
+
+	// The move being pondered was played, so the clock starts now.
+	if( m_ponderHit && m_pondering )
+	{
+		m_pondering = false;
+		m_stopwatch.Restart();
+	}
+
+	// Reading the clock is not free so only look every so many nodes.
+	if( m_canAbort && !m_pondering && ( m_stats.m_nodes & 1023 ) == 0 && m_stopwatch.GetElapsedMs() >= m_config.m_timeLimitMs )
+		m_aborted = true;
+	return m_aborted;
+}
+
+//--------------------------------------------------------------------------------------
+template <typename TGameBoard>
+template <bool maximizing>
 int CComputerPlayer<TGameBoard>::AlphaBeta( const TGameBoard& board, const CMove& move, EPlayer movingPlayer, unsigned int draft, int alpha, int beta )
 {
-	CPerfTimerCall __call( s_AlphaBeta );
+	TPerfCall __call( s_AlphaBeta );
+	// Only the plies near the root are traced, a full search would flood the buffers.
+	TTraceCall trace( "AlphaBeta", "draft", draft );
+
+	m_stats.m_nodes++;
+	if( ShouldStop() )
+		return 0;
 
 	// Stop testing if at max depth.
-	if( draft >= m_depth )
+	if( draft >= m_searchDepth )
 	{
-		int result = board.CalculatePlayerScore( m_player );
-		m_table.UpdateCache( board, STranspositionEntry( draft, result, ScoreType_Exact ) );
+		int result = Evaluate( board );
+		StoreTable( board, STranspositionEntry( 0, result, ScoreType_Exact ) );
 		return result;
 	}
 
 	// Stop test if the move is some how invalid.
 	TGameBoard cpy( board );
 	if( !cpy.MakeMoveIfValid( movingPlayer, move ) )
-		return board.CalculatePlayerScore( m_player );
+		return Evaluate( board );
+	typename CNeuralEvaluator<TGameBoard>::CScopedPush evaluatorPush( m_evaluator, cpy );
+
+	// A position repeated along the path or without progress for too long is a draw, which
+	// also keeps the search from walking around cycles.
+	CGameHistory::CScopedPush historyPush( m_history, cpy.GetHashKey(), board.IsReversibleMove( movingPlayer, move ) );
+	if( m_history.IsDraw() )
+		return 0;
 
-	STranspositionEntry* pEntry = m_table.Get( cpy );
-	if( pEntry && pEntry->m_draft <= draft )
-		return pEntry->m_score;
+	// Table entries record how many plies were searched below them, so they stay usable
+	// across iterations and moves.
+	const unsigned int remaining = m_searchDepth - draft;
+	STranspositionEntry entry;
+	if( ProbeTable( cpy, entry ) && entry.m_draft >= remaining )
+		return entry.m_score;
 
 	// Stop test if the next player cannot move after the moving player moves.
 	EPlayer nextPlayer = TGameBoard::GetOpponent( movingPlayer );
-	std::vector<CMove> moves;
+	assert( maximizing == ( m_player == nextPlayer ) );
+	SPlyBuffers& ply = m_plies[draft];
+	std::vector<CMove>& moves = ply.m_moves;
+	moves.clear();
 	if( !cpy.GetMoves( nextPlayer, moves ) || moves.empty() )
 	{
-		int result = cpy.CalculatePlayerScore( m_player );
-		m_table.UpdateCache( cpy, STranspositionEntry( draft, result, ScoreType_Exact ) );
+		int result = Evaluate( cpy );
+		StoreTable( cpy, STranspositionEntry( remaining, result, ScoreType_Exact ) );
 		return result;
 	}
 
-	// Try to have an early out.
-	std::vector<TScoredMove> scoredMoves;
-	SortByGuess( scoredMoves, moves, cpy, nextPlayer );
-
-	const unsigned int newDraft = draft + 1;
-	int result = 0;
-	if( m_player == nextPlayer )
+	// Captures are forced, so if the first move is not one none are.  Pruning decisions based
+	// on the static score are not safe while a capture is pending.
+	const bool quietPosition = !cpy.IsCapture( moves[0] );
+	unsigned int newDraft = draft + 1;
+	if( quietPosition && ( m_config.m_futilityDepth || m_config.m_razorDepth ) )
 	{
-		// Maximizing this player
-		for( size_t i = 0; i < scoredMoves.size(); ++i )
+		// Margins are from the point of view of the player to move.
+		const int staticScore = Evaluate( cpy );
+		const int gain = maximizing ? staticScore - alpha : beta - staticScore;
+
+		// Futility pruning: so far behind near the leaves that no quiet line will catch up.
+		if( remaining <= m_config.m_futilityDepth && gain + m_config.m_futilityMargin * (int)remaining <= 0 )
+		{
+			m_stats.m_pruned++;
+			return maximizing ? alpha : beta;
+		}
+
+		// Razoring: a little further from the leaves, search such positions a ply shallower.
+		if( remaining <= m_config.m_razorDepth && remaining > 1 && gain + m_config.m_razorMargin <= 0 )
 		{
-			alpha = max( alpha, AlphaBeta( cpy, scoredMoves[i].first, nextPlayer, newDraft, alpha, beta ) );
-			// prune because we are not going to find any better.
-			if( beta <= alpha )
-				break;
+			m_stats.m_reduced++;
+			newDraft++;
 		}
-		m_table.UpdateCache( cpy, STranspositionEntry( draft, alpha, ScoreType_UpperBound ) );
-		result = alpha;
 	}
-	else
+
+	// Try to have an early out.
+	SortByGuess<maximizing>( ply, cpy, nextPlayer );
+	const std::vector<TScoredMove>& scoredMoves = ply.m_scoredMoves;
+	const std::vector<size_t>& childHashes = ply.m_childHashes;
+
+	// Late move reductions: moves ordered late are rarely best, so quiet ones get a shallower
+	// search first and a full one only if they still improve the bound.
+	const bool canReduce = m_config.m_lmrMoves && remaining >= m_config.m_lmrDepth && remaining > 1 && newDraft == draft + 1;
+
+	for( size_t i = 0; i < scoredMoves.size(); ++i )
 	{
-		// Minimizing this player.
-		for( size_t i = 0; i < scoredMoves.size(); ++i )
+		const CMove& next = scoredMoves[i].first;
+		// The sort loaded every child's slot and entry, but the subtrees searched since may
+		// have pushed them out: the child's entry is fetched again before its search, and the
+		// next child's slot for the following move.
+		if( m_config.m_prefetch )
+		{
+			PrefetchTableEntry( childHashes[i] );
+			if( i + 1 < childHashes.size() )
+				PrefetchTableSlot( childHashes[i + 1] );
+		}
+		if( canReduce && i >= m_config.m_lmrMoves && cpy.IsQuietMove( nextPlayer, next ) )
 		{
-			beta = min( beta, AlphaBeta( cpy, scoredMoves[i].first, nextPlayer, newDraft, alpha, beta ) );
-			// prune because we are not going to find any worse.
-			if( beta <= alpha )
-				break;
+			m_stats.m_reduced++;
+			int score = AlphaBeta<!maximizing>( cpy, next, nextPlayer, newDraft + 1, alpha, beta );
+			if( maximizing ? ( score <= alpha ) : ( score >= beta ) )
+				continue;
+			m_stats.m_researched++;
 		}
-		m_table.UpdateCache( cpy, STranspositionEntry( draft, beta, ScoreType_LowerBound ) );
-		result = beta;
+
+		int score = AlphaBeta<!maximizing>( cpy, next, nextPlayer, newDraft, alpha, beta );
+		// Maximizing this player raises alpha and minimizing lowers beta.
+		if( maximizing )
+			alpha = max( alpha, score );
+		else
+			beta = min( beta, score );
+
+		// prune because we are not going to find any better or worse.
+		if( beta <= alpha )
+			break;
 	}
+
+	// An unfinished search must not be remembered.
+	if( m_aborted )
+		return 0;
+
+	// A razored node was searched a ply shallower, and is recorded as such so a later probe
+	// wanting the full depth searches it again.
+	const unsigned int searched = remaining - ( newDraft - draft - 1 );
+	const int result = maximizing ? alpha : beta;
+	StoreTable( cpy, STranspositionEntry( searched, result, maximizing ? ScoreType_UpperBound : ScoreType_LowerBound ) );
 	return result;
-}
+}
\ No newline at end of file
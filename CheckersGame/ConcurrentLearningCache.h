@@ -0,0 +1,174 @@
+#pragma once
+
+#include "LearningCache.h"
+#include "Threading.h"
+
+//--------------------------------------------------------------------------------------
+// A CLearningCache that can be shared between threads.
+// The key space is split over a number of independent LRU shards picked by key hash, each
+// guarded by its own spin lock, so threads only contend when they touch the same shard.
+// Recency is tracked per shard, which approximates a global LRU.  The shards share one
+// block of memory, so a large cache gets huge pages and a NUMA placement as a whole.
+template <typename TKey, typename TValue, typename THash = stdext::hash_compare<TKey> >
+class CConcurrentLearningCache
+{
+public:
+	enum { DefaultShardCount = 64 };
+
+	// The shard count is rounded up to a power of two and the cache size is split evenly.
+	CConcurrentLearningCache( unsigned int cacheSize, unsigned int shardCount = DefaultShardCount, const SPageConfig& pages = SPageConfig() );
+	~CConcurrentLearningCache();
+
+	void Clear();
+
+	// Copies the cached value out since the entry can be evicted by another thread.
+	bool Get( const TKey& key, TValue& value );
+	// The same given the hash GetKeyHash returns for the key.
+	bool Get( const TKey& key, size_t keyHash, TValue& value );
+	void UpdateCache( const TKey& key, const TValue& newValue );
+	bool Remove( const TKey& key );
+
+	unsigned int GetSize() const;
+	unsigned int GetCacheSize() const { return m_cacheSize; }
+	unsigned int GetShardCount() const { return m_shardCount; }
+	const CPageMemory& GetMemory() const { return m_memory; }
+
+	// As in CLearningCache.  The slot is read without the shard's lock: a stale one only makes
+	// the prefetch useless.
+	size_t GetKeyHash( const TKey& key ) const { return m_hasher( key ); }
+	void PrefetchSlot( size_t keyHash ) const { GetShardOfHash( keyHash ).m_pCache->PrefetchSlot( keyHash ); }
+	void PrefetchEntry( size_t keyHash ) const { GetShardOfHash( keyHash ).m_pCache->PrefetchEntry( keyHash ); }
+
+private:
+	typedef CLearningCache<TKey, TValue, THash> TShardCache;
+
+	struct SShard
+	{
+		CSpinLock m_lock;
+		TShardCache* m_pCache;
+		// Keep neighbouring locks on separate cache lines.
+		char m_padding[64];
+
+		SShard() : m_pCache(NULL) {}
+	};
+
+	CPageMemory m_memory;
+	SShard* m_shards;
+	unsigned int m_shardCount;
+	unsigned int m_cacheSize;
+	THash m_hasher;
+
+	CConcurrentLearningCache( const CConcurrentLearningCache& );
+	CConcurrentLearningCache& operator=( const CConcurrentLearningCache& );
+
+	SShard& GetShard( const TKey& key ) const { return GetShardOfHash( m_hasher( key ) ); }
+	SShard& GetShardOfHash( size_t keyHash ) const;
+};
+
+//--------------------------------------------------------------------------------------
+template <typename TKey, typename TValue, typename THash>
+CConcurrentLearningCache<TKey,TValue,THash>::CConcurrentLearningCache( unsigned int cacheSize, unsigned int shardCount, const SPageConfig& pages )
+	: m_shards(NULL)
+	, m_shardCount(1)
+	, m_cacheSize(0)
+{
+	while( m_shardCount < shardCount )
+		m_shardCount <<= 1;
+
+	// All the shards together are kept within the largest single cache, so the shared block's
+	// size and the total entry count cannot wrap.
+	unsigned int shardSize = (unsigned int)( ( (unsigned __int64)cacheSize + m_shardCount - 1 ) / m_shardCount );
+	const unsigned int maxShardSize = TShardCache::GetMaxCacheSize() / m_shardCount;
+	if( shardSize > maxShardSize )
+		shardSize = maxShardSize;
+	if( !shardSize )
+		shardSize = 1;
+	m_cacheSize = shardSize * m_shardCount;
+
+	const size_t shardMemorySize = TShardCache::GetMemorySize( shardSize );
+	char* pMemory = static_cast<char*>( m_memory.Allocate( shardMemorySize * m_shardCount, pages ) );
+	m_shards = new SShard[ m_shardCount ];
+	for( unsigned int i = 0; i < m_shardCount; ++i )
+		m_shards[i].m_pCache = new TShardCache( shardSize, pMemory + shardMemorySize * i );
+}
+
+//--------------------------------------------------------------------------------------
+template <typename TKey, typename TValue, typename THash>
+CConcurrentLearningCache<TKey,TValue,THash>::~CConcurrentLearningCache()
+{
+	for( unsigned int i = 0; i < m_shardCount; ++i )
+		delete m_shards[i].m_pCache;
+	delete [] m_shards;
+}
+
+//--------------------------------------------------------------------------------------
+template <typename TKey, typename TValue, typename THash>
+void CConcurrentLearningCache<TKey,TValue,THash>::Clear()
+{
+	CTraceScope trace( "SharedTableClear", "shards", m_shardCount );
+	for( unsigned int i = 0; i < m_shardCount; ++i )
+	{
+		CScopedLock<CSpinLock> lock( m_shards[i].m_lock );
+		m_shards[i].m_pCache->Clear();
+	}
+}
+
+//--------------------------------------------------------------------------------------
+template <typename TKey, typename TValue, typename THash>
+bool CConcurrentLearningCache<TKey,TValue,THash>::Get( const TKey& key, TValue& value )
+{
+	return Get( key, m_hasher( key ), value );
+}
+
+//--------------------------------------------------------------------------------------
+template <typename TKey, typename TValue, typename THash>
+bool CConcurrentLearningCache<TKey,TValue,THash>::Get( const TKey& key, size_t keyHash, TValue& value )
+{
+	SShard& shard = GetShardOfHash( keyHash );
+	CScopedLock<CSpinLock> lock( shard.m_lock );
+
+	TValue* pValue = shard.m_pCache->Get( key, keyHash );
+	if( !pValue )
+		return false;
+
+	value = *pValue;
+	return true;
+}
+
+//--------------------------------------------------------------------------------------
+template <typename TKey, typename TValue, typename THash>
+void CConcurrentLearningCache<TKey,TValue,THash>::UpdateCache( const TKey& key, const TValue& newValue )
+{
+	SShard& shard = GetShard( key );
+	CScopedLock<CSpinLock> lock( shard.m_lock );
+	shard.m_pCache->UpdateCache( key, newValue );
+}
+
+//--------------------------------------------------------------------------------------
+template <typename TKey, typename TValue, typename THash>
+bool CConcurrentLearningCache<TKey,TValue,THash>::Remove( const TKey& key )
+{
+	SShard& shard = GetShard( key );
+	CScopedLock<CSpinLock> lock( shard.m_lock );
+	return shard.m_pCache->Remove( key );
+}
+
+//--------------------------------------------------------------------------------------
+template <typename TKey, typename TValue, typename THash>
+unsigned int CConcurrentLearningCache<TKey,TValue,THash>::GetSize() const
+{
+	// Only a snapshot, other threads can change the shards while counting.
+	unsigned int size = 0;
+	for( unsigned int i = 0; i < m_shardCount; ++i )
+		size += m_shards[i].m_pCache->GetSize();
+	return size;
+}
+
+//--------------------------------------------------------------------------------------
+template <typename TKey, typename TValue, typename THash>
+typename CConcurrentLearningCache<TKey,TValue,THash>::SShard& CConcurrentLearningCache<TKey,TValue,THash>::GetShardOfHash( size_t keyHash ) const
+{
+	// The shard caches index with the low bits of the hash so select shards with the high bits.
+	unsigned int hash = static_cast<unsigned int>( keyHash ) * 0x9E3779B1;
+	return m_shards[ ( hash >> 16 ) & ( m_shardCount - 1 ) ];
+}
@@ -0,0 +1,89 @@
+#include "StdAfx.h"
+#include "ConfigFile.h"
+
+#include <fstream>
+#include <stdlib.h>
+
+//--------------------------------------------------------------------------------------
+bool CConfigFile::Load( const std::string& path )
+{
+	std::ifstream file( path.c_str() );
+	if( !file )
+		return false;
+
+	Load( file );
+	return true;
+}
+
+//--------------------------------------------------------------------------------------
+void CConfigFile::Load( std::istream& is )
+{
+	std::string section;
+	std::string line;
+	while( std::getline( is, line ) )
+	{
+		size_t comment = line.find_first_of( ";#" );
+		if( comment != std::string::npos )
+			line.erase( comment );
+
+		line = Trim( line );
+		if( line.empty() )
+			continue;
+
+		if( line[0] == '[' )
+		{
+			size_t end = line.find( ']' );
+			section = Trim( line.substr( 1, end == std::string::npos ? std::string::npos : end - 1 ) );
+			continue;
+		}
+
+		size_t equals = line.find( '=' );
+		if( equals == std::string::npos )
+			continue;
+
+		SetString( section, Trim( line.substr( 0, equals ) ), Trim( line.substr( equals + 1 ) ) );
+	}
+}
+
+//--------------------------------------------------------------------------------------
+bool CConfigFile::HasValue( const std::string& section, const std::string& key ) const
+{
+	return m_values.find( MakeKey( section, key ) ) != m_values.end();
+}
+
+//--------------------------------------------------------------------------------------
+std::string CConfigFile::GetString( const std::string& section, const std::string& key, const std::string& defaultValue ) const
+{
+	TValueMap::const_iterator itr = m_values.find( MakeKey( section, key ) );
+	return ( itr != m_values.end() ) ? itr->second : defaultValue;
+}
+
+//--------------------------------------------------------------------------------------
+int CConfigFile::GetInt( const std::string& section, const std::string& key, int defaultValue ) const
+{
+	TValueMap::const_iterator itr = m_values.find( MakeKey( section, key ) );
+	return ( itr != m_values.end() && !itr->second.empty() ) ? atoi( itr->second.c_str() ) : defaultValue;
+}
+
+//--------------------------------------------------------------------------------------
+double CConfigFile::GetDouble( const std::string& section, const std::string& key, double defaultValue ) const
+{
+	TValueMap::const_iterator itr = m_values.find( MakeKey( section, key ) );
+	return ( itr != m_values.end() && !itr->second.empty() ) ? atof( itr->second.c_str() ) : defaultValue;
+}
+
+//--------------------------------------------------------------------------------------
+void CConfigFile::SetString( const std::string& section, const std::string& key, const std::string& value )
+{
+	m_values[ MakeKey( section, key ) ] = value;
+}
+
+//--------------------------------------------------------------------------------------
+std::string CConfigFile::Trim( const std::string& text )
+{
+	size_t begin = text.find_first_not_of( " \t\r\n" );
+	if( begin == std::string::npos )
+		return std::string();
+	size_t end = text.find_last_not_of( " \t\r\n" );
+	return text.substr( begin, end - begin + 1 );
+}
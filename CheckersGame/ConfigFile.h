@@ -0,0 +1,35 @@
+#pragma once
+
+#include <iostream>
+#include <map>
+#include <string>
+
+//--------------------------------------------------------------------------------------
+// Reads simple ini style files:
+//   [section]
+//   key = value   ; comment
+// Keys before the first section belong to the unnamed section "".
+class CConfigFile
+{
+public:
+	CConfigFile() {}
+
+	// Returns false if the file could not be opened.
+	bool Load( const std::string& path );
+	void Load( std::istream& is );
+
+	bool HasValue( const std::string& section, const std::string& key ) const;
+	std::string GetString( const std::string& section, const std::string& key, const std::string& defaultValue = std::string() ) const;
+	int GetInt( const std::string& section, const std::string& key, int defaultValue ) const;
+	double GetDouble( const std::string& section, const std::string& key, double defaultValue ) const;
+
+	void SetString( const std::string& section, const std::string& key, const std::string& value );
+
+private:
+	typedef std::map<std::string, std::string> TValueMap;
+	// Keyed by "section.key".
+	TValueMap m_values;
+
+	static std::string MakeKey( const std::string& section, const std::string& key ) { return section + "." + key; }
+	static std::string Trim( const std::string& text );
+};
@@ -0,0 +1,36 @@
+#include "StdAfx.h"
+#include "CpuFeatures.h"
+
+#if defined( __GNUC__ )
+#include <cpuid.h>
+#else
+#include <intrin.h>
+#endif
+
+namespace
+{
+	// Feature bit of cpuid leaf 1, in edx.
+	const unsigned int kSse2Bit = 1u << 26;
+
+	//--------------------------------------------------------------------------------------
+	// Returns edx of cpuid leaf 1, or zero without cpuid.
+	unsigned int ReadFeatureBits()
+	{
+#if defined( __GNUC__ )
+		unsigned int eax = 0, ebx = 0, ecx = 0, edx = 0;
+		return __get_cpuid( 1, &eax, &ebx, &ecx, &edx ) ? edx : 0;
+#else
+		int registers[4];
+		__cpuid( registers, 1 );
+		return (unsigned int)registers[3];
+#endif
+	}
+}
+
+//--------------------------------------------------------------------------------------
+bool CCpuFeatures::HasSse2()
+{
+	// Threads racing to set this the first time all set the same value.
+	static const bool s_sse2 = ( ReadFeatureBits() & kSse2Bit ) != 0;
+	return s_sse2;
+}
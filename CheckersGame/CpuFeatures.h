@@ -0,0 +1,20 @@
+#pragma once
+
+#include "stdafx.h"
+
+// SSE2 intrinsics compile for every x86 target whatever /arch the project sets, so code using
+// them is always built in there and chosen at run time.
+#if defined( _M_IX86 ) || defined( _M_X64 ) || defined( __SSE2__ )
+#define CPU_FEATURES_SSE2 1
+#else
+#define CPU_FEATURES_SSE2 0
+#endif
+
+//--------------------------------------------------------------------------------------
+// Instruction sets of the processor running the program, read with cpuid.  The projects build
+// for any x86, so code using instructions past that checks here before taking its vector path.
+class CCpuFeatures
+{
+public:
+	static bool HasSse2();
+};
@@ -0,0 +1,542 @@
+#include "StdAfx.h"
+#include "DraughtsBoard.h"
+
+#include <stdlib.h>
+
+CPerfTimer CDraughtsBoard::s_GetMoves( "CDraughtsBoard::GetMoves" );
+CPerfTimer CDraughtsBoard::s_AddCaptures( "CDraughtsBoard::AddCaptures" );
+CPerfTimer CDraughtsBoard::s_IsValidMove( "CDraughtsBoard::IsValidMove" );
+CPerfTimer CDraughtsBoard::s_MakeMoveIfValid( "CDraughtsBoard::MakeMoveIfValid" );
+
+//--------------------------------------------------------------------------------------
+static int BitCount( unsigned int i )
+{
+	i = i - ((i >> 1) & 0x55555555);
+	i = (i & 0x33333333) + ((i >> 2) & 0x33333333);
+	return (((i + (i >> 4)) & 0x0F0F0F0F) * 0x01010101) >> 24;
+}
+
+//--------------------------------------------------------------------------------------
+static int BitCount( unsigned __int64 l )
+{
+	return BitCount( (unsigned int)l ) + BitCount( (unsigned int)(l >> 32) );
+}
+
+//--------------------------------------------------------------------------------------
+// Square y * 5 + x / 2 + y / 2 of the padded layout is at x, y.  Directions 0 and 1 step up
+// the rows, towards lower and higher x, and 2 and 3 step down them, towards higher and lower
+// x, so direction d ^ 2 is the opposite of d.
+namespace
+{
+	const int kDirectionCount = 4;
+	const int kShifts[kDirectionCount] = { 5, 6, 5, 6 };
+
+	// Bits 0 to 54 less the ghost bits 10, 21, 32, 43 and 54.
+	const unsigned __int64 kSquares = 0x003FF7FEFFDFFBFFull;
+	// The dark squares with x and y from 3 to 6.
+	const unsigned __int64 kCenter = 0x0000000C618C0000ull;
+	// The dark squares with x of 0 or 9.
+	const unsigned __int64 kSideColumns = 0x000300600C018030ull;
+
+	//--------------------------------------------------------------------------------------
+	inline unsigned __int64 RowMask( int y )
+	{
+		return 0x1Full << ( y * 5 + y / 2 );
+	}
+
+	//--------------------------------------------------------------------------------------
+	// Moves every set bit one square in the direction, dropping those that leave the board.
+	inline unsigned __int64 Step( unsigned __int64 bits, int direction )
+	{
+		return ( direction < 2 ? bits << kShifts[direction] : bits >> kShifts[direction] ) & kSquares;
+	}
+
+	//--------------------------------------------------------------------------------------
+	inline unsigned __int64 LowestBit( unsigned __int64 bits )
+	{
+		return bits & ( 0 - bits );
+	}
+
+	//--------------------------------------------------------------------------------------
+	// Index of a single set bit by de Bruijn multiplication, which unlike the bit scan
+	// intrinsics also works in 32 bit builds.
+	inline int BitIndex( unsigned __int64 bit )
+	{
+		static const int s_indices[64] =
+		{
+			 0,  1, 48,  2, 57, 49, 28,  3, 61, 58, 50, 42, 38, 29, 17,  4,
+			62, 55, 59, 36, 53, 51, 43, 22, 45, 39, 33, 30, 24, 18, 12,  5,
+			63, 47, 56, 27, 60, 41, 37, 16, 54, 35, 52, 21, 44, 32, 23, 11,
+			46, 26, 40, 15, 34, 20, 31, 10, 25, 14, 19,  9, 13,  8,  7,  6,
+		};
+		return s_indices[ ( bit * 0x03F79D71B4CB0A89ull ) >> 58 ];
+	}
+
+	//--------------------------------------------------------------------------------------
+	// Writes first plus the number of the square, 0 to 49, for every bit set.  Returns how
+	// many were written.
+	unsigned int GetSquareInputs( unsigned __int64 bits, unsigned short first, unsigned short* pInputs )
+	{
+		unsigned int count = 0;
+		for( ; bits; bits &= bits - 1 )
+		{
+			const int index = BitIndex( LowestBit( bits ) );
+			pInputs[count++] = (unsigned short)( first + index - index / 11 );
+		}
+		return count;
+	}
+
+	//--------------------------------------------------------------------------------------
+	// splitmix64 finalizer, as CCheckersBoard::MixHash.
+	inline unsigned __int64 MixHash( unsigned __int64 value )
+	{
+		value ^= value >> 30;
+		value *= 0xBF58476D1CE4E5B9ull;
+		value ^= value >> 27;
+		value *= 0x94D049BB133111EBull;
+		value ^= value >> 31;
+		return value;
+	}
+
+	//--------------------------------------------------------------------------------------
+	// The direction from one position to another on the same diagonal and how many squares
+	// away it is, or false if they do not share a diagonal.
+	bool GetDirection( const SPosition& from, const SPosition& to, int& direction, int& distance )
+	{
+		const int dx = (int)to.m_x - (int)from.m_x;
+		const int dy = (int)to.m_y - (int)from.m_y;
+		if( !dx || abs( dx ) != abs( dy ) )
+			return false;
+
+		direction = ( dy > 0 ) ? ( dx < 0 ? 0 : 1 ) : ( dx > 0 ? 2 : 3 );
+		distance = abs( dx );
+		return true;
+	}
+}
+
+//--------------------------------------------------------------------------------------
+CDraughtsBoard::CDraughtsBoard(const CDraughtsBoard& cpy, EPlayer movingPlayer, const CMove& move)
+{
+	*this = cpy;
+	MakeMoveIfValid( movingPlayer, move );
+}
+
+//--------------------------------------------------------------------------------------
+void CDraughtsBoard::Initialize()
+{
+	Clear();
+	for( int y = 0; y < 4; ++y )
+	{
+		m_redPieces |= RowMask( y );
+		m_blackPieces |= RowMask( Size - 1 - y );
+	}
+}
+
+//--------------------------------------------------------------------------------------
+SPosition CDraughtsBoard::BitToPosition( unsigned __int64 bit )
+{
+	const int index = BitIndex( bit );
+	const int upper = ( index % 11 ) >= 5 ? 1 : 0;
+	const int y = ( index / 11 ) * 2 + upper;
+	const int x = ( index % 11 - upper * 5 ) * 2 + ( ( y + 1 ) & 1 );
+	return SPosition( x, y );
+}
+
+//--------------------------------------------------------------------------------------
+ESquareState CDraughtsBoard::GetSquareState( const SPosition& pos ) const
+{
+	const unsigned __int64 bit = PositionToBit( pos );
+	if( m_blackPieces & bit )
+		return SquareState_Black;
+	if( m_redPieces & bit )
+		return SquareState_Red;
+	if( m_blackKings & bit )
+		return SquareState_BlackKing;
+	if( m_redKings & bit )
+		return SquareState_RedKing;
+	return SquareState_Blank;
+}
+
+//--------------------------------------------------------------------------------------
+ESquareState CDraughtsBoard::SetSquareState( const SPosition& pos, ESquareState state )
+{
+	const unsigned __int64 bit = PositionToBit( pos );
+	if( !bit )
+		return SquareState_Blank;
+
+	m_blackPieces &= ~bit;
+	m_redPieces &= ~bit;
+	m_blackKings &= ~bit;
+	m_redKings &= ~bit;
+	switch( state )
+	{
+	case SquareState_Red:
+		m_redPieces |= bit;
+		break;
+	case SquareState_Black:
+		m_blackPieces |= bit;
+		break;
+	case SquareState_RedKing:
+		m_redKings |= bit;
+		break;
+	case SquareState_BlackKing:
+		m_blackKings |= bit;
+		break;
+	case SquareState_Blank:
+	default:
+		break;
+	}
+	return state;
+}
+
+//--------------------------------------------------------------------------------------
+bool CDraughtsBoard::GetMoves( EPlayer player, std::vector<CMove>& moves ) const
+{
+	TPerfCall __call( s_GetMoves );
+
+	return ( player == Player_Red ) ? GetPlayerMoves<Player_Red>( moves ) : GetPlayerMoves<Player_Black>( moves );
+}
+
+//--------------------------------------------------------------------------------------
+template <EPlayer player>
+bool CDraughtsBoard::GetPlayerMoves( std::vector<CMove>& moves ) const
+{
+	const unsigned __int64 men = ( player == Player_Red ) ? m_redPieces : m_blackPieces;
+	const unsigned __int64 kings = ( player == Player_Red ) ? m_redKings : m_blackKings;
+	const unsigned __int64 occupied = m_blackPieces | m_redPieces | m_blackKings | m_redKings;
+
+	// The longest captures of any piece win, so every piece is searched before deciding
+	// whether there are captures at all.
+	std::vector<unsigned __int64> captured;
+	unsigned int best = 0;
+	SCaptureSearch search;
+	search.m_opponents = ( player == Player_Red ) ? ( m_blackPieces | m_blackKings ) : ( m_redPieces | m_redKings );
+	search.m_pCaptured = &captured;
+	search.m_pBest = &best;
+	for( unsigned __int64 pieces = men | kings; pieces; pieces &= pieces - 1 )
+	{
+		const unsigned __int64 from = LowestBit( pieces );
+		search.m_start = from;
+		search.m_empty = ~( occupied & ~from ) & kSquares;
+		if( kings & from )
+			AddCaptures<true>( search, from, 0, 0, moves );
+		else
+			AddCaptures<false>( search, from, 0, 0, moves );
+	}
+	if( best )
+		return true;
+
+	for( unsigned __int64 pieces = men | kings; pieces; pieces &= pieces - 1 )
+	{
+		const unsigned __int64 from = LowestBit( pieces );
+		AddSimpleMoves<player>( from, ( kings & from ) != 0, moves );
+	}
+	return !moves.empty();
+}
+
+//--------------------------------------------------------------------------------------
+template <bool isKing>
+void CDraughtsBoard::AddCaptures( SCaptureSearch& search, unsigned __int64 from, unsigned int length, unsigned __int64 captured, std::vector<CMove>& moves ) const
+{
+	TPerfCall __call( s_AddCaptures );
+
+	bool extended = false;
+	const unsigned __int64 targets = search.m_opponents & ~captured;
+	for( int direction = 0; direction < kDirectionCount; ++direction )
+	{
+		// A man takes the piece next to it, a king the first one along the diagonal.
+		unsigned __int64 over = Step( from, direction );
+		if( isKing )
+		{
+			while( over & search.m_empty )
+				over = Step( over, direction );
+		}
+		if( !( over & targets ) )
+			continue;
+
+		// A man lands just beyond, a king on any empty square up to the next piece.
+		for( unsigned __int64 to = Step( over, direction ); to & search.m_empty; to = Step( to, direction ) )
+		{
+			search.m_path[length] = to;
+			AddCaptures<isKing>( search, to, length + 1, captured | over, moves );
+			extended = true;
+			if( !isKing )
+				break;
+		}
+	}
+
+	// Captures must be played to the end, so only chains that cannot go on are moves.
+	if( !extended && length )
+		AddCapture( search, length, captured, moves );
+}
+
+//--------------------------------------------------------------------------------------
+void CDraughtsBoard::AddCapture( SCaptureSearch& search, unsigned int length, unsigned __int64 captured, std::vector<CMove>& moves ) const
+{
+	unsigned int& best = *search.m_pBest;
+	std::vector<unsigned __int64>& capturedSets = *search.m_pCaptured;
+	if( length < best )
+		return;
+	if( length > best )
+	{
+		// The first capture replaces any moves there were; a longer one replaces shorter ones.
+		moves.clear();
+		capturedSets.clear();
+		best = length;
+	}
+
+	const SPosition start = BitToPosition( search.m_start );
+	const SPosition end = BitToPosition( search.m_path[length - 1] );
+	for( size_t i = 0; i < moves.size(); ++i )
+	{
+		if( capturedSets[i] == captured && moves[i].m_start == start && moves[i].m_sequence.back() == end )
+			return;
+	}
+
+	moves.push_back( CMove() );
+	CMove& move = moves.back();
+	move.m_start = start;
+	move.m_sequence.resize( length );
+	for( unsigned int i = 0; i < length; ++i )
+		move.m_sequence[i] = BitToPosition( search.m_path[i] );
+	capturedSets.push_back( captured );
+}
+
+//--------------------------------------------------------------------------------------
+template <EPlayer player>
+void CDraughtsBoard::AddSimpleMoves( unsigned __int64 from, bool isKing, std::vector<CMove>& moves ) const
+{
+	const unsigned __int64 empty = ~( m_blackPieces | m_redPieces | m_blackKings | m_redKings ) & kSquares;
+
+	CMove test;
+	test.m_start = BitToPosition( from );
+	test.m_sequence.resize( 1 );
+
+	// Kings go all four ways as far as the diagonal is open, red men one square up the rows
+	// and black men one square down them.
+	const int first = ( isKing || player == Player_Red ) ? 0 : 2;
+	const int last = ( isKing || player == Player_Black ) ? kDirectionCount : 2;
+	for( int direction = first; direction < last; ++direction )
+	{
+		for( unsigned __int64 to = Step( from, direction ); to & empty; to = Step( to, direction ) )
+		{
+			test.m_sequence[0] = BitToPosition( to );
+			moves.push_back( test );
+			if( !isKing )
+				break;
+		}
+	}
+}
+
+//--------------------------------------------------------------------------------------
+bool CDraughtsBoard::IsValidMove( EPlayer player, const CMove& move, unsigned __int64* pCaptured ) const
+{
+	TPerfCall __call( s_IsValidMove );
+
+	const unsigned __int64 start = PositionToBit( move.m_start );
+	const unsigned __int64 men = ( player == Player_Red ) ? m_redPieces : m_blackPieces;
+	const unsigned __int64 kings = ( player == Player_Red ) ? m_redKings : m_blackKings;
+	if( !( start & ( men | kings ) ) || move.m_sequence.empty() )
+		return false;
+
+	const bool isKing = ( kings & start ) != 0;
+	const unsigned __int64 opponents = ( player == Player_Red ) ? ( m_blackPieces | m_blackKings ) : ( m_redPieces | m_redKings );
+	const unsigned __int64 empty = ~( ( m_blackPieces | m_redPieces | m_blackKings | m_redKings ) & ~start ) & kSquares;
+
+	unsigned __int64 captured = 0;
+	unsigned __int64 from = start;
+	SPosition previous = move.m_start;
+	for( size_t i = 0; i < move.m_sequence.size(); ++i )
+	{
+		const SPosition& next = move.m_sequence[i];
+		const unsigned __int64 to = PositionToBit( next );
+		int direction = 0;
+		int distance = 0;
+		if( !( to & empty ) || !GetDirection( previous, next, direction, distance ) )
+			return false;
+
+		// The pieces between the squares, of which a capture passes exactly one.
+		unsigned __int64 passed = 0;
+		unsigned __int64 square = from;
+		for( int step = 1; step < distance; ++step )
+		{
+			square = Step( square, direction );
+			if( !( square & empty ) )
+				passed |= square;
+		}
+
+		if( !passed )
+		{
+			// A plain move is a single step, forwards only for a man.
+			const bool forwards = ( player == Player_Red ) ? direction < 2 : direction >= 2;
+			if( move.m_sequence.size() != 1 || ( !isKing && ( distance != 1 || !forwards ) ) )
+				return false;
+		}
+		else
+		{
+			if( ( passed & ( passed - 1 ) ) || !( passed & opponents & ~captured ) || ( !isKing && distance != 2 ) )
+				return false;
+			captured |= passed;
+		}
+
+		from = to;
+		previous = next;
+	}
+
+	if( pCaptured )
+		*pCaptured = captured;
+	return true;
+}
+
+//--------------------------------------------------------------------------------------
+bool CDraughtsBoard::MakeMoveIfValid( EPlayer player, const CMove& move )
+{
+	TPerfCall __call( s_MakeMoveIfValid );
+
+	unsigned __int64 captured = 0;
+	if( !IsValidMove( player, move, &captured ) )
+		return false;
+
+	unsigned __int64& men = ( player == Player_Red ) ? m_redPieces : m_blackPieces;
+	unsigned __int64& kings = ( player == Player_Red ) ? m_redKings : m_blackKings;
+	unsigned __int64& opponentMen = ( player == Player_Red ) ? m_blackPieces : m_redPieces;
+	unsigned __int64& opponentKings = ( player == Player_Red ) ? m_blackKings : m_redKings;
+
+	const unsigned __int64 start = PositionToBit( move.m_start );
+	const unsigned __int64 end = PositionToBit( move.m_sequence.back() );
+	opponentMen &= ~captured;
+	opponentKings &= ~captured;
+	if( kings & start )
+	{
+		kings = ( kings & ~start ) | end;
+	}
+	else
+	{
+		// A man is crowned only if its move ends on the far row, not when a capture passes it.
+		men &= ~start;
+		const unsigned __int64 crownRow = RowMask( ( player == Player_Red ) ? Size - 1 : 0 );
+		if( end & crownRow )
+			kings |= end;
+		else
+			men |= end;
+	}
+	return true;
+}
+
+//--------------------------------------------------------------------------------------
+int CDraughtsBoard::CalculatePlayerScore( EPlayer player, const SEvalWeights& weights ) const
+{
+	int features[SEvalWeights::FeatureCount];
+	GetEvalFeatures( features );
+
+	int redScore = 0;
+	for( int i = 0; i < SEvalWeights::FeatureCount; ++i )
+		redScore += weights.m_values[i] * features[i];
+
+	// Test for win state.
+	if( !( m_redPieces | m_redKings ) )
+		redScore = CDraughtsBoard::MinScore;
+	else if( !( m_blackPieces | m_blackKings ) )
+		redScore = CDraughtsBoard::MaxScore;
+
+	return ( player == Player_Red ) ? redScore : -redScore;
+}
+
+//--------------------------------------------------------------------------------------
+void CDraughtsBoard::GetEvalFeatures( int features[SEvalWeights::FeatureCount] ) const
+{
+	features[SEvalWeights::Feature_Man] = BitCount( m_redPieces ) - BitCount( m_blackPieces );
+	features[SEvalWeights::Feature_King] = BitCount( m_redKings ) - BitCount( m_blackKings );
+	features[SEvalWeights::Feature_BackRowMan] = BitCount( m_redPieces & RowMask( 0 ) ) - BitCount( m_blackPieces & RowMask( Size - 1 ) );
+	features[SEvalWeights::Feature_CenterMan] = BitCount( m_redPieces & kCenter ) - BitCount( m_blackPieces & kCenter );
+	features[SEvalWeights::Feature_CenterKing] = BitCount( m_redKings & kCenter ) - BitCount( m_blackKings & kCenter );
+	features[SEvalWeights::Feature_EdgeKing] = BitCount( m_redKings & kSideColumns ) - BitCount( m_blackKings & kSideColumns );
+
+	// Red advances up the rows and black down them.
+	int advance = 0;
+	for( int rows = 1; rows < Size; ++rows )
+	{
+		advance += rows * BitCount( m_redPieces & RowMask( rows ) );
+		advance -= rows * BitCount( m_blackPieces & RowMask( Size - 1 - rows ) );
+	}
+	features[SEvalWeights::Feature_ManAdvance] = advance;
+}
+
+//--------------------------------------------------------------------------------------
+unsigned __int64 CDraughtsBoard::GetHashKey() const
+{
+	// Chain the sets through the mixer so the same pattern in two sets does not cancel out.
+	unsigned __int64 key = MixHash( m_blackPieces );
+	key = MixHash( key ^ m_redPieces );
+	key = MixHash( key ^ m_blackKings );
+	return MixHash( key ^ m_redKings );
+}
+
+//--------------------------------------------------------------------------------------
+unsigned int CDraughtsBoard::GetNetworkInputs( unsigned short* pInputs ) const
+{
+	const unsigned __int64 sets[4] = { m_redPieces, m_redKings, m_blackPieces, m_blackKings };
+	unsigned int count = 0;
+	for( int i = 0; i < 4; ++i )
+		count += GetSquareInputs( sets[i], (unsigned short)( i * 50 ), pInputs + count );
+	return count;
+}
+
+//--------------------------------------------------------------------------------------
+void CDraughtsBoard::GetNetworkChanges( const CDraughtsBoard& from, unsigned short* pAdded, unsigned int& addedCount, unsigned short* pRemoved, unsigned int& removedCount ) const
+{
+	const unsigned __int64 sets[4] = { m_redPieces, m_redKings, m_blackPieces, m_blackKings };
+	const unsigned __int64 fromSets[4] = { from.m_redPieces, from.m_redKings, from.m_blackPieces, from.m_blackKings };
+	addedCount = 0;
+	removedCount = 0;
+	for( int i = 0; i < 4; ++i )
+	{
+		const unsigned __int64 changed = sets[i] ^ fromSets[i];
+		addedCount += GetSquareInputs( changed & sets[i], (unsigned short)( i * 50 ), pAdded + addedCount );
+		removedCount += GetSquareInputs( changed & fromSets[i], (unsigned short)( i * 50 ), pRemoved + removedCount );
+	}
+}
+
+//--------------------------------------------------------------------------------------
+bool CDraughtsBoard::IsCapture( const CMove& move ) const
+{
+	if( move.m_sequence.empty() )
+		return false;
+	if( move.m_sequence.size() > 1 )
+		return true;
+
+	// A single jump passes over a piece, a plain move only over empty squares.
+	int direction = 0;
+	int distance = 0;
+	if( !GetDirection( move.m_start, move.m_sequence[0], direction, distance ) )
+		return false;
+
+	const unsigned __int64 occupied = m_blackPieces | m_redPieces | m_blackKings | m_redKings;
+	unsigned __int64 square = PositionToBit( move.m_start );
+	for( int step = 1; step < distance; ++step )
+	{
+		square = Step( square, direction );
+		if( square & occupied )
+			return true;
+	}
+	return false;
+}
+
+//--------------------------------------------------------------------------------------
+bool CDraughtsBoard::IsReversibleMove( EPlayer player, const CMove& move ) const
+{
+	const unsigned __int64 kings = ( player == Player_Red ) ? m_redKings : m_blackKings;
+	return ( kings & PositionToBit( move.m_start ) ) && !IsCapture( move );
+}
+
+//--------------------------------------------------------------------------------------
+bool CDraughtsBoard::IsQuietMove( EPlayer player, const CMove& move ) const
+{
+	if( IsCapture( move ) )
+		return false;
+
+	// Men only move forwards, so a man stepping onto either end row is crowned.
+	const unsigned __int64 kings = ( player == Player_Red ) ? m_redKings : m_blackKings;
+	const unsigned int row = move.m_sequence.back().m_y;
+	return ( kings & PositionToBit( move.m_start ) ) || ( row != 0 && row != Size - 1 );
+}
@@ -0,0 +1,173 @@
+#pragma once
+
+#include "stdafx.h"
+
+#include "CheckersBoard.h"
+#include "GameBoardBasics.h"
+
+#include <vector>
+#include <xhash>
+
+// Instrumentation level of move generation and validation, see PerfTimer.h.
+#ifndef DRAUGHTS_BOARD_PERF_LEVEL
+#define DRAUGHTS_BOARD_PERF_LEVEL PERF_LEVEL
+#endif
+
+//--------------------------------------------------------------------------------------
+// International draughts: a 10x10 board with 20 men a side, men that capture backwards,
+// flying kings and compulsory majority capture (only the captures taking the most pieces
+// are legal, and they must be played to the end).  Implements the same interface as
+// CCheckersBoard so it can be searched by a ComputerPlayer.  Red starts on the four lowest
+// rows and moves up them; squares are dark where x + y is odd as on the 8x8 board.
+// NOTE: x and y run to 9, past SPosition::IsValid, so only the board checks positions.
+class CDraughtsBoard
+{
+public:
+	enum { MaxScore = 10000, MinScore = -10000 };
+	enum { Size = 10 };
+
+	typedef SEvalWeights TEvalWeights;
+
+	CDraughtsBoard(const CDraughtsBoard& cpy, EPlayer movingPlayer, const CMove& move);
+	CDraughtsBoard(void) { Initialize(); }
+	~CDraughtsBoard(void) {}
+
+	// Sets the game board to the initial state.
+	void Initialize();
+
+	// Returns the piece on a square, blank for light squares and squares off the board.
+	ESquareState GetSquareState( const SPosition& pos ) const;
+	// Sets the game state of a space, for setting up positions.
+	ESquareState SetSquareState( const SPosition& pos, ESquareState state );
+	// Removes every piece from the board.
+	void Clear() { m_blackPieces = m_redPieces = m_blackKings = m_redKings = 0; }
+
+	// Calculates the list of valid moves for a provided player.  When a capture is possible
+	// only the captures of the most pieces are returned.
+	bool GetMoves( EPlayer player, std::vector<CMove>& moves ) const;
+
+	// Determines if a move follows the movement and capture rules, returning the bits of the
+	// pieces it takes.  Like CCheckersBoard it does not check that a capture was compulsory,
+	// nor here that it was the longest.
+	bool IsValidMove( EPlayer player, const CMove& move, unsigned __int64* pCaptured = NULL ) const;
+
+	// Tests if a move is valid and finalizes it.
+	bool MakeMoveIfValid( EPlayer player, const CMove& move );
+
+	// Evaluate score with the features of CCheckersBoard, measured on this board.
+	int CalculatePlayerScore( EPlayer player ) const { return CalculatePlayerScore( player, SEvalWeights() ); }
+	int CalculatePlayerScore( EPlayer player, const SEvalWeights& weights ) const;
+	void GetEvalFeatures( int features[SEvalWeights::FeatureCount] ) const;
+
+	// Returns the opponent player to the given player.
+	static EPlayer GetOpponent( EPlayer player ) { return( player == Player_Red ? Player_Black : Player_Red ); }
+
+	// Returns a 64 bit key identifying the position, used for repetition detection.
+	unsigned __int64 GetHashKey() const;
+	// Returns true if the move could be undone later: a king moving without a capture.
+	bool IsReversibleMove( EPlayer player, const CMove& move ) const;
+	// Returns true if the move takes a piece.  A flying king moves several squares without
+	// capturing, so unlike CCheckersBoard this needs the board the move is made on.
+	bool IsCapture( const CMove& move ) const;
+	// Returns true if the move neither captures nor crowns a man.
+	bool IsQuietMove( EPlayer player, const CMove& move ) const;
+
+	// Converts between positions and the bits of the padded layout.  Returns 0 for a
+	// position that is not a dark square on the board.
+	static unsigned __int64 PositionToBit( const SPosition& pos );
+	static SPosition BitToPosition( unsigned __int64 bit );
+
+	// Inputs of a neural evaluation as for CCheckersBoard, over the 50 squares in bit order.
+	enum { NetworkInputCount = 4 * 50 };
+	unsigned int GetNetworkInputs( unsigned short* pInputs ) const;
+	void GetNetworkChanges( const CDraughtsBoard& from, unsigned short* pAdded, unsigned int& addedCount, unsigned short* pRemoved, unsigned int& removedCount ) const;
+
+	// Returns 0 if equal else +1 if this > rhs else -1 (implying this < rhs)
+	int Compare( const CDraughtsBoard& rhs ) const;
+
+	bool operator==( const CDraughtsBoard& rhs ) const { return Compare( rhs ) == 0; }
+	bool operator!=( const CDraughtsBoard& rhs ) const { return Compare( rhs ) != 0; }
+	bool operator< ( const CDraughtsBoard& rhs ) const { return Compare( rhs ) <  0; }
+	bool operator<=( const CDraughtsBoard& rhs ) const { return Compare( rhs ) <= 0; }
+	bool operator> ( const CDraughtsBoard& rhs ) const { return Compare( rhs ) >  0; }
+	bool operator>=( const CDraughtsBoard& rhs ) const { return Compare( rhs ) >= 0; }
+
+	operator size_t() const
+	{
+		unsigned int* begin = (unsigned int*)(this);
+		unsigned int* end = begin + sizeof(CDraughtsBoard) / sizeof(unsigned int);
+		return stdext::_Hash_value( begin, end );
+	}
+
+	// Active at DRAUGHTS_BOARD_PERF_LEVEL.
+	static CPerfTimer s_GetMoves;
+	static CPerfTimer s_AddCaptures;
+	static CPerfTimer s_IsValidMove;
+	static CPerfTimer s_MakeMoveIfValid;
+
+private:
+	typedef CPerfTimerScope<DRAUGHTS_BOARD_PERF_LEVEL> TPerfCall;
+
+	// A capture takes a different piece with every jump, so never more than a side has.
+	enum { MaxCaptureChain = 20 };
+
+	// The 50 dark squares in a padded layout: each pair of rows takes 11 bits, five squares
+	// of the lower row, five of the upper and a ghost bit that is never set.  Every diagonal
+	// step is then a shift by 5 or 6 in every row, and a step off the side of the board lands
+	// on a ghost bit, so moves are shifts and masks with no edge tables.
+	unsigned __int64 m_blackPieces;
+	unsigned __int64 m_redPieces;
+	unsigned __int64 m_blackKings;
+	unsigned __int64 m_redKings;
+
+	// State of the capture search of one piece.
+	struct SCaptureSearch
+	{
+		unsigned __int64 m_start;
+		// Squares a piece may pass over or land on.  The start square is empty, captured
+		// pieces are not: they stay on the board until the capture is complete.
+		unsigned __int64 m_empty;
+		unsigned __int64 m_opponents;
+		unsigned __int64 m_path[MaxCaptureChain];
+		// Pieces taken by the best captures so far, each parallel to its move, so two chains
+		// taking the same pieces to the same square are kept only once.
+		std::vector<unsigned __int64>* m_pCaptured;
+		// Length of the best captures so far, 0 before the first.
+		unsigned int* m_pBest;
+	};
+
+	// Like CCheckersBoard, move generation and validation are compiled once per player.
+	template <EPlayer player> bool GetPlayerMoves( std::vector<CMove>& moves ) const;
+	// Follows the captures of a man or king from the bit from, length jumps in, depth first.
+	// Complete chains at least as long as the best so far are added to moves.
+	template <bool isKing> void AddCaptures( SCaptureSearch& search, unsigned __int64 from, unsigned int length, unsigned __int64 captured, std::vector<CMove>& moves ) const;
+	void AddCapture( SCaptureSearch& search, unsigned int length, unsigned __int64 captured, std::vector<CMove>& moves ) const;
+	// Adds the non-capture moves of a man or king standing on the bit from.
+	template <EPlayer player> void AddSimpleMoves( unsigned __int64 from, bool isKing, std::vector<CMove>& moves ) const;
+
+	// Helpers for the compare function.
+	int CompareBlack( const CDraughtsBoard& rhs ) const { return ( m_blackPieces == rhs.m_blackPieces ) ? 0 : ( m_blackPieces > rhs.m_blackPieces ) ? 1 : -1; }
+	int CompareRed( const CDraughtsBoard& rhs ) const { return ( m_redPieces == rhs.m_redPieces ) ? 0 : ( m_redPieces > rhs.m_redPieces ) ? 1 : -1; }
+	int CompareBlackKing( const CDraughtsBoard& rhs ) const { return ( m_blackKings == rhs.m_blackKings ) ? 0 : ( m_blackKings > rhs.m_blackKings ) ? 1 : -1; }
+	int CompareRedKing( const CDraughtsBoard& rhs ) const { return ( m_redKings == rhs.m_redKings ) ? 0 : ( m_redKings > rhs.m_redKings ) ? 1 : -1; }
+};
+
+//--------------------------------------------------------------------------------------
+inline unsigned __int64 CDraughtsBoard::PositionToBit( const SPosition& pos )
+{
+	static const unsigned __int64 one = 1;
+
+	if( pos.m_x >= Size || pos.m_y >= Size || !( ( pos.m_x + pos.m_y ) & 1 ) )
+		return 0;
+	// Five squares a row, x / 2 along it, and a ghost bit after every second row.
+	return one << ( pos.m_y * 5 + pos.m_x / 2 + pos.m_y / 2 );
+}
+
+//--------------------------------------------------------------------------------------
+inline int CDraughtsBoard::Compare( const CDraughtsBoard& rhs ) const
+{
+	int result = CompareBlack( rhs ); if( result ) return result;
+	result = CompareRed( rhs ); if( result ) return result;
+	result = CompareBlackKing( rhs ); if( result ) return result;
+	return CompareRedKing( rhs );
+}
@@ -0,0 +1,136 @@
+#pragma once
+
+#include "stdafx.h"
+
+#include "ComputerPlayer.h"
+#include "GameHistory.h"
+#include "PerfTimer.h"
+#include "Threading.h"
+
+#include <deque>
+#include <functional>
+#include <map>
+#include <vector>
+
+//--------------------------------------------------------------------------------------
+// Answer to a move request made to CEngineService.
+struct SServiceResult
+{
+	unsigned int m_session;
+	// False if the side to move had no move.
+	bool m_found;
+	CMove m_bestMove;
+	SSearchStats m_stats;
+	// Time from Submit until the search started, and until it finished.
+	unsigned __int64 m_queueUs;
+	unsigned __int64 m_totalUs;
+
+	SServiceResult() : m_session(0), m_found(false), m_queueUs(0), m_totalUs(0) {}
+};
+
+//--------------------------------------------------------------------------------------
+// Serves move requests for many games at once from a fixed pool of worker threads.
+// Games are sessions; each request is a position, the side to move and a time budget.
+// Waiting requests are taken round-robin across sessions so a busy game cannot starve the
+// others, and requests beyond the queue limits are refused rather than left to pile up.
+// All searches for a colour share one transposition table, so positions met by one game
+// help every other game.
+template <typename TGameBoard>
+class CEngineService
+{
+public:
+	typedef CComputerPlayer<TGameBoard> TPlayer;
+	// Called on a worker thread. It may submit the session's next request.
+	typedef std::function<void ( const SServiceResult& )> TCallback;
+
+	struct SConfig
+	{
+		// Worker threads, 0 uses every core.
+		unsigned int m_threads;
+		// Requests waiting across all sessions before Submit refuses more.
+		unsigned int m_maxQueued;
+		// Requests a single session may have waiting or running.
+		unsigned int m_maxPerSession;
+		// Entries in each of the shared tables.
+		unsigned int m_sharedCacheSize;
+		// Depth, weights and default time per move. The table size is not used; the table pages
+		// are those of the shared tables.
+		typename TPlayer::SConfig m_player;
+
+		SConfig() : m_threads(0), m_maxQueued(256), m_maxPerSession(1), m_sharedCacheSize(1 << 20) {}
+	};
+
+	enum ESubmitResult
+	{
+		SubmitResult_Accepted,
+		// Admission control turned the request away; try again later.
+		SubmitResult_QueueFull,
+		SubmitResult_SessionBusy,
+		SubmitResult_UnknownSession,
+
+		SubmitResultCount
+	};
+
+	CEngineService( const SConfig& config );
+	// Lets running searches finish and drops waiting requests without calling back.
+	~CEngineService();
+
+	unsigned int OpenSession();
+	// Drops the session's waiting requests. A request already running still calls back.
+	void CloseSession( unsigned int session );
+
+	// Queues a search for side on board. A budget of 0 uses the configured time limit.
+	ESubmitResult Submit( unsigned int session, const TGameBoard& board, EPlayer side, const CGameHistory& history, unsigned int budgetMs, const TCallback& callback );
+
+	// Blocks until no request is waiting or running.
+	void WaitIdle();
+
+	unsigned int GetThreadCount() const { return (unsigned int)m_threads.size(); }
+
+private:
+	struct SRequest
+	{
+		unsigned int m_session;
+		TGameBoard m_board;
+		EPlayer m_side;
+		CGameHistory m_history;
+		unsigned int m_budgetMs;
+		TCallback m_callback;
+		CStopwatch m_submitted;
+	};
+
+	struct SSession
+	{
+		std::deque<SRequest> m_requests;
+		unsigned int m_running;
+		// In m_ready, waiting for a worker.
+		bool m_scheduled;
+		bool m_closed;
+
+		SSession() : m_running(0), m_scheduled(false), m_closed(false) {}
+	};
+	typedef std::map<unsigned int, SSession> TSessionMap;
+
+	const SConfig m_config;
+	// One table per colour since scores are from the searching player's point of view.
+	typename TPlayer::TSharedTable* m_pTables[PlayerCount];
+	std::vector<CThread*> m_threads;
+
+	CCriticalSection m_lock;
+	CConditionVariable m_wake;
+	CConditionVariable m_idle;
+	TSessionMap m_sessions;
+	// Sessions with waiting requests in the order they get a worker.
+	std::deque<unsigned int> m_ready;
+	unsigned int m_nextSession;
+	unsigned int m_queued;
+	unsigned int m_running;
+	bool m_quit;
+
+	void WorkerLoop();
+	// Takes the next request round-robin. Called with m_lock held and m_ready not empty.
+	void PopRequest( SRequest& request );
+
+	CEngineService( const CEngineService& );
+	CEngineService& operator=( const CEngineService& );
+};
@@ -0,0 +1,203 @@
+#pragma once
+
+#include "StdAfx.h"
+#include "EngineService.h"
+#include "ComputerPlayer.inl"
+
+#include <algorithm>
+
+//--------------------------------------------------------------------------------------
+template <typename TGameBoard>
+CEngineService<TGameBoard>::CEngineService( const SConfig& config )
+	: m_config( config )
+	, m_nextSession( 1 )
+	, m_queued( 0 )
+	, m_running( 0 )
+	, m_quit( false )
+{
+	for( unsigned int i = 0; i < PlayerCount; ++i )
+		m_pTables[i] = ( i == Player_None ) ? NULL : new typename TPlayer::TSharedTable( config.m_sharedCacheSize, TPlayer::TSharedTable::DefaultShardCount, config.m_player.m_tablePages );
+
+	unsigned int threadCount = config.m_threads ? config.m_threads : CThread::GetHardwareThreadCount();
+	m_threads.resize( threadCount ? threadCount : 1 );
+	for( size_t i = 0; i < m_threads.size(); ++i )
+	{
+		m_threads[i] = new CThread;
+		m_threads[i]->Start( [this]() { WorkerLoop(); } );
+	}
+}
+
+//--------------------------------------------------------------------------------------
+template <typename TGameBoard>
+CEngineService<TGameBoard>::~CEngineService()
+{
+	{
+		CScopedLock<CCriticalSection> lock( m_lock );
+		m_quit = true;
+		m_wake.NotifyAll();
+	}
+	for( size_t i = 0; i < m_threads.size(); ++i )
+	{
+		m_threads[i]->Join();
+		delete m_threads[i];
+	}
+	for( unsigned int i = 0; i < PlayerCount; ++i )
+		delete m_pTables[i];
+}
+
+//--------------------------------------------------------------------------------------
+template <typename TGameBoard>
+unsigned int CEngineService<TGameBoard>::OpenSession()
+{
+	CScopedLock<CCriticalSection> lock( m_lock );
+	unsigned int session = m_nextSession++;
+	m_sessions[ session ];
+	return session;
+}
+
+//--------------------------------------------------------------------------------------
+template <typename TGameBoard>
+void CEngineService<TGameBoard>::CloseSession( unsigned int session )
+{
+	CScopedLock<CCriticalSection> lock( m_lock );
+	typename TSessionMap::iterator it = m_sessions.find( session );
+	if( it == m_sessions.end() )
+		return;
+
+	m_queued -= (unsigned int)it->second.m_requests.size();
+	if( it->second.m_scheduled )
+		m_ready.erase( std::remove( m_ready.begin(), m_ready.end(), session ), m_ready.end() );
+
+	// A running request still refers to the session; the worker erases it when done.
+	if( it->second.m_running )
+	{
+		it->second.m_requests.clear();
+		it->second.m_scheduled = false;
+		it->second.m_closed = true;
+	}
+	else
+	{
+		m_sessions.erase( it );
+	}
+
+	if( m_queued == 0 && m_running == 0 )
+		m_idle.NotifyAll();
+}
+
+//--------------------------------------------------------------------------------------
+template <typename TGameBoard>
+typename CEngineService<TGameBoard>::ESubmitResult CEngineService<TGameBoard>::Submit( unsigned int session, const TGameBoard& board, EPlayer side, const CGameHistory& history, unsigned int budgetMs, const TCallback& callback )
+{
+	CScopedLock<CCriticalSection> lock( m_lock );
+	typename TSessionMap::iterator it = m_sessions.find( session );
+	if( it == m_sessions.end() || it->second.m_closed )
+		return SubmitResult_UnknownSession;
+
+	SSession& state = it->second;
+	if( state.m_requests.size() + state.m_running >= m_config.m_maxPerSession )
+		return SubmitResult_SessionBusy;
+	if( m_queued >= m_config.m_maxQueued )
+		return SubmitResult_QueueFull;
+
+	state.m_requests.push_back( SRequest() );
+	SRequest& request = state.m_requests.back();
+	request.m_session = session;
+	request.m_board = board;
+	request.m_side = side;
+	request.m_history = history;
+	request.m_budgetMs = budgetMs;
+	request.m_callback = callback;
+	request.m_submitted.Restart();
+	m_queued++;
+
+	if( !state.m_scheduled )
+	{
+		state.m_scheduled = true;
+		m_ready.push_back( session );
+		m_wake.NotifyOne();
+	}
+	return SubmitResult_Accepted;
+}
+
+//--------------------------------------------------------------------------------------
+template <typename TGameBoard>
+void CEngineService<TGameBoard>::WaitIdle()
+{
+	CScopedLock<CCriticalSection> lock( m_lock );
+	while( m_queued || m_running )
+		m_idle.Wait( m_lock );
+}
+
+//--------------------------------------------------------------------------------------
+template <typename TGameBoard>
+void CEngineService<TGameBoard>::PopRequest( SRequest& request )
+{
+	unsigned int session = m_ready.front();
+	m_ready.pop_front();
+
+	SSession& state = m_sessions[ session ];
+	request = state.m_requests.front();
+	state.m_requests.pop_front();
+	state.m_running++;
+	m_queued--;
+	m_running++;
+
+	// One request per turn; a session with more waiting goes to the back of the line, where
+	// an idle worker can take it while this one runs.
+	if( state.m_requests.empty() )
+		state.m_scheduled = false;
+	else
+	{
+		m_ready.push_back( session );
+		m_wake.NotifyOne();
+	}
+}
+
+//--------------------------------------------------------------------------------------
+template <typename TGameBoard>
+void CEngineService<TGameBoard>::WorkerLoop()
+{
+	for( ;; )
+	{
+		SRequest request;
+		{
+			CScopedLock<CCriticalSection> lock( m_lock );
+			while( m_ready.empty() && !m_quit )
+				m_wake.Wait( m_lock );
+			if( m_quit )
+				return;
+			PopRequest( request );
+		}
+
+		SServiceResult result;
+		result.m_session = request.m_session;
+		result.m_queueUs = request.m_submitted.GetElapsedUs();
+
+		// Players are cheap without a table of their own, so every request gets a fresh one.
+		typename TPlayer::SConfig playerConfig( m_config.m_player );
+		if( request.m_budgetMs )
+			playerConfig.m_timeLimitMs = request.m_budgetMs;
+		TPlayer player( request.m_side, playerConfig, m_pTables[ request.m_side ] );
+		result.m_found = player.FindBestMove( request.m_board, result.m_bestMove, &request.m_history );
+		result.m_stats = player.GetLastSearchStats();
+		result.m_totalUs = request.m_submitted.GetElapsedUs();
+
+		// Release the session first so the callback can submit its next move.
+		{
+			CScopedLock<CCriticalSection> lock( m_lock );
+			typename TSessionMap::iterator it = m_sessions.find( request.m_session );
+			if( it != m_sessions.end() && --it->second.m_running == 0 && it->second.m_closed )
+				m_sessions.erase( it );
+		}
+
+		if( request.m_callback )
+			request.m_callback( result );
+
+		{
+			CScopedLock<CCriticalSection> lock( m_lock );
+			m_running--;
+			if( m_queued == 0 && m_running == 0 )
+				m_idle.NotifyAll();
+		}
+	}
+}
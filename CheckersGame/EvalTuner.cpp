@@ -0,0 +1,376 @@
+#include "StdAfx.h"
+#include "EvalTuner.h"
+
+#include "Threading.h"
+
+#include <map>
+#include <math.h>
+
+//--------------------------------------------------------------------------------------
+// A fixed set of threads that run each ParallelFor handed to them and wait for the next.  The
+// calling thread takes the first range itself.
+class CEvalTuner::CWorkers
+{
+public:
+	CWorkers( unsigned int threads );
+	~CWorkers();
+
+	void Run( size_t count, const TRangeFunc& func );
+
+private:
+	const unsigned int m_threadCount;
+	std::vector<CThread*> m_threads;
+	CCriticalSection m_lock;
+	CConditionVariable m_start;
+	CConditionVariable m_done;
+	// The work of the current round, which starts whenever m_round changes.
+	const TRangeFunc* m_pFunc;
+	size_t m_count;
+	unsigned int m_round;
+	unsigned int m_pending;
+	bool m_quit;
+
+	void WorkerLoop( unsigned int thread );
+
+	CWorkers( const CWorkers& );
+	CWorkers& operator=( const CWorkers& );
+};
+
+//--------------------------------------------------------------------------------------
+CEvalTuner::CWorkers::CWorkers( unsigned int threads )
+	: m_threadCount( threads ? threads : 1 )
+	, m_pFunc( NULL )
+	, m_count( 0 )
+	, m_round( 0 )
+	, m_pending( 0 )
+	, m_quit( false )
+{
+	for( unsigned int t = 1; t < m_threadCount; ++t )
+	{
+		m_threads.push_back( new CThread );
+		m_threads.back()->Start( [this, t]() { WorkerLoop( t ); } );
+	}
+}
+
+//--------------------------------------------------------------------------------------
+CEvalTuner::CWorkers::~CWorkers()
+{
+	{
+		CScopedLock<CCriticalSection> lock( m_lock );
+		m_quit = true;
+		m_start.NotifyAll();
+	}
+	for( size_t t = 0; t < m_threads.size(); ++t )
+	{
+		m_threads[t]->Join();
+		delete m_threads[t];
+	}
+}
+
+//--------------------------------------------------------------------------------------
+void CEvalTuner::CWorkers::Run( size_t count, const TRangeFunc& func )
+{
+	{
+		CScopedLock<CCriticalSection> lock( m_lock );
+		m_pFunc = &func;
+		m_count = count;
+		m_pending = m_threadCount - 1;
+		m_round++;
+		m_start.NotifyAll();
+	}
+
+	func( 0, 0, count / m_threadCount );
+
+	CScopedLock<CCriticalSection> lock( m_lock );
+	while( m_pending )
+		m_done.Wait( m_lock );
+	m_pFunc = NULL;
+}
+
+//--------------------------------------------------------------------------------------
+void CEvalTuner::CWorkers::WorkerLoop( unsigned int thread )
+{
+	unsigned int round = 0;
+	for( ;; )
+	{
+		const TRangeFunc* pFunc = NULL;
+		size_t count = 0;
+		{
+			CScopedLock<CCriticalSection> lock( m_lock );
+			while( m_round == round && !m_quit )
+				m_start.Wait( m_lock );
+			if( m_quit )
+				return;
+			round = m_round;
+			pFunc = m_pFunc;
+			count = m_count;
+		}
+
+		( *pFunc )( thread, count * thread / m_threadCount, count * ( thread + 1 ) / m_threadCount );
+
+		CScopedLock<CCriticalSection> lock( m_lock );
+		if( --m_pending == 0 )
+			m_done.NotifyOne();
+	}
+}
+
+//--------------------------------------------------------------------------------------
+CEvalTuner::CEvalTuner( const SConfig& config )
+	: m_config( config )
+	, m_threads( config.m_threads ? config.m_threads : CThread::GetHardwareThreadCount() )
+	, m_scale( 0.005 )
+	, m_pWorkers( NULL )
+{
+}
+
+//--------------------------------------------------------------------------------------
+size_t CEvalTuner::Load( const CPositionDb& db )
+{
+	// Blocks finish in any order; keep them by index so the samples, and with them the sums
+	// of every later pass, come out the same on every run.
+	typedef std::map< unsigned __int64, std::vector<SSample> > TBlocks;
+	TBlocks blocks;
+	CCriticalSection blocksLock;
+
+	db.ParallelScan( [&]( const SPositionRecord* pRecords, size_t count, unsigned __int64 firstIndex ) {
+		std::vector<SSample> samples;
+		samples.reserve( count );
+
+		CCheckersBoard board;
+		std::vector<CMove> moves;
+		int features[SEvalWeights::FeatureCount];
+		for( size_t i = 0; i < count; ++i )
+		{
+			const SPositionRecord& record = pRecords[i];
+			if( record.m_result == SPositionRecord::Result_Unknown )
+				continue;
+			// Won positions are scored by the search, not the weights.
+			if( !record.m_red || !record.m_black )
+				continue;
+
+			record.ToBoard( board );
+			if( m_config.m_quietOnly )
+			{
+				// Jumps are forced, so the moves are all captures or none are.
+				moves.clear();
+				board.GetMoves( record.GetPlayerToMove(), moves );
+				if( !moves.empty() && CCheckersBoard::IsCapture( moves[0] ) )
+					continue;
+			}
+
+			SSample sample;
+			board.GetEvalFeatures( features );
+			for( int f = 0; f < SEvalWeights::FeatureCount; ++f )
+				sample.m_features[f] = (signed char)features[f];
+			sample.m_result = ( record.m_result == SPositionRecord::Result_RedWin ) ? 1.0f : ( record.m_result == SPositionRecord::Result_Draw ) ? 0.5f : 0.0f;
+			samples.push_back( sample );
+		}
+
+		CScopedLock<CCriticalSection> lock( blocksLock );
+		blocks[firstIndex].swap( samples );
+	}, m_threads );
+
+	m_samples.clear();
+	size_t total = 0;
+	for( TBlocks::const_iterator it = blocks.begin(); it != blocks.end(); ++it )
+		total += it->second.size();
+	m_samples.reserve( total );
+	for( TBlocks::const_iterator it = blocks.begin(); it != blocks.end(); ++it )
+		m_samples.insert( m_samples.end(), it->second.begin(), it->second.end() );
+	return m_samples.size();
+}
+
+//--------------------------------------------------------------------------------------
+double CEvalTuner::FitScale( const SEvalWeights& weights )
+{
+	double values[SEvalWeights::FeatureCount];
+	for( int i = 0; i < SEvalWeights::FeatureCount; ++i )
+		values[i] = weights.m_values[i];
+
+	CWorkers workers( m_threads );
+	m_pWorkers = &workers;
+
+	// Golden section search over log10( scale ); the error has a single minimum in scale.
+	const double ratio = 0.6180339887498949;
+	double low = -5.0;
+	double high = -1.0;
+	double a = high - ratio * ( high - low );
+	double b = low + ratio * ( high - low );
+	m_scale = pow( 10.0, a );
+	double errorA = Evaluate( values, NULL );
+	m_scale = pow( 10.0, b );
+	double errorB = Evaluate( values, NULL );
+	for( int i = 0; i < 40; ++i )
+	{
+		if( errorA < errorB )
+		{
+			high = b;
+			b = a;
+			errorB = errorA;
+			a = high - ratio * ( high - low );
+			m_scale = pow( 10.0, a );
+			errorA = Evaluate( values, NULL );
+		}
+		else
+		{
+			low = a;
+			a = b;
+			errorA = errorB;
+			b = low + ratio * ( high - low );
+			m_scale = pow( 10.0, b );
+			errorB = Evaluate( values, NULL );
+		}
+	}
+
+	m_pWorkers = NULL;
+	m_scale = pow( 10.0, ( low + high ) / 2.0 );
+	return m_scale;
+}
+
+//--------------------------------------------------------------------------------------
+double CEvalTuner::GetError( const SEvalWeights& weights )
+{
+	double values[SEvalWeights::FeatureCount];
+	for( int i = 0; i < SEvalWeights::FeatureCount; ++i )
+		values[i] = weights.m_values[i];
+	return Evaluate( values, NULL );
+}
+
+//--------------------------------------------------------------------------------------
+SEvalWeights CEvalTuner::Tune( const SEvalWeights& start, std::ostream& os )
+{
+	const int count = SEvalWeights::FeatureCount;
+	double weights[count];
+	double best[count];
+	double gradient[count];
+	// Adam moment estimates: each weight gets a step of about the learning rate however
+	// large its feature's counts, so one rate suits every feature.
+	double mean[count];
+	double variance[count];
+	for( int i = 0; i < count; ++i )
+	{
+		weights[i] = best[i] = start.m_values[i];
+		mean[i] = variance[i] = 0.0;
+	}
+
+	const double beta1 = 0.9;
+	const double beta2 = 0.999;
+	double beta1Power = 1.0;
+	double beta2Power = 1.0;
+	CWorkers workers( m_threads );
+	m_pWorkers = &workers;
+	double bestError = Evaluate( weights, NULL );
+	for( unsigned int iteration = 1; iteration <= m_config.m_iterations; ++iteration )
+	{
+		double error = Evaluate( weights, gradient );
+		if( error < bestError )
+		{
+			bestError = error;
+			memcpy( best, weights, sizeof( best ) );
+		}
+
+		if( m_config.m_reportInterval && iteration % m_config.m_reportInterval == 0 )
+			os << "iteration=" << iteration << " error=" << error << std::endl;
+
+		beta1Power *= beta1;
+		beta2Power *= beta2;
+		for( int i = 0; i < count; ++i )
+		{
+			if( i == SEvalWeights::Feature_Man )
+				continue;
+
+			mean[i] = beta1 * mean[i] + ( 1.0 - beta1 ) * gradient[i];
+			variance[i] = beta2 * variance[i] + ( 1.0 - beta2 ) * gradient[i] * gradient[i];
+			double step = ( mean[i] / ( 1.0 - beta1Power ) ) / ( sqrt( variance[i] / ( 1.0 - beta2Power ) ) + 1e-12 );
+			weights[i] -= m_config.m_learningRate * step;
+		}
+	}
+
+	double error = Evaluate( weights, NULL );
+	if( error < bestError )
+		memcpy( best, weights, sizeof( best ) );
+	m_pWorkers = NULL;
+
+	SEvalWeights result;
+	for( int i = 0; i < count; ++i )
+		result.m_values[i] = (int)floor( best[i] + 0.5 );
+	return result;
+}
+
+//--------------------------------------------------------------------------------------
+double CEvalTuner::Evaluate( const double weights[SEvalWeights::FeatureCount], double* pGradient ) const
+{
+	const int count = SEvalWeights::FeatureCount;
+	if( m_samples.empty() )
+	{
+		if( pGradient )
+			memset( pGradient, 0, sizeof( double ) * count );
+		return 0.0;
+	}
+
+	// Each thread sums its own range; the partial sums are added in thread order so the
+	// result does not depend on timing.
+	std::vector<double> errors( m_threads, 0.0 );
+	std::vector<double> gradients( m_threads * count, 0.0 );
+	const double scale = m_scale;
+	ParallelFor( m_samples.size(), [&]( unsigned int thread, size_t begin, size_t end ) {
+		double error = 0.0;
+		double gradient[SEvalWeights::FeatureCount] = { 0.0 };
+		for( size_t s = begin; s < end; ++s )
+		{
+			const SSample& sample = m_samples[s];
+			double score = 0.0;
+			for( int i = 0; i < count; ++i )
+				score += weights[i] * sample.m_features[i];
+
+			double predicted = 1.0 / ( 1.0 + exp( -scale * score ) );
+			double difference = sample.m_result - predicted;
+			error += difference * difference;
+			if( pGradient )
+			{
+				// d( difference^2 ) / d( weight ) through the sigmoid.
+				double slope = -2.0 * difference * predicted * ( 1.0 - predicted ) * scale;
+				for( int i = 0; i < count; ++i )
+					gradient[i] += slope * sample.m_features[i];
+			}
+		}
+
+		errors[thread] = error;
+		for( int i = 0; i < count; ++i )
+			gradients[thread * count + i] = gradient[i];
+	} );
+
+	double error = 0.0;
+	if( pGradient )
+		memset( pGradient, 0, sizeof( double ) * count );
+	for( unsigned int t = 0; t < m_threads; ++t )
+	{
+		error += errors[t];
+		if( pGradient )
+		{
+			for( int i = 0; i < count; ++i )
+				pGradient[i] += gradients[t * count + i];
+		}
+	}
+
+	const double samples = (double)m_samples.size();
+	if( pGradient )
+	{
+		for( int i = 0; i < count; ++i )
+			pGradient[i] /= samples;
+	}
+	return error / samples;
+}
+
+//--------------------------------------------------------------------------------------
+void CEvalTuner::ParallelFor( size_t count, const TRangeFunc& func ) const
+{
+	if( m_pWorkers )
+	{
+		m_pWorkers->Run( count, func );
+		return;
+	}
+
+	CWorkers workers( m_threads );
+	workers.Run( count, func );
+}
@@ -0,0 +1,79 @@
+#pragma once
+
+#include "stdafx.h"
+
+#include "CheckersBoard.h"
+#include "PositionDb.h"
+
+#include <functional>
+#include <iostream>
+#include <vector>
+
+//--------------------------------------------------------------------------------------
+// Fits the evaluation weights to game results (Texel tuning).  The win probability of a
+// position is predicted as 1 / ( 1 + exp( -scale * score ) ) with score the red point of view
+// evaluation, and the weights are moved to minimize the mean squared difference between
+// prediction and result.  The man weight stays fixed to keep the score scale.
+class CEvalTuner
+{
+public:
+	struct SConfig
+	{
+		// 0 uses every core.
+		unsigned int m_threads;
+		unsigned int m_iterations;
+		// Largest change of a weight per iteration, in score units.
+		double m_learningRate;
+		// Skips positions where the side to move has a capture; their score is not settled.
+		bool m_quietOnly;
+		// Iterations between progress lines, 0 for none.
+		unsigned int m_reportInterval;
+
+		SConfig() : m_threads(0), m_iterations(500), m_learningRate(1.0), m_quietOnly(true), m_reportInterval(50) {}
+	};
+
+	CEvalTuner( const SConfig& config );
+
+	// Extracts the features of every position with a known result. Returns how many are kept.
+	size_t Load( const CPositionDb& db );
+	size_t GetSampleCount() const { return m_samples.size(); }
+
+	// Finds the scale that best predicts the results from the given weights.
+	double FitScale( const SEvalWeights& weights );
+	double GetScale() const { return m_scale; }
+
+	// Mean squared prediction error of the weights at the current scale.
+	double GetError( const SEvalWeights& weights );
+
+	// Runs gradient descent from the given weights and returns the best found, writing
+	// key=value progress lines to os.
+	SEvalWeights Tune( const SEvalWeights& start, std::ostream& os );
+
+private:
+	// The features of a position as the evaluation counts them, all of which fit a byte.
+	struct SSample
+	{
+		signed char m_features[SEvalWeights::FeatureCount];
+		// 1 for a red win, 0.5 for a draw and 0 for a black win.
+		float m_result;
+	};
+
+	typedef std::function<void ( unsigned int thread, size_t begin, size_t end )> TRangeFunc;
+
+	// Threads kept for a whole FitScale or Tune, which each evaluate the samples many times.
+	class CWorkers;
+
+	const SConfig m_config;
+	unsigned int m_threads;
+	std::vector<SSample> m_samples;
+	double m_scale;
+	// The workers of the run in progress, NULL outside one.
+	CWorkers* m_pWorkers;
+
+	// The batch evaluation path: scores every sample with the weights and sums the error, and
+	// the gradient of the error if pGradient is given, on every thread.
+	double Evaluate( const double weights[SEvalWeights::FeatureCount], double* pGradient ) const;
+	// Splits [0, count) into one contiguous range per thread and waits for them all.  Uses the
+	// workers of the run in progress, or threads of its own outside one.
+	void ParallelFor( size_t count, const TRangeFunc& func ) const;
+};
@@ -0,0 +1,85 @@
+#pragma once
+
+#include <vector>
+
+//--------------------------------------------------------------------------------------
+// Hash keys of the positions reached so far in a game, used to detect draws.
+// A position can only repeat while every move since it was reversible (a king moving
+// without a capture), so each entry also counts the reversible plies that led to it.
+class CGameHistory
+{
+public:
+	enum { DefaultNoProgressMoves = 40 };
+
+	// noProgressMoves is the number of moves per player without a capture or a man moving
+	// after which the game is drawn. Zero disables the rule.
+	CGameHistory( unsigned int noProgressMoves = DefaultNoProgressMoves ) : m_noProgressPlies( noProgressMoves * 2 ) {}
+
+	void Clear() { m_entries.clear(); }
+	size_t GetSize() const { return m_entries.size(); }
+	bool IsEmpty() const { return m_entries.empty(); }
+
+	// Records the position reached by a move.
+	void Push( unsigned __int64 key, bool reversible )
+	{
+		unsigned int reversibleCount = ( reversible && !m_entries.empty() ) ? m_entries.back().m_reversibleCount + 1 : 0;
+		m_entries.push_back( SEntry( key, reversibleCount ) );
+	}
+	void Pop() { m_entries.pop_back(); }
+
+	// Returns true if the current position has now occurred at least 'count' times with the
+	// same player to move.
+	bool IsRepetition( unsigned int count = 2 ) const
+	{
+		if( m_entries.size() < 5 || count < 2 )
+			return false;
+
+		const SEntry& current = m_entries.back();
+		size_t last = m_entries.size() - 1;
+		unsigned int found = 1;
+		// Same player to move every second ply; a cycle needs at least four plies.
+		for( size_t back = 4; back <= current.m_reversibleCount && back <= last; back += 2 )
+		{
+			if( m_entries[ last - back ].m_key == current.m_key && ++found >= count )
+				return true;
+		}
+		return false;
+	}
+
+	// Returns true if the no-progress limit has been reached.
+	bool IsNoProgressDraw() const
+	{
+		return m_noProgressPlies && !m_entries.empty() && m_entries.back().m_reversibleCount >= m_noProgressPlies;
+	}
+
+	// Reversible plies that led to the current position, counting towards the no-progress rule.
+	unsigned int GetReversibleCount() const { return m_entries.empty() ? 0 : m_entries.back().m_reversibleCount; }
+
+	bool IsDraw( unsigned int repetitionCount = 2 ) const { return IsNoProgressDraw() || IsRepetition( repetitionCount ); }
+
+	//--------------------------------------------------------------------------------------
+	// Pushes a position for the lifetime of the object, for walking down a search tree.
+	class CScopedPush
+	{
+	public:
+		CScopedPush( CGameHistory& history, unsigned __int64 key, bool reversible ) : m_history(history) { m_history.Push( key, reversible ); }
+		~CScopedPush() { m_history.Pop(); }
+	private:
+		CGameHistory& m_history;
+
+		CScopedPush( const CScopedPush& );
+		CScopedPush& operator=( const CScopedPush& );
+	};
+
+private:
+	struct SEntry
+	{
+		unsigned __int64 m_key;
+		unsigned int m_reversibleCount;
+
+		SEntry( unsigned __int64 key, unsigned int reversibleCount ) : m_key(key), m_reversibleCount(reversibleCount) {}
+	};
+
+	std::vector<SEntry> m_entries;
+	unsigned int m_noProgressPlies;
+};
@@ -0,0 +1,96 @@
+#include "StdAfx.h"
+#include "HardwareCounters.h"
+
+#include <windows.h>
+
+//--------------------------------------------------------------------------------------
+void SHardwareCounts::Clear()
+{
+	for( int i = 0; i < HardwareCounterCount; ++i )
+	{
+		m_values[i] = 0;
+		m_valid[i] = false;
+	}
+}
+
+//--------------------------------------------------------------------------------------
+bool SHardwareCounts::IsValid() const
+{
+	for( int i = 0; i < HardwareCounterCount; ++i )
+	{
+		if( m_valid[i] )
+			return true;
+	}
+	return false;
+}
+
+//--------------------------------------------------------------------------------------
+SHardwareCounts& SHardwareCounts::operator += ( const SHardwareCounts& rhs )
+{
+	for( int i = 0; i < HardwareCounterCount; ++i )
+	{
+		m_values[i] += rhs.m_values[i];
+		m_valid[i] |= rhs.m_valid[i];
+	}
+	return *this;
+}
+
+//--------------------------------------------------------------------------------------
+void SHardwareCounts::PrintPerNode( std::ostream& os, unsigned __int64 nodes ) const
+{
+	if( !nodes )
+		return;
+
+	for( int i = 0; i < HardwareCounterCount; ++i )
+	{
+		if( m_valid[i] )
+			os << " " << CHardwareCounters::GetCounterName( (EHardwareCounter)i ) << "PerNode=" << (double)m_values[i] / (double)nodes;
+	}
+}
+
+//--------------------------------------------------------------------------------------
+const char* CHardwareCounters::GetCounterName( EHardwareCounter counter )
+{
+	static const char* s_names[HardwareCounterCount] = { "cycles", "instructions", "l1dMisses", "llcMisses", "branchMisses" };
+	return ( counter < HardwareCounterCount ) ? s_names[counter] : "unknown";
+}
+
+//--------------------------------------------------------------------------------------
+CHardwareCounters::CHardwareCounters()
+	: m_available( false )
+	, m_startCycles( 0 )
+{
+	ULONG64 cycles = 0;
+	m_available = QueryThreadCycleTime( GetCurrentThread(), &cycles ) != FALSE;
+}
+
+//--------------------------------------------------------------------------------------
+CHardwareCounters::~CHardwareCounters()
+{
+}
+
+//--------------------------------------------------------------------------------------
+void CHardwareCounters::Start()
+{
+	ULONG64 cycles = 0;
+	if( m_available && QueryThreadCycleTime( GetCurrentThread(), &cycles ) )
+		m_startCycles = cycles;
+}
+
+//--------------------------------------------------------------------------------------
+void CHardwareCounters::Stop( SHardwareCounts& counts )
+{
+	counts.Clear();
+	ULONG64 cycles = 0;
+	if( m_available && QueryThreadCycleTime( GetCurrentThread(), &cycles ) )
+	{
+		counts.m_values[HardwareCounter_Cycles] = cycles - m_startCycles;
+		counts.m_valid[HardwareCounter_Cycles] = true;
+	}
+}
+
+//--------------------------------------------------------------------------------------
+bool CHardwareCounters::IsAvailable() const
+{
+	return m_available;
+}
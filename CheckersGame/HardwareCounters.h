@@ -0,0 +1,67 @@
+#pragma once
+
+#include "stdafx.h"
+
+#include <iostream>
+
+//--------------------------------------------------------------------------------------
+// CPU events counted by CHardwareCounters.
+enum EHardwareCounter
+{
+	HardwareCounter_Cycles,
+	HardwareCounter_Instructions,
+	HardwareCounter_L1DMisses,
+	HardwareCounter_LLCMisses,
+	HardwareCounter_BranchMisses,
+
+	HardwareCounterCount
+};
+
+//--------------------------------------------------------------------------------------
+// Event counts over one measured stretch.  Counters the machine or OS would not open are
+// marked invalid rather than reported as zero.
+struct SHardwareCounts
+{
+	unsigned __int64 m_values[HardwareCounterCount];
+	bool m_valid[HardwareCounterCount];
+
+	SHardwareCounts() { Clear(); }
+
+	void Clear();
+	bool IsValid() const;
+	SHardwareCounts& operator += ( const SHardwareCounts& rhs );
+
+	// Writes " <name>PerNode=<value>" for every valid counter, or nothing without nodes.
+	void PrintPerNode( std::ostream& os, unsigned __int64 nodes ) const;
+};
+
+//--------------------------------------------------------------------------------------
+// Hardware performance counters of the calling thread.  Windows gives unprivileged processes
+// only the thread's cycles, through QueryThreadCycleTime, which counts kernel time too; the
+// other events need a kernel driver or administrator tracing.  Counters that cannot be read
+// come back invalid, so callers need no checks.  The counters follow the thread that
+// constructed the object, so use it on that thread only.
+class CHardwareCounters
+{
+public:
+	CHardwareCounters();
+	~CHardwareCounters();
+
+	// True if at least one counter can be read.
+	bool IsAvailable() const;
+
+	// Zeroes and starts the counters.
+	void Start();
+	// Stops the counters and reads the counts since Start.
+	void Stop( SHardwareCounts& counts );
+
+	static const char* GetCounterName( EHardwareCounter counter );
+
+private:
+	bool m_available;
+	// The thread's cycle count at Start.
+	unsigned __int64 m_startCycles;
+
+	CHardwareCounters( const CHardwareCounters& );
+	CHardwareCounters& operator = ( const CHardwareCounters& );
+};
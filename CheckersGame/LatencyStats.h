@@ -0,0 +1,54 @@
+#pragma once
+
+#include <algorithm>
+#include <vector>
+
+//--------------------------------------------------------------------------------------
+// Collects latency samples in microseconds and reports mean and percentiles.
+// Not thread safe; keep one per thread and Merge them at the end.
+class CLatencyStats
+{
+public:
+	CLatencyStats() : m_total(0), m_sorted(true) {}
+
+	void Add( unsigned __int64 us )
+	{
+		m_samples.push_back( us );
+		m_total += us;
+		m_sorted = false;
+	}
+	void Merge( const CLatencyStats& other )
+	{
+		m_samples.insert( m_samples.end(), other.m_samples.begin(), other.m_samples.end() );
+		m_total += other.m_total;
+		m_sorted = false;
+	}
+
+	size_t GetCount() const { return m_samples.size(); }
+	unsigned __int64 GetTotal() const { return m_total; }
+	double GetMean() const { return m_samples.empty() ? 0.0 : (double)m_total / m_samples.size(); }
+
+	// Nearest-rank percentile, percent in [0,100].
+	unsigned __int64 GetPercentile( double percent )
+	{
+		if( m_samples.empty() )
+			return 0;
+		if( !m_sorted )
+		{
+			std::sort( m_samples.begin(), m_samples.end() );
+			m_sorted = true;
+		}
+		size_t rank = (size_t)( percent / 100.0 * m_samples.size() + 0.5 );
+		if( rank > 0 )
+			rank--;
+		if( rank >= m_samples.size() )
+			rank = m_samples.size() - 1;
+		return m_samples[rank];
+	}
+	unsigned __int64 GetMax() { return GetPercentile( 100.0 ); }
+
+private:
+	std::vector<unsigned __int64> m_samples;
+	unsigned __int64 m_total;
+	bool m_sorted;
+};
@@ -1,156 +1,444 @@
 #pragma once
 
-#include <queue>
-#include <hash_map>
+#include "PageMemory.h"
+#include "TraceRecorder.h"
+
+#include <assert.h>
+#include <new>
+#include <utility>
+#include <xhash>
+#include <xmmintrin.h>
 
 //--------------------------------------------------------------------------------------
-template <typename TKey, typename TValue>
+// A cache with a maximum size which forgets the least recently used entry first.
+// All nodes live in a single arena sized to the cache size. Released nodes are kept on
+// an intrusive free list and are found through an open-addressing index into the arena,
+// so nothing is allocated after construction.  The arena and index share one block, which
+// large caches take from CPageMemory so it can have huge pages and a NUMA placement.
+template <typename TKey, typename TValue, typename THash = stdext::hash_compare<TKey> >
 class CLearningCache
 {
 public:
 	typedef std::pair<TKey, TValue> TDataPair;
 
-	CLearningCache(unsigned int cacheSize) : m_cacheSize(cacheSize), m_head(NULL), m_tail(NULL) {}
+	CLearningCache(unsigned int cacheSize, const SPageConfig& pages = SPageConfig());
+	// Uses memory of GetMemorySize( cacheSize ) bytes owned by the caller, for caches that
+	// share one block.
+	CLearningCache(unsigned int cacheSize, void* pMemory);
 	virtual ~CLearningCache();
 
+	static size_t GetMemorySize( unsigned int cacheSize );
+	// The largest cache whose block and index sizes cannot wrap; larger sizes are cut to it.
+	static unsigned int GetMaxCacheSize();
+
 	void Clear();
 
 	TValue* Get( const TKey& key );
+	// The same given the hash GetKeyHash returns for the key, for callers that already have it.
+	TValue* Get( const TKey& key, size_t keyHash );
 	void UpdateCache( const TKey& key, const TValue& newValue );
+	bool Remove( const TKey& key );
+
+	// Number of entries currently held.
+	unsigned int GetSize() const { return m_size; }
+	// Maximum number of entries that can be held.
+	unsigned int GetCacheSize() const { return m_cacheSize; }
+	// The memory the cache allocated itself, if any.
+	const CPageMemory& GetMemory() const { return m_memory; }
+
+	// A lookup first reads the index slot the key hashes to, then the entry the slot names,
+	// and in a large cache each read misses the cache.  PrefetchSlot starts loading the slot of
+	// a key from the hash its hasher gives, with GetKeyHash; PrefetchEntry reads the slot and
+	// starts loading its entry, so it should follow PrefetchSlot by a while.  Neither changes
+	// the cache, and both are safe to call for keys that are not in it.
+	size_t GetKeyHash( const TKey& key ) const { return m_hasher( key ); }
+	void PrefetchSlot( size_t keyHash ) const;
+	void PrefetchEntry( size_t keyHash ) const;
 
 private:
+	// Marks an empty index slot and the end of the node lists.
+	static const unsigned int kNullNode = 0xFFFFFFFF;
+
 	struct SNode
 	{
 		TDataPair m_data;
-		SNode* m_next;
-		SNode* m_prev;
+		size_t m_hash;
+		unsigned int m_next;
+		unsigned int m_prev;
 
-		SNode( const TDataPair& data ) : m_data(data), m_next(NULL), m_prev(NULL) { }
+		SNode( const TDataPair& data, size_t hash ) : m_data(data), m_hash(hash), m_next(kNullNode), m_prev(kNullNode) { }
 	};
-	typedef std::hash_map<TKey, SNode*> TNodeHash;
 
-	SNode* m_head;
-	SNode* m_tail;
-	TNodeHash m_hash;
+	// Holds the arena and the index unless the memory was given.
+	CPageMemory m_memory;
+	// Arena of m_cacheSize nodes. Only nodes below m_unused have ever been handed out.
+	SNode* m_nodes;
+	// Open-addressing index holding arena indices, sized to a power of two.
+	unsigned int* m_slots;
+	unsigned int m_slotMask;
+
+	unsigned int m_head;
+	unsigned int m_tail;
+	unsigned int m_free;
+	unsigned int m_unused;
+	unsigned int m_size;
 	const unsigned int m_cacheSize;
+	THash m_hasher;
+
+	// Not copyable, the arena is owned.
+	CLearningCache( const CLearningCache& );
+	CLearningCache& operator=( const CLearningCache& );
 
-	void MoveToTail( SNode* node );
-	void AddToTail( SNode* node );
-	bool RemoveNode( SNode* node );
-	void RemoveHeadAndHashEntry();
+	static unsigned int ClampCacheSize( unsigned int cacheSize );
+	static unsigned int GetSlotCount( unsigned int cacheSize );
+	void Initialize( void* pMemory );
+
+	size_t HashKey( const TKey& key ) const { return MixHash( m_hasher( key ) ); }
+	static size_t MixHash( size_t keyHash );
+	unsigned int FindSlot( const TKey& key, size_t hash ) const;
+	unsigned int FindSlotOfNode( unsigned int node ) const;
+	void RemoveSlot( unsigned int slot );
+
+	unsigned int AllocNode( const TKey& key, const TValue& value, size_t hash );
+	void FreeNode( unsigned int node );
+	// A free node holds no SNode, only the index of the next free node at its start.
+	unsigned int& GetFreeLink( unsigned int node ) { return *reinterpret_cast<unsigned int*>( &m_nodes[node] ); }
+
+	void MoveToTail( unsigned int node );
+	void AddToTail( unsigned int node );
+	void RemoveNode( unsigned int node );
 };
 
 //--------------------------------------------------------------------------------------
-template <typename TKey, typename TValue>
-CLearningCache<TKey,TValue>::~CLearningCache()
+template <typename TKey, typename TValue, typename THash>
+CLearningCache<TKey,TValue,THash>::CLearningCache(unsigned int cacheSize, const SPageConfig& pages)
+	: m_nodes(NULL)
+	, m_slots(NULL)
+	, m_slotMask(0)
+	, m_head(kNullNode)
+	, m_tail(kNullNode)
+	, m_free(kNullNode)
+	, m_unused(0)
+	, m_size(0)
+	, m_cacheSize(ClampCacheSize( cacheSize ))
+{
+	Initialize( m_memory.Allocate( GetMemorySize( m_cacheSize ), pages ) );
+}
+
+//--------------------------------------------------------------------------------------
+template <typename TKey, typename TValue, typename THash>
+CLearningCache<TKey,TValue,THash>::CLearningCache(unsigned int cacheSize, void* pMemory)
+	: m_nodes(NULL)
+	, m_slots(NULL)
+	, m_slotMask(0)
+	, m_head(kNullNode)
+	, m_tail(kNullNode)
+	, m_free(kNullNode)
+	, m_unused(0)
+	, m_size(0)
+	, m_cacheSize(ClampCacheSize( cacheSize ))
+{
+	Initialize( pMemory );
+}
+
+//--------------------------------------------------------------------------------------
+template <typename TKey, typename TValue, typename THash>
+CLearningCache<TKey,TValue,THash>::~CLearningCache()
 {
 	Clear();
 }
 
 //--------------------------------------------------------------------------------------
-template <typename TKey, typename TValue>
-void CLearningCache<TKey,TValue>::Clear()
+template <typename TKey, typename TValue, typename THash>
+size_t CLearningCache<TKey,TValue,THash>::GetMemorySize( unsigned int cacheSize )
 {
-	SNode* curr = m_head;
-	while( curr )
+	cacheSize = ClampCacheSize( cacheSize );
+	const unsigned __int64 size = (unsigned __int64)sizeof( SNode ) * cacheSize + (unsigned __int64)sizeof( unsigned int ) * GetSlotCount( cacheSize );
+	assert( size <= (size_t)-1 );
+	return (size_t)size;
+}
+
+//--------------------------------------------------------------------------------------
+template <typename TKey, typename TValue, typename THash>
+unsigned int CLearningCache<TKey,TValue,THash>::GetMaxCacheSize()
+{
+	// The index has fewer than four slots per node, and a slot count past 2^31 would not fit.
+	// On 32 bit builds the block size limits the cache first.
+	const unsigned __int64 maxBlockNodes = (unsigned __int64)(size_t)-1 / ( sizeof( SNode ) + 4 * sizeof( unsigned int ) );
+	const unsigned __int64 maxIndexNodes = 1u << 30;
+	return (unsigned int)( maxBlockNodes < maxIndexNodes ? maxBlockNodes : maxIndexNodes );
+}
+
+//--------------------------------------------------------------------------------------
+template <typename TKey, typename TValue, typename THash>
+unsigned int CLearningCache<TKey,TValue,THash>::ClampCacheSize( unsigned int cacheSize )
+{
+	if( !cacheSize )
+		return 1;
+	const unsigned int maxCacheSize = GetMaxCacheSize();
+	return cacheSize < maxCacheSize ? cacheSize : maxCacheSize;
+}
+
+//--------------------------------------------------------------------------------------
+template <typename TKey, typename TValue, typename THash>
+unsigned int CLearningCache<TKey,TValue,THash>::GetSlotCount( unsigned int cacheSize )
+{
+	// Keep the load factor at or below one half so probe sequences stay short.
+	assert( cacheSize <= GetMaxCacheSize() );
+	const unsigned __int64 minSlotCount = (unsigned __int64)cacheSize * 2;
+	unsigned int slotCount = 2;
+	while( slotCount < minSlotCount )
+		slotCount <<= 1;
+	return slotCount;
+}
+
+//--------------------------------------------------------------------------------------
+template <typename TKey, typename TValue, typename THash>
+void CLearningCache<TKey,TValue,THash>::Initialize( void* pMemory )
+{
+	// The arena comes first, so its nodes keep the block's alignment.
+	m_nodes = static_cast<SNode*>( pMemory );
+	m_slots = reinterpret_cast<unsigned int*>( m_nodes + m_cacheSize );
+
+	const unsigned int slotCount = GetSlotCount( m_cacheSize );
+	m_slotMask = slotCount - 1;
+	for( unsigned int i = 0; i < slotCount; ++i )
+		m_slots[i] = kNullNode;
+}
+
+//--------------------------------------------------------------------------------------
+template <typename TKey, typename TValue, typename THash>
+void CLearningCache<TKey,TValue,THash>::PrefetchSlot( size_t keyHash ) const
+{
+	_mm_prefetch( reinterpret_cast<const char*>( &m_slots[ MixHash( keyHash ) & m_slotMask ] ), _MM_HINT_T0 );
+}
+
+//--------------------------------------------------------------------------------------
+template <typename TKey, typename TValue, typename THash>
+void CLearningCache<TKey,TValue,THash>::PrefetchEntry( size_t keyHash ) const
+{
+	// Only the first node of the probe run; with the index at most half full it is usually the one.
+	const unsigned int node = m_slots[ MixHash( keyHash ) & m_slotMask ];
+	if( node != kNullNode )
+		_mm_prefetch( reinterpret_cast<const char*>( &m_nodes[node] ), _MM_HINT_T0 );
+}
+
+//--------------------------------------------------------------------------------------
+template <typename TKey, typename TValue, typename THash>
+void CLearningCache<TKey,TValue,THash>::Clear()
+{
+	CTraceScope trace( "TableClear", "entries", m_size );
+	unsigned int curr = m_head;
+	while( curr != kNullNode )
 	{
-		SNode* next = curr->m_next;
-		delete curr;
+		unsigned int next = m_nodes[curr].m_next;
+		m_nodes[curr].~SNode();
 		curr = next;
 	}
-	m_head = NULL;
-	m_tail = NULL;
-	m_hash.clear();
+	for( unsigned int i = 0; i <= m_slotMask; ++i )
+		m_slots[i] = kNullNode;
+
+	m_head = kNullNode;
+	m_tail = kNullNode;
+	m_free = kNullNode;
+	m_unused = 0;
+	m_size = 0;
+}
+
+//--------------------------------------------------------------------------------------
+template <typename TKey, typename TValue, typename THash>
+TValue* CLearningCache<TKey,TValue,THash>::Get( const TKey& key )
+{
+	return Get( key, m_hasher( key ) );
 }
 
 //--------------------------------------------------------------------------------------
-template <typename TKey, typename TValue>
-TValue* CLearningCache<TKey,TValue>::Get( const TKey& key )
+template <typename TKey, typename TValue, typename THash>
+TValue* CLearningCache<TKey,TValue,THash>::Get( const TKey& key, size_t keyHash )
 {
-	TNodeHash::iterator hashItr = m_hash.find( key );
-	if( hashItr == m_hash.end() )
+	unsigned int slot = FindSlot( key, MixHash( keyHash ) );
+	if( m_slots[slot] == kNullNode )
 		return NULL;
 
-	MoveToTail( hashItr->second );
-	return &( hashItr->second->m_data.second );
+	MoveToTail( m_slots[slot] );
+	return &( m_nodes[ m_slots[slot] ].m_data.second );
 }
 
 //--------------------------------------------------------------------------------------
-template <typename TKey, typename TValue>
-void CLearningCache<TKey,TValue>::UpdateCache( const TKey& key, const TValue& newValue )
+template <typename TKey, typename TValue, typename THash>
+void CLearningCache<TKey,TValue,THash>::UpdateCache( const TKey& key, const TValue& newValue )
 {
-	TValue* existingEntry = Get(key);
-	if( existingEntry )
+	size_t hash = HashKey( key );
+	unsigned int slot = FindSlot( key, hash );
+	if( m_slots[slot] != kNullNode )
 	{
-		*existingEntry = newValue;
+		MoveToTail( m_slots[slot] );
+		m_nodes[ m_slots[slot] ].m_data.second = newValue;
+		return;
 	}
-	else
+
+	// Recycling the oldest entry can shift the index, so look the slot up again after.
+	if( m_size == m_cacheSize )
 	{
-		SNode* node = new SNode( TDataPair( key, newValue ) );
-		AddToTail( node );
-		m_hash[ key ] = node;
-		while( m_hash.size() > m_cacheSize )
-			RemoveHeadAndHashEntry();
+		unsigned int oldest = m_head;
+		RemoveSlot( FindSlotOfNode( oldest ) );
+		RemoveNode( oldest );
+		FreeNode( oldest );
+		slot = FindSlot( key, hash );
 	}
+
+	unsigned int node = AllocNode( key, newValue, hash );
+	AddToTail( node );
+	m_slots[slot] = node;
 }
+
 //--------------------------------------------------------------------------------------
-template <typename TKey, typename TValue>
-bool CLearningCache<TKey,TValue>::RemoveNode( SNode* node )
+template <typename TKey, typename TValue, typename THash>
+bool CLearningCache<TKey,TValue,THash>::Remove( const TKey& key )
 {
-	if( !node || !m_tail || !m_head )
+	unsigned int slot = FindSlot( key, HashKey( key ) );
+	unsigned int node = m_slots[slot];
+	if( node == kNullNode )
 		return false;
 
-	if( node == m_head )
-		m_head = node->m_next;
+	RemoveSlot( slot );
+	RemoveNode( node );
+	FreeNode( node );
+	return true;
+}
 
-	if( node == m_tail )
-		m_tail = node->m_prev;
+//--------------------------------------------------------------------------------------
+template <typename TKey, typename TValue, typename THash>
+size_t CLearningCache<TKey,TValue,THash>::MixHash( size_t keyHash )
+{
+	// Linear probing only looks at the low bits so fold the high bits down.
+	size_t hash = keyHash;
+	hash ^= hash >> 16;
+	hash *= 0x85EBCA6B;
+	hash ^= hash >> 13;
+	return hash;
+}
 
-	if( node->m_prev )
-		node->m_prev->m_next = node->m_next;
-	if( node->m_next )
-		node->m_next->m_prev = node->m_prev;
+//--------------------------------------------------------------------------------------
+template <typename TKey, typename TValue, typename THash>
+unsigned int CLearningCache<TKey,TValue,THash>::FindSlot( const TKey& key, size_t hash ) const
+{
+	// Returns the slot holding the key, or the empty slot where it would be inserted.
+	unsigned int slot = hash & m_slotMask;
+	while( m_slots[slot] != kNullNode )
+	{
+		const SNode& node = m_nodes[ m_slots[slot] ];
+		if( node.m_hash == hash && node.m_data.first == key )
+			break;
+		slot = ( slot + 1 ) & m_slotMask;
+	}
+	return slot;
+}
 
-	return true;
+//--------------------------------------------------------------------------------------
+template <typename TKey, typename TValue, typename THash>
+unsigned int CLearningCache<TKey,TValue,THash>::FindSlotOfNode( unsigned int node ) const
+{
+	unsigned int slot = m_nodes[node].m_hash & m_slotMask;
+	while( m_slots[slot] != node )
+	{
+		assert( m_slots[slot] != kNullNode );
+		slot = ( slot + 1 ) & m_slotMask;
+	}
+	return slot;
 }
 
 //--------------------------------------------------------------------------------------
-template <typename TKey, typename TValue>
-void CLearningCache<TKey,TValue>::MoveToTail( SNode* node )
+template <typename TKey, typename TValue, typename THash>
+void CLearningCache<TKey,TValue,THash>::RemoveSlot( unsigned int slot )
 {
-	if( node == m_tail )
-		return;
+	// Backward shift deletion: pull later entries of the probe run into the hole so that
+	// lookups never need tombstones.
+	unsigned int hole = slot;
+	unsigned int next = slot;
+	for( ;; )
+	{
+		next = ( next + 1 ) & m_slotMask;
+		if( m_slots[next] == kNullNode )
+			break;
 
-	if( !RemoveNode( node ) )
-		return;
+		unsigned int home = m_nodes[ m_slots[next] ].m_hash & m_slotMask;
+		bool homeInRun = ( hole <= next ) ? ( hole < home && home <= next ) : ( hole < home || home <= next );
+		if( homeInRun )
+			continue;
 
-	AddToTail( node );
+		m_slots[hole] = m_slots[next];
+		hole = next;
+	}
+	m_slots[hole] = kNullNode;
 }
 
 //--------------------------------------------------------------------------------------
-template <typename TKey, typename TValue>
-void CLearningCache<TKey,TValue>::AddToTail( SNode* node )
+template <typename TKey, typename TValue, typename THash>
+unsigned int CLearningCache<TKey,TValue,THash>::AllocNode( const TKey& key, const TValue& value, size_t hash )
 {
-	if( !node )
-		return;
+	unsigned int node = m_free;
+	if( node != kNullNode )
+		m_free = GetFreeLink( node );
+	else
+		node = m_unused++;
 
-	node->m_next = NULL;
-	node->m_prev = m_tail;
-	if( m_tail )
-		m_tail->m_next = node;
-	m_tail = node;
-	if( !m_head )
-		m_head = m_tail;
+	assert( node < m_cacheSize );
+	new( &m_nodes[node] ) SNode( TDataPair( key, value ), hash );
+	m_size++;
+	return node;
+}
+
+//--------------------------------------------------------------------------------------
+template <typename TKey, typename TValue, typename THash>
+void CLearningCache<TKey,TValue,THash>::FreeNode( unsigned int node )
+{
+	m_nodes[node].~SNode();
+	new( &m_nodes[node] ) unsigned int( m_free );
+	m_free = node;
+	m_size--;
+}
+
+//--------------------------------------------------------------------------------------
+template <typename TKey, typename TValue, typename THash>
+void CLearningCache<TKey,TValue,THash>::RemoveNode( unsigned int node )
+{
+	SNode& curr = m_nodes[node];
+
+	if( node == m_head )
+		m_head = curr.m_next;
+	if( node == m_tail )
+		m_tail = curr.m_prev;
+
+	if( curr.m_prev != kNullNode )
+		m_nodes[ curr.m_prev ].m_next = curr.m_next;
+	if( curr.m_next != kNullNode )
+		m_nodes[ curr.m_next ].m_prev = curr.m_prev;
+
+	curr.m_next = kNullNode;
+	curr.m_prev = kNullNode;
 }
 
 //--------------------------------------------------------------------------------------
-template <typename TKey, typename TValue>
-void CLearningCache<TKey,TValue>::RemoveHeadAndHashEntry()
+template <typename TKey, typename TValue, typename THash>
+void CLearningCache<TKey,TValue,THash>::MoveToTail( unsigned int node )
 {
-	SNode* toDelete = m_head;
-	if( !RemoveNode( toDelete ) )
+	if( node == m_tail )
 		return;
 
-	m_hash.erase( toDelete->m_data.first );
-	delete toDelete;
+	RemoveNode( node );
+	AddToTail( node );
+}
+
+//--------------------------------------------------------------------------------------
+template <typename TKey, typename TValue, typename THash>
+void CLearningCache<TKey,TValue,THash>::AddToTail( unsigned int node )
+{
+	m_nodes[node].m_next = kNullNode;
+	m_nodes[node].m_prev = m_tail;
+	if( m_tail != kNullNode )
+		m_nodes[m_tail].m_next = node;
+	m_tail = node;
+	if( m_head == kNullNode )
+		m_head = m_tail;
 }
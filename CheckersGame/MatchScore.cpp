@@ -0,0 +1,89 @@
+#include "StdAfx.h"
+#include "MatchScore.h"
+
+#include <math.h>
+
+//--------------------------------------------------------------------------------------
+double SMatchScore::GetScore() const
+{
+	unsigned int games = GetGames();
+	if( !games )
+		return 0.5;
+	return ( m_wins + 0.5 * m_draws ) / games;
+}
+
+//--------------------------------------------------------------------------------------
+double SMatchScore::GetEloDifference() const
+{
+	return ScoreToElo( GetScore() );
+}
+
+//--------------------------------------------------------------------------------------
+double SMatchScore::GetEloErrorMargin() const
+{
+	unsigned int games = GetGames();
+	if( !games )
+		return 0.0;
+
+	// 1.96 standard errors either side of the score, mapped through the Elo curve.
+	double score = GetScore();
+	double error = 1.96 * sqrt( GetVariance() / games );
+	return ( ScoreToElo( score + error ) - ScoreToElo( score - error ) ) / 2.0;
+}
+
+//--------------------------------------------------------------------------------------
+double SMatchScore::GetSprtLlr( double elo0, double elo1 ) const
+{
+	unsigned int games = GetGames();
+	double variance = GetVariance();
+	if( !games || variance <= 0.0 )
+		return 0.0;
+
+	double score0 = EloToScore( elo0 );
+	double score1 = EloToScore( elo1 );
+	return games * ( score1 - score0 ) * ( 2.0 * GetScore() - score0 - score1 ) / ( 2.0 * variance );
+}
+
+//--------------------------------------------------------------------------------------
+double SMatchScore::GetSprtLowerBound( double alpha, double beta )
+{
+	return log( beta / ( 1.0 - alpha ) );
+}
+
+//--------------------------------------------------------------------------------------
+double SMatchScore::GetSprtUpperBound( double alpha, double beta )
+{
+	return log( ( 1.0 - beta ) / alpha );
+}
+
+//--------------------------------------------------------------------------------------
+double SMatchScore::ScoreToElo( double score )
+{
+	// Keep a perfect score finite.
+	const double kEpsilon = 1e-6;
+	if( score < kEpsilon )
+		score = kEpsilon;
+	if( score > 1.0 - kEpsilon )
+		score = 1.0 - kEpsilon;
+	return -400.0 * log10( 1.0 / score - 1.0 );
+}
+
+//--------------------------------------------------------------------------------------
+double SMatchScore::EloToScore( double elo )
+{
+	return 1.0 / ( 1.0 + pow( 10.0, -elo / 400.0 ) );
+}
+
+//--------------------------------------------------------------------------------------
+double SMatchScore::GetVariance() const
+{
+	unsigned int games = GetGames();
+	if( !games )
+		return 0.0;
+
+	double score = GetScore();
+	double winDelta = 1.0 - score;
+	double drawDelta = 0.5 - score;
+	double lossDelta = 0.0 - score;
+	return ( m_wins * winDelta * winDelta + m_draws * drawDelta * drawDelta + m_losses * lossDelta * lossDelta ) / games;
+}
@@ -0,0 +1,35 @@
+#pragma once
+
+//--------------------------------------------------------------------------------------
+// Win/loss/draw record of one engine against another with the usual rating statistics.
+struct SMatchScore
+{
+	unsigned int m_wins;
+	unsigned int m_losses;
+	unsigned int m_draws;
+
+	SMatchScore() : m_wins(0), m_losses(0), m_draws(0) {}
+
+	unsigned int GetGames() const { return m_wins + m_losses + m_draws; }
+
+	// Fraction of points scored, a draw is worth half a point.
+	double GetScore() const;
+	// Elo difference implied by the score.
+	double GetEloDifference() const;
+	// Half width of the 95% confidence interval around GetEloDifference.
+	double GetEloErrorMargin() const;
+
+	// Log-likelihood ratio of the hypothesis elo1 against elo0 (trinomial GSPRT approximation).
+	double GetSprtLlr( double elo0, double elo1 ) const;
+	// Accept elo0 when the LLR falls below the lower bound, elo1 when it passes the upper bound.
+	static double GetSprtLowerBound( double alpha, double beta );
+	static double GetSprtUpperBound( double alpha, double beta );
+
+	// Elo difference for an expected score and the inverse.
+	static double ScoreToElo( double score );
+	static double EloToScore( double elo );
+
+private:
+	// Per game variance of the points scored.
+	double GetVariance() const;
+};
@@ -0,0 +1,178 @@
+#pragma once
+
+#include "stdafx.h"
+
+#include "GameBoardBasics.h"
+#include "GameHistory.h"
+#include "PerfTimer.h"
+#include "Random.h"
+#include "Threading.h"
+
+#include <vector>
+
+//--------------------------------------------------------------------------------------
+// Counters from the last search made by a Monte Carlo player.
+struct SMonteCarloStats
+{
+	unsigned __int64 m_playouts;
+	// Plies played by all the playouts together.
+	unsigned __int64 m_playoutPlies;
+	unsigned __int64 m_elapsedUs;
+	// Tree nodes taken from the pool, and the deepest one a playout started from.
+	unsigned int m_nodes;
+	unsigned int m_depth;
+	// Visits of the move chosen and its mean result for the searching player, from 0 for a
+	// loss to 1 for a win.
+	unsigned int m_bestVisits;
+	double m_bestScore;
+
+	SMonteCarloStats() : m_playouts(0), m_playoutPlies(0), m_elapsedUs(0), m_nodes(0), m_depth(0), m_bestVisits(0), m_bestScore(0.0) {}
+
+	double GetPlayoutsPerSecond() const { return m_elapsedUs ? m_playouts * 1000000.0 / m_elapsedUs : 0.0; }
+};
+
+//--------------------------------------------------------------------------------------
+// Chooses moves by Monte Carlo tree search (UCT) instead of alpha-beta, with the same Move and
+// FindBestMove as a ComputerPlayer.  Each iteration walks down the tree by the UCT bound, adds
+// the children of the leaf it reaches once that has been visited, and plays the game out with
+// random moves made straight on the board's bit masks.  The move visited most is played.  The
+// search stops after a number of playouts or on a time limit, and gives a usable answer
+// however little time it had, which suits tight move budgets.
+//
+// Nodes come from a pool allocated with the player; children are claimed in one block with an
+// interlocked add, so the search never allocates.  Several threads can search the same tree:
+// each adds virtual losses to the nodes on its path until its playout is counted, which sends
+// the other threads down other lines.
+//
+// Requires of the board, besides what a ComputerPlayer does: MakeRandomMove.
+template <typename TGameBoard>
+class CMonteCarloPlayer
+{
+public:
+	struct SConfig
+	{
+		// Milliseconds allowed per move.  Without a limit the search plays m_playouts playouts.
+		unsigned int m_timeLimitMs;
+		unsigned int m_playouts;
+		// Threads searching the tree; with 1 the search runs on the calling thread.
+		unsigned int m_threads;
+		// Nodes in the pool.  Once they are used up leaves are played out without being expanded.
+		unsigned int m_maxNodes;
+		// Weight of the exploration term of the UCT bound, with results scored from 0 to 1.
+		double m_exploration;
+		// Losses a thread adds to each node on its path while its playout runs.
+		unsigned int m_virtualLoss;
+		// Playouts still running after this many plies are adjudicated on material.
+		unsigned int m_playoutPlies;
+		// Moves per player without a capture or a man moving before a draw, as in CGameHistory.
+		unsigned int m_noProgressMoves;
+		// Seeds the playouts. The two colours draw different sequences from the same seed.
+		unsigned int m_seed;
+
+		SConfig()
+			: m_timeLimitMs(0), m_playouts(10000), m_threads(1), m_maxNodes(1 << 18), m_exploration(1.0), m_virtualLoss(3)
+			, m_playoutPlies(150), m_noProgressMoves(CGameHistory::DefaultNoProgressMoves), m_seed(0) {}
+	};
+
+	CMonteCarloPlayer( EPlayer player, const SConfig& config );
+	~CMonteCarloPlayer();
+
+	EPlayer GetPlayer() const { return m_player; }
+	const SConfig& GetConfig() const { return m_config; }
+
+	// Asks that the computer make the best move it finds.  The game history, if given, carries
+	// the no-progress count into the search; repetitions are not detected.
+	bool Move( TGameBoard& board, const CGameHistory* pHistory = NULL );
+	// Searches for the best move without changing the board. Returns false if there is no move.
+	bool FindBestMove( const TGameBoard& board, CMove& bestMove, const CGameHistory* pHistory = NULL );
+
+	// Counters from the last call to Move or FindBestMove.
+	const SMonteCarloStats& GetLastSearchStats() const { return m_stats; }
+
+	// May be called from another thread while FindBestMove runs; the most visited move so far is used.
+	void Stop() { InterlockedExchange( &m_stopRequested, 1 ); }
+	void ResetSignals() { InterlockedExchange( &m_stopRequested, 0 ); }
+
+private:
+	enum ENodeState
+	{
+		NodeState_Leaf,
+		// A thread is adding the children; others play out from the node meanwhile.
+		NodeState_Expanding,
+		NodeState_Expanded,
+
+		NodeStateCount
+	};
+
+	// A material lead of a man decides an adjudicated playout.
+	enum { AdjudicationMargin = 100 };
+	// Iterations between looks at the clock.
+	enum { CheckInterval = 16 };
+	// The root and its children fit in any pool, so the root can always be expanded.
+	enum { MinPoolSize = 256 };
+
+	struct SNode
+	{
+		// The position after the move leading to the node.
+		TGameBoard m_board;
+		// Playout results through the node for the player who moved into it, in half points:
+		// 2 for a win and 1 for a draw.
+		volatile LONG m_score;
+		volatile LONG m_visits;
+		volatile LONG m_virtualLoss;
+		volatile LONG m_state;
+		// The children are consecutive in the pool, in the order of GetMoves.
+		unsigned int m_firstChild;
+		unsigned int m_childCount;
+		// Reversible plies that led to the position, for the no-progress rule.
+		unsigned int m_reversiblePlies;
+	};
+
+	// State of one search thread.
+	struct SWorker
+	{
+		CRandom m_random;
+		unsigned __int64 m_playouts;
+		unsigned __int64 m_playoutPlies;
+		unsigned int m_depth;
+		// The nodes walked by the current iteration, root first.
+		std::vector<unsigned int> m_path;
+		std::vector<CMove> m_moves;
+
+		SWorker() : m_playouts(0), m_playoutPlies(0), m_depth(0) {}
+	};
+
+	const EPlayer m_player;
+	const SConfig m_config;
+	CRandom m_random;
+
+	// The node pool; the root is always the first node.
+	const unsigned int m_poolSize;
+	SNode* m_pNodes;
+	volatile LONG m_nodeCount;
+	volatile LONG m_poolFull;
+	std::vector<CMove> m_rootMoves;
+
+	// State of the search in progress.
+	volatile LONG m_playoutCount;
+	volatile LONG m_stop;
+	volatile LONG m_stopRequested;
+	CStopwatch m_stopwatch;
+	SMonteCarloStats m_stats;
+
+	void Search( SWorker& worker );
+	// Runs one iteration: selection, expansion, playout and backing up the result.
+	void Iterate( SWorker& worker );
+	// Adds the children of a leaf.  Returns false if another thread is adding them or the pool is used up.
+	bool Expand( SWorker& worker, SNode& node, EPlayer toMove );
+	// Returns the child with the highest UCT bound, counting virtual losses as losses.
+	unsigned int SelectChild( const SNode& node ) const;
+	// Plays random moves until the game ends.  Returns the result for toMove in half points.
+	int Playout( SWorker& worker, const TGameBoard& start, EPlayer toMove, unsigned int reversiblePlies );
+	bool ShouldStop( unsigned __int64 iteration );
+
+	bool IsNoProgressDraw( unsigned int reversiblePlies ) const { return m_config.m_noProgressMoves && reversiblePlies >= m_config.m_noProgressMoves * 2; }
+
+	CMonteCarloPlayer( const CMonteCarloPlayer& );
+	CMonteCarloPlayer& operator=( const CMonteCarloPlayer& );
+};
@@ -0,0 +1,311 @@
+#pragma once
+
+#include "StdAfx.h"
+#include "MonteCarloPlayer.h"
+
+#include <algorithm>
+#include <math.h>
+
+//--------------------------------------------------------------------------------------
+template <typename TGameBoard>
+CMonteCarloPlayer<TGameBoard>::CMonteCarloPlayer( EPlayer player, const SConfig& config )
+	: m_player( player )
+	, m_config( config )
+	, m_random( (unsigned __int64)config.m_seed * 2 + player )
+	, m_poolSize( ( std::max )( config.m_maxNodes, (unsigned int)MinPoolSize ) )
+	, m_pNodes( NULL )
+	, m_nodeCount( 0 )
+	, m_poolFull( 0 )
+	, m_playoutCount( 0 )
+	, m_stop( 0 )
+	, m_stopRequested( 0 )
+{
+	m_pNodes = new SNode[ m_poolSize ];
+}
+
+//--------------------------------------------------------------------------------------
+template <typename TGameBoard>
+CMonteCarloPlayer<TGameBoard>::~CMonteCarloPlayer()
+{
+	delete[] m_pNodes;
+}
+
+//--------------------------------------------------------------------------------------
+template <typename TGameBoard>
+bool CMonteCarloPlayer<TGameBoard>::Move( TGameBoard& board, const CGameHistory* pHistory )
+{
+	CMove bestMove;
+	if( !FindBestMove( board, bestMove, pHistory ) )
+		return false;
+
+	return board.MakeMoveIfValid( m_player, bestMove );
+}
+
+//--------------------------------------------------------------------------------------
+template <typename TGameBoard>
+bool CMonteCarloPlayer<TGameBoard>::FindBestMove( const TGameBoard& board, CMove& bestMove, const CGameHistory* pHistory )
+{
+	m_stats = SMonteCarloStats();
+	m_stopwatch.Restart();
+
+	m_rootMoves.clear();
+	if( !board.GetMoves( m_player, m_rootMoves ) || m_rootMoves.empty() )
+		return false;
+
+	// A forced move needs no search.
+	if( m_rootMoves.size() == 1 )
+	{
+		bestMove = m_rootMoves[0];
+		m_stats.m_elapsedUs = m_stopwatch.GetElapsedUs();
+		return true;
+	}
+
+	SNode& root = m_pNodes[0];
+	root.m_board = board;
+	root.m_score = 0;
+	root.m_visits = 0;
+	root.m_virtualLoss = 0;
+	root.m_state = NodeState_Leaf;
+	root.m_firstChild = 0;
+	root.m_childCount = 0;
+	root.m_reversiblePlies = pHistory ? pHistory->GetReversibleCount() : 0;
+	m_nodeCount = 1;
+	m_poolFull = 0;
+	m_playoutCount = 0;
+	m_stop = 0;
+
+	const unsigned int threadCount = m_config.m_threads ? m_config.m_threads : CThread::GetHardwareThreadCount();
+	std::vector<SWorker> workers( threadCount );
+	for( unsigned int i = 0; i < threadCount; ++i )
+		workers[i].m_random.Seed( m_random.Next() );
+
+	// Every iteration starts by choosing a move at the root.  The root gets no children when
+	// the game is already drawn by the no-progress rule, or the pool cannot hold its moves, and
+	// then any move will do.
+	Expand( workers[0], root, m_player );
+	if( !root.m_childCount )
+	{
+		bestMove = m_rootMoves[0];
+		m_stats.m_elapsedUs = m_stopwatch.GetElapsedUs();
+		return true;
+	}
+	if( threadCount == 1 )
+		Search( workers[0] );
+	else
+	{
+		std::vector<CThread*> threads( threadCount );
+		for( unsigned int i = 0; i < threadCount; ++i )
+		{
+			SWorker* pWorker = &workers[i];
+			threads[i] = new CThread;
+			threads[i]->Start( [this, pWorker]() { Search( *pWorker ); } );
+		}
+		for( unsigned int i = 0; i < threadCount; ++i )
+		{
+			threads[i]->Join();
+			delete threads[i];
+		}
+	}
+
+	// The most visited move is the one the search trusts most.
+	unsigned int best = 0;
+	for( unsigned int i = 1; i < root.m_childCount; ++i )
+	{
+		const SNode& child = m_pNodes[ root.m_firstChild + i ];
+		const SNode& bestChild = m_pNodes[ root.m_firstChild + best ];
+		if( child.m_visits > bestChild.m_visits || ( child.m_visits == bestChild.m_visits && child.m_score > bestChild.m_score ) )
+			best = i;
+	}
+	bestMove = m_rootMoves[ best ];
+
+	const SNode& bestChild = m_pNodes[ root.m_firstChild + best ];
+	for( unsigned int i = 0; i < threadCount; ++i )
+	{
+		m_stats.m_playouts += workers[i].m_playouts;
+		m_stats.m_playoutPlies += workers[i].m_playoutPlies;
+		if( workers[i].m_depth > m_stats.m_depth )
+			m_stats.m_depth = workers[i].m_depth;
+	}
+	m_stats.m_nodes = ( std::min )( (unsigned int)m_nodeCount, m_poolSize );
+	m_stats.m_bestVisits = bestChild.m_visits;
+	m_stats.m_bestScore = bestChild.m_visits ? bestChild.m_score / ( 2.0 * bestChild.m_visits ) : 0.0;
+	m_stats.m_elapsedUs = m_stopwatch.GetElapsedUs();
+	return true;
+}
+
+//--------------------------------------------------------------------------------------
+template <typename TGameBoard>
+void CMonteCarloPlayer<TGameBoard>::Search( SWorker& worker )
+{
+	for( unsigned __int64 iteration = 0; !ShouldStop( iteration ); ++iteration )
+		Iterate( worker );
+}
+
+//--------------------------------------------------------------------------------------
+template <typename TGameBoard>
+bool CMonteCarloPlayer<TGameBoard>::ShouldStop( unsigned __int64 iteration )
+{
+	if( m_stop || m_stopRequested )
+		return true;
+
+	bool stop = false;
+	if( m_config.m_timeLimitMs )
+		stop = ( iteration % CheckInterval ) == 0 && m_stopwatch.GetElapsedMs() >= m_config.m_timeLimitMs;
+	else
+		stop = InterlockedIncrement( &m_playoutCount ) > (LONG)m_config.m_playouts;
+
+	if( stop )
+		InterlockedExchange( &m_stop, 1 );
+	return stop;
+}
+
+//--------------------------------------------------------------------------------------
+template <typename TGameBoard>
+void CMonteCarloPlayer<TGameBoard>::Iterate( SWorker& worker )
+{
+	const LONG virtualLoss = m_config.m_virtualLoss;
+
+	// Selection, expanding the leaf reached if it was visited before.
+	worker.m_path.clear();
+	unsigned int index = 0;
+	EPlayer toMove = m_player;
+	for( ;; )
+	{
+		SNode& node = m_pNodes[ index ];
+		InterlockedExchangeAdd( &node.m_virtualLoss, virtualLoss );
+		worker.m_path.push_back( index );
+		if( node.m_state != NodeState_Expanded && ( node.m_visits == 0 || !Expand( worker, node, toMove ) ) )
+			break;
+		if( !node.m_childCount )
+			break;
+
+		index = SelectChild( node );
+		toMove = TGameBoard::GetOpponent( toMove );
+	}
+
+	// The result for the player to move at the leaf: a position without moves is lost.
+	const SNode& leaf = m_pNodes[ index ];
+	int points = 0;
+	if( leaf.m_state == NodeState_Expanded && !leaf.m_childCount )
+		points = IsNoProgressDraw( leaf.m_reversiblePlies ) ? 1 : 0;
+	else
+		points = Playout( worker, leaf.m_board, toMove, leaf.m_reversiblePlies );
+
+	// Each node keeps the result for the player who moved into it, the opponent of the one to move.
+	for( size_t i = worker.m_path.size(); i-- > 0; )
+	{
+		points = 2 - points;
+		SNode& node = m_pNodes[ worker.m_path[i] ];
+		InterlockedExchangeAdd( &node.m_score, points );
+		InterlockedIncrement( &node.m_visits );
+		InterlockedExchangeAdd( &node.m_virtualLoss, -virtualLoss );
+	}
+
+	worker.m_playouts++;
+	if( worker.m_path.size() - 1 > worker.m_depth )
+		worker.m_depth = (unsigned int)worker.m_path.size() - 1;
+}
+
+//--------------------------------------------------------------------------------------
+template <typename TGameBoard>
+bool CMonteCarloPlayer<TGameBoard>::Expand( SWorker& worker, SNode& node, EPlayer toMove )
+{
+	if( m_poolFull || InterlockedCompareExchange( &node.m_state, NodeState_Expanding, NodeState_Leaf ) != NodeState_Leaf )
+		return node.m_state == NodeState_Expanded;
+
+	worker.m_moves.clear();
+	if( !IsNoProgressDraw( node.m_reversiblePlies ) )
+		node.m_board.GetMoves( toMove, worker.m_moves );
+
+	const LONG count = (LONG)worker.m_moves.size();
+	const LONG first = InterlockedExchangeAdd( &m_nodeCount, count );
+	if( first + count > (LONG)m_poolSize )
+	{
+		InterlockedExchange( &m_poolFull, 1 );
+		InterlockedExchange( &node.m_state, NodeState_Leaf );
+		return false;
+	}
+
+	for( LONG i = 0; i < count; ++i )
+	{
+		const CMove& move = worker.m_moves[i];
+		SNode& child = m_pNodes[ first + i ];
+		child.m_board = node.m_board;
+		child.m_board.MakeMoveIfValid( toMove, move );
+		child.m_score = 0;
+		child.m_visits = 0;
+		child.m_virtualLoss = 0;
+		child.m_state = NodeState_Leaf;
+		child.m_firstChild = 0;
+		child.m_childCount = 0;
+		child.m_reversiblePlies = node.m_board.IsReversibleMove( toMove, move ) ? node.m_reversiblePlies + 1 : 0;
+	}
+	node.m_firstChild = first;
+	node.m_childCount = count;
+	// Publishes the children before any thread can select them.
+	InterlockedExchange( &node.m_state, NodeState_Expanded );
+	return true;
+}
+
+//--------------------------------------------------------------------------------------
+template <typename TGameBoard>
+unsigned int CMonteCarloPlayer<TGameBoard>::SelectChild( const SNode& node ) const
+{
+	const double logVisits = log( (double)( node.m_visits + node.m_virtualLoss ) );
+	unsigned int best = node.m_firstChild;
+	double bestBound = -1.0;
+	for( unsigned int i = 0; i < node.m_childCount; ++i )
+	{
+		const SNode& child = m_pNodes[ node.m_firstChild + i ];
+		const LONG visits = child.m_visits + child.m_virtualLoss;
+		// Every move is tried once before any is tried again.
+		if( visits == 0 )
+			return node.m_firstChild + i;
+
+		const double bound = child.m_score / ( 2.0 * visits ) + m_config.m_exploration * sqrt( logVisits / visits );
+		if( bound > bestBound )
+		{
+			bestBound = bound;
+			best = node.m_firstChild + i;
+		}
+	}
+	return best;
+}
+
+//--------------------------------------------------------------------------------------
+template <typename TGameBoard>
+int CMonteCarloPlayer<TGameBoard>::Playout( SWorker& worker, const TGameBoard& start, EPlayer toMove, unsigned int reversiblePlies )
+{
+	TGameBoard board( start );
+	EPlayer player = toMove;
+	int points = 1;
+	unsigned int ply = 0;
+	for( ;; )
+	{
+		if( ply == m_config.m_playoutPlies )
+		{
+			const int score = board.CalculatePlayerScore( toMove, typename TGameBoard::TEvalWeights() );
+			points = ( score >= AdjudicationMargin ) ? 2 : ( score <= -AdjudicationMargin ) ? 0 : 1;
+			break;
+		}
+
+		bool reversible = false;
+		if( !board.MakeRandomMove( player, worker.m_random, reversible ) )
+		{
+			points = ( player == toMove ) ? 0 : 2;
+			break;
+		}
+		++ply;
+
+		reversiblePlies = reversible ? reversiblePlies + 1 : 0;
+		if( IsNoProgressDraw( reversiblePlies ) )
+		{
+			points = 1;
+			break;
+		}
+		player = TGameBoard::GetOpponent( player );
+	}
+
+	worker.m_playoutPlies += ply;
+	return points;
+}
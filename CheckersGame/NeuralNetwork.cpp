@@ -0,0 +1,310 @@
+#include "StdAfx.h"
+#include "NeuralNetwork.h"
+
+#include "Random.h"
+
+#include <fstream>
+#include <string.h>
+
+#if NEURAL_NETWORK_SIMD == 256
+#include <immintrin.h>
+#elif NEURAL_NETWORK_SIMD == 128
+#include <emmintrin.h>
+#endif
+
+namespace
+{
+	// Network files start with this tag and version, then the input and layer sizes, then
+	// the weights and biases of each layer in order, little endian.
+	const char kFileTag[4] = { 'C', 'K', 'N', 'N' };
+	const unsigned int kFileVersion = 1;
+
+	// Hidden layer sums are scaled down by this many bits before clipping.
+	const int kHiddenShift = 6;
+
+	//--------------------------------------------------------------------------------------
+	inline int Clip( int value )
+	{
+		return ( value < 0 ) ? 0 : ( value > 127 ) ? 127 : value;
+	}
+
+#if NEURAL_NETWORK_SIMD
+	//--------------------------------------------------------------------------------------
+	inline int HorizontalSum( __m128i sum )
+	{
+		sum = _mm_add_epi32( sum, _mm_shuffle_epi32( sum, 0x4E ) );
+		sum = _mm_add_epi32( sum, _mm_shuffle_epi32( sum, 0xB1 ) );
+		return _mm_cvtsi128_si32( sum );
+	}
+#endif
+
+#if NEURAL_NETWORK_SIMD == 256
+	//--------------------------------------------------------------------------------------
+	inline int HorizontalSum( __m256i sums )
+	{
+		return HorizontalSum( _mm_add_epi32( _mm256_castsi256_si128( sums ), _mm256_extracti128_si256( sums, 1 ) ) );
+	}
+#endif
+}
+
+//--------------------------------------------------------------------------------------
+CNeuralNetwork::CNeuralNetwork()
+	: m_inputCount( 0 )
+	, m_outputBias( 0 )
+{
+	memset( m_inputBiases, 0, sizeof( m_inputBiases ) );
+	memset( m_hiddenWeights, 0, sizeof( m_hiddenWeights ) );
+	memset( m_hiddenBiases, 0, sizeof( m_hiddenBiases ) );
+	memset( m_outputWeights, 0, sizeof( m_outputWeights ) );
+}
+
+//--------------------------------------------------------------------------------------
+bool CNeuralNetwork::Load( const std::string& path, unsigned int inputCount )
+{
+	std::ifstream file( path.c_str(), std::ios::binary );
+	if( !file )
+		return false;
+
+	char tag[4];
+	unsigned int header[4];
+	file.read( tag, sizeof( tag ) );
+	file.read( (char*)header, sizeof( header ) );
+	if( !file || memcmp( tag, kFileTag, sizeof( tag ) ) || header[0] != kFileVersion || header[1] != inputCount
+		|| header[2] != HiddenSize || header[3] != OutputHiddenSize )
+		return false;
+
+	// Read into a copy so a truncated file leaves this network as it was.
+	CNeuralNetwork network;
+	network.m_inputCount = inputCount;
+	network.m_inputWeights.resize( inputCount * HiddenSize );
+	file.read( (char*)&network.m_inputWeights[0], network.m_inputWeights.size() * sizeof( short ) );
+	file.read( (char*)network.m_inputBiases, sizeof( network.m_inputBiases ) );
+	file.read( (char*)network.m_hiddenWeights, sizeof( network.m_hiddenWeights ) );
+	file.read( (char*)network.m_hiddenBiases, sizeof( network.m_hiddenBiases ) );
+	file.read( (char*)network.m_outputWeights, sizeof( network.m_outputWeights ) );
+	file.read( (char*)&network.m_outputBias, sizeof( network.m_outputBias ) );
+	if( !file )
+		return false;
+
+	*this = network;
+	return true;
+}
+
+//--------------------------------------------------------------------------------------
+bool CNeuralNetwork::Save( const std::string& path ) const
+{
+	std::ofstream file( path.c_str(), std::ios::binary );
+	if( !file || !m_inputCount )
+		return false;
+
+	const unsigned int header[4] = { kFileVersion, m_inputCount, HiddenSize, OutputHiddenSize };
+	file.write( kFileTag, sizeof( kFileTag ) );
+	file.write( (const char*)header, sizeof( header ) );
+	file.write( (const char*)&m_inputWeights[0], m_inputWeights.size() * sizeof( short ) );
+	file.write( (const char*)m_inputBiases, sizeof( m_inputBiases ) );
+	file.write( (const char*)m_hiddenWeights, sizeof( m_hiddenWeights ) );
+	file.write( (const char*)m_hiddenBiases, sizeof( m_hiddenBiases ) );
+	file.write( (const char*)m_outputWeights, sizeof( m_outputWeights ) );
+	file.write( (const char*)&m_outputBias, sizeof( m_outputBias ) );
+	return file.good();
+}
+
+//--------------------------------------------------------------------------------------
+void CNeuralNetwork::Randomize( unsigned int inputCount, unsigned __int64 seed )
+{
+	CRandom random( seed );
+	m_inputCount = inputCount;
+	m_inputWeights.resize( inputCount * HiddenSize );
+	for( size_t i = 0; i < m_inputWeights.size(); ++i )
+		m_inputWeights[i] = (short)random.NextBelow( 81 ) - 40;
+	for( int i = 0; i < HiddenSize; ++i )
+		m_inputBiases[i] = (short)random.NextBelow( 33 );
+	for( int j = 0; j < OutputHiddenSize; ++j )
+	{
+		for( int i = 0; i < HiddenSize; ++i )
+			m_hiddenWeights[j][i] = (signed char)( (int)random.NextBelow( 65 ) - 32 );
+		m_hiddenBiases[j] = (int)random.NextBelow( 1025 ) - 512;
+		m_outputWeights[j] = (signed char)( (int)random.NextBelow( 129 ) - 64 );
+	}
+	m_outputBias = 0;
+}
+
+//--------------------------------------------------------------------------------------
+void CNeuralNetwork::CountPieces( SNeuralAccumulator& accumulator, const unsigned short* pInputs, unsigned int count, int sign ) const
+{
+	for( unsigned int i = 0; i < count; ++i )
+	{
+		if( pInputs[i] < m_inputCount / 2 )
+			accumulator.m_redPieces += sign;
+		else
+			accumulator.m_blackPieces += sign;
+	}
+}
+
+//--------------------------------------------------------------------------------------
+void CNeuralNetwork::Refresh( SNeuralAccumulator& accumulator, const unsigned short* pInputs, unsigned int count ) const
+{
+	SNeuralAccumulator empty;
+	memcpy( empty.m_values, m_inputBiases, sizeof( empty.m_values ) );
+	empty.m_redPieces = 0;
+	empty.m_blackPieces = 0;
+	Update( accumulator, empty, pInputs, count, NULL, 0 );
+}
+
+//--------------------------------------------------------------------------------------
+void CNeuralNetwork::Update( SNeuralAccumulator& accumulator, const SNeuralAccumulator& from, const unsigned short* pAdded, unsigned int addedCount, const unsigned short* pRemoved, unsigned int removedCount ) const
+{
+	accumulator.m_redPieces = from.m_redPieces;
+	accumulator.m_blackPieces = from.m_blackPieces;
+	CountPieces( accumulator, pAdded, addedCount, 1 );
+	CountPieces( accumulator, pRemoved, removedCount, -1 );
+
+#if NEURAL_NETWORK_SIMD == 256
+	// The whole accumulator fits in registers, so it is read and written once per update.
+	enum { Chunks = HiddenSize / 16 };
+	__m256i sums[Chunks];
+	for( int c = 0; c < Chunks; ++c )
+		sums[c] = _mm256_loadu_si256( (const __m256i*)( from.m_values + c * 16 ) );
+	for( unsigned int i = 0; i < addedCount; ++i )
+	{
+		const short* pWeights = &m_inputWeights[ pAdded[i] * HiddenSize ];
+		for( int c = 0; c < Chunks; ++c )
+			sums[c] = _mm256_add_epi16( sums[c], _mm256_loadu_si256( (const __m256i*)( pWeights + c * 16 ) ) );
+	}
+	for( unsigned int i = 0; i < removedCount; ++i )
+	{
+		const short* pWeights = &m_inputWeights[ pRemoved[i] * HiddenSize ];
+		for( int c = 0; c < Chunks; ++c )
+			sums[c] = _mm256_sub_epi16( sums[c], _mm256_loadu_si256( (const __m256i*)( pWeights + c * 16 ) ) );
+	}
+	for( int c = 0; c < Chunks; ++c )
+		_mm256_storeu_si256( (__m256i*)( accumulator.m_values + c * 16 ), sums[c] );
+#else
+#if NEURAL_NETWORK_SIMD == 128
+	if( CCpuFeatures::HasSse2() )
+	{
+		// x86 has only eight registers, so the accumulator is done a chunk at a time, each chunk
+		// still read and written once.
+		for( int c = 0; c < HiddenSize; c += 8 )
+		{
+			__m128i sum = _mm_loadu_si128( (const __m128i*)( from.m_values + c ) );
+			for( unsigned int i = 0; i < addedCount; ++i )
+				sum = _mm_add_epi16( sum, _mm_loadu_si128( (const __m128i*)&m_inputWeights[ pAdded[i] * HiddenSize + c ] ) );
+			for( unsigned int i = 0; i < removedCount; ++i )
+				sum = _mm_sub_epi16( sum, _mm_loadu_si128( (const __m128i*)&m_inputWeights[ pRemoved[i] * HiddenSize + c ] ) );
+			_mm_storeu_si128( (__m128i*)( accumulator.m_values + c ), sum );
+		}
+		return;
+	}
+#endif
+
+	if( &accumulator != &from )
+		memcpy( accumulator.m_values, from.m_values, sizeof( accumulator.m_values ) );
+	for( unsigned int i = 0; i < addedCount; ++i )
+	{
+		const short* pWeights = &m_inputWeights[ pAdded[i] * HiddenSize ];
+		for( int j = 0; j < HiddenSize; ++j )
+			accumulator.m_values[j] = (short)( accumulator.m_values[j] + pWeights[j] );
+	}
+	for( unsigned int i = 0; i < removedCount; ++i )
+	{
+		const short* pWeights = &m_inputWeights[ pRemoved[i] * HiddenSize ];
+		for( int j = 0; j < HiddenSize; ++j )
+			accumulator.m_values[j] = (short)( accumulator.m_values[j] - pWeights[j] );
+	}
+#endif
+}
+
+//--------------------------------------------------------------------------------------
+int CNeuralNetwork::Evaluate( const SNeuralAccumulator& accumulator ) const
+{
+	int hidden[OutputHiddenSize];
+
+#if NEURAL_NETWORK_SIMD == 256
+	// Clip to 0..127 and narrow to bytes.  Packing works within 128 bit lanes, so the
+	// quarters are put back in order afterwards.
+	unsigned char clipped[HiddenSize];
+	const __m256i limit = _mm256_set1_epi16( 127 );
+	for( int c = 0; c < HiddenSize / 32; ++c )
+	{
+		const __m256i low = _mm256_min_epi16( _mm256_loadu_si256( (const __m256i*)( accumulator.m_values + c * 32 ) ), limit );
+		const __m256i high = _mm256_min_epi16( _mm256_loadu_si256( (const __m256i*)( accumulator.m_values + c * 32 + 16 ) ), limit );
+		const __m256i packed = _mm256_permute4x64_epi64( _mm256_packus_epi16( low, high ), 0xD8 );
+		_mm256_storeu_si256( (__m256i*)( clipped + c * 32 ), packed );
+	}
+
+	// Byte products summed in pairs cannot overflow 16 bits: 2 * 127 * 128 < 32768.
+	const __m256i ones = _mm256_set1_epi16( 1 );
+	for( int j = 0; j < OutputHiddenSize; ++j )
+	{
+		__m256i sums = _mm256_setzero_si256();
+		for( int c = 0; c < HiddenSize / 32; ++c )
+		{
+			const __m256i inputs = _mm256_loadu_si256( (const __m256i*)( clipped + c * 32 ) );
+			const __m256i weights = _mm256_loadu_si256( (const __m256i*)( m_hiddenWeights[j] + c * 32 ) );
+			sums = _mm256_add_epi32( sums, _mm256_madd_epi16( _mm256_maddubs_epi16( inputs, weights ), ones ) );
+		}
+		hidden[j] = Clip( ( m_hiddenBiases[j] + HorizontalSum( sums ) ) >> kHiddenShift );
+	}
+#else
+#if NEURAL_NETWORK_SIMD == 128
+	if( CCpuFeatures::HasSse2() )
+	{
+		// SSE2 has no byte products, so the inputs are clipped in 16 bits and the weights
+		// widened to meet them.
+		short clipped[HiddenSize];
+		const __m128i zero = _mm_setzero_si128();
+		const __m128i limit = _mm_set1_epi16( 127 );
+		for( int c = 0; c < HiddenSize; c += 8 )
+		{
+			const __m128i values = _mm_loadu_si128( (const __m128i*)( accumulator.m_values + c ) );
+			_mm_storeu_si128( (__m128i*)( clipped + c ), _mm_max_epi16( _mm_min_epi16( values, limit ), zero ) );
+		}
+
+		for( int j = 0; j < OutputHiddenSize; ++j )
+		{
+			__m128i sums = zero;
+			for( int c = 0; c < HiddenSize; c += 16 )
+			{
+				const __m128i weights = _mm_loadu_si128( (const __m128i*)( m_hiddenWeights[j] + c ) );
+				const __m128i signs = _mm_cmpgt_epi8( zero, weights );
+				sums = _mm_add_epi32( sums, _mm_madd_epi16( _mm_loadu_si128( (const __m128i*)( clipped + c ) ), _mm_unpacklo_epi8( weights, signs ) ) );
+				sums = _mm_add_epi32( sums, _mm_madd_epi16( _mm_loadu_si128( (const __m128i*)( clipped + c + 8 ) ), _mm_unpackhi_epi8( weights, signs ) ) );
+			}
+			hidden[j] = Clip( ( m_hiddenBiases[j] + HorizontalSum( sums ) ) >> kHiddenShift );
+		}
+	}
+	else
+#endif
+	{
+		int clipped[HiddenSize];
+		for( int i = 0; i < HiddenSize; ++i )
+			clipped[i] = Clip( accumulator.m_values[i] );
+
+		for( int j = 0; j < OutputHiddenSize; ++j )
+		{
+			int sum = m_hiddenBiases[j];
+			for( int i = 0; i < HiddenSize; ++i )
+				sum += clipped[i] * m_hiddenWeights[j][i];
+			hidden[j] = Clip( sum >> kHiddenShift );
+		}
+	}
+#endif
+
+	int output = m_outputBias;
+	for( int j = 0; j < OutputHiddenSize; ++j )
+		output += hidden[j] * m_outputWeights[j];
+	return output / OutputScale;
+}
+
+//--------------------------------------------------------------------------------------
+const char* CNeuralNetwork::GetSimdName()
+{
+#if NEURAL_NETWORK_SIMD == 256
+	return "avx2";
+#elif NEURAL_NETWORK_SIMD == 128
+	return CCpuFeatures::HasSse2() ? "sse2" : "scalar";
+#else
+	return "scalar";
+#endif
+}
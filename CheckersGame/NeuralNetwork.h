@@ -0,0 +1,189 @@
+#pragma once
+
+#include "stdafx.h"
+
+#include "CpuFeatures.h"
+#include "GameBoardBasics.h"
+
+#include <assert.h>
+#include <string>
+#include <vector>
+
+// The network arithmetic uses AVX2 when the compiler targets it (/arch:AVX2, -mavx2), which the
+// VS2010 toolset cannot.  Otherwise x86 builds carry SSE2 code taken when the processor has it,
+// and plain integer code is left for the rest.  All give exactly the same scores.
+#if defined( __AVX2__ )
+#define NEURAL_NETWORK_SIMD 256
+#elif CPU_FEATURES_SSE2
+#define NEURAL_NETWORK_SIMD 128
+#else
+#define NEURAL_NETWORK_SIMD 0
+#endif
+
+//--------------------------------------------------------------------------------------
+// First layer sums of a position in 16 bit fixed point: the biases plus the weights of
+// every input that is set.  Also counts the pieces of each side so wins can be scored.
+struct SNeuralAccumulator
+{
+	enum { Size = 128 };
+
+	short m_values[Size];
+	unsigned int m_redPieces;
+	unsigned int m_blackPieces;
+};
+
+//--------------------------------------------------------------------------------------
+// Small quantized evaluation network in the style of NNUE.  The inputs are one per kind of
+// piece on each square, so a position sets only a few and a move changes fewer still:
+// the first layer is kept in an accumulator updated by the changed inputs alone.  It is
+// followed by clipped ReLUs (0 to 127) and two dense layers with 8 bit weights, the last
+// giving red's score in 1/16 points, where a man is worth about 100.
+//
+// Inputs of red pieces come first and black pieces second, as boards number them (see
+// CCheckersBoard::GetNetworkInputs).  Weights are read from binary files, usually written by
+// a trainer; Randomize makes a network for benchmarks.
+class CNeuralNetwork
+{
+public:
+	enum { HiddenSize = SNeuralAccumulator::Size, OutputHiddenSize = 32 };
+	// Output units per score point.
+	enum { OutputScale = 16 };
+
+	CNeuralNetwork();
+
+	unsigned int GetInputCount() const { return m_inputCount; }
+
+	// Reads a network with the given number of inputs.  Returns false if the file cannot be
+	// read or was made for another board or layer size; the network is unchanged then.
+	bool Load( const std::string& path, unsigned int inputCount );
+	bool Save( const std::string& path ) const;
+	// Fills the network with small random weights.
+	void Randomize( unsigned int inputCount, unsigned __int64 seed );
+
+	// Computes an accumulator from the inputs that are set.
+	void Refresh( SNeuralAccumulator& accumulator, const unsigned short* pInputs, unsigned int count ) const;
+	// Computes an accumulator from that of the previous position and the inputs set and
+	// cleared since.
+	void Update( SNeuralAccumulator& accumulator, const SNeuralAccumulator& from, const unsigned short* pAdded, unsigned int addedCount, const unsigned short* pRemoved, unsigned int removedCount ) const;
+	// Red's score in points.
+	int Evaluate( const SNeuralAccumulator& accumulator ) const;
+
+	// The instructions Update and Evaluate use on this processor: "avx2", "sse2" or "scalar".
+	static const char* GetSimdName();
+
+private:
+	unsigned int m_inputCount;
+	// HiddenSize weights per input.
+	std::vector<short> m_inputWeights;
+	short m_inputBiases[HiddenSize];
+	signed char m_hiddenWeights[OutputHiddenSize][HiddenSize];
+	int m_hiddenBiases[OutputHiddenSize];
+	signed char m_outputWeights[OutputHiddenSize];
+	int m_outputBias;
+
+	void CountPieces( SNeuralAccumulator& accumulator, const unsigned short* pInputs, unsigned int count, int sign ) const;
+};
+
+//--------------------------------------------------------------------------------------
+// Evaluates the positions along a search path with a network, keeping one accumulator per
+// ply.  Accumulators are brought up to date only when a position is evaluated, each from
+// the one before it, so moves whose subtrees are cut off cost no network work.
+//
+// The boards are held by pointer and must stay alive while they are on the path.  They
+// provide NetworkInputCount, GetNetworkInputs and GetNetworkChanges.
+template <typename TGameBoard>
+class CNeuralEvaluator
+{
+public:
+	CNeuralEvaluator() : m_pNetwork( NULL ), m_size( 0 ), m_computed( 0 ) {}
+
+	void SetNetwork( const CNeuralNetwork* pNetwork ) { m_pNetwork = pNetwork; }
+
+	// Starts a path at the root position.
+	void Reset( const TGameBoard& root ) { m_size = 0; m_computed = 0; Push( root ); }
+
+	void Push( const TGameBoard& board )
+	{
+		if( m_size == m_boards.size() )
+		{
+			m_boards.resize( m_size + 1 );
+			m_accumulators.resize( m_size + 1 );
+		}
+		m_boards[m_size] = &board;
+		if( m_computed > m_size )
+			m_computed = m_size;
+		m_size++;
+	}
+
+	void Pop()
+	{
+		assert( m_size );
+		m_size--;
+		if( m_computed > m_size )
+			m_computed = m_size;
+	}
+
+	// Scores the last board pushed for the player.
+	int Evaluate( EPlayer player );
+
+	// Pushes a board for the lifetime of the object.
+	class CScopedPush
+	{
+	public:
+		CScopedPush( CNeuralEvaluator& evaluator, const TGameBoard& board ) : m_evaluator( evaluator ) { m_evaluator.Push( board ); }
+		~CScopedPush() { m_evaluator.Pop(); }
+
+	private:
+		CNeuralEvaluator& m_evaluator;
+
+		CScopedPush& operator = ( const CScopedPush& );
+	};
+
+private:
+	const CNeuralNetwork* m_pNetwork;
+	std::vector<const TGameBoard*> m_boards;
+	std::vector<SNeuralAccumulator> m_accumulators;
+	unsigned int m_size;
+	// Accumulators below this index are those of the boards now on the path.
+	unsigned int m_computed;
+};
+
+//--------------------------------------------------------------------------------------
+template <typename TGameBoard>
+int CNeuralEvaluator<TGameBoard>::Evaluate( EPlayer player )
+{
+	assert( m_pNetwork && m_size );
+
+	unsigned short added[TGameBoard::NetworkInputCount];
+	unsigned short removed[TGameBoard::NetworkInputCount];
+	if( !m_computed )
+	{
+		m_pNetwork->Refresh( m_accumulators[0], added, m_boards[0]->GetNetworkInputs( added ) );
+		m_computed = 1;
+	}
+	for( ; m_computed < m_size; ++m_computed )
+	{
+		unsigned int addedCount = 0;
+		unsigned int removedCount = 0;
+		m_boards[m_computed]->GetNetworkChanges( *m_boards[m_computed - 1], added, addedCount, removed, removedCount );
+		m_pNetwork->Update( m_accumulators[m_computed], m_accumulators[m_computed - 1], added, addedCount, removed, removedCount );
+	}
+
+	// As with the weighted evaluation, a side without pieces has lost and nothing else
+	// may score as much.
+	const SNeuralAccumulator& accumulator = m_accumulators[m_size - 1];
+	int redScore = 0;
+	if( !accumulator.m_redPieces )
+		redScore = TGameBoard::MinScore;
+	else if( !accumulator.m_blackPieces )
+		redScore = TGameBoard::MaxScore;
+	else
+	{
+		redScore = m_pNetwork->Evaluate( accumulator );
+		if( redScore <= TGameBoard::MinScore )
+			redScore = TGameBoard::MinScore + 1;
+		else if( redScore >= TGameBoard::MaxScore )
+			redScore = TGameBoard::MaxScore - 1;
+	}
+	return ( player == Player_Red ) ? redScore : -redScore;
+}
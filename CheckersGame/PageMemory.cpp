@@ -0,0 +1,185 @@
+#include "StdAfx.h"
+#include "PageMemory.h"
+
+#include <new>
+#include <string.h>
+#include <windows.h>
+
+namespace
+{
+	//--------------------------------------------------------------------------------------
+	inline size_t RoundUp( size_t size, size_t granularity )
+	{
+		return ( size + granularity - 1 ) / granularity * granularity;
+	}
+
+	//--------------------------------------------------------------------------------------
+	// Large pages need the Lock Pages in Memory privilege, which an administrator grants but the
+	// process must still switch on.
+	bool EnableLockMemoryPrivilege()
+	{
+		HANDLE token = NULL;
+		if( !OpenProcessToken( GetCurrentProcess(), TOKEN_ADJUST_PRIVILEGES | TOKEN_QUERY, &token ) )
+			return false;
+
+		TOKEN_PRIVILEGES privileges;
+		privileges.PrivilegeCount = 1;
+		privileges.Privileges[0].Attributes = SE_PRIVILEGE_ENABLED;
+		// AdjustTokenPrivileges succeeds without granting what the account lacks, so check the error too.
+		const bool enabled = LookupPrivilegeValueA( NULL, "SeLockMemoryPrivilege", &privileges.Privileges[0].Luid )
+			&& AdjustTokenPrivileges( token, FALSE, &privileges, 0, NULL, NULL )
+			&& GetLastError() == ERROR_SUCCESS;
+		CloseHandle( token );
+		return enabled;
+	}
+}
+
+//--------------------------------------------------------------------------------------
+const char* SPageConfig::GetNumaPolicyName( ENumaPolicy policy )
+{
+	static const char* s_names[NumaPolicyCount] = { "default", "interleave", "local" };
+	return ( policy < NumaPolicyCount ) ? s_names[policy] : "unknown";
+}
+
+//--------------------------------------------------------------------------------------
+ENumaPolicy SPageConfig::ParseNumaPolicy( const char* name )
+{
+	for( int policy = 0; policy < NumaPolicyCount; ++policy )
+	{
+		if( strcmp( name, GetNumaPolicyName( (ENumaPolicy)policy ) ) == 0 )
+			return (ENumaPolicy)policy;
+	}
+	return NumaPolicyCount;
+}
+
+//--------------------------------------------------------------------------------------
+CPageMemory::CPageMemory()
+	: m_pMemory( NULL )
+	, m_size( 0 )
+	, m_mappedSize( 0 )
+	, m_pageKind( PageKind_Normal )
+	, m_numa( NumaPolicy_Default )
+{
+}
+
+//--------------------------------------------------------------------------------------
+CPageMemory::~CPageMemory()
+{
+	Free();
+}
+
+//--------------------------------------------------------------------------------------
+void* CPageMemory::Allocate( size_t size, const SPageConfig& config )
+{
+	Free();
+
+	// Small blocks gain nothing from huge pages, and a node of their own is not worth a mapping.
+	const bool wantsMapping = config.m_hugePages || config.m_numa != NumaPolicy_Default;
+	if( !size || !wantsMapping || size < HugePageSize || !Map( size, config ) )
+	{
+		m_pMemory = ::operator new( size ? size : 1 );
+		m_pageKind = PageKind_Normal;
+		m_numa = NumaPolicy_Default;
+	}
+	m_size = size;
+	return m_pMemory;
+}
+
+//--------------------------------------------------------------------------------------
+void CPageMemory::Free()
+{
+	if( m_mappedSize )
+		Unmap();
+	else
+		::operator delete( m_pMemory );
+
+	m_pMemory = NULL;
+	m_size = 0;
+	m_mappedSize = 0;
+	m_pageKind = PageKind_Normal;
+	m_numa = NumaPolicy_Default;
+}
+
+//--------------------------------------------------------------------------------------
+const char* CPageMemory::GetPageKindName( EPageKind kind )
+{
+	static const char* s_names[PageKindCount] = { "normal", "huge" };
+	return ( kind < PageKindCount ) ? s_names[kind] : "unknown";
+}
+
+//--------------------------------------------------------------------------------------
+unsigned int CPageMemory::GetNumaNodeCount()
+{
+	ULONG highest = 0;
+	if( !GetNumaHighestNodeNumber( &highest ) )
+		return 1;
+	return highest + 1;
+}
+
+//--------------------------------------------------------------------------------------
+bool CPageMemory::Map( size_t size, const SPageConfig& config )
+{
+	const unsigned int nodeCount = GetNumaNodeCount();
+	const bool interleave = ( config.m_numa == NumaPolicy_Interleave && nodeCount > 1 );
+	UCHAR localNode = 0;
+	const bool local = ( config.m_numa == NumaPolicy_Local && nodeCount > 1 && GetNumaProcessorNode( (UCHAR)GetCurrentProcessorNumber(), &localNode ) );
+
+	// Large pages are committed with their reservation, so they cannot be spread over nodes.
+	const SIZE_T largePageSize = GetLargePageMinimum();
+	if( config.m_hugePages && largePageSize && !interleave && EnableLockMemoryPrivilege() )
+	{
+		const size_t mappedSize = RoundUp( size, largePageSize );
+		const DWORD flags = MEM_RESERVE | MEM_COMMIT | MEM_LARGE_PAGES;
+		void* pMemory = local ? VirtualAllocExNuma( GetCurrentProcess(), NULL, mappedSize, flags, PAGE_READWRITE, localNode )
+			: VirtualAlloc( NULL, mappedSize, flags, PAGE_READWRITE );
+		if( pMemory )
+		{
+			m_pMemory = pMemory;
+			m_mappedSize = mappedSize;
+			m_pageKind = PageKind_Huge;
+			m_numa = local ? NumaPolicy_Local : NumaPolicy_Default;
+			return true;
+		}
+	}
+
+	const size_t mappedSize = RoundUp( size, HugePageSize );
+	void* pMemory = NULL;
+	if( interleave )
+	{
+		// Reserve the range, then commit it a huge page's worth at a time on each node in turn.
+		pMemory = VirtualAlloc( NULL, mappedSize, MEM_RESERVE, PAGE_READWRITE );
+		if( !pMemory )
+			return false;
+		for( size_t offset = 0; offset < mappedSize; offset += HugePageSize )
+		{
+			char* pChunk = static_cast<char*>( pMemory ) + offset;
+			const DWORD node = (DWORD)( ( offset / HugePageSize ) % nodeCount );
+			if( !VirtualAllocExNuma( GetCurrentProcess(), pChunk, HugePageSize, MEM_COMMIT, PAGE_READWRITE, node )
+				&& !VirtualAlloc( pChunk, HugePageSize, MEM_COMMIT, PAGE_READWRITE ) )
+			{
+				VirtualFree( pMemory, 0, MEM_RELEASE );
+				return false;
+			}
+		}
+	}
+	else
+	{
+		const DWORD flags = MEM_RESERVE | MEM_COMMIT;
+		pMemory = local ? VirtualAllocExNuma( GetCurrentProcess(), NULL, mappedSize, flags, PAGE_READWRITE, localNode )
+			: VirtualAlloc( NULL, mappedSize, flags, PAGE_READWRITE );
+		if( !pMemory )
+			return false;
+	}
+
+	m_pMemory = pMemory;
+	m_mappedSize = mappedSize;
+	m_pageKind = PageKind_Normal;
+	m_numa = interleave ? NumaPolicy_Interleave : ( local ? NumaPolicy_Local : NumaPolicy_Default );
+	return true;
+}
+
+//--------------------------------------------------------------------------------------
+void CPageMemory::Unmap()
+{
+	VirtualFree( m_pMemory, 0, MEM_RELEASE );
+}
@@ -0,0 +1,88 @@
+#pragma once
+
+#include "stdafx.h"
+
+//--------------------------------------------------------------------------------------
+// Where the pages of a large allocation are placed on a machine with several NUMA nodes.
+enum ENumaPolicy
+{
+	// Wherever the OS puts them, normally the node of the thread that first touches each page.
+	NumaPolicy_Default,
+	// Spread page by page over every node, so threads on all of them see the same latency.
+	NumaPolicy_Interleave,
+	// On the node of the thread allocating, for a table searched from that thread.
+	NumaPolicy_Local,
+
+	NumaPolicyCount
+};
+
+//--------------------------------------------------------------------------------------
+// The pages an allocation ended up with.
+enum EPageKind
+{
+	PageKind_Normal,
+	// Large pages, committed and locked with the reservation.
+	PageKind_Huge,
+
+	PageKindCount
+};
+
+//--------------------------------------------------------------------------------------
+// How the memory of a large table is allocated.
+struct SPageConfig
+{
+	// Backs the memory with huge pages where the OS gives them, so random probes over a large
+	// table miss the TLB far less.  Falls back to normal pages.
+	bool m_hugePages;
+	ENumaPolicy m_numa;
+
+	SPageConfig() : m_hugePages(false), m_numa(NumaPolicy_Default) {}
+
+	static const char* GetNumaPolicyName( ENumaPolicy policy );
+	// Returns NumaPolicyCount for a name that is not one.
+	static ENumaPolicy ParseNumaPolicy( const char* name );
+};
+
+//--------------------------------------------------------------------------------------
+// One block of memory for a large table, taken straight from the OS so it can have huge pages
+// and a NUMA placement.  Huge pages are Windows large pages, which need the Lock Pages in
+// Memory privilege.  Blocks smaller than a huge page, and any the OS refuses, come from
+// operator new as before, so an allocation only fails when there is no memory at all.  The
+// contents start zeroed only when they come from the OS.
+class CPageMemory
+{
+public:
+	enum { HugePageSize = 2 * 1024 * 1024 };
+
+	CPageMemory();
+	~CPageMemory();
+
+	// Frees any block held, then allocates size bytes as config asks.
+	void* Allocate( size_t size, const SPageConfig& config );
+	void Free();
+
+	void* Get() const { return m_pMemory; }
+	size_t GetSize() const { return m_size; }
+	EPageKind GetPageKind() const { return m_pageKind; }
+	// The policy actually applied, NumaPolicy_Default on a single node or where placement failed.
+	ENumaPolicy GetNumaPolicy() const { return m_numa; }
+
+	static const char* GetPageKindName( EPageKind kind );
+	// NUMA nodes of the machine, 1 where the OS cannot tell.
+	static unsigned int GetNumaNodeCount();
+
+private:
+	void* m_pMemory;
+	size_t m_size;
+	// Bytes mapped from the OS, 0 when the block came from operator new.
+	size_t m_mappedSize;
+	EPageKind m_pageKind;
+	ENumaPolicy m_numa;
+
+	// Maps the block from the OS.  Returns false, holding nothing, if it would not.
+	bool Map( size_t size, const SPageConfig& config );
+	void Unmap();
+
+	CPageMemory( const CPageMemory& );
+	CPageMemory& operator=( const CPageMemory& );
+};
@@ -0,0 +1,663 @@
+#include "StdAfx.h"
+#include "Pdn.h"
+
+#include "Threading.h"
+
+#include <deque>
+#include <sstream>
+
+namespace
+{
+	const int kEndOfFile = std::char_traits<char>::eof();
+	const unsigned int kSquareCount = 32;
+	// Move text is wrapped before this column.
+	const size_t kLineLength = 79;
+
+	//--------------------------------------------------------------------------------------
+	bool IsSpace( int c )
+	{
+		return c == ' ' || c == '\t' || c == '\r' || c == '\n';
+	}
+
+	//--------------------------------------------------------------------------------------
+	bool IsDigit( int c )
+	{
+		return c >= '0' && c <= '9';
+	}
+
+	//--------------------------------------------------------------------------------------
+	// Converts a game termination marker to the 1-0 / 0-1 / 1/2-1/2 / * form.
+	// Draughts records sometimes count 2 points for a win.
+	bool ParseResult( const std::string& token, std::string& result )
+	{
+		if( token == "1-0" || token == "2-0" )
+			result = "1-0";
+		else if( token == "0-1" || token == "0-2" )
+			result = "0-1";
+		else if( token == "1/2-1/2" || token == "1-1" )
+			result = "1/2-1/2";
+		else if( token == "*" || token == "0-0" )
+			result = "*";
+		else
+			return false;
+		return true;
+	}
+
+	//--------------------------------------------------------------------------------------
+	// Appends the squares of one colour in a FEN piece list, e.g. "1-12" or "K30".
+	bool ParseFenPieces( const std::string& list, CCheckersBoard& board, ESquareState man, ESquareState king )
+	{
+		std::istringstream is( list );
+		std::string item;
+		while( std::getline( is, item, ',' ) )
+		{
+			if( item.empty() )
+				continue;
+
+			bool isKing = ( item[0] == 'K' );
+			if( isKing )
+				item.erase( 0, 1 );
+
+			unsigned int first = 0;
+			unsigned int last = 0;
+			char dash = 0;
+			std::istringstream range( item );
+			if( !( range >> first ) )
+				return false;
+			last = first;
+			if( range >> dash && ( dash != '-' || !( range >> last ) ) )
+				return false;
+
+			for( unsigned int square = first; square <= last; ++square )
+			{
+				SPosition pos;
+				if( !CPdn::SquareToPosition( square, pos ) )
+					return false;
+				board.SetSquareState( pos, isKing ? king : man );
+			}
+		}
+		return true;
+	}
+
+	//--------------------------------------------------------------------------------------
+	void WriteFenPieces( std::ostream& os, const CCheckersBoard& board, EPlayer player )
+	{
+		bool first = true;
+		for( unsigned int square = 1; square <= kSquareCount; ++square )
+		{
+			SPosition pos;
+			CPdn::SquareToPosition( square, pos );
+			ESquareState state = board.GetSquareState( pos );
+			if( CCheckersBoard::GetPlayerOwner( state ) != player )
+				continue;
+
+			os << ( first ? "" : "," ) << ( CCheckersBoard::IsKing( state ) ? "K" : "" ) << square;
+			first = false;
+		}
+	}
+}
+
+//--------------------------------------------------------------------------------------
+const std::string& SPdnGame::GetTag( const std::string& name, const std::string& defaultValue ) const
+{
+	for( size_t i = 0; i < m_tags.size(); ++i )
+	{
+		if( m_tags[i].first == name )
+			return m_tags[i].second;
+	}
+	return defaultValue;
+}
+
+//--------------------------------------------------------------------------------------
+void SPdnGame::SetTag( const std::string& name, const std::string& value )
+{
+	for( size_t i = 0; i < m_tags.size(); ++i )
+	{
+		if( m_tags[i].first == name )
+		{
+			m_tags[i].second = value;
+			return;
+		}
+	}
+	m_tags.push_back( std::make_pair( name, value ) );
+}
+
+//--------------------------------------------------------------------------------------
+bool CPdn::SquareToPosition( unsigned int square, SPosition& pos )
+{
+	if( square < 1 || square > kSquareCount )
+		return false;
+
+	// Four dark squares per row; even rows start on the second column.
+	unsigned int index = square - 1;
+	unsigned int y = index / 4;
+	pos = SPosition( ( index % 4 ) * 2 + ( ( y % 2 ) == 0 ? 1 : 0 ), y );
+	return true;
+}
+
+//--------------------------------------------------------------------------------------
+unsigned int CPdn::PositionToSquare( const SPosition& pos )
+{
+	if( !pos.IsValid() || ( ( pos.m_x + pos.m_y ) % 2 ) == 0 )
+		return 0;
+	return pos.m_y * 4 + pos.m_x / 2 + 1;
+}
+
+//--------------------------------------------------------------------------------------
+SPdnMove CPdn::FromMove( const CMove& move )
+{
+	SPdnMove written;
+	written.m_squares.push_back( (unsigned char)PositionToSquare( move.m_start ) );
+	for( size_t i = 0; i < move.m_sequence.size(); ++i )
+		written.m_squares.push_back( (unsigned char)PositionToSquare( move.m_sequence[i] ) );
+
+	// Jumps cover two rows, steps one.
+	written.m_capture = !move.m_sequence.empty() && abs( (int)move.m_sequence[0].m_y - (int)move.m_start.m_y ) == 2;
+	return written;
+}
+
+//--------------------------------------------------------------------------------------
+std::string CPdn::ToString( const SPdnMove& move )
+{
+	std::ostringstream os;
+	for( size_t i = 0; i < move.m_squares.size(); ++i )
+	{
+		if( i )
+			os << ( move.m_capture ? 'x' : '-' );
+		os << (unsigned int)move.m_squares[i];
+	}
+	return os.str();
+}
+
+//--------------------------------------------------------------------------------------
+bool CPdn::Parse( const std::string& text, SPdnMove& move )
+{
+	move = SPdnMove();
+
+	size_t end = text.find_last_not_of( "!?" );
+	if( end == std::string::npos )
+		return false;
+
+	unsigned int square = 0;
+	bool hasDigit = false;
+	for( size_t i = 0; i <= end; ++i )
+	{
+		char c = text[i];
+		if( IsDigit( c ) )
+		{
+			square = square * 10 + ( c - '0' );
+			hasDigit = true;
+			if( square > kSquareCount )
+				return false;
+			continue;
+		}
+
+		if( !hasDigit || ( c != '-' && c != 'x' && c != ':' ) )
+			return false;
+		if( c != '-' )
+			move.m_capture = true;
+		move.m_squares.push_back( (unsigned char)square );
+		square = 0;
+		hasDigit = false;
+	}
+	if( !hasDigit )
+		return false;
+	move.m_squares.push_back( (unsigned char)square );
+
+	for( size_t i = 0; i < move.m_squares.size(); ++i )
+	{
+		if( move.m_squares[i] < 1 )
+			return false;
+	}
+	return move.m_squares.size() >= 2;
+}
+
+//--------------------------------------------------------------------------------------
+bool CPdn::FindMove( const CCheckersBoard& board, EPlayer player, const SPdnMove& written, CMove& move )
+{
+	if( written.m_squares.size() < 2 )
+		return false;
+
+	SPosition start;
+	if( !SquareToPosition( written.m_squares[0], start ) )
+		return false;
+
+	std::vector<SPosition> path( written.m_squares.size() - 1 );
+	for( size_t i = 0; i < path.size(); ++i )
+	{
+		if( !SquareToPosition( written.m_squares[i + 1], path[i] ) )
+			return false;
+	}
+
+	std::vector<CMove> moves;
+	if( !board.GetMoves( player, moves ) )
+		return false;
+
+	// Matching against the legal moves means a bad record can never reach MakeMoveIfValid
+	// with a move it does not expect.
+	const CMove* pFound = NULL;
+	unsigned int matches = 0;
+	for( size_t i = 0; i < moves.size(); ++i )
+	{
+		const CMove& candidate = moves[i];
+		if( candidate.m_start != start || candidate.m_sequence.empty() )
+			continue;
+
+		if( candidate.m_sequence == path )
+		{
+			move = candidate;
+			return true;
+		}
+
+		// A capture written with only its first and last squares.
+		if( path.size() == 1 && candidate.m_sequence.back() == path[0] )
+		{
+			pFound = &candidate;
+			matches++;
+		}
+	}
+
+	if( matches != 1 )
+		return false;
+	move = *pFound;
+	return true;
+}
+
+//--------------------------------------------------------------------------------------
+bool CPdn::ParseFen( const std::string& fen, CCheckersBoard& board, EPlayer& toMove )
+{
+	std::string text = fen;
+	size_t end = text.find_last_not_of( " ." );
+	text.erase( end == std::string::npos ? 0 : end + 1 );
+
+	std::istringstream is( text );
+	std::string field;
+	if( !std::getline( is, field, ':' ) || field.size() != 1 || ( field[0] != 'B' && field[0] != 'W' ) )
+		return false;
+	toMove = ( field[0] == 'B' ) ? Player_Red : Player_Black;
+
+	board.Clear();
+	while( std::getline( is, field, ':' ) )
+	{
+		if( field.empty() )
+			continue;
+
+		bool ok;
+		if( field[0] == 'B' )
+			ok = ParseFenPieces( field.substr( 1 ), board, SquareState_Red, SquareState_RedKing );
+		else if( field[0] == 'W' )
+			ok = ParseFenPieces( field.substr( 1 ), board, SquareState_Black, SquareState_BlackKing );
+		else
+			ok = false;
+		if( !ok )
+			return false;
+	}
+	return true;
+}
+
+//--------------------------------------------------------------------------------------
+std::string CPdn::ToFen( const CCheckersBoard& board, EPlayer toMove )
+{
+	std::ostringstream os;
+	os << ( toMove == Player_Red ? 'B' : 'W' ) << ":W";
+	WriteFenPieces( os, board, Player_Black );
+	os << ":B";
+	WriteFenPieces( os, board, Player_Red );
+	return os.str();
+}
+
+//--------------------------------------------------------------------------------------
+bool CPdn::Replay( const SPdnGame& game, SPdnReplay& replay )
+{
+	replay.m_board = CCheckersBoard();
+	replay.m_toMove = Player_Red;
+	replay.m_moves.clear();
+	replay.m_error.clear();
+
+	const std::string& fen = game.GetTag( "FEN" );
+	if( !fen.empty() && !ParseFen( fen, replay.m_board, replay.m_toMove ) )
+	{
+		replay.m_error = "bad FEN \"" + fen + "\"";
+		return false;
+	}
+	replay.m_start = replay.m_board;
+	replay.m_startToMove = replay.m_toMove;
+
+	replay.m_moves.reserve( game.m_moves.size() );
+	for( size_t i = 0; i < game.m_moves.size(); ++i )
+	{
+		CMove move;
+		if( !FindMove( replay.m_board, replay.m_toMove, game.m_moves[i], move ) || !replay.m_board.MakeMoveIfValid( replay.m_toMove, move ) )
+		{
+			std::ostringstream os;
+			os << "ply " << ( i + 1 ) << " " << ToString( game.m_moves[i] ) << " is not legal";
+			replay.m_error = os.str();
+			return false;
+		}
+		replay.m_moves.push_back( move );
+		replay.m_toMove = CCheckersBoard::GetOpponent( replay.m_toMove );
+	}
+	return true;
+}
+
+//--------------------------------------------------------------------------------------
+CPdnReader::CPdnReader( std::istream& is )
+	: m_pBuffer( is.rdbuf() )
+	, m_line( 1 )
+{
+}
+
+//--------------------------------------------------------------------------------------
+int CPdnReader::Get()
+{
+	int c = m_pBuffer->sbumpc();
+	if( c == '\n' )
+		m_line++;
+	return c;
+}
+
+//--------------------------------------------------------------------------------------
+int CPdnReader::SkipSpace()
+{
+	int c = Peek();
+	while( IsSpace( c ) )
+	{
+		Get();
+		c = Peek();
+	}
+	return c;
+}
+
+//--------------------------------------------------------------------------------------
+void CPdnReader::SkipPast( int end )
+{
+	for( int c = Get(); c != kEndOfFile && c != end; c = Get() )
+	{
+	}
+}
+
+//--------------------------------------------------------------------------------------
+bool CPdnReader::ReadTag( SPdnGame& game )
+{
+	Get(); // '['
+	SkipSpace();
+
+	std::string name;
+	for( int c = Peek(); c != kEndOfFile && !IsSpace( c ) && c != '"' && c != ']'; c = Peek() )
+		name += (char)Get();
+
+	if( SkipSpace() != '"' || name.empty() )
+		return false;
+	Get();
+
+	std::string value;
+	for( int c = Get(); c != '"'; c = Get() )
+	{
+		if( c == kEndOfFile || c == '\n' )
+			return false;
+		if( c == '\\' )
+			c = Get();
+		value += (char)c;
+	}
+
+	if( SkipSpace() != ']' )
+		return false;
+	Get();
+
+	game.m_tags.push_back( std::make_pair( name, value ) );
+	return true;
+}
+
+//--------------------------------------------------------------------------------------
+void CPdnReader::ReadToken()
+{
+	m_token.clear();
+	for( int c = Peek(); c != kEndOfFile && !IsSpace( c ); c = Peek() )
+	{
+		if( c == '{' || c == '}' || c == '(' || c == ')' || c == '[' || c == ']' || c == ';' )
+			break;
+		m_token += (char)Get();
+	}
+}
+
+//--------------------------------------------------------------------------------------
+void CPdnReader::Resync()
+{
+	for( int c = Get(); c != kEndOfFile; c = Get() )
+	{
+		if( c == '\n' && Peek() == '[' )
+			return;
+	}
+}
+
+//--------------------------------------------------------------------------------------
+bool CPdnReader::Fail( const std::string& error )
+{
+	std::ostringstream os;
+	os << "line " << m_line << ": " << error;
+	m_error = os.str();
+	Resync();
+	return false;
+}
+
+//--------------------------------------------------------------------------------------
+bool CPdnReader::ReadGame( SPdnGame& game )
+{
+	game.Clear();
+	m_error.clear();
+
+	int c = SkipSpace();
+	if( c == kEndOfFile )
+		return false;
+	game.m_line = m_line;
+
+	while( c == '[' )
+	{
+		if( !ReadTag( game ) )
+			return Fail( "bad tag" );
+		c = SkipSpace();
+	}
+
+	for( c = SkipSpace(); c != kEndOfFile && c != '['; c = SkipSpace() )
+	{
+		if( c == '{' )
+		{
+			SkipPast( '}' );
+			continue;
+		}
+		if( c == ';' )
+		{
+			SkipPast( '\n' );
+			continue;
+		}
+		if( c == '(' )
+		{
+			// Variations nest and may hold comments with parentheses in them.
+			Get();
+			for( unsigned int depth = 1; depth; )
+			{
+				c = Get();
+				if( c == kEndOfFile )
+					return Fail( "unterminated variation" );
+				if( c == '{' )
+					SkipPast( '}' );
+				else if( c == '(' )
+					depth++;
+				else if( c == ')' )
+					depth--;
+			}
+			continue;
+		}
+
+		ReadToken();
+		if( m_token.empty() )
+		{
+			// Stray punctuation.
+			Get();
+			continue;
+		}
+		if( m_token[0] == '$' )
+			continue;
+		if( ParseResult( m_token, game.m_result ) )
+			break;
+
+		// Drop a move number, which may be run together with the move as in "1.11-15".
+		size_t dot = m_token.find_last_of( '.' );
+		if( dot != std::string::npos )
+			m_token.erase( 0, dot + 1 );
+		if( m_token.empty() )
+			continue;
+
+		SPdnMove move;
+		if( !CPdn::Parse( m_token, move ) )
+			return Fail( "bad move \"" + m_token + "\"" );
+		game.m_moves.push_back( move );
+	}
+
+	if( game.m_result.empty() )
+		game.m_result = game.GetTag( "Result", "*" );
+	return true;
+}
+
+//--------------------------------------------------------------------------------------
+void CPdnWriter::WriteGame( const SPdnGame& game )
+{
+	bool hasResult = false;
+	for( size_t i = 0; i < game.m_tags.size(); ++i )
+	{
+		std::string value;
+		for( size_t j = 0; j < game.m_tags[i].second.size(); ++j )
+		{
+			char c = game.m_tags[i].second[j];
+			if( c == '"' || c == '\\' )
+				value += '\\';
+			value += c;
+		}
+		m_os << '[' << game.m_tags[i].first << " \"" << value << "\"]\n";
+		hasResult = hasResult || game.m_tags[i].first == "Result";
+	}
+
+	const std::string result = game.m_result.empty() ? "*" : game.m_result;
+	if( !hasResult )
+		m_os << "[Result \"" << result << "\"]\n";
+	m_os << '\n';
+
+	// Move numbers count full moves; a game set up with white to move starts with "1...".
+	bool firstMovesSecond = ( game.GetTag( "FEN" ).substr( 0, 1 ) == "W" );
+	std::string line;
+	for( size_t i = 0; i < game.m_moves.size(); ++i )
+	{
+		size_t ply = i + ( firstMovesSecond ? 1 : 0 );
+		std::ostringstream os;
+		if( ( ply % 2 ) == 0 )
+			os << ( ply / 2 + 1 ) << ". ";
+		else if( i == 0 )
+			os << ( ply / 2 + 1 ) << "... ";
+		os << CPdn::ToString( game.m_moves[i] );
+
+		std::string word = os.str();
+		if( !line.empty() && line.size() + 1 + word.size() > kLineLength )
+		{
+			m_os << line << '\n';
+			line.clear();
+		}
+		line += ( line.empty() ? "" : " " ) + word;
+	}
+	if( !line.empty() && line.size() + 1 + result.size() > kLineLength )
+	{
+		m_os << line << '\n';
+		line.clear();
+	}
+	line += ( line.empty() ? "" : " " ) + result;
+	m_os << line << "\n\n";
+}
+
+//--------------------------------------------------------------------------------------
+CPdnBatchReplay::CPdnBatchReplay( unsigned int threads )
+	: m_threads( threads ? threads : CThread::GetHardwareThreadCount() )
+{
+	if( !m_threads )
+		m_threads = 1;
+}
+
+//--------------------------------------------------------------------------------------
+CPdnBatchReplay::SStats CPdnBatchReplay::Run( std::istream& is, const TGameFunc& func )
+{
+	const size_t queueLimit = m_threads * 4;
+
+	CCriticalSection lock;
+	CConditionVariable notEmpty;
+	CConditionVariable notFull;
+	std::deque<SPdnGame*> queue;
+	bool done = false;
+	std::vector<SStats> workerStats( m_threads );
+
+	std::vector<CThread*> threads( m_threads );
+	for( unsigned int i = 0; i < m_threads; ++i )
+	{
+		SStats* pStats = &workerStats[i];
+		threads[i] = new CThread;
+		threads[i]->Start( [&, pStats]() {
+			SPdnReplay replay;
+			for( ;; )
+			{
+				SPdnGame* pGame = NULL;
+				{
+					CScopedLock<CCriticalSection> scopedLock( lock );
+					while( queue.empty() && !done )
+						notEmpty.Wait( lock );
+					if( queue.empty() )
+						break;
+					pGame = queue.front();
+					queue.pop_front();
+					notFull.NotifyOne();
+				}
+
+				pStats->m_games++;
+				if( !CPdn::Replay( *pGame, replay ) )
+					pStats->m_invalidGames++;
+				pStats->m_plies += replay.m_moves.size();
+				if( func )
+					func( *pGame, replay );
+				delete pGame;
+			}
+		} );
+	}
+
+	SStats stats;
+	CPdnReader reader( is );
+	for( ;; )
+	{
+		SPdnGame* pGame = new SPdnGame;
+		if( !reader.ReadGame( *pGame ) )
+		{
+			delete pGame;
+			if( reader.GetError().empty() )
+				break;
+			if( !stats.m_syntaxErrors++ )
+				stats.m_firstSyntaxError = reader.GetError();
+			continue;
+		}
+
+		CScopedLock<CCriticalSection> scopedLock( lock );
+		while( queue.size() >= queueLimit )
+			notFull.Wait( lock );
+		queue.push_back( pGame );
+		notEmpty.NotifyOne();
+	}
+
+	{
+		CScopedLock<CCriticalSection> scopedLock( lock );
+		done = true;
+		notEmpty.NotifyAll();
+	}
+	for( unsigned int i = 0; i < m_threads; ++i )
+	{
+		threads[i]->Join();
+		delete threads[i];
+		stats.m_games += workerStats[i].m_games;
+		stats.m_invalidGames += workerStats[i].m_invalidGames;
+		stats.m_plies += workerStats[i].m_plies;
+	}
+	return stats;
+}
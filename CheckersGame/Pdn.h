@@ -0,0 +1,177 @@
+#pragma once
+
+#include "stdafx.h"
+
+#include "CheckersBoard.h"
+#include "GameBoardBasics.h"
+
+#include <functional>
+#include <iostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+//--------------------------------------------------------------------------------------
+// Portable Draughts Notation support for American checkers.
+//
+// Squares are numbered 1 to 32 row by row from the top of the board, which is where the
+// side that moves first starts.  PDN calls that side Black; here it is Player_Red, so PDN
+// "B" is Player_Red and PDN "W" is Player_Black throughout.
+//--------------------------------------------------------------------------------------
+
+//--------------------------------------------------------------------------------------
+// A move as written: the squares visited and whether it was written as a capture.
+// Captures may list every landing square or only the first and last.
+struct SPdnMove
+{
+	std::vector<unsigned char> m_squares;
+	bool m_capture;
+
+	SPdnMove() : m_capture(false) {}
+};
+
+//--------------------------------------------------------------------------------------
+// One game record: tag pairs, the moves of the main line and the result.
+struct SPdnGame
+{
+	typedef std::vector< std::pair<std::string, std::string> > TTags;
+
+	TTags m_tags;
+	std::vector<SPdnMove> m_moves;
+	// "1-0", "0-1", "1/2-1/2" or "*".
+	std::string m_result;
+	// Line of the input the game started on.
+	unsigned int m_line;
+
+	SPdnGame() : m_line(0) {}
+
+	void Clear() { m_tags.clear(); m_moves.clear(); m_result.clear(); m_line = 0; }
+	const std::string& GetTag( const std::string& name, const std::string& defaultValue = std::string() ) const;
+	void SetTag( const std::string& name, const std::string& value );
+};
+
+//--------------------------------------------------------------------------------------
+// A game played through on a board.
+struct SPdnReplay
+{
+	// Starting position and the player to move in it.
+	CCheckersBoard m_start;
+	EPlayer m_startToMove;
+	// Position after the last valid move and the player to move in it.
+	CCheckersBoard m_board;
+	EPlayer m_toMove;
+	std::vector<CMove> m_moves;
+	// Empty if every move was legal.
+	std::string m_error;
+
+	SPdnReplay() : m_startToMove(Player_Red), m_toMove(Player_Red) {}
+};
+
+//--------------------------------------------------------------------------------------
+// Conversions between PDN and the board types.
+class CPdn
+{
+public:
+	// Square numbers run from 1 to 32.  Returns false for light squares and numbers out of range.
+	static bool SquareToPosition( unsigned int square, SPosition& pos );
+	static unsigned int PositionToSquare( const SPosition& pos );
+
+	// Builds the written form of a move, listing every landing square.
+	static SPdnMove FromMove( const CMove& move );
+	// Formats "11-15" or "9x18x27".
+	static std::string ToString( const SPdnMove& move );
+	// Parses a move token. Move strength marks such as "!" or "?" are ignored.
+	static bool Parse( const std::string& text, SPdnMove& move );
+
+	// Finds the legal move the written move stands for. Fails if none or more than one match.
+	static bool FindMove( const CCheckersBoard& board, EPlayer player, const SPdnMove& written, CMove& move );
+
+	// Reads and writes the FEN tag, e.g. "B:W21,22,K30:B1,2,K9". Ranges such as "1-12" are accepted.
+	static bool ParseFen( const std::string& fen, CCheckersBoard& board, EPlayer& toMove );
+	static std::string ToFen( const CCheckersBoard& board, EPlayer toMove );
+
+	// Plays the game through MakeMoveIfValid from its FEN or the initial position.
+	// Returns false and fills m_error at the first move that is not legal.
+	static bool Replay( const SPdnGame& game, SPdnReplay& replay );
+};
+
+//--------------------------------------------------------------------------------------
+// Reads games one at a time so files of any size are read with bounded memory.
+// Comments, variations and NAGs are skipped.
+class CPdnReader
+{
+public:
+	CPdnReader( std::istream& is );
+
+	// Reads the next game. Returns false at the end of the input or on a syntax error, which
+	// GetError describes.  After an error the reader skips to the next game.
+	bool ReadGame( SPdnGame& game );
+
+	const std::string& GetError() const { return m_error; }
+	unsigned int GetLine() const { return m_line; }
+
+private:
+	std::streambuf* m_pBuffer;
+	unsigned int m_line;
+	std::string m_error;
+	std::string m_token;
+
+	int Peek() { return m_pBuffer->sgetc(); }
+	int Get();
+	// Skips whitespace and returns the next character without taking it.
+	int SkipSpace();
+	// Skips everything up to and including the given character.
+	void SkipPast( int end );
+	bool ReadTag( SPdnGame& game );
+	// Reads a run of characters that are not whitespace or PDN punctuation into m_token.
+	void ReadToken();
+	// Skips to the next line starting with '[' after an error.
+	void Resync();
+	bool Fail( const std::string& error );
+};
+
+//--------------------------------------------------------------------------------------
+// Writes games in PDN, wrapping the move text.
+class CPdnWriter
+{
+public:
+	CPdnWriter( std::ostream& os ) : m_os(os) {}
+
+	void WriteGame( const SPdnGame& game );
+
+private:
+	std::ostream& m_os;
+
+	CPdnWriter& operator=( const CPdnWriter& );
+};
+
+//--------------------------------------------------------------------------------------
+// Replays every game of a PDN stream on a pool of threads.  The calling thread parses and
+// hands games to the workers through a small bounded queue, so memory use does not grow
+// with the size of the input.
+class CPdnBatchReplay
+{
+public:
+	// Called on a worker thread for each game that parsed; check replay.m_error for validity.
+	typedef std::function<void ( const SPdnGame& game, const SPdnReplay& replay )> TGameFunc;
+
+	struct SStats
+	{
+		unsigned int m_games;
+		unsigned int m_invalidGames;
+		unsigned int m_syntaxErrors;
+		unsigned __int64 m_plies;
+		// Where parsing first went wrong, if it did.
+		std::string m_firstSyntaxError;
+
+		SStats() : m_games(0), m_invalidGames(0), m_syntaxErrors(0), m_plies(0) {}
+	};
+
+	// threads of 0 uses every core.
+	CPdnBatchReplay( unsigned int threads = 0 );
+
+	SStats Run( std::istream& is, const TGameFunc& func = TGameFunc() );
+
+private:
+	unsigned int m_threads;
+};
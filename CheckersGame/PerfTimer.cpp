@@ -1,23 +1,83 @@
 #include "StdAfx.h"
 #include "PerfTimer.h"
 
-bool CPerfTimer::s_init = false;
+#include <string.h>
+
+CPerfTimer* CPerfTimer::s_pFirst = NULL;
 LARGE_INTEGER CPerfTimer::s_frequency;
+volatile LONG CPerfTimer::s_nextSlot = 0;
+__declspec(thread) unsigned int CPerfTimer::s_threadSlot = 0;
 
-std::ostream& operator <<(std::ostream& os, const CPerfTimer& timer)
+//--------------------------------------------------------------------------------------
+CPerfTimer::CPerfTimer( const std::string& name )
+	: m_name( name )
+	, m_pNext( s_pFirst )
+{
+	// Timers are statics, constructed one at a time before main.
+	s_pFirst = this;
+	QueryPerformanceFrequency( &s_frequency );
+	memset( m_slots, 0, sizeof( m_slots ) );
+}
+
+//--------------------------------------------------------------------------------------
+unsigned __int64 CPerfTimer::GetCalls() const
+{
+	unsigned __int64 calls = 0;
+	for( int i = 0; i < SlotCount; ++i )
+		calls += m_slots[i].m_calls;
+	return calls;
+}
+
+//--------------------------------------------------------------------------------------
+unsigned __int64 CPerfTimer::GetTotalUs() const
+{
+	unsigned __int64 ticks = 0;
+	for( int i = 0; i < SlotCount; ++i )
+		ticks += m_slots[i].m_ticks;
+	return s_frequency.QuadPart ? ( ticks * 1000000 ) / s_frequency.QuadPart : 0;
+}
+
+//--------------------------------------------------------------------------------------
+void CPerfTimer::Reset()
 {
-	double callsPerUsec = (double)timer.m_totalTime / (double)timer.m_calls;
-	if( timer.m_calls > 10000 )
+	memset( m_slots, 0, sizeof( m_slots ) );
+}
+
+//--------------------------------------------------------------------------------------
+void CPerfTimer::ReportAll( std::ostream& os )
+{
+	for( const CPerfTimer* pTimer = s_pFirst; pTimer; pTimer = pTimer->m_pNext )
 	{
-		os << "---------------------------------------------------" << std::endl;
-		os << timer.m_name << ": " << callsPerUsec * 10000 << " us/kcall" << std::endl;
-		os << timer.m_name << ": " << timer.m_calls / 10000.f << " kcalls" << std::endl;
+		if( pTimer->GetCalls() )
+			os << *pTimer;
 	}
-	else
+}
+
+//--------------------------------------------------------------------------------------
+void CPerfTimer::ResetAll()
+{
+	for( CPerfTimer* pTimer = s_pFirst; pTimer; pTimer = pTimer->m_pNext )
+		pTimer->Reset();
+}
+
+//--------------------------------------------------------------------------------------
+std::ostream& operator <<(std::ostream& os, const CPerfTimer& timer)
+{
+	const unsigned __int64 calls = timer.GetCalls();
+	const unsigned __int64 totalUs = timer.GetTotalUs();
+	os << "---------------------------------------------------" << std::endl;
+	// Counting builds do not read the clock, so there is no time to show.
+	if( totalUs )
 	{
-		os << "---------------------------------------------------" << std::endl;
-		os << timer.m_name << ": " << callsPerUsec << " us/call" << std::endl;
-		os << timer.m_name << ": " << timer.m_calls << " calls" << std::endl;
+		double usPerCall = calls ? (double)totalUs / (double)calls : 0.0;
+		if( calls > 10000 )
+			os << timer.m_name << ": " << usPerCall * 1000 << " us/kcall" << std::endl;
+		else
+			os << timer.m_name << ": " << usPerCall << " us/call" << std::endl;
 	}
+	if( calls > 10000 )
+		os << timer.m_name << ": " << calls / 1000.0 << " kcalls" << std::endl;
+	else
+		os << timer.m_name << ": " << calls << " calls" << std::endl;
 	return os;
 }
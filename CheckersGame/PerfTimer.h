@@ -4,54 +4,132 @@
 #include <windows.h>
 #include <iostream>
 
-class CPerfTimerCall;
+//--------------------------------------------------------------------------------------
+// Instrumentation levels of CPerfTimerScope, chosen at build time.
+#define PERF_LEVEL_OFF		0	// Compiled out entirely.
+#define PERF_LEVEL_COUNT	1	// Counts calls per thread without reading the clock.
+#define PERF_LEVEL_TIME		2	// Counts calls and times them with the performance counter.
 
+// Level of the hot paths.  Debug builds time them and release builds pay nothing.  Define
+// PERF_LEVEL, or the level of a single class such as CHECKERS_BOARD_PERF_LEVEL, to override.
+#ifndef PERF_LEVEL
+#ifdef _DEBUG
+#define PERF_LEVEL PERF_LEVEL_TIME
+#else
+#define PERF_LEVEL PERF_LEVEL_OFF
+#endif
+#endif
+
+template <int level> class CPerfTimerScope;
+
+//--------------------------------------------------------------------------------------
+// Call count and inclusive time of one function, summed over all threads.
 class CPerfTimer
 {
-	friend class CPerfTimerCall;
+	template <int level> friend class CPerfTimerScope;
 public:
-	CPerfTimer( const std::string& name ) : m_name(name), m_totalTime(0), m_calls(0) { Init(); }
+	CPerfTimer( const std::string& name );
 	~CPerfTimer(void) {}
 
-	friend std::ostream& operator <<(std::ostream& os, const CPerfTimer& timer);
+	const std::string& GetName() const { return m_name; }
+	unsigned __int64 GetCalls() const;
+	unsigned __int64 GetTotalUs() const;
+	void Reset();
 
-protected:
-	void StartCall() 
-	{ 
-		QueryPerformanceCounter(&m_lastTime); 
-		m_calls++; 
-	}
-	void EndCall() 
-	{ 		
-		LARGE_INTEGER endTime; 
-		QueryPerformanceCounter(&endTime); 
-		m_totalTime += ((endTime.QuadPart - m_lastTime.QuadPart) * 1000000) / s_frequency.QuadPart; 
-	}
+	// Prints every timer that has been called since the last reset.
+	static void ReportAll( std::ostream& os );
+	static void ResetAll();
+
+	friend std::ostream& operator <<(std::ostream& os, const CPerfTimer& timer);
 
 private:
-	static bool s_init;
+	// Each thread counts in a slot of its own on a separate cache line, so counting needs no
+	// locked instructions.  Threads beyond SlotCount share slots and may lose the odd count.
+	enum { SlotCount = 64, CacheLineSize = 64 };
+	struct SSlot
+	{
+		unsigned __int64 m_calls;
+		unsigned __int64 m_ticks;
+		char m_padding[ CacheLineSize - 2 * sizeof( unsigned __int64 ) ];
+	};
+
+	static CPerfTimer* s_pFirst;
 	static LARGE_INTEGER s_frequency;
-	static void Init()
+	static volatile LONG s_nextSlot;
+	// One more than the slot of the calling thread, 0 until it first counts.
+	static __declspec(thread) unsigned int s_threadSlot;
+
+	std::string m_name;
+	CPerfTimer* m_pNext;
+	SSlot m_slots[ SlotCount ];
+
+	SSlot& GetSlot()
 	{
-		if( !s_init )
-		{
-			s_init = true;
-			QueryPerformanceFrequency(&s_frequency);
-		}
+		if( !s_threadSlot )
+			s_threadSlot = (unsigned int)( InterlockedIncrement( &s_nextSlot ) - 1 ) % SlotCount + 1;
+		return m_slots[ s_threadSlot - 1 ];
+	}
+};
+
+//--------------------------------------------------------------------------------------
+// Instruments the enclosing scope at the given level.
+template <>
+class CPerfTimerScope<PERF_LEVEL_OFF>
+{
+public:
+	CPerfTimerScope( CPerfTimer& ) {}
+};
+
+template <>
+class CPerfTimerScope<PERF_LEVEL_COUNT>
+{
+public:
+	CPerfTimerScope( CPerfTimer& timer ) { timer.GetSlot().m_calls++; }
+};
+
+template <>
+class CPerfTimerScope<PERF_LEVEL_TIME>
+{
+public:
+	CPerfTimerScope( CPerfTimer& timer ) : m_slot( timer.GetSlot() )
+	{
+		m_slot.m_calls++;
+		QueryPerformanceCounter( &m_start );
+	}
+	~CPerfTimerScope()
+	{
+		// Ticks are converted when reported, keeping the divide out of the hot path.
+		LARGE_INTEGER end;
+		QueryPerformanceCounter( &end );
+		m_slot.m_ticks += end.QuadPart - m_start.QuadPart;
 	}
 
 private:
-	std::string m_name;
-	LARGE_INTEGER m_lastTime;
-	unsigned __int64 m_totalTime;
-	unsigned int m_calls;
+	CPerfTimer::SSlot& m_slot;
+	LARGE_INTEGER m_start;
 };
 
-class CPerfTimerCall
+// Instruments a scope at the default level.
+typedef CPerfTimerScope<PERF_LEVEL> CPerfTimerCall;
+
+//--------------------------------------------------------------------------------------
+// Measures elapsed wall time with the performance counter.
+class CStopwatch
 {
 public:
-	CPerfTimerCall( CPerfTimer& timer ) : m_timer(timer) { m_timer.StartCall(); }
-	~CPerfTimerCall() { m_timer.EndCall(); }
+	CStopwatch() { Restart(); }
+
+	void Restart() { QueryPerformanceCounter( &m_start ); }
+
+	unsigned __int64 GetElapsedUs() const
+	{
+		LARGE_INTEGER now, frequency;
+		QueryPerformanceCounter( &now );
+		QueryPerformanceFrequency( &frequency );
+		return ( ( now.QuadPart - m_start.QuadPart ) * 1000000 ) / frequency.QuadPart;
+	}
+	unsigned __int64 GetElapsedMs() const { return GetElapsedUs() / 1000; }
+
 private:
-	CPerfTimer& m_timer;
+	LARGE_INTEGER m_start;
 };
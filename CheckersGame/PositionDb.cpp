@@ -0,0 +1,403 @@
+#include "StdAfx.h"
+#include "PositionDb.h"
+
+#include "Pdn.h"
+#include "Threading.h"
+
+#include <vector>
+
+namespace
+{
+	//--------------------------------------------------------------------------------------
+	struct SPositionDbHeader
+	{
+		char m_magic[4];
+		unsigned int m_version;
+		unsigned __int64 m_count;
+	};
+
+	// Readers on other machines depend on this layout.
+	static_assert( sizeof( SPositionDbHeader ) == 16, "position database header must be 16 bytes" );
+	static_assert( sizeof( SPositionRecord ) == 16, "position records must be 16 bytes" );
+
+	const char kMagic[4] = { 'C', 'K', 'P', 'D' };
+	const unsigned int kVersion = 1;
+	const unsigned int kSquareCount = 32;
+
+	//--------------------------------------------------------------------------------------
+	// Board position of every PDN square, filled before main runs.
+	struct SSquareTable
+	{
+		SPosition m_positions[kSquareCount];
+
+		SSquareTable()
+		{
+			for( unsigned int i = 0; i < kSquareCount; ++i )
+				CPdn::SquareToPosition( i + 1, m_positions[i] );
+		}
+	};
+	const SSquareTable s_squares;
+}
+
+//--------------------------------------------------------------------------------------
+void SPositionRecord::FromBoard( const CCheckersBoard& board, EPlayer toMove )
+{
+	m_red = 0;
+	m_black = 0;
+	m_kings = 0;
+	for( unsigned int i = 0; i < kSquareCount; ++i )
+	{
+		const unsigned int bit = 1u << i;
+		switch( board.GetSquareState( s_squares.m_positions[i] ) )
+		{
+		case SquareState_RedKing:
+			m_kings |= bit;
+			// Fall through.
+		case SquareState_Red:
+			m_red |= bit;
+			break;
+		case SquareState_BlackKing:
+			m_kings |= bit;
+			// Fall through.
+		case SquareState_Black:
+			m_black |= bit;
+			break;
+		default:
+			break;
+		}
+	}
+
+	if( toMove == Player_Red )
+		m_flags |= Flag_RedToMove;
+	else
+		m_flags &= ~Flag_RedToMove;
+}
+
+//--------------------------------------------------------------------------------------
+void SPositionRecord::ToBoard( CCheckersBoard& board ) const
+{
+	board.Clear();
+	for( unsigned int i = 0; i < kSquareCount; ++i )
+	{
+		const unsigned int bit = 1u << i;
+		const bool isKing = ( m_kings & bit ) != 0;
+		if( m_red & bit )
+			board.SetSquareState( s_squares.m_positions[i], isKing ? SquareState_RedKing : SquareState_Red );
+		else if( m_black & bit )
+			board.SetSquareState( s_squares.m_positions[i], isKing ? SquareState_BlackKing : SquareState_Black );
+	}
+}
+
+//--------------------------------------------------------------------------------------
+bool CPositionDbWriter::Open( const std::string& path )
+{
+	Close();
+	m_count = 0;
+	m_file.open( path.c_str(), std::ios::out | std::ios::binary | std::ios::trunc );
+	if( !m_file )
+		return false;
+
+	WriteHeader();
+	return m_file.good();
+}
+
+//--------------------------------------------------------------------------------------
+void CPositionDbWriter::Close()
+{
+	if( !m_file.is_open() )
+		return;
+
+	m_file.seekp( 0 );
+	WriteHeader();
+	m_file.close();
+}
+
+//--------------------------------------------------------------------------------------
+void CPositionDbWriter::Append( const SPositionRecord& record )
+{
+	m_file.write( (const char*)&record, sizeof( record ) );
+	m_count++;
+}
+
+//--------------------------------------------------------------------------------------
+void CPositionDbWriter::WriteHeader()
+{
+	SPositionDbHeader header;
+	memcpy( header.m_magic, kMagic, sizeof( kMagic ) );
+	header.m_version = kVersion;
+	header.m_count = m_count;
+	m_file.write( (const char*)&header, sizeof( header ) );
+}
+
+//--------------------------------------------------------------------------------------
+CConcurrentPositionDbWriter::CConcurrentPositionDbWriter()
+	: m_file( INVALID_HANDLE_VALUE )
+	, m_count( 0 )
+	, m_failed( 0 )
+{
+}
+
+//--------------------------------------------------------------------------------------
+bool CConcurrentPositionDbWriter::Open( const std::string& path )
+{
+	Close();
+	m_count = 0;
+	m_failed = 0;
+	m_file = CreateFileA( path.c_str(), GENERIC_WRITE, 0, NULL, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL );
+	return m_file != INVALID_HANDLE_VALUE;
+}
+
+//--------------------------------------------------------------------------------------
+bool CConcurrentPositionDbWriter::Close()
+{
+	if( m_file == INVALID_HANDLE_VALUE )
+		return true;
+
+	SPositionDbHeader header;
+	memcpy( header.m_magic, kMagic, sizeof( kMagic ) );
+	header.m_version = kVersion;
+	header.m_count = m_count;
+	bool written = WriteAt( 0, &header, sizeof( header ) ) && !m_failed;
+	CloseHandle( m_file );
+	m_file = INVALID_HANDLE_VALUE;
+	return written;
+}
+
+//--------------------------------------------------------------------------------------
+bool CConcurrentPositionDbWriter::AppendBlock( const SPositionRecord* pRecords, size_t count )
+{
+	if( !count )
+		return true;
+
+	// The add hands every block its own range of records; nothing else is shared.
+	const unsigned __int64 first = (unsigned __int64)InterlockedExchangeAdd64( &m_count, (LONGLONG)count );
+	if( WriteAt( sizeof( SPositionDbHeader ) + first * sizeof( SPositionRecord ), pRecords, count * sizeof( SPositionRecord ) ) )
+		return true;
+
+	InterlockedExchange( &m_failed, 1 );
+	return false;
+}
+
+//--------------------------------------------------------------------------------------
+bool CConcurrentPositionDbWriter::WriteAt( unsigned __int64 offset, const void* pData, size_t bytes )
+{
+	// An offset in the OVERLAPPED makes this a positioned write on a synchronous handle.
+	OVERLAPPED overlapped;
+	memset( &overlapped, 0, sizeof( overlapped ) );
+	overlapped.Offset = (DWORD)offset;
+	overlapped.OffsetHigh = (DWORD)( offset >> 32 );
+	DWORD written = 0;
+	return WriteFile( m_file, pData, (DWORD)bytes, &written, &overlapped ) && written == bytes;
+}
+
+//--------------------------------------------------------------------------------------
+CPositionDbThreadWriter::CPositionDbThreadWriter( CConcurrentPositionDbWriter& writer, size_t blockRecords )
+	: m_writer( writer )
+	, m_blockRecords( blockRecords ? blockRecords : 1 )
+{
+	m_block.reserve( m_blockRecords );
+}
+
+//--------------------------------------------------------------------------------------
+void CPositionDbThreadWriter::Flush()
+{
+	if( m_block.empty() )
+		return;
+	m_writer.AppendBlock( &m_block[0], m_block.size() );
+	m_block.clear();
+}
+
+//--------------------------------------------------------------------------------------
+CPositionDb::CPositionDb()
+	: m_file( INVALID_HANDLE_VALUE )
+	, m_mapping( NULL )
+	, m_fileSize( 0 )
+	, m_count( 0 )
+{
+}
+
+//--------------------------------------------------------------------------------------
+bool CPositionDb::Open( const std::string& path )
+{
+	Close();
+
+	m_file = CreateFileA( path.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL );
+	if( m_file == INVALID_HANDLE_VALUE )
+		return false;
+
+	LARGE_INTEGER size;
+	if( !GetFileSizeEx( m_file, &size ) || size.QuadPart < (LONGLONG)sizeof( SPositionDbHeader ) )
+	{
+		Close();
+		return false;
+	}
+	m_fileSize = size.QuadPart;
+
+	m_mapping = CreateFileMappingA( m_file, NULL, PAGE_READONLY, 0, 0, NULL );
+	if( !m_mapping )
+	{
+		Close();
+		return false;
+	}
+
+	// The header is small enough to read through a throwaway view.
+	const SPositionDbHeader* pHeader = (const SPositionDbHeader*)MapViewOfFile( m_mapping, FILE_MAP_READ, 0, 0, sizeof( SPositionDbHeader ) );
+	bool valid = pHeader && memcmp( pHeader->m_magic, kMagic, sizeof( kMagic ) ) == 0 && pHeader->m_version == kVersion;
+	unsigned __int64 headerCount = valid ? pHeader->m_count : 0;
+	if( pHeader )
+		UnmapViewOfFile( pHeader );
+	if( !valid )
+	{
+		Close();
+		return false;
+	}
+
+	// A writer that never closed leaves a count of zero; trust the file size then.
+	unsigned __int64 sizeCount = ( m_fileSize - sizeof( SPositionDbHeader ) ) / sizeof( SPositionRecord );
+	m_count = ( headerCount && headerCount <= sizeCount ) ? headerCount : sizeCount;
+	return true;
+}
+
+//--------------------------------------------------------------------------------------
+void CPositionDb::Close()
+{
+	if( m_mapping )
+		CloseHandle( m_mapping );
+	if( m_file != INVALID_HANDLE_VALUE )
+		CloseHandle( m_file );
+	m_mapping = NULL;
+	m_file = INVALID_HANDLE_VALUE;
+	m_fileSize = 0;
+	m_count = 0;
+}
+
+//--------------------------------------------------------------------------------------
+void CPositionDb::ParallelScan( const TBlockFunc& func, unsigned int threads, size_t blockRecords ) const
+{
+	if( !threads )
+		threads = CThread::GetHardwareThreadCount();
+	if( !blockRecords )
+		blockRecords = DefaultBlockRecords;
+
+	const unsigned __int64 blockCount = ( m_count + blockRecords - 1 ) / blockRecords;
+	if( threads > blockCount )
+		threads = blockCount ? (unsigned int)blockCount : 1;
+
+	volatile LONG nextBlock = 0;
+	std::vector<CThread*> workers( threads );
+	for( unsigned int i = 0; i < threads; ++i )
+	{
+		workers[i] = new CThread;
+		workers[i]->Start( [&]() {
+			CPositionDbCursor cursor( *this );
+			for( ;; )
+			{
+				unsigned __int64 block = (unsigned __int64)( InterlockedIncrement( &nextBlock ) - 1 );
+				if( block >= blockCount )
+					break;
+
+				// A block may straddle two cursor windows.
+				unsigned __int64 index = block * blockRecords;
+				unsigned __int64 end = index + blockRecords;
+				if( end > m_count )
+					end = m_count;
+				while( index < end )
+				{
+					size_t count = (size_t)( end - index );
+					const SPositionRecord* pRecords = cursor.GetBlock( index, count );
+					if( !pRecords || !count )
+						break;
+					func( pRecords, count, index );
+					index += count;
+				}
+			}
+		} );
+	}
+
+	for( unsigned int i = 0; i < threads; ++i )
+	{
+		workers[i]->Join();
+		delete workers[i];
+	}
+}
+
+//--------------------------------------------------------------------------------------
+CPositionDbCursor::CPositionDbCursor( const CPositionDb& db, size_t windowBytes )
+	: m_db( db )
+	, m_windowBytes( windowBytes )
+	, m_pView( NULL )
+	, m_viewOffset( 0 )
+	, m_viewBytes( 0 )
+{
+	// Views start on allocation granularity boundaries, so round the window to it.
+	SYSTEM_INFO info;
+	GetSystemInfo( &info );
+	size_t granularity = info.dwAllocationGranularity;
+	m_windowBytes = ( ( m_windowBytes + granularity - 1 ) / granularity ) * granularity;
+	if( !m_windowBytes )
+		m_windowBytes = granularity;
+}
+
+//--------------------------------------------------------------------------------------
+const SPositionRecord* CPositionDbCursor::Get( unsigned __int64 index )
+{
+	size_t count = 1;
+	return GetBlock( index, count );
+}
+
+//--------------------------------------------------------------------------------------
+const SPositionRecord* CPositionDbCursor::GetBlock( unsigned __int64 index, size_t& count )
+{
+	if( index >= m_db.m_count )
+	{
+		count = 0;
+		return NULL;
+	}
+
+	unsigned __int64 offset = sizeof( SPositionDbHeader ) + index * sizeof( SPositionRecord );
+	if( !m_pView || offset < m_viewOffset || offset + sizeof( SPositionRecord ) > m_viewOffset + m_viewBytes )
+	{
+		if( !Map( offset ) )
+		{
+			count = 0;
+			return NULL;
+		}
+	}
+
+	// Windows and the header are multiples of the record size, so records never straddle views.
+	size_t available = (size_t)( ( m_viewOffset + m_viewBytes - offset ) / sizeof( SPositionRecord ) );
+	unsigned __int64 remaining = m_db.m_count - index;
+	if( available > remaining )
+		available = (size_t)remaining;
+	if( count > available )
+		count = available;
+	return (const SPositionRecord*)( m_pView + ( offset - m_viewOffset ) );
+}
+
+//--------------------------------------------------------------------------------------
+bool CPositionDbCursor::Map( unsigned __int64 offset )
+{
+	Unmap();
+
+	unsigned __int64 start = ( offset / m_windowBytes ) * m_windowBytes;
+	unsigned __int64 bytes = m_db.m_fileSize - start;
+	if( bytes > m_windowBytes )
+		bytes = m_windowBytes;
+
+	m_pView = (const char*)MapViewOfFile( m_db.m_mapping, FILE_MAP_READ, (DWORD)( start >> 32 ), (DWORD)start, (SIZE_T)bytes );
+	if( !m_pView )
+		return false;
+	m_viewOffset = start;
+	m_viewBytes = (size_t)bytes;
+	return true;
+}
+
+//--------------------------------------------------------------------------------------
+void CPositionDbCursor::Unmap()
+{
+	if( m_pView )
+		UnmapViewOfFile( m_pView );
+	m_pView = NULL;
+	m_viewOffset = 0;
+	m_viewBytes = 0;
+}
@@ -0,0 +1,197 @@
+#pragma once
+
+#include "stdafx.h"
+
+#include "CheckersBoard.h"
+
+#include <fstream>
+#include <functional>
+#include <string>
+#include <vector>
+
+//--------------------------------------------------------------------------------------
+// A position packed into 16 bytes for position databases.
+// Bit n of each mask is PDN square n + 1 (see Pdn.h), so the layout does not depend on
+// how CCheckersBoard stores its bitboards.
+struct SPositionRecord
+{
+	enum EFlags
+	{
+		Flag_RedToMove = 1 << 0,
+		// m_score holds a search or evaluation score.
+		Flag_HasScore = 1 << 1,
+	};
+
+	enum EResult
+	{
+		Result_BlackWin = -1,
+		Result_Draw = 0,
+		Result_RedWin = 1,
+		Result_Unknown = 2,
+	};
+
+	unsigned int m_red;
+	unsigned int m_black;
+	unsigned int m_kings;
+	// From the point of view of the player to move.
+	short m_score;
+	unsigned char m_flags;
+	// EResult of the game the position came from.
+	signed char m_result;
+
+	SPositionRecord() : m_red(0), m_black(0), m_kings(0), m_score(0), m_flags(0), m_result(Result_Unknown) {}
+
+	void FromBoard( const CCheckersBoard& board, EPlayer toMove );
+	void ToBoard( CCheckersBoard& board ) const;
+	EPlayer GetPlayerToMove() const { return ( m_flags & Flag_RedToMove ) ? Player_Red : Player_Black; }
+};
+
+//--------------------------------------------------------------------------------------
+// Appends position records to a database file.
+// Layout: a 16 byte SPositionDbHeader followed by the records, little endian.
+class CPositionDbWriter
+{
+public:
+	CPositionDbWriter() : m_count(0) {}
+	~CPositionDbWriter() { Close(); }
+
+	// Creates or truncates the file.
+	bool Open( const std::string& path );
+	// Writes the final record count into the header.
+	void Close();
+
+	void Append( const SPositionRecord& record );
+	unsigned __int64 GetCount() const { return m_count; }
+
+private:
+	std::ofstream m_file;
+	unsigned __int64 m_count;
+
+	void WriteHeader();
+};
+
+//--------------------------------------------------------------------------------------
+// Appends blocks of records to a database file from many threads at once without a lock.
+// Each block claims its place in the file with an interlocked add on the record count and
+// is written there with a positioned write, so blocks of different threads interleave but
+// never overlap.  The header is written by Close once every thread has finished.
+class CConcurrentPositionDbWriter
+{
+public:
+	CConcurrentPositionDbWriter();
+	~CConcurrentPositionDbWriter() { Close(); }
+
+	// Creates or truncates the file.
+	bool Open( const std::string& path );
+	// Writes the final record count into the header. Returns false if any write failed.
+	bool Close();
+
+	// May be called from any thread. Returns false if the write failed.
+	bool AppendBlock( const SPositionRecord* pRecords, size_t count );
+	unsigned __int64 GetCount() const { return (unsigned __int64)m_count; }
+
+private:
+	HANDLE m_file;
+	volatile LONGLONG m_count;
+	volatile LONG m_failed;
+
+	bool WriteAt( unsigned __int64 offset, const void* pData, size_t bytes );
+
+	CConcurrentPositionDbWriter( const CConcurrentPositionDbWriter& );
+	CConcurrentPositionDbWriter& operator=( const CConcurrentPositionDbWriter& );
+};
+
+//--------------------------------------------------------------------------------------
+// Collects one thread's records and hands them to a concurrent writer a block at a time.
+// Use one per thread; whatever is left is written when it is destroyed.
+class CPositionDbThreadWriter
+{
+public:
+	enum { DefaultBlockRecords = 1 << 14 };
+
+	CPositionDbThreadWriter( CConcurrentPositionDbWriter& writer, size_t blockRecords = DefaultBlockRecords );
+	~CPositionDbThreadWriter() { Flush(); }
+
+	void Append( const SPositionRecord& record )
+	{
+		m_block.push_back( record );
+		if( m_block.size() >= m_blockRecords )
+			Flush();
+	}
+	void Flush();
+
+private:
+	CConcurrentPositionDbWriter& m_writer;
+	size_t m_blockRecords;
+	std::vector<SPositionRecord> m_block;
+
+	CPositionDbThreadWriter( const CPositionDbThreadWriter& );
+	CPositionDbThreadWriter& operator=( const CPositionDbThreadWriter& );
+};
+
+//--------------------------------------------------------------------------------------
+// A position database opened read only through a file mapping. The database itself maps
+// nothing; reads go through cursors, each of which maps a window of the file, so files far
+// larger than the address space of a 32 bit process can be read.
+class CPositionDb
+{
+	friend class CPositionDbCursor;
+public:
+	// Called with blocks of records that are read straight from the mapping.
+	typedef std::function<void ( const SPositionRecord* pRecords, size_t count, unsigned __int64 firstIndex )> TBlockFunc;
+
+	CPositionDb();
+	~CPositionDb() { Close(); }
+
+	bool Open( const std::string& path );
+	void Close();
+	bool IsOpen() const { return m_mapping != NULL; }
+
+	unsigned __int64 GetCount() const { return m_count; }
+
+	// Calls func for every record, split into blocks handed out to threads as they finish
+	// the last. threads of 0 uses every core. Blocks arrive in no particular order.
+	void ParallelScan( const TBlockFunc& func, unsigned int threads = 0, size_t blockRecords = DefaultBlockRecords ) const;
+
+	enum { DefaultBlockRecords = 1 << 16 };
+
+private:
+	HANDLE m_file;
+	HANDLE m_mapping;
+	unsigned __int64 m_fileSize;
+	unsigned __int64 m_count;
+
+	CPositionDb( const CPositionDb& );
+	CPositionDb& operator=( const CPositionDb& );
+};
+
+//--------------------------------------------------------------------------------------
+// A mapped window over a CPositionDb. Use one per thread.
+class CPositionDbCursor
+{
+public:
+	enum { DefaultWindowBytes = 64 << 20 };
+
+	CPositionDbCursor( const CPositionDb& db, size_t windowBytes = DefaultWindowBytes );
+	~CPositionDbCursor() { Unmap(); }
+
+	// Returns the record, or NULL past the end. Valid until the cursor moves to another window.
+	const SPositionRecord* Get( unsigned __int64 index );
+	// Returns up to count records from index on that are mapped together and sets count to
+	// how many there are.
+	const SPositionRecord* GetBlock( unsigned __int64 index, size_t& count );
+
+private:
+	const CPositionDb& m_db;
+	size_t m_windowBytes;
+	const char* m_pView;
+	unsigned __int64 m_viewOffset;
+	size_t m_viewBytes;
+
+	// Maps the window holding the byte offset.
+	bool Map( unsigned __int64 offset );
+	void Unmap();
+
+	CPositionDbCursor( const CPositionDbCursor& );
+	CPositionDbCursor& operator=( const CPositionDbCursor& );
+};
@@ -0,0 +1,183 @@
+#pragma once
+
+#include "stdafx.h"
+
+#include "GameBoardBasics.h"
+#include "GameHistory.h"
+#include "PerfTimer.h"
+#include "Threading.h"
+
+#include <iostream>
+#include <vector>
+
+//--------------------------------------------------------------------------------------
+// Proves positions won, drawn or lost with depth-first proof-number search (df-pn).  Unlike
+// the ComputerPlayer nothing is scored: a position is proven when every reply is answered
+// by a line ending in a side that cannot move, however deep that is.  Draws are handled in two
+// passes, first proving or disproving a win with draws counted as failures, then, if there
+// is no win, proving or disproving a draw with draws counted as successes.
+//
+// Games are drawn by the no-progress rule of CGameHistory.  The reversible plies played so far
+// are part of a position's key, so no position can recur and every result holds whatever
+// path reached it; repetitions need no special handling since a side that can force one can
+// also force the no-progress draw.
+//
+// Threads share the table and each runs the search from the root; among equally promising
+// children a thread prefers those no other thread is in, so they spread over the tree.
+template <typename TGameBoard>
+class CProofNumberSolver
+{
+public:
+	enum EResult
+	{
+		Result_Unknown,
+		Result_Win,
+		Result_Draw,
+		Result_Loss,
+
+		ResultCount
+	};
+
+	struct SConfig
+	{
+		// Search threads, 0 uses every core.
+		unsigned int m_threads;
+		// Entries in the table, rounded up to a power of two.
+		unsigned int m_tableSize;
+		// Moves per player without a capture or a man moving before a draw, as in CGameHistory.
+		unsigned int m_noProgressMoves;
+		// Lines longer than this are scored as draws, which bounds the recursion.  Far longer
+		// than any game the no-progress rule allows, it is a safeguard.
+		unsigned int m_maxPlies;
+		// Give up with an unknown result after this many nodes or milliseconds, 0 for no limit.
+		unsigned __int64 m_maxNodes;
+		unsigned int m_timeLimitMs;
+		// Milliseconds between progress lines, when a progress stream is given.
+		unsigned int m_reportIntervalMs;
+
+		SConfig() : m_threads(0), m_tableSize(1 << 20), m_noProgressMoves(CGameHistory::DefaultNoProgressMoves), m_maxPlies(1000), m_maxNodes(0), m_timeLimitMs(0), m_reportIntervalMs(1000) {}
+	};
+
+	// Counters from the last Solve, over both passes.
+	struct SStats
+	{
+		unsigned __int64 m_nodes;
+		unsigned __int64 m_elapsedUs;
+		unsigned __int64 m_tableStores;
+		// Stores that evicted another position.
+		unsigned __int64 m_tableReplacements;
+		unsigned int m_passes;
+		unsigned int m_maxPly;
+
+		SStats() : m_nodes(0), m_elapsedUs(0), m_tableStores(0), m_tableReplacements(0), m_passes(0), m_maxPly(0) {}
+	};
+
+	CProofNumberSolver( const SConfig& config );
+	~CProofNumberSolver();
+
+	// Returns the result for the player to move, or unknown if a limit was reached first.
+	// Progress lines are written to pProgress if given.
+	EResult Solve( const TGameBoard& board, EPlayer toMove, std::ostream* pProgress = NULL );
+
+	const SStats& GetLastStats() const { return m_stats; }
+	const SConfig& GetConfig() const { return m_config; }
+
+	// May be called from another thread; Solve returns unknown unless already done.
+	void Stop() { InterlockedExchange( &m_stopRequested, 1 ); }
+
+	static const char* GetResultName( EResult result );
+
+private:
+	// Proof and disproof numbers saturate here; a number at infinity means solved.
+	enum { Infinity = 0x3FFFFFFF };
+	enum { BucketSize = 4, LockCount = 1024 };
+	// Nodes between checks of the limits and the clock.
+	enum { CheckInterval = 1024 };
+
+	// Numbers are kept from the point of view of the player to move, as in Nagai's df-pn:
+	// phi is the proof number of a win for that player and delta its disproof number.
+	struct SEntry
+	{
+		unsigned __int64 m_key;
+		unsigned int m_phi;
+		unsigned int m_delta;
+		// Nodes searched below the position, the replacement priority.
+		unsigned int m_work;
+		// Threads searching below the position now.
+		unsigned int m_workers;
+	};
+
+	// State of one search thread.
+	struct SWorker
+	{
+		unsigned int m_index;
+		unsigned __int64 m_nodes;
+		unsigned __int64 m_tableStores;
+		unsigned __int64 m_tableReplacements;
+		unsigned int m_maxPly;
+
+		SWorker() : m_index(0), m_nodes(0), m_tableStores(0), m_tableReplacements(0), m_maxPly(0) {}
+	};
+
+	// A move from the position being searched and where it leads.
+	struct SChild
+	{
+		TGameBoard m_board;
+		unsigned __int64 m_key;
+		unsigned int m_reversiblePlies;
+		// Drawn by the no-progress rule or the ply limit.
+		bool m_draw;
+	};
+
+	const SConfig m_config;
+	unsigned int m_threads;
+
+	SEntry* m_pTable;
+	unsigned int m_bucketMask;
+	CSpinLock m_locks[LockCount];
+
+	// State of the pass in progress.
+	EPlayer m_drawWinner;
+	unsigned __int64 m_rootKey;
+	volatile LONG m_stop;
+	volatile LONG m_stopRequested;
+	// +1 once the root is proven, -1 once it is disproven.
+	volatile LONG m_outcome;
+	volatile LONGLONG m_totalNodes;
+	CStopwatch m_stopwatch;
+	unsigned __int64 m_lastReportMs;
+	std::ostream* m_pProgress;
+	const char* m_passName;
+	SStats m_stats;
+
+	// Proves or disproves a win for the player to move, draws counting for drawWinner.
+	// Returns the outcome, 0 if a limit was reached.
+	int RunPass( const TGameBoard& board, EPlayer toMove, EPlayer drawWinner, const char* passName );
+	// Searches until phi reaches thPhi or delta reaches thDelta, returning both.
+	void Search( SWorker& worker, const TGameBoard& board, EPlayer toMove, unsigned __int64 key, unsigned int reversiblePlies, unsigned int ply, unsigned int thPhi, unsigned int thDelta, unsigned int& phi, unsigned int& delta );
+	void CheckLimits( SWorker& worker );
+
+	static unsigned __int64 GetKey( const TGameBoard& board, EPlayer toMove, unsigned int reversiblePlies );
+	// Sums of open numbers stop short of infinity, which only a solved position reaches.
+	static unsigned int Add( unsigned int a, unsigned int b )
+	{
+		if( a >= Infinity || b >= Infinity )
+			return Infinity;
+		return ( a + b >= Infinity ) ? Infinity - 1 : a + b;
+	}
+
+	// Table access, each bucket guarded by one of the striped locks.
+	void ClearTable();
+	bool Lookup( unsigned __int64 key, unsigned int& phi, unsigned int& delta, unsigned int& workers );
+	// Counts a thread into the position, creating the entry if it is missing.
+	void Enter( SWorker& worker, unsigned __int64 key );
+	// Solved entries are final for the pass and are never overwritten with open numbers.
+	void Store( SWorker& worker, unsigned __int64 key, unsigned int phi, unsigned int delta, unsigned int work, bool leaving );
+	SEntry* GetBucket( unsigned __int64 key ) { return m_pTable + ( key & m_bucketMask ) * BucketSize; }
+	CSpinLock& GetLock( unsigned __int64 key ) { return m_locks[ ( key & m_bucketMask ) % LockCount ]; }
+	// Returns the entry for the key, claiming the least valuable one of the bucket if absent.
+	SEntry& FindOrReplace( SWorker& worker, SEntry* pBucket, unsigned __int64 key );
+
+	CProofNumberSolver( const CProofNumberSolver& );
+	CProofNumberSolver& operator=( const CProofNumberSolver& );
+};
@@ -0,0 +1,351 @@
+#pragma once
+
+#include "StdAfx.h"
+#include "ProofNumberSolver.h"
+
+#include <algorithm>
+#include <string.h>
+
+//--------------------------------------------------------------------------------------
+template <typename TGameBoard>
+CProofNumberSolver<TGameBoard>::CProofNumberSolver( const SConfig& config )
+	: m_config( config )
+	, m_threads( config.m_threads ? config.m_threads : CThread::GetHardwareThreadCount() )
+	, m_pTable( NULL )
+	, m_bucketMask( 0 )
+	, m_drawWinner( Player_Red )
+	, m_rootKey( 0 )
+	, m_stop( 0 )
+	, m_stopRequested( 0 )
+	, m_outcome( 0 )
+	, m_totalNodes( 0 )
+	, m_lastReportMs( 0 )
+	, m_pProgress( NULL )
+	, m_passName( "" )
+{
+	unsigned int buckets = 1;
+	while( buckets * BucketSize < config.m_tableSize )
+		buckets <<= 1;
+	m_bucketMask = buckets - 1;
+	m_pTable = new SEntry[ buckets * BucketSize ];
+	ClearTable();
+}
+
+//--------------------------------------------------------------------------------------
+template <typename TGameBoard>
+CProofNumberSolver<TGameBoard>::~CProofNumberSolver()
+{
+	delete[] m_pTable;
+}
+
+//--------------------------------------------------------------------------------------
+template <typename TGameBoard>
+const char* CProofNumberSolver<TGameBoard>::GetResultName( EResult result )
+{
+	switch( result )
+	{
+	case Result_Win:
+		return "win";
+	case Result_Draw:
+		return "draw";
+	case Result_Loss:
+		return "loss";
+	default:
+		return "unknown";
+	}
+}
+
+//--------------------------------------------------------------------------------------
+template <typename TGameBoard>
+typename CProofNumberSolver<TGameBoard>::EResult CProofNumberSolver<TGameBoard>::Solve( const TGameBoard& board, EPlayer toMove, std::ostream* pProgress )
+{
+	m_stats = SStats();
+	m_stopwatch.Restart();
+	m_lastReportMs = 0;
+	m_totalNodes = 0;
+	m_stopRequested = 0;
+	m_pProgress = pProgress;
+
+	// Without a win, a draw is proven if the opponent cannot win either.
+	EResult result = Result_Unknown;
+	int outcome = RunPass( board, toMove, TGameBoard::GetOpponent( toMove ), "win" );
+	if( outcome > 0 )
+		result = Result_Win;
+	else if( outcome < 0 )
+	{
+		outcome = RunPass( board, toMove, toMove, "draw" );
+		if( outcome > 0 )
+			result = Result_Draw;
+		else if( outcome < 0 )
+			result = Result_Loss;
+	}
+
+	m_stats.m_elapsedUs = m_stopwatch.GetElapsedUs();
+	return result;
+}
+
+//--------------------------------------------------------------------------------------
+template <typename TGameBoard>
+int CProofNumberSolver<TGameBoard>::RunPass( const TGameBoard& board, EPlayer toMove, EPlayer drawWinner, const char* passName )
+{
+	// The numbers of one pass mean nothing to the other.
+	ClearTable();
+	m_drawWinner = drawWinner;
+	m_passName = passName;
+	m_stop = 0;
+	m_outcome = 0;
+	m_stats.m_passes++;
+
+	m_rootKey = GetKey( board, toMove, 0 );
+	std::vector<SWorker> workers( m_threads );
+	{
+		std::vector<CThread*> threads( m_threads );
+		for( unsigned int i = 0; i < m_threads; ++i )
+		{
+			SWorker* pWorker = &workers[i];
+			pWorker->m_index = i;
+			threads[i] = new CThread;
+			threads[i]->Start( [this, pWorker, &board, toMove]() {
+				unsigned int phi = 0;
+				unsigned int delta = 0;
+				Search( *pWorker, board, toMove, m_rootKey, 0, 0, Infinity, Infinity, phi, delta );
+				if( phi == 0 || delta == 0 )
+				{
+					InterlockedExchange( &m_outcome, ( phi == 0 ) ? 1 : -1 );
+					// The other threads have nothing left to do.
+					InterlockedExchange( &m_stop, 1 );
+				}
+			} );
+		}
+		for( unsigned int i = 0; i < m_threads; ++i )
+		{
+			threads[i]->Join();
+			delete threads[i];
+		}
+	}
+
+	for( unsigned int i = 0; i < m_threads; ++i )
+	{
+		m_stats.m_nodes += workers[i].m_nodes;
+		m_stats.m_tableStores += workers[i].m_tableStores;
+		m_stats.m_tableReplacements += workers[i].m_tableReplacements;
+		if( workers[i].m_maxPly > m_stats.m_maxPly )
+			m_stats.m_maxPly = workers[i].m_maxPly;
+	}
+	return m_outcome;
+}
+
+//--------------------------------------------------------------------------------------
+template <typename TGameBoard>
+void CProofNumberSolver<TGameBoard>::Search( SWorker& worker, const TGameBoard& board, EPlayer toMove, unsigned __int64 key, unsigned int reversiblePlies, unsigned int ply, unsigned int thPhi, unsigned int thDelta, unsigned int& phi, unsigned int& delta )
+{
+	worker.m_nodes++;
+	if( ply > worker.m_maxPly )
+		worker.m_maxPly = ply;
+	if( ( worker.m_nodes % CheckInterval ) == 0 )
+		CheckLimits( worker );
+
+	// A player that cannot move has lost.
+	std::vector<CMove> moves;
+	if( !board.GetMoves( toMove, moves ) || moves.empty() )
+	{
+		phi = Infinity;
+		delta = 0;
+		Store( worker, key, phi, delta, 1, false );
+		return;
+	}
+
+	const EPlayer opponent = TGameBoard::GetOpponent( toMove );
+	const bool drawWinsForOpponent = ( opponent == m_drawWinner );
+	const unsigned int noProgressPlies = m_config.m_noProgressMoves * 2;
+	std::vector<SChild> children( moves.size() );
+	for( size_t i = 0; i < moves.size(); ++i )
+	{
+		SChild& child = children[i];
+		child.m_reversiblePlies = board.IsReversibleMove( toMove, moves[i] ) ? reversiblePlies + 1 : 0;
+		child.m_board = board;
+		child.m_board.MakeMoveIfValid( toMove, moves[i] );
+		child.m_key = GetKey( child.m_board, opponent, child.m_reversiblePlies );
+		child.m_draw = ( noProgressPlies && child.m_reversiblePlies >= noProgressPlies ) || ply + 1 >= m_config.m_maxPlies;
+	}
+
+	const unsigned __int64 startNodes = worker.m_nodes;
+	// Threads start their scan of the children at different places, so ties are broken
+	// differently on each.
+	const size_t first = worker.m_index % children.size();
+	Enter( worker, key );
+	for( ;; )
+	{
+		// phi is the smallest delta of a child: the player to move needs one winning move.
+		// delta counts the replies to refute with weak proof numbers, the largest phi of a
+		// child plus one for every other open child, instead of the sum of their phis.  Kings
+		// reach the same position by many paths, and a sum counts each path again.
+		phi = Infinity;
+		delta = 0;
+		unsigned int maxPhi = 0;
+		unsigned int openChildren = 0;
+		size_t best = first;
+		unsigned int bestWorkers = 0xFFFFFFFF;
+		unsigned int secondDelta = Infinity;
+		for( size_t n = 0; n < children.size(); ++n )
+		{
+			const size_t i = ( first + n ) % children.size();
+			unsigned int childPhi = 1;
+			unsigned int childDelta = 1;
+			unsigned int childWorkers = 0;
+			if( children[i].m_draw )
+			{
+				childPhi = drawWinsForOpponent ? 0 : (unsigned int)Infinity;
+				childDelta = drawWinsForOpponent ? (unsigned int)Infinity : 0;
+			}
+			else
+				Lookup( children[i].m_key, childPhi, childDelta, childWorkers );
+
+			if( childPhi > maxPhi )
+				maxPhi = childPhi;
+			if( childPhi )
+				openChildren++;
+			if( childDelta < phi || ( childDelta == phi && childWorkers < bestWorkers ) )
+			{
+				secondDelta = phi;
+				phi = childDelta;
+				best = i;
+				bestWorkers = childWorkers;
+			}
+			else if( childDelta < secondDelta )
+				secondDelta = childDelta;
+		}
+
+		delta = openChildren ? Add( maxPhi, openChildren - 1 ) : 0;
+		if( phi >= thPhi || delta >= thDelta || m_stop )
+			break;
+
+		// The child is searched until it is no longer the best, with the 1 + epsilon trick
+		// (epsilon 1/4) so it is not left the moment the second best draws level.
+		const unsigned int childThDelta = ( std::min )( thPhi, Add( secondDelta, secondDelta / 4 + 1 ) );
+		// delta reaches its threshold once the child's phi passes the largest by that much.
+		const unsigned int childThPhi = ( thDelta >= Infinity ) ? (unsigned int)Infinity : thDelta - delta + maxPhi;
+		const SChild& child = children[best];
+		unsigned int childPhi = 0;
+		unsigned int childDelta = 0;
+		Search( worker, child.m_board, opponent, child.m_key, child.m_reversiblePlies, ply + 1, childThPhi, childThDelta, childPhi, childDelta );
+	}
+
+	const unsigned __int64 work = worker.m_nodes - startNodes + 1;
+	Store( worker, key, phi, delta, ( work < Infinity ) ? (unsigned int)work : (unsigned int)Infinity, true );
+}
+
+//--------------------------------------------------------------------------------------
+template <typename TGameBoard>
+void CProofNumberSolver<TGameBoard>::CheckLimits( SWorker& worker )
+{
+	const unsigned __int64 nodes = InterlockedExchangeAdd64( &m_totalNodes, CheckInterval ) + CheckInterval;
+	const unsigned __int64 elapsedMs = m_stopwatch.GetElapsedMs();
+	if( m_stopRequested || ( m_config.m_maxNodes && nodes >= m_config.m_maxNodes ) || ( m_config.m_timeLimitMs && elapsedMs >= m_config.m_timeLimitMs ) )
+		InterlockedExchange( &m_stop, 1 );
+
+	// Only the first thread reports, so the lines need no lock.
+	if( worker.m_index != 0 || !m_pProgress || elapsedMs < m_lastReportMs + m_config.m_reportIntervalMs )
+		return;
+	m_lastReportMs = elapsedMs;
+
+	unsigned int phi = 1;
+	unsigned int delta = 1;
+	unsigned int workers = 0;
+	Lookup( m_rootKey, phi, delta, workers );
+	*m_pProgress << "progress pass=" << m_passName
+	             << " nodes=" << nodes
+	             << " rootPhi=" << phi
+	             << " rootDelta=" << delta
+	             << " ms=" << elapsedMs
+	             << " nps=" << ( elapsedMs ? nodes * 1000 / elapsedMs : 0 ) << std::endl;
+}
+
+//--------------------------------------------------------------------------------------
+template <typename TGameBoard>
+unsigned __int64 CProofNumberSolver<TGameBoard>::GetKey( const TGameBoard& board, EPlayer toMove, unsigned int reversiblePlies )
+{
+	// The board key includes neither the player to move nor the plies toward a draw.
+	const unsigned __int64 key = board.GetHashKey() ^ ( ( toMove == Player_Black ) ? 0x9E3779B97F4A7C15ull : 0 );
+	return key + reversiblePlies * 0xD6E8FEB86659FD93ull;
+}
+
+//--------------------------------------------------------------------------------------
+template <typename TGameBoard>
+void CProofNumberSolver<TGameBoard>::ClearTable()
+{
+	memset( m_pTable, 0, sizeof( SEntry ) * ( m_bucketMask + 1 ) * BucketSize );
+}
+
+//--------------------------------------------------------------------------------------
+template <typename TGameBoard>
+bool CProofNumberSolver<TGameBoard>::Lookup( unsigned __int64 key, unsigned int& phi, unsigned int& delta, unsigned int& workers )
+{
+	SEntry* pBucket = GetBucket( key );
+	CScopedLock<CSpinLock> lock( GetLock( key ) );
+	for( int i = 0; i < BucketSize; ++i )
+	{
+		if( pBucket[i].m_key == key )
+		{
+			phi = pBucket[i].m_phi;
+			delta = pBucket[i].m_delta;
+			workers = pBucket[i].m_workers;
+			return true;
+		}
+	}
+	return false;
+}
+
+//--------------------------------------------------------------------------------------
+template <typename TGameBoard>
+void CProofNumberSolver<TGameBoard>::Enter( SWorker& worker, unsigned __int64 key )
+{
+	SEntry* pBucket = GetBucket( key );
+	CScopedLock<CSpinLock> lock( GetLock( key ) );
+	FindOrReplace( worker, pBucket, key ).m_workers++;
+}
+
+//--------------------------------------------------------------------------------------
+template <typename TGameBoard>
+void CProofNumberSolver<TGameBoard>::Store( SWorker& worker, unsigned __int64 key, unsigned int phi, unsigned int delta, unsigned int work, bool leaving )
+{
+	SEntry* pBucket = GetBucket( key );
+	CScopedLock<CSpinLock> lock( GetLock( key ) );
+	SEntry& entry = FindOrReplace( worker, pBucket, key );
+	worker.m_tableStores++;
+	if( leaving && entry.m_workers )
+		entry.m_workers--;
+	if( entry.m_phi == 0 || entry.m_delta == 0 )
+		return;
+
+	entry.m_phi = phi;
+	entry.m_delta = delta;
+	if( work > entry.m_work )
+		entry.m_work = work;
+}
+
+//--------------------------------------------------------------------------------------
+template <typename TGameBoard>
+typename CProofNumberSolver<TGameBoard>::SEntry& CProofNumberSolver<TGameBoard>::FindOrReplace( SWorker& worker, SEntry* pBucket, unsigned __int64 key )
+{
+	// Evict the entry with the least work below it, sparing those a thread is inside.
+	SEntry* pVictim = NULL;
+	for( int i = 0; i < BucketSize; ++i )
+	{
+		SEntry& entry = pBucket[i];
+		if( entry.m_key == key )
+			return entry;
+		if( !pVictim || ( entry.m_workers == 0 && pVictim->m_workers != 0 )
+			|| ( ( entry.m_workers == 0 ) == ( pVictim->m_workers == 0 ) && entry.m_work < pVictim->m_work ) )
+			pVictim = &entry;
+	}
+
+	if( pVictim->m_key )
+		worker.m_tableReplacements++;
+	pVictim->m_key = key;
+	pVictim->m_phi = 1;
+	pVictim->m_delta = 1;
+	pVictim->m_work = 0;
+	pVictim->m_workers = 0;
+	return *pVictim;
+}
@@ -0,0 +1,44 @@
+#pragma once
+
+//--------------------------------------------------------------------------------------
+// Small fast pseudo random generator (xoshiro256**).  Each owner keeps its own state, so
+// threads never share or lock anything and a given seed always gives the same sequence.
+class CRandom
+{
+public:
+	CRandom( unsigned __int64 seed = 0 ) { Seed( seed ); }
+
+	// Expands the seed into the 256 bit state with splitmix64, which never leaves it all zero.
+	void Seed( unsigned __int64 seed )
+	{
+		for( int i = 0; i < 4; ++i )
+		{
+			seed += 0x9E3779B97F4A7C15ull;
+			unsigned __int64 value = seed;
+			value = ( value ^ ( value >> 30 ) ) * 0xBF58476D1CE4E5B9ull;
+			value = ( value ^ ( value >> 27 ) ) * 0x94D049BB133111EBull;
+			m_state[i] = value ^ ( value >> 31 );
+		}
+	}
+
+	unsigned __int64 Next()
+	{
+		const unsigned __int64 result = RotateLeft( m_state[1] * 5, 7 ) * 9;
+		const unsigned __int64 shifted = m_state[1] << 17;
+		m_state[2] ^= m_state[0];
+		m_state[3] ^= m_state[1];
+		m_state[1] ^= m_state[2];
+		m_state[0] ^= m_state[3];
+		m_state[2] ^= shifted;
+		m_state[3] = RotateLeft( m_state[3], 45 );
+		return result;
+	}
+
+	// Returns a value from 0 to count - 1.  The bias for counts far below 2^64 is negligible.
+	unsigned int NextBelow( unsigned int count ) { return count ? (unsigned int)( Next() % count ) : 0; }
+
+private:
+	unsigned __int64 m_state[4];
+
+	static unsigned __int64 RotateLeft( unsigned __int64 value, int bits ) { return ( value << bits ) | ( value >> ( 64 - bits ) ); }
+};
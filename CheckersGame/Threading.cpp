@@ -0,0 +1,43 @@
+#include "StdAfx.h"
+#include "Threading.h"
+
+#include "TraceRecorder.h"
+
+//--------------------------------------------------------------------------------------
+bool CThread::Start( const TThreadFunc& func )
+{
+	if( m_handle )
+		return false;
+
+	m_func = func;
+	m_handle = CreateThread( NULL, 0, &CThread::ThreadProc, this, 0, NULL );
+	return m_handle != NULL;
+}
+
+//--------------------------------------------------------------------------------------
+void CThread::Join()
+{
+	if( !m_handle )
+		return;
+
+	WaitForSingleObject( m_handle, INFINITE );
+	CloseHandle( m_handle );
+	m_handle = NULL;
+}
+
+//--------------------------------------------------------------------------------------
+unsigned int CThread::GetHardwareThreadCount()
+{
+	SYSTEM_INFO info;
+	GetSystemInfo( &info );
+	return info.dwNumberOfProcessors ? info.dwNumberOfProcessors : 1;
+}
+
+//--------------------------------------------------------------------------------------
+DWORD WINAPI CThread::ThreadProc( LPVOID pParam )
+{
+	CThread* pThread = static_cast<CThread*>( pParam );
+	pThread->m_func();
+	CTraceRecorder::ReleaseThreadBuffer();
+	return 0;
+}
@@ -0,0 +1,117 @@
+#pragma once
+
+#include <windows.h>
+#include <functional>
+
+//--------------------------------------------------------------------------------------
+// Busy-waiting lock for very short critical sections such as a single cache lookup.
+class CSpinLock
+{
+public:
+	CSpinLock() : m_locked(0) {}
+
+	void Lock()
+	{
+		while( InterlockedCompareExchange( &m_locked, 1, 0 ) != 0 )
+		{
+			// Spin on a plain read so the cache line is not bounced between cores, and give up
+			// the time slice if the owner looks preempted.
+			for( unsigned int spins = 0; m_locked; ++spins )
+			{
+				if( spins < 1000 )
+					YieldProcessor();
+				else
+					SwitchToThread();
+			}
+		}
+	}
+	void Unlock() { InterlockedExchange( &m_locked, 0 ); }
+
+private:
+	volatile LONG m_locked;
+
+	CSpinLock( const CSpinLock& );
+	CSpinLock& operator=( const CSpinLock& );
+};
+
+//--------------------------------------------------------------------------------------
+// Kernel backed lock for longer critical sections or ones that wait on a condition.
+class CCriticalSection
+{
+	friend class CConditionVariable;
+public:
+	CCriticalSection() { InitializeCriticalSectionAndSpinCount( &m_section, 4000 ); }
+	~CCriticalSection() { DeleteCriticalSection( &m_section ); }
+
+	void Lock() { EnterCriticalSection( &m_section ); }
+	void Unlock() { LeaveCriticalSection( &m_section ); }
+
+private:
+	CRITICAL_SECTION m_section;
+
+	CCriticalSection( const CCriticalSection& );
+	CCriticalSection& operator=( const CCriticalSection& );
+};
+
+//--------------------------------------------------------------------------------------
+// Holds a lock for the lifetime of the object.
+template <typename TLock>
+class CScopedLock
+{
+public:
+	CScopedLock( TLock& lock ) : m_lock(lock) { m_lock.Lock(); }
+	~CScopedLock() { m_lock.Unlock(); }
+private:
+	TLock& m_lock;
+
+	CScopedLock( const CScopedLock& );
+	CScopedLock& operator=( const CScopedLock& );
+};
+
+//--------------------------------------------------------------------------------------
+// Lets threads sleep until another thread signals a change made under a critical section.
+class CConditionVariable
+{
+public:
+	CConditionVariable() { InitializeConditionVariable( &m_condition ); }
+
+	// Releases the lock while waiting. Returns false if the timeout expired.
+	bool Wait( CCriticalSection& lock, DWORD timeoutMs = INFINITE ) { return SleepConditionVariableCS( &m_condition, &lock.m_section, timeoutMs ) != FALSE; }
+	void NotifyOne() { WakeConditionVariable( &m_condition ); }
+	void NotifyAll() { WakeAllConditionVariable( &m_condition ); }
+
+private:
+	CONDITION_VARIABLE m_condition;
+
+	CConditionVariable( const CConditionVariable& );
+	CConditionVariable& operator=( const CConditionVariable& );
+};
+
+//--------------------------------------------------------------------------------------
+// Runs a function on a new OS thread.
+class CThread
+{
+public:
+	typedef std::function<void ()> TThreadFunc;
+
+	CThread() : m_handle(NULL) {}
+	~CThread() { Join(); }
+
+	// Starts the thread. Returns false if the thread is already running or could not be created.
+	bool Start( const TThreadFunc& func );
+	// Waits for the thread to finish.
+	void Join();
+	bool IsStarted() const { return m_handle != NULL; }
+
+	// Number of logical processors available to this process.
+	static unsigned int GetHardwareThreadCount();
+
+private:
+	HANDLE m_handle;
+	TThreadFunc m_func;
+
+	static DWORD WINAPI ThreadProc( LPVOID pParam );
+
+	CThread( const CThread& );
+	CThread& operator=( const CThread& );
+};
@@ -0,0 +1,141 @@
+#include "StdAfx.h"
+#include "TraceRecorder.h"
+
+#include <fstream>
+
+volatile bool CTraceRecorder::s_recording = false;
+unsigned int CTraceRecorder::s_detailDepth = CTraceRecorder::DefaultDetailDepth;
+unsigned int CTraceRecorder::s_eventsPerThread = CTraceRecorder::DefaultEventsPerThread;
+__int64 CTraceRecorder::s_startTicks = 0;
+__declspec(thread) CTraceRecorder::SThreadBuffer* CTraceRecorder::s_pThreadBuffer = NULL;
+std::list<CTraceRecorder::SThreadBuffer> CTraceRecorder::s_buffers;
+std::vector<CTraceRecorder::SThreadBuffer*> CTraceRecorder::s_freeBuffers;
+CCriticalSection CTraceRecorder::s_buffersLock;
+
+//--------------------------------------------------------------------------------------
+void CTraceRecorder::Start( unsigned int eventsPerThread, unsigned int detailDepth )
+{
+	s_eventsPerThread = eventsPerThread ? eventsPerThread : 1;
+	s_detailDepth = detailDepth;
+	for( std::list<SThreadBuffer>::iterator it = s_buffers.begin(); it != s_buffers.end(); ++it )
+	{
+		it->m_count = 0;
+		it->m_events.resize( s_eventsPerThread );
+	}
+
+	LARGE_INTEGER now;
+	QueryPerformanceCounter( &now );
+	s_startTicks = now.QuadPart;
+	s_recording = true;
+}
+
+//--------------------------------------------------------------------------------------
+void CTraceRecorder::Stop()
+{
+	s_recording = false;
+}
+
+//--------------------------------------------------------------------------------------
+void CTraceRecorder::Record( char phase, const char* name, const char* argName, __int64 arg )
+{
+	if( !s_recording )
+		return;
+
+	SThreadBuffer* pBuffer = s_pThreadBuffer ? s_pThreadBuffer : AddThreadBuffer();
+	SEvent& event = pBuffer->m_events[ (size_t)( pBuffer->m_count % pBuffer->m_events.size() ) ];
+	LARGE_INTEGER now;
+	QueryPerformanceCounter( &now );
+	event.m_ticks = now.QuadPart;
+	event.m_name = name;
+	event.m_argName = argName;
+	event.m_arg = arg;
+	event.m_phase = phase;
+	pBuffer->m_count++;
+}
+
+//--------------------------------------------------------------------------------------
+CTraceRecorder::SThreadBuffer* CTraceRecorder::AddThreadBuffer()
+{
+	CScopedLock<CCriticalSection> lock( s_buffersLock );
+	if( !s_freeBuffers.empty() )
+	{
+		// Events go on after those of the thread that left, which ended before this one began.
+		s_pThreadBuffer = s_freeBuffers.back();
+		s_freeBuffers.pop_back();
+		return s_pThreadBuffer;
+	}
+
+	s_buffers.push_back( SThreadBuffer() );
+	SThreadBuffer& buffer = s_buffers.back();
+	buffer.m_index = (unsigned int)s_buffers.size();
+	buffer.m_count = 0;
+	buffer.m_events.resize( s_eventsPerThread );
+	s_pThreadBuffer = &buffer;
+	return &buffer;
+}
+
+//--------------------------------------------------------------------------------------
+void CTraceRecorder::ReleaseThreadBuffer()
+{
+	if( !s_pThreadBuffer )
+		return;
+
+	CScopedLock<CCriticalSection> lock( s_buffersLock );
+	s_freeBuffers.push_back( s_pThreadBuffer );
+	s_pThreadBuffer = NULL;
+}
+
+//--------------------------------------------------------------------------------------
+bool CTraceRecorder::Write( const std::string& path )
+{
+	std::ofstream file( path.c_str() );
+	if( !file )
+		return false;
+
+	LARGE_INTEGER frequency;
+	QueryPerformanceFrequency( &frequency );
+	const double usPerTick = 1000000.0 / (double)frequency.QuadPart;
+	file.setf( std::ios::fixed );
+	file.precision( 3 );
+
+	file << "{\"traceEvents\":[" << std::endl;
+	bool first = true;
+	for( std::list<SThreadBuffer>::const_iterator it = s_buffers.begin(); it != s_buffers.end(); ++it )
+	{
+		const SThreadBuffer& buffer = *it;
+		if( !buffer.m_count )
+			continue;
+
+		file << ( first ? "" : ",\n" ) << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << buffer.m_index
+		     << ",\"args\":{\"name\":\"thread " << buffer.m_index << "\"}}";
+		first = false;
+
+		// A full buffer starts with its oldest surviving event.  Ends whose begin was
+		// overwritten are dropped so the viewer does not close the wrong span.
+		const unsigned __int64 size = buffer.m_events.size();
+		const unsigned __int64 begin = ( buffer.m_count > size ) ? buffer.m_count - size : 0;
+		unsigned int openSpans = 0;
+		for( unsigned __int64 i = begin; i < buffer.m_count; ++i )
+		{
+			const SEvent& event = buffer.m_events[ (size_t)( i % size ) ];
+			if( event.m_phase == 'B' )
+				openSpans++;
+			else if( event.m_phase == 'E' )
+			{
+				if( !openSpans )
+					continue;
+				openSpans--;
+			}
+
+			file << ",\n{\"name\":\"" << event.m_name << "\",\"ph\":\"" << event.m_phase << "\",\"ts\":"
+			     << (double)( event.m_ticks - s_startTicks ) * usPerTick << ",\"pid\":1,\"tid\":" << buffer.m_index;
+			if( event.m_phase == 'i' )
+				file << ",\"s\":\"t\"";
+			if( event.m_argName )
+				file << ",\"args\":{\"" << event.m_argName << "\":" << event.m_arg << "}";
+			file << "}";
+		}
+	}
+	file << "\n],\"displayTimeUnit\":\"ms\"}" << std::endl;
+	return file.good();
+}
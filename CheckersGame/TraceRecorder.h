@@ -0,0 +1,133 @@
+#pragma once
+
+#include "stdafx.h"
+
+#include "PerfTimer.h"
+#include "Threading.h"
+
+#include <list>
+#include <string>
+#include <vector>
+
+//--------------------------------------------------------------------------------------
+// Timeline of search activity in the Chrome Trace Event format, which chrome://tracing and
+// Perfetto load.  Each thread records into a ring buffer of its own, so recording takes no
+// locks and keeps the latest events once a buffer is full.  A CThread hands its buffer back
+// when it exits and the next thread to record takes it over, on the same track of the trace,
+// so there are never more buffers than threads recording at once.  Recording is off until
+// Start; events then cost a clock read and a few stores.
+//
+// Start, Stop and Write must be called while no traced thread is running.  Event and
+// argument names are stored as pointers, so they must be string literals.
+class CTraceRecorder
+{
+public:
+	enum { DefaultEventsPerThread = 1 << 16, DefaultDetailDepth = 1 };
+
+	// Starts recording, dropping any earlier events.  Searches trace their AlphaBeta calls
+	// down to detailDepth plies below the root; 1 traces each root move.
+	static void Start( unsigned int eventsPerThread = DefaultEventsPerThread, unsigned int detailDepth = DefaultDetailDepth );
+	static void Stop();
+
+	static bool IsRecording() { return s_recording; }
+	// Plies of each search to trace, 0 while not recording.
+	static unsigned int GetDetailDepth() { return s_recording ? s_detailDepth : 0; }
+
+	// Duration and instant events of the calling thread.  Ignored while not recording.
+	static void Begin( const char* name, const char* argName = NULL, __int64 arg = 0 ) { Record( 'B', name, argName, arg ); }
+	static void End( const char* name, const char* argName = NULL, __int64 arg = 0 ) { Record( 'E', name, argName, arg ); }
+	static void Instant( const char* name, const char* argName = NULL, __int64 arg = 0 ) { Record( 'i', name, argName, arg ); }
+
+	// Writes the recorded events as a JSON trace.  Returns false if the file cannot be written.
+	static bool Write( const std::string& path );
+
+	// Gives the buffer of the calling thread, events and all, to the next thread that records.
+	// Called by every CThread as it exits.
+	static void ReleaseThreadBuffer();
+
+private:
+	struct SEvent
+	{
+		const char* m_name;
+		const char* m_argName;
+		__int64 m_arg;
+		__int64 m_ticks;
+		char m_phase;
+	};
+
+	struct SThreadBuffer
+	{
+		unsigned int m_index;
+		// Events written since Start; the buffer holds the last m_events.size() of them.
+		unsigned __int64 m_count;
+		std::vector<SEvent> m_events;
+	};
+
+	static volatile bool s_recording;
+	static unsigned int s_detailDepth;
+	static unsigned int s_eventsPerThread;
+	static __int64 s_startTicks;
+	static __declspec(thread) SThreadBuffer* s_pThreadBuffer;
+	// Every buffer made, kept across Start so the thread pointers stay valid.
+	static std::list<SThreadBuffer> s_buffers;
+	// Buffers of exited threads, waiting for a thread to take them.
+	static std::vector<SThreadBuffer*> s_freeBuffers;
+	static CCriticalSection s_buffersLock;
+
+	static void Record( char phase, const char* name, const char* argName, __int64 arg );
+	// Finds the calling thread a buffer on its first event, a released one if there is any.
+	static SThreadBuffer* AddThreadBuffer();
+};
+
+//--------------------------------------------------------------------------------------
+// Records a duration event for the enclosing scope.  A NULL name records nothing, which
+// lets callers trace only some calls of a function.
+class CTraceScope
+{
+public:
+	CTraceScope( const char* name, const char* argName = NULL, __int64 arg = 0 )
+		: m_name( ( name && CTraceRecorder::IsRecording() ) ? name : NULL )
+		, m_endArgName( NULL )
+		, m_endArg( 0 )
+	{
+		if( m_name )
+			CTraceRecorder::Begin( m_name, argName, arg );
+	}
+	~CTraceScope()
+	{
+		if( m_name )
+			CTraceRecorder::End( m_name, m_endArgName, m_endArg );
+	}
+
+	// Attaches a value known only at the end, such as a node count, to the event.
+	void SetEndArg( const char* argName, __int64 arg ) { m_endArgName = argName; m_endArg = arg; }
+
+private:
+	const char* m_name;
+	const char* m_endArgName;
+	__int64 m_endArg;
+};
+
+//--------------------------------------------------------------------------------------
+// A CTraceScope for hot recursive calls, recording only those made fewer plies below the root
+// than the recorder's detail depth.  Like CPerfTimerScope it is compiled out below
+// PERF_LEVEL_TIME, so a release search pays nothing for it, not even the recording test.
+template <int level>
+class CTraceDepthScope
+{
+public:
+	CTraceDepthScope( const char*, const char*, unsigned int ) {}
+};
+
+template <>
+class CTraceDepthScope<PERF_LEVEL_TIME>
+{
+public:
+	CTraceDepthScope( const char* name, const char* argName, unsigned int depth )
+		: m_scope( ( depth < CTraceRecorder::GetDetailDepth() ) ? name : NULL, argName, depth )
+	{
+	}
+
+private:
+	CTraceScope m_scope;
+};
@@ -3,92 +3,291 @@
 
 #include "stdafx.h"
 
+#include "AsyncSearch.inl"
 #include "Display.h"
-#include "ComputerPlayer.h"
-#include "ComputerPlayer.inl"
+#include "CommandLine.h"
+#include "ConfigFile.h"
+#include "EvalTuner.h"
+#include "Pdn.h"
+#include "PositionDb.h"
+#include "SelfPlay.h"
+#include "Tournament.h"
+#include "TraceRecorder.h"
 
-#include <time.h>
+#include <fstream>
 #include <iostream>
 using namespace std;
 
-bool UserMove( CCheckersBoard& board, const CDisplay& display, EPlayer userPlayer );
+bool UserMove( CCheckersBoard& board, const CDisplay& display, EPlayer userPlayer, CMove& move );
+void PlayUser( const STournamentConfig& config );
+int ReplayPdn( const string& path, const string& positionsPath, unsigned int threads );
+int TuneWeights( const string& positionsPath, const SEvalWeights& start, const string& outPath, const CEvalTuner::SConfig& tunerConfig );
 
 
 int _tmain(int argc, _TCHAR* argv[])
 {
-	srand( (unsigned int)time(NULL) );
+	CCommandLine commandLine( argc, argv );
 
-	
-	CComputerPlayer<CCheckersBoard> p1( Player_Red, 3 );
-	CComputerPlayer<CCheckersBoard> p2( Player_Black, 10 );
-	//EPlayer p2 = CCheckersBoard::GetOpponent( p1.GetPlayer() );
+	// Engines and match settings come from an optional config file, see tournament.ini.
+	STournamentConfig config;
+	string configPath = commandLine.GetPositional( 0 );
+	if( !configPath.empty() )
+	{
+		CConfigFile file;
+		if( !file.Load( configPath ) )
+		{
+			cout << "Unable to read " << configPath << endl;
+			return 1;
+		}
+		config.Load( file );
+	}
+	config.m_games = commandLine.GetInt( "games", config.m_games );
+	config.m_threads = commandLine.GetInt( "threads", config.m_threads );
+	config.m_seed = commandLine.GetInt( "seed", config.m_seed );
+	config.m_pdnPath = commandLine.GetString( "pdn", config.m_pdnPath );
+
+	// Check every game of a PDN file against the rules.
+	if( commandLine.HasOption( "replay" ) )
+		return ReplayPdn( commandLine.GetString( "replay" ), commandLine.GetString( "positions" ), config.m_threads );
+
+	// Generate training positions from engine1 playing itself at a shallow depth.
+	if( commandLine.HasOption( "selfplay" ) )
+	{
+		SSelfPlayConfig selfPlayConfig( config );
+		selfPlayConfig.m_player.m_depth = commandLine.GetInt( "depth", 4 );
+		selfPlayConfig.m_player.m_timeLimitMs = 0;
+		selfPlayConfig.m_randomPlies = commandLine.GetInt( "randomPlies", selfPlayConfig.m_randomPlies );
+		CSelfPlay selfPlay( selfPlayConfig );
+		return selfPlay.Run( commandLine.GetString( "selfplay" ), cout ) ? 0 : 1;
+	}
+
+	// Fit engine1's weights to the results of a position database.
+	if( commandLine.HasOption( "tune" ) )
+	{
+		CEvalTuner::SConfig tunerConfig;
+		tunerConfig.m_threads = config.m_threads;
+		tunerConfig.m_iterations = commandLine.GetInt( "iterations", tunerConfig.m_iterations );
+		return TuneWeights( commandLine.GetString( "tune" ), config.m_engines[0].m_player.m_weights, commandLine.GetString( "out", "weights.ini" ), tunerConfig );
+	}
+
+	// Record a timeline of the searches for chrome://tracing or Perfetto.
+	string tracePath = commandLine.GetString( "trace" );
+	if( !tracePath.empty() )
+		CTraceRecorder::Start( commandLine.GetInt( "traceEvents", CTraceRecorder::DefaultEventsPerThread ), commandLine.GetInt( "traceDepth", CTraceRecorder::DefaultDetailDepth ) );
+
+	// Play against engine1 from the console.
+	if( commandLine.HasOption( "play" ) )
+		PlayUser( config );
+	else
+	{
+		CTournament tournament( config );
 
-	unsigned int p1Wins = 0;
-	unsigned int p2Wins = 0;
+		// Watch a single game board by board.
+		if( commandLine.HasOption( "watch" ) )
+		{
+			switch( tournament.PlayGame( 0, &cout ) )
+			{
+			case CTournament::GameResult_Engine1Win:
+				cout << config.m_engines[0].m_name << " Wins!" << endl;
+				break;
+			case CTournament::GameResult_Engine2Win:
+				cout << config.m_engines[1].m_name << " Wins!" << endl;
+				break;
+			default:
+				cout << "Tie." << endl;
+				break;
+			}
+		}
+		else
+			tournament.Run( cout );
+	}
 
-	for( ;; ) // for repeated testing.
+	if( !tracePath.empty() )
 	{
+		CTraceRecorder::Stop();
+		if( !CTraceRecorder::Write( tracePath ) )
+		{
+			cout << "Unable to write " << tracePath << endl;
+			return 1;
+		}
+	}
+	return 0;
+}
+
+//--------------------------------------------------------------------------------------
+// The computer plays red and thinks on the user's time, guessing the user's reply.
+void PlayUser( const STournamentConfig& config )
+{
+	CAsyncSearch<CCheckersBoard> computer( Player_Red, config.m_engines[0].m_player );
+
 	CDisplay display;
 	CCheckersBoard board;
-
+	CGameHistory history( config.m_noProgressMoves );
+	history.Push( board.GetHashKey(), false );
 	display.Show( cout, board );
-	cout << endl;
-	for( ;; ) 
+
+	computer.Start( board, history );
+	for( ;; )
 	{
-		if( !p1.Move( board ) )
+		SSearchResult result = computer.Wait();
+		bool reversible = result.m_found && board.IsReversibleMove( Player_Red, result.m_bestMove );
+		if( !result.m_found || !board.MakeMoveIfValid( Player_Red, result.m_bestMove ) )
 		{
-			display.Show( cout, board );
-			break;
+			cout << "You Win!" << endl;
+			return;
 		}
+		history.Push( board.GetHashKey(), reversible );
 
+		cout << endl;
 		display.Show( cout, board );
-		cout << "P1: " << board.CalculatePlayerScore( p1.GetPlayer() ) << endl << endl;
+		cout << "depth=" << result.m_stats.m_depth << " nodes=" << result.m_stats.m_nodes
+		     << " ms=" << result.m_stats.m_elapsedUs / 1000 << ( result.m_ponderHit ? " ponderhit" : "" ) << endl;
+		if( history.IsDraw( config.m_repetitions ) )
+		{
+			cout << "Tie." << endl;
+			return;
+		}
 
-		// if( !UserMove( board, display, p2 ) ) break;
+		computer.Ponder( board, history );
 
-		if( !p2.Move( board ) )
+		CMove move;
+		CCheckersBoard before( board );
+		if( !UserMove( board, display, Player_Black, move ) )
 		{
-			display.Show( cout, board );
-			break;
+			computer.Cancel();
+			cout << "Computer Wins!" << endl;
+			return;
 		}
+		history.Push( board.GetHashKey(), before.IsReversibleMove( Player_Black, move ) );
 
 		display.Show( cout, board );
-		cout << "P2: " << board.CalculatePlayerScore( p2.GetPlayer() ) << endl << endl;
+		if( history.IsDraw( config.m_repetitions ) )
+		{
+			computer.Cancel();
+			cout << "Tie." << endl;
+			return;
+		}
+
+		computer.OpponentMoved( board, move, history );
 	}
+}
 
-	int p1Score = board.CalculatePlayerScore( p1.GetPlayer() );
-	int p2Score = board.CalculatePlayerScore( p2.GetPlayer() );
-	if( p1Score > p2Score )
+//--------------------------------------------------------------------------------------
+// Replays a PDN file on every core and prints the games that break the rules.
+// Every position of the valid games is written to a position database if a path is given.
+int ReplayPdn( const string& path, const string& positionsPath, unsigned int threads )
+{
+	ifstream file( path.c_str(), ios::in | ios::binary );
+	if( !file )
 	{
-		p1Wins++;
-		cout << "Player 1 Wins!" << endl;
+		cout << "Unable to read " << path << endl;
+		return 1;
 	}
-	else if( p2Score > p1Score )
+
+	CPositionDbWriter positions;
+	if( !positionsPath.empty() && !positions.Open( positionsPath ) )
 	{
-		p2Wins++;
-		cout << "Player 2 Wins!" << endl;
+		cout << "Unable to write " << positionsPath << endl;
+		return 1;
 	}
-	else
-		cout << "Tie." << endl;
-	cout << "[ p1: " << p1Wins << " ; p2: " << p2Wins << "]" << endl;
-
-	cout << "DONE" << endl;
-	cout << CCheckersBoard::s_GetMoves;
-	cout << CCheckersBoard::s_AddSimpleMoves;
-	cout << CCheckersBoard::s_AddJumpMoves;
-	cout << CCheckersBoard::s_AddNextJumpMoves;
-	cout << CCheckersBoard::s_IsValidMove;
-	cout << CCheckersBoard::s_MakeMoveIfValid;
-	cout << CComputerPlayer<CCheckersBoard>::s_AlphaBeta;
-	cout << CComputerPlayer<CCheckersBoard>::s_Move;
-
-	cin.get();
+
+	CCriticalSection outputLock;
+	CStopwatch stopwatch;
+	CPdnBatchReplay replay( threads );
+	CPdnBatchReplay::SStats stats = replay.Run( file, [&]( const SPdnGame& game, const SPdnReplay& result ) {
+		if( !result.m_error.empty() )
+		{
+			CScopedLock<CCriticalSection> lock( outputLock );
+			cout << "invalid line=" << game.m_line << " " << result.m_error << endl;
+			return;
+		}
+		if( positionsPath.empty() )
+			return;
+
+		// PDN White is Player_Black.
+		SPositionRecord record;
+		if( game.m_result == "1-0" )
+			record.m_result = SPositionRecord::Result_BlackWin;
+		else if( game.m_result == "0-1" )
+			record.m_result = SPositionRecord::Result_RedWin;
+		else if( game.m_result == "1/2-1/2" )
+			record.m_result = SPositionRecord::Result_Draw;
+
+		std::vector<SPositionRecord> records;
+		records.reserve( result.m_moves.size() + 1 );
+		CCheckersBoard board( result.m_start );
+		EPlayer toMove = result.m_startToMove;
+		for( size_t i = 0; ; ++i )
+		{
+			record.FromBoard( board, toMove );
+			records.push_back( record );
+			if( i == result.m_moves.size() )
+				break;
+			board.MakeMoveIfValid( toMove, result.m_moves[i] );
+			toMove = CCheckersBoard::GetOpponent( toMove );
+		}
+
+		CScopedLock<CCriticalSection> lock( outputLock );
+		for( size_t i = 0; i < records.size(); ++i )
+			positions.Append( records[i] );
+	} );
+	positions.Close();
+
+	if( stats.m_syntaxErrors )
+		cout << "syntax " << stats.m_firstSyntaxError << endl;
+
+	double seconds = stopwatch.GetElapsedUs() / 1000000.0;
+	cout << "games=" << stats.m_games
+	     << " invalid=" << stats.m_invalidGames
+	     << " syntaxErrors=" << stats.m_syntaxErrors
+	     << " plies=" << stats.m_plies
+	     << " positions=" << positions.GetCount()
+	     << " seconds=" << seconds
+	     << " gamesPerSec=" << ( seconds > 0.0 ? stats.m_games / seconds : 0.0 ) << endl;
+	return ( stats.m_invalidGames || stats.m_syntaxErrors ) ? 1 : 0;
+}
+
+//--------------------------------------------------------------------------------------
+// Tunes the evaluation weights on a position database and writes them to a weight file.
+int TuneWeights( const string& positionsPath, const SEvalWeights& start, const string& outPath, const CEvalTuner::SConfig& tunerConfig )
+{
+	CPositionDb db;
+	if( !db.Open( positionsPath ) )
+	{
+		cout << "Unable to read " << positionsPath << endl;
+		return 1;
+	}
+
+	CStopwatch stopwatch;
+	CEvalTuner tuner( tunerConfig );
+	size_t samples = tuner.Load( db );
+	cout << "records=" << db.GetCount() << " samples=" << samples << " loadSeconds=" << stopwatch.GetElapsedUs() / 1000000.0 << endl;
+	if( !samples )
+	{
+		cout << "No positions with a result to tune on" << endl;
+		return 1;
 	}
 
+	double scale = tuner.FitScale( start );
+	double startError = tuner.GetError( start );
+	cout << "scale=" << scale << " error=" << startError << endl;
+
+	SEvalWeights weights = tuner.Tune( start, cout );
+	double error = tuner.GetError( weights );
+	cout << "error=" << error << " improvement=" << startError - error << " seconds=" << stopwatch.GetElapsedUs() / 1000000.0 << endl;
+	for( int i = 0; i < SEvalWeights::FeatureCount; ++i )
+		cout << SEvalWeights::GetFeatureName( (SEvalWeights::EFeature)i ) << "=" << weights.m_values[i] << ( i + 1 < SEvalWeights::FeatureCount ? " " : "\n" );
+
+	if( !weights.Save( outPath ) )
+	{
+		cout << "Unable to write " << outPath << endl;
+		return 1;
+	}
 	return 0;
 }
 
-bool UserMove( CCheckersBoard& board, const CDisplay& display, EPlayer userPlayer)
+//--------------------------------------------------------------------------------------
+bool UserMove( CCheckersBoard& board, const CDisplay& display, EPlayer userPlayer, CMove& move )
 {
 	std::vector<CMove> moves;
 	if( !board.GetMoves( userPlayer, moves ) )
@@ -96,11 +295,12 @@ bool UserMove( CCheckersBoard& board, const CDisplay& display, EPlayer userPlaye
 	if( moves.empty() )
 		return false;
 
-	unsigned int selection;
+	unsigned int selection = 0;
 	do {
 		display.ShowMoves( cout, moves );
 		cout << "Please select a move: ";
-		cin >> selection;
+		if( !( cin >> selection ) )
+			return false;
 	} while( selection >= moves.size() );
 	if( !board.MakeMoveIfValid( userPlayer, moves[selection] ) )
 	{
@@ -108,5 +308,6 @@ bool UserMove( CCheckersBoard& board, const CDisplay& display, EPlayer userPlaye
 		return false;
 	}
 
+	move = moves[selection];
 	return true;
-}
\ No newline at end of file
+}
@@ -0,0 +1,197 @@
+#include "StdAfx.h"
+#include "SelfPlay.h"
+
+#include "ComputerPlayer.inl"
+#include "Random.h"
+
+#include <vector>
+
+//--------------------------------------------------------------------------------------
+SSelfPlayConfig::SSelfPlayConfig()
+	: m_player( 4 )
+	, m_games( 1000 )
+	, m_threads( 0 )
+	, m_randomPlies( 6 )
+	, m_maxPlies( 400 )
+	, m_noProgressMoves( CGameHistory::DefaultNoProgressMoves )
+	, m_repetitions( 3 )
+	, m_seed( 1 )
+	, m_reportInterval( 100 )
+{
+}
+
+//--------------------------------------------------------------------------------------
+SSelfPlayConfig::SSelfPlayConfig( const STournamentConfig& config )
+	: m_player( config.m_engines[0].m_player )
+	, m_games( config.m_games )
+	, m_threads( config.m_threads )
+	, m_randomPlies( 6 )
+	, m_maxPlies( config.m_maxPlies )
+	, m_noProgressMoves( config.m_noProgressMoves )
+	, m_repetitions( config.m_repetitions )
+	, m_seed( config.m_seed )
+	, m_reportInterval( config.m_reportInterval )
+{
+}
+
+//--------------------------------------------------------------------------------------
+CSelfPlay::CSelfPlay( const SSelfPlayConfig& config )
+	: m_config( config )
+	, m_nextGame( 0 )
+	, m_positions( 0 )
+{
+}
+
+//--------------------------------------------------------------------------------------
+bool CSelfPlay::Run( const std::string& path, std::ostream& os )
+{
+	CConcurrentPositionDbWriter db;
+	if( !db.Open( path ) )
+	{
+		os << "Unable to write " << path << std::endl;
+		return false;
+	}
+
+	unsigned int threadCount = m_config.m_threads ? m_config.m_threads : CThread::GetHardwareThreadCount();
+	if( threadCount > m_config.m_games )
+		threadCount = m_config.m_games ? m_config.m_games : 1;
+
+	os << "selfplay games=" << m_config.m_games << " depth=" << m_config.m_player.m_depth
+	   << " randomPlies=" << m_config.m_randomPlies << " threads=" << threadCount << std::endl;
+
+	m_nextGame = 0;
+	m_positions = 0;
+	m_wallTime.Restart();
+	std::vector<SWorkerStats> stats( threadCount );
+	{
+		std::vector<CThread*> threads( threadCount );
+		for( unsigned int i = 0; i < threadCount; ++i )
+		{
+			threads[i] = new CThread;
+			SWorkerStats* pStats = &stats[i];
+			CConcurrentPositionDbWriter* pDb = &db;
+			threads[i]->Start( [this, pDb, pStats, &os]() { Worker( *pDb, *pStats, os ); } );
+		}
+		for( unsigned int i = 0; i < threadCount; ++i )
+		{
+			threads[i]->Join();
+			delete threads[i];
+		}
+	}
+	const bool written = db.Close();
+	const double seconds = m_wallTime.GetElapsedUs() / 1000000.0;
+
+	SWorkerStats total;
+	for( unsigned int i = 0; i < threadCount; ++i )
+	{
+		total.m_games += stats[i].m_games;
+		total.m_positions += stats[i].m_positions;
+		total.m_nodes += stats[i].m_nodes;
+		for( int r = 0; r < 3; ++r )
+			total.m_results[r] += stats[i].m_results[r];
+	}
+
+	os << "games=" << total.m_games
+	   << " redWins=" << total.m_results[ 1 + SPositionRecord::Result_RedWin ]
+	   << " blackWins=" << total.m_results[ 1 + SPositionRecord::Result_BlackWin ]
+	   << " draws=" << total.m_results[ 1 + SPositionRecord::Result_Draw ] << std::endl;
+	os << "positions=" << db.GetCount()
+	   << " nodes=" << total.m_nodes
+	   << " seconds=" << seconds
+	   << " positionsPerSec=" << ( seconds > 0.0 ? total.m_positions / seconds : 0.0 )
+	   << " gamesPerSec=" << ( seconds > 0.0 ? total.m_games / seconds : 0.0 )
+	   << " nps=" << ( seconds > 0.0 ? total.m_nodes / seconds : 0.0 ) << std::endl;
+	if( !written )
+		os << "Unable to write " << path << std::endl;
+	return written;
+}
+
+//--------------------------------------------------------------------------------------
+void CSelfPlay::Worker( CConcurrentPositionDbWriter& db, SWorkerStats& stats, std::ostream& os )
+{
+	CPositionDbThreadWriter writer( db );
+	std::vector<SPositionRecord> records;
+	for( ;; )
+	{
+		LONG gameIndex = InterlockedIncrement( &m_nextGame ) - 1;
+		if( gameIndex >= (LONG)m_config.m_games )
+			break;
+
+		records.clear();
+		const int result = PlayGame( gameIndex, records, stats );
+		for( size_t i = 0; i < records.size(); ++i )
+		{
+			records[i].m_result = (signed char)result;
+			writer.Append( records[i] );
+		}
+		stats.m_games++;
+		stats.m_positions += records.size();
+		stats.m_results[ 1 + result ]++;
+
+		const LONGLONG positions = InterlockedExchangeAdd64( &m_positions, (LONGLONG)records.size() ) + records.size();
+		if( m_config.m_reportInterval && ( gameIndex + 1 ) % m_config.m_reportInterval == 0 )
+		{
+			const double seconds = m_wallTime.GetElapsedUs() / 1000000.0;
+			CScopedLock<CCriticalSection> lock( m_outputLock );
+			os << "progress games=" << ( gameIndex + 1 ) << " positions=" << positions
+			   << " positionsPerSec=" << ( seconds > 0.0 ? positions / seconds : 0.0 ) << std::endl;
+		}
+	}
+}
+
+//--------------------------------------------------------------------------------------
+int CSelfPlay::PlayGame( unsigned int gameIndex, std::vector<SPositionRecord>& records, SWorkerStats& stats )
+{
+	// Each game seeds its opening and players, so a game plays out the same whichever thread runs it.
+	CRandom random( ( (unsigned __int64)m_config.m_seed << 32 ) | gameIndex );
+	TCheckersPlayer::SConfig config( m_config.m_player );
+	config.m_seed = m_config.m_seed + gameIndex;
+	TCheckersPlayer red( Player_Red, config );
+	TCheckersPlayer black( Player_Black, config );
+	TCheckersPlayer* players[2] = { &red, &black };
+
+	CCheckersBoard board;
+	CGameHistory history( m_config.m_noProgressMoves );
+	history.Push( board.GetHashKey(), false );
+
+	std::vector<CMove> moves;
+	SPositionRecord record;
+	for( unsigned int ply = 0; ply < m_config.m_maxPlies; ++ply )
+	{
+		const EPlayer toMove = ( ply % 2 ) ? Player_Black : Player_Red;
+		const int loss = ( toMove == Player_Red ) ? SPositionRecord::Result_BlackWin : SPositionRecord::Result_RedWin;
+
+		CMove move;
+		if( ply < m_config.m_randomPlies )
+		{
+			// The opening is not recorded: its moves were not chosen by a search.
+			moves.clear();
+			if( !board.GetMoves( toMove, moves ) || moves.empty() )
+				return loss;
+			move = moves[ random.NextBelow( (unsigned int)moves.size() ) ];
+		}
+		else
+		{
+			TCheckersPlayer& player = *players[ ply % 2 ];
+			if( !player.FindBestMove( board, move, &history ) )
+				return loss;
+
+			const SSearchStats& search = player.GetLastSearchStats();
+			stats.m_nodes += search.m_nodes;
+			record.FromBoard( board, toMove );
+			record.m_score = (short)search.m_score;
+			record.m_flags |= SPositionRecord::Flag_HasScore;
+			records.push_back( record );
+		}
+
+		bool reversible = board.IsReversibleMove( toMove, move );
+		if( !board.MakeMoveIfValid( toMove, move ) )
+			return loss;
+
+		history.Push( board.GetHashKey(), reversible );
+		if( history.IsDraw( m_config.m_repetitions ) )
+			return SPositionRecord::Result_Draw;
+	}
+
+	return SPositionRecord::Result_Draw;
+}
@@ -0,0 +1,68 @@
+#pragma once
+
+#include "Tournament.h"
+#include "PositionDb.h"
+#include "Threading.h"
+
+#include <iostream>
+
+//--------------------------------------------------------------------------------------
+struct SSelfPlayConfig
+{
+	// Both sides search with this config, usually engine1's at a shallow depth.
+	TCheckersPlayer::SConfig m_player;
+	unsigned int m_games;
+	// Worker threads, 0 uses every core.
+	unsigned int m_threads;
+	// Plies played at random before the searches take over, so games differ from the start.
+	unsigned int m_randomPlies;
+	// Draw rules as in STournamentConfig.
+	unsigned int m_maxPlies;
+	unsigned int m_noProgressMoves;
+	unsigned int m_repetitions;
+	unsigned int m_seed;
+	// Print a progress line every so many games, 0 for none.
+	unsigned int m_reportInterval;
+
+	SSelfPlayConfig();
+	// Takes the game rules, seed and engine1's player from a tournament config.
+	SSelfPlayConfig( const STournamentConfig& config );
+};
+
+//--------------------------------------------------------------------------------------
+// Generates training data: plays games against itself on every core and writes each searched
+// position with the score of its search and the result of its game to a position database.
+// Each worker buffers its records and writes them a block at a time through a concurrent
+// writer, so workers share nothing but a couple of counters.
+class CSelfPlay
+{
+public:
+	CSelfPlay( const SSelfPlayConfig& config );
+
+	// Plays the games into the database and prints progress followed by a key=value report.
+	// Returns false if the database could not be written.
+	bool Run( const std::string& path, std::ostream& os );
+
+private:
+	// Counters kept by each worker and merged at the end.
+	struct SWorkerStats
+	{
+		unsigned __int64 m_games;
+		unsigned __int64 m_positions;
+		unsigned __int64 m_nodes;
+		unsigned __int64 m_results[3];
+
+		SWorkerStats() : m_games(0), m_positions(0), m_nodes(0) { m_results[0] = m_results[1] = m_results[2] = 0; }
+	};
+
+	const SSelfPlayConfig m_config;
+
+	volatile LONG m_nextGame;
+	volatile LONGLONG m_positions;
+	CCriticalSection m_outputLock;
+	CStopwatch m_wallTime;
+
+	void Worker( CConcurrentPositionDbWriter& db, SWorkerStats& stats, std::ostream& os );
+	// Plays one game, appending its positions to records. Returns the SPositionRecord::EResult.
+	int PlayGame( unsigned int gameIndex, std::vector<SPositionRecord>& records, SWorkerStats& stats );
+};
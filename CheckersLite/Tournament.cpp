@@ -0,0 +1,326 @@
+#include "StdAfx.h"
+#include "Tournament.h"
+
+#include "ComputerPlayer.inl"
+#include "Display.h"
+
+#include <sstream>
+#include <stdlib.h>
+#include <vector>
+
+//--------------------------------------------------------------------------------------
+void SEngineConfig::Load( const CConfigFile& file, const std::string& section )
+{
+	m_name = file.GetString( section, "name", section );
+	m_player.m_depth = file.GetInt( section, "depth", m_player.m_depth );
+	m_player.m_timeLimitMs = file.GetInt( section, "time", m_player.m_timeLimitMs );
+	m_player.m_cacheSize = file.GetInt( section, "cacheSize", m_player.m_cacheSize );
+	m_player.m_tablePages.m_hugePages = file.GetInt( section, "hugePages", m_player.m_tablePages.m_hugePages ? 1 : 0 ) != 0;
+	std::string numa = file.GetString( section, "numa", SPageConfig::GetNumaPolicyName( m_player.m_tablePages.m_numa ) );
+	const ENumaPolicy numaPolicy = SPageConfig::ParseNumaPolicy( numa.c_str() );
+	if( numaPolicy != NumaPolicyCount )
+		m_player.m_tablePages.m_numa = numaPolicy;
+	else
+		std::cerr << "Unknown NUMA policy " << numa << std::endl;
+	m_player.m_prefetch = file.GetInt( section, "prefetch", m_player.m_prefetch ? 1 : 0 ) != 0;
+	m_player.m_lmrMoves = file.GetInt( section, "lmrMoves", m_player.m_lmrMoves );
+	m_player.m_lmrDepth = file.GetInt( section, "lmrDepth", m_player.m_lmrDepth );
+	m_player.m_futilityDepth = file.GetInt( section, "futilityDepth", m_player.m_futilityDepth );
+	m_player.m_futilityMargin = file.GetInt( section, "futilityMargin", m_player.m_futilityMargin );
+	m_player.m_razorDepth = file.GetInt( section, "razorDepth", m_player.m_razorDepth );
+	m_player.m_razorMargin = file.GetInt( section, "razorMargin", m_player.m_razorMargin );
+	// A weight file from the tuner is read first so single weights can still be overridden.
+	std::string weightsPath = file.GetString( section, "weights" );
+	if( !weightsPath.empty() && !m_player.m_weights.Load( weightsPath ) )
+		std::cerr << "Cannot read weights " << weightsPath << std::endl;
+	m_player.m_weights.Load( file, section );
+
+	std::string networkPath = file.GetString( section, "network" );
+	if( !networkPath.empty() )
+	{
+		m_pNetwork.reset( new CNeuralNetwork() );
+		if( m_pNetwork->Load( networkPath, CCheckersBoard::NetworkInputCount ) )
+			m_player.m_pNetwork = m_pNetwork.get();
+		else
+			std::cerr << "Cannot read network " << networkPath << std::endl;
+	}
+}
+
+//--------------------------------------------------------------------------------------
+STournamentConfig::STournamentConfig()
+	: m_games( 100 )
+	, m_threads( 0 )
+	, m_maxPlies( 400 )
+	, m_noProgressMoves( CGameHistory::DefaultNoProgressMoves )
+	, m_repetitions( 3 )
+	, m_seed( 1 )
+	, m_reportInterval( 10 )
+	, m_sprt( false )
+	, m_elo0( 0.0 )
+	, m_elo1( 10.0 )
+	, m_alpha( 0.05 )
+	, m_beta( 0.05 )
+{
+	m_engines[0].m_name = "engine1";
+	m_engines[0].m_player.m_depth = 3;
+	m_engines[1].m_name = "engine2";
+	m_engines[1].m_player.m_depth = 10;
+}
+
+//--------------------------------------------------------------------------------------
+void STournamentConfig::Load( const CConfigFile& file )
+{
+	m_games = file.GetInt( "tournament", "games", m_games );
+	m_threads = file.GetInt( "tournament", "threads", m_threads );
+	m_maxPlies = file.GetInt( "tournament", "maxPlies", m_maxPlies );
+	m_noProgressMoves = file.GetInt( "tournament", "noProgressMoves", m_noProgressMoves );
+	m_repetitions = file.GetInt( "tournament", "repetitions", m_repetitions );
+	m_seed = file.GetInt( "tournament", "seed", m_seed );
+	m_reportInterval = file.GetInt( "tournament", "reportInterval", m_reportInterval );
+	m_pdnPath = file.GetString( "tournament", "pdn", m_pdnPath );
+
+	m_sprt = file.HasValue( "tournament", "elo0" ) || file.HasValue( "tournament", "elo1" );
+	m_elo0 = file.GetDouble( "tournament", "elo0", m_elo0 );
+	m_elo1 = file.GetDouble( "tournament", "elo1", m_elo1 );
+	m_alpha = file.GetDouble( "tournament", "alpha", m_alpha );
+	m_beta = file.GetDouble( "tournament", "beta", m_beta );
+
+	m_engines[0].Load( file, "engine1" );
+	m_engines[1].Load( file, "engine2" );
+}
+
+//--------------------------------------------------------------------------------------
+CTournament::CTournament( const STournamentConfig& config )
+	: m_config( config )
+	, m_nextGame( 0 )
+	, m_stop( 0 )
+{
+}
+
+//--------------------------------------------------------------------------------------
+void CTournament::Run( std::ostream& os )
+{
+	unsigned int threadCount = m_config.m_threads ? m_config.m_threads : CThread::GetHardwareThreadCount();
+	if( threadCount > m_config.m_games )
+		threadCount = m_config.m_games ? m_config.m_games : 1;
+
+	os << "engine1=" << m_config.m_engines[0].m_name << " engine2=" << m_config.m_engines[1].m_name
+	   << " games=" << m_config.m_games << " threads=" << threadCount << std::endl;
+
+	m_nextGame = 0;
+	m_stop = 0;
+	m_score = SMatchScore();
+	if( !m_config.m_pdnPath.empty() )
+	{
+		m_pdn.open( m_config.m_pdnPath.c_str(), std::ios::out | std::ios::app );
+		if( !m_pdn )
+			os << "Unable to write " << m_config.m_pdnPath << std::endl;
+	}
+
+	CStopwatch wallTime;
+	std::vector<SWorkerStats> stats( threadCount );
+	{
+		std::vector<CThread*> threads( threadCount );
+		for( unsigned int i = 0; i < threadCount; ++i )
+		{
+			threads[i] = new CThread;
+			SWorkerStats* pStats = &stats[i];
+			threads[i]->Start( [this, pStats, &os]() { Worker( *pStats, os ); } );
+		}
+		for( unsigned int i = 0; i < threadCount; ++i )
+		{
+			threads[i]->Join();
+			delete threads[i];
+		}
+	}
+	unsigned __int64 wallUs = wallTime.GetElapsedUs();
+
+	SWorkerStats total;
+	for( unsigned int i = 0; i < threadCount; ++i )
+	{
+		total.m_nodes += stats[i].m_nodes;
+		total.m_searchUs += stats[i].m_searchUs;
+		total.m_plies += stats[i].m_plies;
+		total.m_moveLatency.Merge( stats[i].m_moveLatency );
+	}
+	Report( os, total, wallUs );
+	if( m_pdn.is_open() )
+		m_pdn.close();
+}
+
+//--------------------------------------------------------------------------------------
+CTournament::EGameResult CTournament::PlayGame( unsigned int gameIndex, std::ostream* pShowBoards )
+{
+	SWorkerStats stats;
+	return PlayGame( gameIndex, stats, pShowBoards, NULL );
+}
+
+//--------------------------------------------------------------------------------------
+void CTournament::Worker( SWorkerStats& stats, std::ostream& os )
+{
+	while( !m_stop )
+	{
+		LONG gameIndex = InterlockedIncrement( &m_nextGame ) - 1;
+		if( gameIndex >= (LONG)m_config.m_games )
+			break;
+
+		SPdnGame record;
+		SPdnGame* pRecord = m_pdn.is_open() ? &record : NULL;
+		EGameResult result = PlayGame( gameIndex, stats, NULL, pRecord );
+		if( pRecord )
+		{
+			// Engine1 is red in even games, and red is PDN Black whose win is written 0-1.
+			const bool engine1Red = ( gameIndex % 2 ) == 0;
+			if( result == GameResult_Draw )
+				record.m_result = "1/2-1/2";
+			else if( ( result == GameResult_Engine1Win ) == engine1Red )
+				record.m_result = "0-1";
+			else
+				record.m_result = "1-0";
+			record.SetTag( "Result", record.m_result );
+		}
+
+		if( AddResult( result, pRecord, os ) )
+			InterlockedExchange( &m_stop, 1 );
+	}
+}
+
+//--------------------------------------------------------------------------------------
+CTournament::EGameResult CTournament::PlayGame( unsigned int gameIndex, SWorkerStats& stats, std::ostream* pShowBoards, SPdnGame* pRecord )
+{
+	// Alternate colours so neither engine always moves first.
+	const unsigned int redEngine = gameIndex % 2;
+
+	// Each game seeds its players, so a game plays out the same whichever thread runs it.
+	TCheckersPlayer::SConfig redConfig( m_config.m_engines[ redEngine ].m_player );
+	TCheckersPlayer::SConfig blackConfig( m_config.m_engines[ 1 - redEngine ].m_player );
+	redConfig.m_seed = blackConfig.m_seed = m_config.m_seed + gameIndex;
+	TCheckersPlayer red( Player_Red, redConfig );
+	TCheckersPlayer black( Player_Black, blackConfig );
+	TCheckersPlayer* players[2] = { &red, &black };
+	const unsigned int engineOf[2] = { redEngine, 1 - redEngine };
+
+	// PDN calls the side that moves first Black.
+	if( pRecord )
+	{
+		std::ostringstream round;
+		round << ( gameIndex + 1 );
+		pRecord->SetTag( "Event", "CheckersLite tournament" );
+		pRecord->SetTag( "Round", round.str() );
+		pRecord->SetTag( "Black", m_config.m_engines[ redEngine ].m_name );
+		pRecord->SetTag( "White", m_config.m_engines[ 1 - redEngine ].m_name );
+	}
+
+	CDisplay display;
+	CCheckersBoard board;
+	CGameHistory history( m_config.m_noProgressMoves );
+	history.Push( board.GetHashKey(), false );
+	if( pShowBoards )
+		display.Show( *pShowBoards, board );
+
+	for( unsigned int ply = 0; ply < m_config.m_maxPlies; ++ply )
+	{
+		TCheckersPlayer& player = *players[ ply % 2 ];
+
+		CStopwatch moveTime;
+		CMove move;
+		bool found = player.FindBestMove( board, move, &history );
+		stats.m_moveLatency.Add( moveTime.GetElapsedUs() );
+		stats.m_nodes += player.GetLastSearchStats().m_nodes;
+		stats.m_searchUs += player.GetLastSearchStats().m_elapsedUs;
+
+		// A player that cannot move has lost.
+		bool reversible = found && board.IsReversibleMove( player.GetPlayer(), move );
+		if( !found || !board.MakeMoveIfValid( player.GetPlayer(), move ) )
+			return ( engineOf[ ply % 2 ] == 0 ) ? GameResult_Engine2Win : GameResult_Engine1Win;
+
+		stats.m_plies++;
+		if( pRecord )
+			pRecord->m_moves.push_back( CPdn::FromMove( move ) );
+		if( pShowBoards )
+		{
+			*pShowBoards << std::endl;
+			display.Show( *pShowBoards, board );
+		}
+
+		// End dead games as soon as the rules allow instead of playing out the ply limit.
+		history.Push( board.GetHashKey(), reversible );
+		if( history.IsDraw( m_config.m_repetitions ) )
+			return GameResult_Draw;
+	}
+
+	return GameResult_Draw;
+}
+
+//--------------------------------------------------------------------------------------
+bool CTournament::AddResult( EGameResult result, const SPdnGame* pRecord, std::ostream& os )
+{
+	CScopedLock<CCriticalSection> lock( m_resultLock );
+
+	if( pRecord )
+		CPdnWriter( m_pdn ).WriteGame( *pRecord );
+
+	switch( result )
+	{
+	case GameResult_Engine1Win:
+		m_score.m_wins++;
+		break;
+	case GameResult_Engine2Win:
+		m_score.m_losses++;
+		break;
+	default:
+		m_score.m_draws++;
+		break;
+	}
+
+	unsigned int games = m_score.GetGames();
+	if( m_config.m_reportInterval && ( games % m_config.m_reportInterval ) == 0 )
+	{
+		os << "progress games=" << games
+		   << " wins=" << m_score.m_wins << " losses=" << m_score.m_losses << " draws=" << m_score.m_draws
+		   << " elo=" << m_score.GetEloDifference() << std::endl;
+	}
+
+	if( !m_config.m_sprt )
+		return false;
+
+	double llr = m_score.GetSprtLlr( m_config.m_elo0, m_config.m_elo1 );
+	return llr <= SMatchScore::GetSprtLowerBound( m_config.m_alpha, m_config.m_beta )
+		|| llr >= SMatchScore::GetSprtUpperBound( m_config.m_alpha, m_config.m_beta );
+}
+
+//--------------------------------------------------------------------------------------
+void CTournament::Report( std::ostream& os, SWorkerStats& total, unsigned __int64 wallUs ) const
+{
+	os << "games=" << m_score.GetGames()
+	   << " wins=" << m_score.m_wins
+	   << " losses=" << m_score.m_losses
+	   << " draws=" << m_score.m_draws << std::endl;
+	os << "score=" << m_score.GetScore()
+	   << " elo=" << m_score.GetEloDifference()
+	   << " elo95=" << m_score.GetEloErrorMargin() << std::endl;
+
+	if( m_config.m_sprt )
+	{
+		double llr = m_score.GetSprtLlr( m_config.m_elo0, m_config.m_elo1 );
+		double lower = SMatchScore::GetSprtLowerBound( m_config.m_alpha, m_config.m_beta );
+		double upper = SMatchScore::GetSprtUpperBound( m_config.m_alpha, m_config.m_beta );
+		const char* verdict = ( llr <= lower ) ? "H0" : ( llr >= upper ) ? "H1" : "none";
+		os << "sprt elo0=" << m_config.m_elo0 << " elo1=" << m_config.m_elo1
+		   << " llr=" << llr << " lower=" << lower << " upper=" << upper
+		   << " accepted=" << verdict << std::endl;
+	}
+
+	double wallSeconds = wallUs / 1000000.0;
+	double searchSeconds = total.m_searchUs / 1000000.0;
+	os << "nodes=" << total.m_nodes
+	   << " plies=" << total.m_plies
+	   << " seconds=" << wallSeconds
+	   << " nps=" << ( wallSeconds > 0.0 ? total.m_nodes / wallSeconds : 0.0 )
+	   << " threadNps=" << ( searchSeconds > 0.0 ? total.m_nodes / searchSeconds : 0.0 ) << std::endl;
+	os << "moveUs mean=" << total.m_moveLatency.GetMean()
+	   << " p50=" << total.m_moveLatency.GetPercentile( 50.0 )
+	   << " p90=" << total.m_moveLatency.GetPercentile( 90.0 )
+	   << " p99=" << total.m_moveLatency.GetPercentile( 99.0 )
+	   << " max=" << total.m_moveLatency.GetMax() << std::endl;
+}
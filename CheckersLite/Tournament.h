@@ -0,0 +1,117 @@
+#pragma once
+
+#include "CheckersBoard.h"
+#include "ComputerPlayer.h"
+#include "ConfigFile.h"
+#include "GameHistory.h"
+#include "LatencyStats.h"
+#include "MatchScore.h"
+#include "Pdn.h"
+#include "Threading.h"
+
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <string>
+
+typedef CComputerPlayer<CCheckersBoard> TCheckersPlayer;
+
+//--------------------------------------------------------------------------------------
+// One of the two engines playing in a tournament.
+struct SEngineConfig
+{
+	std::string m_name;
+	TCheckersPlayer::SConfig m_player;
+	// The network m_player evaluates with, if any, shared by every copy of the config.
+	std::shared_ptr<CNeuralNetwork> m_pNetwork;
+
+	// Reads the engine keys documented in tournament.ini from the given section; missing keys
+	// keep their defaults.
+	void Load( const CConfigFile& file, const std::string& section );
+};
+
+//--------------------------------------------------------------------------------------
+struct STournamentConfig
+{
+	SEngineConfig m_engines[2];
+	unsigned int m_games;
+	// Worker threads, 0 uses every core.
+	unsigned int m_threads;
+	// Games still running after this many plies are scored as a draw.
+	unsigned int m_maxPlies;
+	// Draw rules: moves per player without a capture or a man moving, 0 to disable, and how
+	// many times a position has to occur.
+	unsigned int m_noProgressMoves;
+	unsigned int m_repetitions;
+	unsigned int m_seed;
+	// Print a progress line every so many games, 0 for none.
+	unsigned int m_reportInterval;
+	// Every game is appended to this PDN file when set.
+	std::string m_pdnPath;
+
+	// Sequential probability ratio test of engine1 against engine2. Disabled when m_sprt is false.
+	bool m_sprt;
+	double m_elo0;
+	double m_elo1;
+	double m_alpha;
+	double m_beta;
+
+	STournamentConfig();
+
+	// Reads the [tournament], [engine1] and [engine2] sections.
+	void Load( const CConfigFile& file );
+};
+
+//--------------------------------------------------------------------------------------
+// Plays many games between two engines in parallel without any display.
+// Every game gets fresh players so the results do not depend on which thread ran it.
+class CTournament
+{
+public:
+	enum EGameResult
+	{
+		GameResult_Engine1Win,
+		GameResult_Engine2Win,
+		GameResult_Draw,
+
+		GameResultCount
+	};
+
+	CTournament( const STournamentConfig& config );
+
+	// Plays the games and prints progress followed by a key=value report.
+	void Run( std::ostream& os );
+
+	// Plays one game and optionally prints every board. Exposed for watching single games.
+	EGameResult PlayGame( unsigned int gameIndex, std::ostream* pShowBoards = NULL );
+
+	const SMatchScore& GetScore() const { return m_score; }
+
+private:
+	// Counters kept by each worker and merged at the end so workers never share them.
+	struct SWorkerStats
+	{
+		unsigned __int64 m_nodes;
+		unsigned __int64 m_searchUs;
+		unsigned __int64 m_plies;
+		CLatencyStats m_moveLatency;
+
+		SWorkerStats() : m_nodes(0), m_searchUs(0), m_plies(0) {}
+	};
+
+	const STournamentConfig m_config;
+
+	volatile LONG m_nextGame;
+	volatile LONG m_stop;
+
+	CCriticalSection m_resultLock;
+	SMatchScore m_score;
+	std::ofstream m_pdn;
+
+	void Worker( SWorkerStats& stats, std::ostream& os );
+	// Plays one game, recording its moves in pRecord if given.
+	EGameResult PlayGame( unsigned int gameIndex, SWorkerStats& stats, std::ostream* pShowBoards, SPdnGame* pRecord );
+	// Records a result and returns true if the tournament should stop early.
+	bool AddResult( EGameResult result, const SPdnGame* pRecord, std::ostream& os );
+	void Report( std::ostream& os, SWorkerStats& total, unsigned __int64 wallUs ) const;
+};